@@ -897,9 +897,77 @@ void DatafeedCallbackData::run(const struct sr_dev_inst *sdi,
 {
 	auto device = _session->get_device(sdi);
 	shared_ptr<Packet> packet {new Packet{device, pkt}, default_delete<Packet>{}};
+	/*
+	 * pkt is only valid until we return, but the callback may keep the
+	 * packet, or pass it to another thread. Take a reference before,
+	 * which shares the samples with the driver where possible.
+	 */
+	packet->retain();
 	_callback(move(device), move(packet));
 }
 
+DatafeedViewCallbackData::DatafeedViewCallbackData(Session *session,
+		DatafeedViewCallbackFunction callback) :
+	_callback(move(callback)),
+	_session(session)
+{
+}
+
+void DatafeedViewCallbackData::run(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *pkt)
+{
+	const PacketView view{pkt, device(sdi), this};
+	_callback(view._device, view);
+	/*
+	 * The cached objects keep their parents alive, which for devices
+	 * of a loaded session is the session itself. Drop them once the
+	 * acquisition is over.
+	 */
+	if (pkt->type == SR_DF_END)
+		clear();
+}
+
+const shared_ptr<Device> &DatafeedViewCallbackData::device(
+	const struct sr_dev_inst *sdi)
+{
+	for (const auto &entry : _devices)
+		if (entry.first == sdi)
+			return entry.second;
+	_devices.emplace_back(sdi, _session->get_device(sdi));
+	return _devices.back().second;
+}
+
+const vector<shared_ptr<Channel>> &DatafeedViewCallbackData::channels(
+	const shared_ptr<Device> &device, const GSList *list)
+{
+	for (const auto &entry : _channels) {
+		auto l = list;
+		auto key = entry.first.begin();
+		while (l && key != entry.first.end() && *key == l->data) {
+			l = l->next;
+			++key;
+		}
+		if (!l && key == entry.first.end())
+			return entry.second;
+	}
+
+	vector<struct sr_channel *> key;
+	vector<shared_ptr<Channel>> result;
+	for (auto l = list; l; l = l->next) {
+		auto *const ch = static_cast<struct sr_channel *>(l->data);
+		key.push_back(ch);
+		result.push_back(device->get_channel(ch));
+	}
+	_channels.emplace_back(move(key), move(result));
+	return _channels.back().second;
+}
+
+void DatafeedViewCallbackData::clear()
+{
+	_devices.clear();
+	_channels.clear();
+}
+
 SessionDevice::SessionDevice(struct sr_dev_inst *structure) :
 	Device(structure)
 {
@@ -1035,10 +1103,27 @@ void Session::add_datafeed_callback(DatafeedCallbackFunction callback)
 	_datafeed_callbacks.push_back(move(cb_data));
 }
 
+static void datafeed_view_callback(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *pkt, void *cb_data) noexcept
+{
+	auto callback = static_cast<DatafeedViewCallbackData *>(cb_data);
+	callback->run(sdi, pkt);
+}
+
+void Session::add_datafeed_view_callback(DatafeedViewCallbackFunction callback)
+{
+	unique_ptr<DatafeedViewCallbackData> cb_data
+		{new DatafeedViewCallbackData{this, move(callback)}};
+	check(sr_session_datafeed_callback_add(_structure,
+			&datafeed_view_callback, cb_data.get()));
+	_datafeed_view_callbacks.push_back(move(cb_data));
+}
+
 void Session::remove_datafeed_callbacks()
 {
 	check(sr_session_datafeed_callback_remove_all(_structure));
 	_datafeed_callbacks.clear();
+	_datafeed_view_callbacks.clear();
 }
 
 shared_ptr<Trigger> Session::trigger()
@@ -1069,6 +1154,7 @@ shared_ptr<Context> Session::context()
 Packet::Packet(shared_ptr<Device> device,
 	const struct sr_datafeed_packet *structure) :
 	_structure(structure),
+	_retained(nullptr),
 	_device(move(device))
 {
 	switch (structure->type)
@@ -1098,6 +1184,44 @@ Packet::Packet(shared_ptr<Device> device,
 
 Packet::~Packet()
 {
+	sr_packet_unref(_retained);
+}
+
+void Packet::retain()
+{
+	struct sr_datafeed_packet *ref;
+
+	if (_retained)
+		return;
+
+	check(sr_packet_ref(_structure, &ref));
+	_retained = ref;
+	_structure = ref;
+
+	/* Payload objects may already be shared, so update them in place. */
+	switch (ref->type)
+	{
+		case SR_DF_HEADER:
+			static_cast<Header *>(_payload.get())->_structure =
+				static_cast<const struct sr_datafeed_header *>(
+					ref->payload);
+			break;
+		case SR_DF_META:
+			static_cast<Meta *>(_payload.get())->_structure =
+				static_cast<const struct sr_datafeed_meta *>(
+					ref->payload);
+			break;
+		case SR_DF_LOGIC:
+			static_cast<Logic *>(_payload.get())->_structure =
+				static_cast<const struct sr_datafeed_logic *>(
+					ref->payload);
+			break;
+		case SR_DF_ANALOG:
+			static_cast<Analog *>(_payload.get())->_structure =
+				static_cast<const struct sr_datafeed_analog *>(
+					ref->payload);
+			break;
+	}
 }
 
 const PacketType *Packet::type() const
@@ -1356,6 +1480,124 @@ shared_ptr<Logic> Analog::get_logic_via_schmitt_trigger(float lo_thr,
 	return logic;
 }
 
+PacketView::PacketView(const struct sr_datafeed_packet *structure,
+		const shared_ptr<Device> &device, DatafeedViewCallbackData *cache) :
+	_structure(structure),
+	_device(device),
+	_cache(cache)
+{
+}
+
+const PacketType *PacketView::type() const
+{
+	return PacketType::get(_structure->type);
+}
+
+LogicView PacketView::logic() const
+{
+	if (_structure->type != SR_DF_LOGIC)
+		throw Error(SR_ERR_NA);
+	return LogicView{static_cast<const struct sr_datafeed_logic *>(
+		_structure->payload)};
+}
+
+AnalogView PacketView::analog() const
+{
+	if (_structure->type != SR_DF_ANALOG)
+		throw Error(SR_ERR_NA);
+	return AnalogView{static_cast<const struct sr_datafeed_analog *>(
+		_structure->payload), _device, _cache};
+}
+
+shared_ptr<Packet> PacketView::retain() const
+{
+	shared_ptr<Packet> packet {new Packet{_device, _structure},
+		default_delete<Packet>{}};
+	packet->retain();
+	return packet;
+}
+
+LogicView::LogicView(const struct sr_datafeed_logic *structure) :
+	_structure(structure)
+{
+}
+
+unsigned int LogicView::unit_size() const
+{
+	return _structure->unitsize;
+}
+
+size_t LogicView::num_samples() const
+{
+	return _structure->unitsize ? _structure->length / _structure->unitsize : 0;
+}
+
+SampleSpan<const uint8_t> LogicView::data() const
+{
+	return SampleSpan<const uint8_t>(
+		static_cast<const uint8_t *>(_structure->data),
+		num_samples() * _structure->unitsize);
+}
+
+AnalogView::AnalogView(const struct sr_datafeed_analog *structure,
+		const shared_ptr<Device> &device, DatafeedViewCallbackData *cache) :
+	_structure(structure),
+	_device(device),
+	_cache(cache)
+{
+}
+
+unsigned int AnalogView::num_samples() const
+{
+	return _structure->num_samples;
+}
+
+size_t AnalogView::num_values() const
+{
+	return (size_t)_structure->num_samples
+		* g_slist_length(_structure->meaning->channels);
+}
+
+const vector<shared_ptr<Channel>> &AnalogView::channels() const
+{
+	return _cache->channels(_device, _structure->meaning->channels);
+}
+
+unsigned int AnalogView::unitsize() const
+{
+	return _structure->encoding->unitsize;
+}
+
+bool AnalogView::is_signed() const
+{
+	return _structure->encoding->is_signed;
+}
+
+bool AnalogView::is_float() const
+{
+	return _structure->encoding->is_float;
+}
+
+bool AnalogView::is_bigendian() const
+{
+	return _structure->encoding->is_bigendian;
+}
+
+const Quantity *AnalogView::mq() const
+{
+	return Quantity::get(_structure->meaning->mq);
+}
+
+const Unit *AnalogView::unit() const
+{
+	return Unit::get(_structure->meaning->unit);
+}
+
+void AnalogView::get_data_as_float(float *dest) const
+{
+	check(sr_analog_to_float(_structure, dest));
+}
+
 Rational::Rational(const struct sr_rational *structure) :
 	_structure(structure)
 {
@@ -1651,17 +1893,27 @@ Output::~Output()
 	check(sr_output_free(_structure));
 }
 
-string Output::receive(shared_ptr<Packet> packet)
+static int append_output(const uint8_t *data, size_t len,
+		void *cb_data) noexcept
 {
-	GString *out;
-	check(sr_output_send(_structure, packet->_structure, &out));
-	if (out) {
-		auto result = string(out->str, out->str + out->len);
-		g_string_free(out, true);
-		return result;
-	} else {
-		return string();
+	try {
+		static_cast<string *>(cb_data)->append(
+			reinterpret_cast<const char *>(data), len);
+	} catch (...) {
+		return SR_ERR_MALLOC;
 	}
+	return SR_OK;
+}
+
+string Output::receive(shared_ptr<Packet> packet)
+{
+	string result;
+	auto *const sink = sr_output_sink_new_callback(&append_output, &result);
+	const int ret = sr_output_send_sink(_structure, packet->_structure, sink);
+	const int flushed = sr_output_sink_free(sink);
+	check(ret);
+	check(flushed);
+	return result;
 }
 
 #include <enums.cpp>
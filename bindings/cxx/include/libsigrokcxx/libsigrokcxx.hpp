@@ -81,6 +81,7 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 #include <stdexcept>
 #include <memory>
 #include <vector>
+#include <deque>
 #include <map>
 #include <set>
 
@@ -112,6 +113,9 @@ class SR_API ChannelType;
 class SR_API Packet;
 class SR_API PacketPayload;
 class SR_API PacketType;
+class SR_API PacketView;
+class SR_API LogicView;
+class SR_API AnalogView;
 class SR_API Quantity;
 class SR_API Unit;
 class SR_API QuantityFlag;
@@ -412,6 +416,7 @@ private:
 	friend class ChannelGroup;
 	friend class Output;
 	friend class Analog;
+	friend class DatafeedViewCallbackData;
 	friend struct std::default_delete<Device>;
 };
 
@@ -591,6 +596,34 @@ private:
 	friend class Session;
 };
 
+/** Type of low overhead datafeed callback */
+typedef function<void(const shared_ptr<Device> &, const PacketView &)>
+	DatafeedViewCallbackFunction;
+
+/* Data required for C callback function to call a C++ view callback */
+class SR_PRIV DatafeedViewCallbackData
+{
+public:
+	void run(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *pkt);
+private:
+	DatafeedViewCallbackFunction _callback;
+	DatafeedViewCallbackData(Session *session,
+		DatafeedViewCallbackFunction callback);
+	const shared_ptr<Device> &device(const struct sr_dev_inst *sdi);
+	const vector<shared_ptr<Channel> > &channels(
+		const shared_ptr<Device> &device, const GSList *list);
+	void clear();
+	Session *_session;
+	/* Devices and channel lists seen in this acquisition. Views refer to
+	 * the entries, which a deque doesn't move when more are added. */
+	deque<pair<const struct sr_dev_inst *, shared_ptr<Device> > > _devices;
+	deque<pair<vector<struct sr_channel *>,
+		vector<shared_ptr<Channel> > > > _channels;
+	friend class Session;
+	friend class AnalogView;
+};
+
 /** A virtual device associated with a stored session */
 class SR_API SessionDevice :
 	public ParentOwned<SessionDevice, Session>,
@@ -617,8 +650,21 @@ public:
 	/** Remove all devices from this session. */
 	void remove_devices();
 	/** Add a datafeed callback to this session.
+	 *
+	 * The packets stay valid after the callback returned, and may be
+	 * passed to other threads. Packets which were not sent from a
+	 * buffer are copied for this, see add_datafeed_view_callback() to
+	 * avoid that.
 	 * @param callback Callback of the form callback(Device, Packet). */
 	void add_datafeed_callback(DatafeedCallbackFunction callback);
+	/** Add a low overhead datafeed callback to this session.
+	 *
+	 * The callback gets a PacketView instead of a Packet. Views are not
+	 * allocated on the heap and only valid until the callback returns,
+	 * use PacketView::retain() to keep a packet. Devices and channel
+	 * lists are looked up once per acquisition.
+	 * @param callback Callback of the form callback(Device, PacketView). */
+	void add_datafeed_view_callback(DatafeedViewCallbackFunction callback);
 	/** Remove all datafeed callbacks from this session. */
 	void remove_datafeed_callbacks();
 	/** Start the session. */
@@ -650,12 +696,14 @@ private:
 	map<const struct sr_dev_inst *, unique_ptr<SessionDevice> > _owned_devices;
 	map<const struct sr_dev_inst *, shared_ptr<Device> > _other_devices;
 	vector<unique_ptr<DatafeedCallbackData> > _datafeed_callbacks;
+	vector<unique_ptr<DatafeedViewCallbackData> > _datafeed_view_callbacks;
 	SessionStoppedCallback _stopped_callback;
 	string _filename;
 	shared_ptr<Trigger> _trigger;
 
 	friend class Context;
 	friend class DatafeedCallbackData;
+	friend class DatafeedViewCallbackData;
 	friend class SessionDevice;
 	friend struct std::default_delete<Session>;
 };
@@ -668,17 +716,25 @@ public:
 	const PacketType *type() const;
 	/** Payload of this packet. */
 	shared_ptr<PacketPayload> payload();
+	/**
+	 * Keep the sample data valid after the datafeed callback returned.
+	 * Packets passed to datafeed callbacks are retained already.
+	 */
+	void retain();
 private:
 	Packet(shared_ptr<Device> device,
 		const struct sr_datafeed_packet *structure);
 	~Packet();
 	const struct sr_datafeed_packet *_structure;
+	/* Reference held on the packet once it outlives its callback. */
+	struct sr_datafeed_packet *_retained;
 	shared_ptr<Device> _device;
 	unique_ptr<PacketPayload> _payload;
 
 	friend class Session;
 	friend class Output;
 	friend class DatafeedCallbackData;
+	friend class PacketView;
 	friend class Header;
 	friend class Meta;
 	friend class Logic;
@@ -845,6 +901,136 @@ private:
 	friend class Packet;
 };
 
+/** Non-owning view of an array of samples */
+template <class T>
+class SR_API SampleSpan
+{
+public:
+	SampleSpan() : _data(nullptr), _size(0) {}
+	SampleSpan(T *data, size_t size) : _data(data), _size(size) {}
+	/** Pointer to the first sample. */
+	T *data() const { return _data; }
+	/** Number of samples. */
+	size_t size() const { return _size; }
+	/** Whether there are no samples. */
+	bool empty() const { return _size == 0; }
+	T *begin() const { return _data; }
+	T *end() const { return _data + _size; }
+	T &operator[](size_t i) const { return _data[i]; }
+private:
+	T *_data;
+	size_t _size;
+};
+
+/** View of a logic payload, only valid during a view callback */
+class SR_API LogicView
+{
+public:
+	/** Size of each sample in bytes. */
+	unsigned int unit_size() const;
+	/** Number of samples. */
+	size_t num_samples() const;
+	/** Sample data, unit_size() bytes per sample. */
+	SampleSpan<const uint8_t> data() const;
+	/**
+	 * Samples as unsigned words of unit_size() bytes. On little endian
+	 * hosts, bit n of each word is the state of logic channel n.
+	 * @throws Error if sizeof(T) is not unit_size(), or the data is not
+	 *         aligned for T.
+	 */
+	template <class T>
+	SampleSpan<const T> words() const
+	{
+		if (sizeof(T) != unit_size()
+				|| reinterpret_cast<uintptr_t>(_structure->data) % alignof(T))
+			throw Error(SR_ERR_ARG);
+		return SampleSpan<const T>(
+			static_cast<const T *>(_structure->data), num_samples());
+	}
+private:
+	explicit LogicView(const struct sr_datafeed_logic *structure);
+
+	const struct sr_datafeed_logic *_structure;
+
+	friend class PacketView;
+};
+
+/** View of an analog payload, only valid during a view callback */
+class SR_API AnalogView
+{
+public:
+	/** Number of samples per channel. */
+	unsigned int num_samples() const;
+	/** Channels for which this packet contains data. */
+	const vector<shared_ptr<Channel> > &channels() const;
+	/** Size of a single sample in bytes. */
+	unsigned int unitsize() const;
+	/** Samples use a signed data type. */
+	bool is_signed() const;
+	/** Samples use float. */
+	bool is_float() const;
+	/** Samples are stored in big-endian order. */
+	bool is_bigendian() const;
+	/** Measured quantity of the samples in this packet. */
+	const Quantity *mq() const;
+	/** Unit of the samples in this packet. */
+	const Unit *unit() const;
+	/**
+	 * Samples as stored by the device, interleaved if the packet holds
+	 * more than one channel. Use is_float(), is_signed() and
+	 * is_bigendian() to pick T, or get_data_as_float() to convert.
+	 * @throws Error if sizeof(T) is not unitsize(), or the data is not
+	 *         aligned for T.
+	 */
+	template <class T>
+	SampleSpan<const T> samples() const
+	{
+		if (sizeof(T) != unitsize()
+				|| reinterpret_cast<uintptr_t>(_structure->data) % alignof(T))
+			throw Error(SR_ERR_ARG);
+		return SampleSpan<const T>(
+			static_cast<const T *>(_structure->data), num_values());
+	}
+	/**
+	 * Fills dest with the samples converted to float. It must have
+	 * space for num_samples() floats per channel.
+	 */
+	void get_data_as_float(float *dest) const;
+private:
+	AnalogView(const struct sr_datafeed_analog *structure,
+		const shared_ptr<Device> &device, DatafeedViewCallbackData *cache);
+	size_t num_values() const;
+
+	const struct sr_datafeed_analog *_structure;
+	const shared_ptr<Device> &_device;
+	DatafeedViewCallbackData *_cache;
+
+	friend class PacketView;
+};
+
+/** View of a datafeed packet, only valid during a view callback */
+class SR_API PacketView
+{
+public:
+	/** Type of this packet. */
+	const PacketType *type() const;
+	/** Logic payload. @throws Error if this is not a logic packet. */
+	LogicView logic() const;
+	/** Analog payload. @throws Error if this is not an analog packet. */
+	AnalogView analog() const;
+	/** Full packet, which may be kept after the callback returned. */
+	shared_ptr<Packet> retain() const;
+private:
+	PacketView(const struct sr_datafeed_packet *structure,
+		const shared_ptr<Device> &device, DatafeedViewCallbackData *cache);
+
+	const struct sr_datafeed_packet *_structure;
+	const shared_ptr<Device> &_device;
+	DatafeedViewCallbackData *_cache;
+
+	friend class DatafeedViewCallbackData;
+};
+
 /** Number represented by a numerator/denominator integer pair */
 class SR_API Rational :
 	public ParentOwned<Rational, Analog>
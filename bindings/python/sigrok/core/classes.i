@@ -528,23 +528,162 @@ std::map<std::string, Glib::VariantBase> dict_to_map_options(PyObject *dict,
     }
 }
 
-/* Return NumPy array from Analog::data(). */
+%{
+
+/*
+ * Wrap packet sample data in a read-only NumPy array. The array holds a
+ * reference to owner, the Python object of the payload, which keeps the
+ * packet alive.
+ */
+PyObject *sample_array(PyObject *owner, void *data, int typenum,
+    char byteorder, int nd, npy_intp *dims)
+{
+    PyArray_Descr *descr = PyArray_DescrFromType(typenum);
+    if (byteorder != NPY_NATIVE) {
+        PyArray_Descr *swapped = PyArray_DescrNewByteorder(descr, byteorder);
+        Py_DECREF(descr);
+        descr = swapped;
+    }
+
+    PyObject *array = PyArray_NewFromDescr(&PyArray_Type, descr, nd, dims,
+        nullptr, data, NPY_ARRAY_C_CONTIGUOUS, nullptr);
+    if (!array)
+        return nullptr;
+    PyArray_UpdateFlags((PyArrayObject *)array, NPY_ARRAY_ALIGNED);
+
+    Py_INCREF(owner);
+    if (PyArray_SetBaseObject((PyArrayObject *)array, owner) < 0) {
+        Py_DECREF(array);
+        return nullptr;
+    }
+
+    return array;
+}
+
+/* NumPy type of integer or float samples, or NPY_NOTYPE. */
+int sample_typenum(unsigned int unitsize, bool is_float, bool is_signed)
+{
+    if (is_float)
+        return unitsize == 4 ? NPY_FLOAT32 : unitsize == 8 ? NPY_FLOAT64 :
+            NPY_NOTYPE;
+
+    switch (unitsize) {
+    case 1: return is_signed ? NPY_INT8 : NPY_UINT8;
+    case 2: return is_signed ? NPY_INT16 : NPY_UINT16;
+    case 4: return is_signed ? NPY_INT32 : NPY_UINT32;
+    case 8: return is_signed ? NPY_INT64 : NPY_UINT64;
+    default: return NPY_NOTYPE;
+    }
+}
+
+/* Wrap the samples of an Analog payload in their own encoding. */
+PyObject *analog_raw_array(sigrok::Analog *analog, PyObject *owner)
+{
+    int typenum = sample_typenum(analog->unitsize(), analog->is_float(),
+        analog->is_signed());
+    if (typenum == NPY_NOTYPE)
+        throw sigrok::Error(SR_ERR_NA);
+
+    if (auto packet = analog->parent())
+        packet->retain();
+
+    npy_intp dims[2];
+    dims[0] = analog->channels().size();
+    dims[1] = analog->num_samples();
+    return sample_array(owner, analog->data_pointer(), typenum,
+        analog->unitsize() == 1 ? NPY_NATIVE :
+        analog->is_bigendian() ? NPY_BIG : NPY_LITTLE, 2, dims);
+}
+
+%}
+
+/* Return NumPy arrays of the samples in Logic packets. */
+%extend sigrok::Logic
+{
+    PyObject *_data(PyObject *owner)
+    {
+        if (auto packet = $self->parent())
+            packet->retain();
+
+        unsigned int unitsize = $self->unit_size();
+        npy_intp dims[2];
+        dims[0] = unitsize ? $self->data_length() / unitsize : 0;
+        dims[1] = unitsize;
+
+        int typenum = sample_typenum(unitsize, false, false);
+        if (typenum == NPY_NOTYPE)
+            return sample_array(owner, $self->data_pointer(), NPY_UINT8,
+                NPY_NATIVE, 2, dims);
+        else
+            return sample_array(owner, $self->data_pointer(), typenum,
+                NPY_LITTLE, 1, dims);
+    }
+
+%pythoncode
+{
+    data = property(lambda self: self._data(self), doc=
+        """Samples as a read-only array, without copying them.
+
+        Unit sizes of 1, 2, 4 and 8 bytes give one unsigned integer per
+        sample, with channel n in bit n. Other unit sizes give one row of
+        bytes per sample.""")
+
+    def _bits(self):
+        import numpy
+        samples = self.data.view(numpy.uint8).reshape(-1, self.unit_size)
+        return numpy.unpackbits(samples, axis=1, bitorder='little').T.astype(bool)
+
+    bits = property(_bits, doc=
+        """Samples unpacked into one row of booleans per channel.""")
+}
+}
+
+/* Return NumPy arrays of the samples in Analog packets. */
 %extend sigrok::Analog
 {
-    PyObject * _data()
+    PyObject *_raw_data(PyObject *owner)
     {
-        int nd = 2;
+        return analog_raw_array($self, owner);
+    }
+
+    PyObject *_data(PyObject *owner)
+    {
+        auto scale = $self->scale();
+        auto offset = $self->offset();
+        /* Samples which need no conversion are passed on as they are. */
+        if ($self->is_float() && $self->unitsize() == sizeof(float)
+                && $self->is_bigendian() == (G_BYTE_ORDER == G_BIG_ENDIAN)
+                && scale->numerator() == (int64_t)scale->denominator()
+                && offset->numerator() == 0)
+            return analog_raw_array($self, owner);
+
         npy_intp dims[2];
         dims[0] = $self->channels().size();
         dims[1] = $self->num_samples();
-        int typenum = NPY_FLOAT;
-        void *data = $self->data_pointer();
-        return PyArray_SimpleNewFromData(nd, dims, typenum, data);
+        PyObject *array = PyArray_SimpleNew(2, dims, NPY_FLOAT32);
+        if (!array)
+            return nullptr;
+        try {
+            $self->get_data_as_float(
+                static_cast<float *>(PyArray_DATA((PyArrayObject *)array)));
+        } catch (...) {
+            Py_DECREF(array);
+            throw;
+        }
+        return array;
     }
 
 %pythoncode
 {
-    data = property(_data)
+    data = property(lambda self: self._data(self), doc=
+        """Samples as floats, one row per channel.
+
+        Float samples which need no scaling are returned as a read-only
+        array of the packet's data, all others are converted.""")
+
+    raw_data = property(lambda self: self._raw_data(self), doc=
+        """Samples as a read-only array in the packet's own encoding,
+        one row per channel, without copying them.""")
 }
 }
 
@@ -80,6 +80,12 @@ template< class T > class enable_shared_from_this;
 #define SR_PRIV
 
 %ignore sigrok::DatafeedCallbackData;
+%ignore sigrok::DatafeedViewCallbackData;
+%ignore sigrok::Session::add_datafeed_view_callback;
+%ignore sigrok::PacketView;
+%ignore sigrok::LogicView;
+%ignore sigrok::AnalogView;
+%ignore sigrok::SampleSpan;
 
 #ifndef SWIGJAVA
 
@@ -133,6 +133,10 @@ enum sr_loglevel {
 /** Type definition for callback function for data reception. */
 typedef int (*sr_receive_data_callback)(int fd, int revents, void *cb_data);
 
+/** Type definition for callback function receiving output module output. */
+typedef int (*sr_output_sink_callback)(const uint8_t *data, size_t len,
+		void *cb_data);
+
 /** Data types used by sr_config_info(). */
 enum sr_datatype {
 	SR_T_UINT64 = 10000,
@@ -168,6 +172,8 @@ enum sr_packettype {
 	SR_DF_FRAME_END,
 	/** Payload is struct sr_datafeed_analog. */
 	SR_DF_ANALOG,
+	/** Payload is struct sr_datafeed_logic_rle. */
+	SR_DF_LOGIC_RLE,
 
 	/* Update datafeed_dump() (session.c) upon changes! */
 };
@@ -441,7 +447,9 @@ struct sr_trigger_match {
 	 */
 	int match;
 	/** If the trigger match is one of SR_TRIGGER_OVER or SR_TRIGGER_UNDER,
-	 * this contains the value to compare against. */
+	 * this contains the value to compare against. For SR_TRIGGER_RISING
+	 * and SR_TRIGGER_FALLING on analog channels, it is the level which
+	 * has to be crossed. */
 	float value;
 };
 
@@ -465,6 +473,14 @@ struct sr_context;
  */
 struct sr_session;
 
+/**
+ * @struct sr_session_reader
+ * Opaque structure giving random access to the data in a session file.
+ *
+ * @see sr_session_reader_open(), sr_session_reader_close().
+ */
+struct sr_session_reader;
+
 struct sr_rational {
 	/** Numerator of the rational number. */
 	int64_t p;
@@ -496,6 +512,29 @@ struct sr_datafeed_logic {
 	void *data;
 };
 
+/**
+ * Transition-encoded logic datafeed payload for type SR_DF_LOGIC_RLE.
+ *
+ * The samples are stored as runs: the i-th run holds the value at
+ * values + i * unitsize for lengths[i] consecutive samples. Adjacent runs
+ * may have the same value.
+ *
+ * Only datafeed callbacks and output modules which ask for this format
+ * receive it, all others get the samples as SR_DF_LOGIC packets.
+ * @see sr_session_datafeed_callback_flags_set(), sr_logic_rle_expand()
+ */
+struct sr_datafeed_logic_rle {
+	/** Number of samples, the sum of all run lengths. */
+	uint64_t num_samples;
+	/** Number of runs. */
+	uint64_t num_runs;
+	uint16_t unitsize;
+	/** Number of samples in each run, none of them zero. */
+	uint64_t *lengths;
+	/** Sample value of each run, num_runs * unitsize bytes. */
+	void *values;
+};
+
 /** Analog datafeed payload for type SR_DF_ANALOG. */
 struct sr_datafeed_analog {
 	void *data;
@@ -505,6 +544,38 @@ struct sr_datafeed_analog {
 	struct sr_analog_spec *spec;
 };
 
+/** Datafeed callback flags, see sr_session_datafeed_callback_flags_set(). */
+enum sr_datafeed_callback_flag {
+	/** The callback accepts SR_DF_LOGIC_RLE packets. */
+	SR_DF_CALLBACK_LOGIC_RLE = 0x01,
+};
+
+/** Event loop threads of a running session, see sr_session_threading_set(). */
+enum sr_session_threading {
+	/** All devices are serviced by the thread which runs the session. */
+	SR_SESSION_THREADING_NONE,
+	/** Every device gets its own event loop thread. */
+	SR_SESSION_THREADING_DEVICE,
+	/** Devices of the same transport (serial, SCPI, ...) share a thread. */
+	SR_SESSION_THREADING_TRANSPORT,
+};
+
+/** Statistics of an asynchronous datafeed callback's packet queue. */
+struct sr_datafeed_queue_stats {
+	/** Number of packets accepted into the queue. */
+	uint64_t queued;
+	/** Number of packets the callback has returned from. */
+	uint64_t delivered;
+	/** Number of data packets dropped because the queue was full. */
+	uint64_t dropped;
+	/** Number of packets currently waiting in the queue. */
+	uint32_t fill;
+	/** Highest number of packets that were waiting at the same time. */
+	uint32_t high_water;
+	/** Maximum number of packets the queue can hold. */
+	uint32_t capacity;
+};
+
 struct sr_analog_encoding {
 	uint8_t unitsize;
 	gboolean is_signed;
@@ -538,6 +609,15 @@ struct sr_analog_spec {
 	int8_t spec_digits;
 };
 
+/**
+ * @struct sr_analog_conv
+ * Opaque structure representing a plan for converting samples of one
+ * encoding to float.
+ *
+ * @see sr_analog_conv_new(), sr_analog_conv_free().
+ */
+struct sr_analog_conv;
+
 /** Generic option struct used by various subsystems. */
 struct sr_option {
 	/* Short name suitable for commandline usage, [a-z0-9-]. */
@@ -575,12 +655,15 @@ struct sr_resource {
 enum sr_output_flag {
 	/** If set, this output module writes the output itself. */
 	SR_OUTPUT_INTERNAL_IO_HANDLING = 0x01,
+	/** If set, this output module accepts SR_DF_LOGIC_RLE packets. */
+	SR_OUTPUT_LOGIC_RLE = 0x02,
 };
 
 struct sr_input;
 struct sr_input_module;
 struct sr_output;
 struct sr_output_module;
+struct sr_output_sink;
 struct sr_transform;
 struct sr_transform_module;
 
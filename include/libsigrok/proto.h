@@ -30,6 +30,11 @@
 
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *buf);
+SR_API int sr_analog_conv_new(const struct sr_analog_encoding *encoding,
+		struct sr_analog_conv **conv);
+SR_API int sr_analog_conv_run(const struct sr_analog_conv *conv,
+		const void *data, size_t count, float *outbuf);
+SR_API void sr_analog_conv_free(struct sr_analog_conv *conv);
 SR_API const char *sr_analog_si_prefix(float *value, int *digits);
 SR_API gboolean sr_analog_si_prefix_friendly(enum sr_unit unit);
 SR_API int sr_analog_unit_to_string(const struct sr_datafeed_analog *analog,
@@ -41,6 +46,11 @@ SR_API int sr_rational_mult(struct sr_rational *res, const struct sr_rational *a
 SR_API int sr_rational_div(struct sr_rational *res, const struct sr_rational *num,
 		const struct sr_rational *div);
 
+/*--- logic_rle.c -----------------------------------------------------------*/
+
+SR_API int sr_logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+		uint64_t start, uint64_t count, void *data);
+
 /*--- backend.c -------------------------------------------------------------*/
 
 SR_API int sr_init(struct sr_context **ctx);
@@ -93,6 +103,8 @@ SR_API const char *sr_dev_inst_sernum_get(const struct sr_dev_inst *sdi);
 SR_API const char *sr_dev_inst_connid_get(const struct sr_dev_inst *sdi);
 SR_API GSList *sr_dev_inst_channels_get(const struct sr_dev_inst *sdi);
 SR_API GSList *sr_dev_inst_channel_groups_get(const struct sr_dev_inst *sdi);
+SR_API int sr_dev_inst_start_time_get(const struct sr_dev_inst *sdi,
+		int64_t *begin_us, int64_t *end_us);
 
 SR_API struct sr_dev_inst *sr_dev_inst_user_new(const char *vendor,
 		const char *model, const char *version);
@@ -105,6 +117,13 @@ SR_API int sr_driver_init(struct sr_context *ctx,
 		struct sr_dev_driver *driver);
 SR_API GArray *sr_driver_scan_options_list(const struct sr_dev_driver *driver);
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options);
+typedef void (*sr_scan_callback)(struct sr_dev_inst *sdi, void *cb_data);
+SR_API GSList *sr_drivers_scan(struct sr_context *ctx,
+		struct sr_dev_driver **drivers, GSList *options,
+		sr_scan_callback cb, void *cb_data);
+SR_API int sr_scan_config_set(struct sr_context *ctx, unsigned int threads,
+		unsigned int timeout_ms, unsigned int cache_ms);
+SR_API int sr_scan_cache_clear(struct sr_context *ctx);
 SR_API int sr_config_get(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi,
 		const struct sr_channel_group *cg,
@@ -145,6 +164,18 @@ SR_API int sr_session_trigger_set(struct sr_session *session, struct sr_trigger
 SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session);
 SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 		sr_datafeed_callback cb, void *cb_data);
+SR_API int sr_session_datafeed_callback_add_async(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data, size_t queue_size);
+SR_API int sr_session_datafeed_callback_stats_get(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data,
+		struct sr_datafeed_queue_stats *stats);
+SR_API int sr_session_datafeed_callback_flags_set(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data, uint64_t flags);
+SR_API int sr_session_coalesce_set(struct sr_session *session,
+		size_t max_bytes, unsigned int max_latency_ms);
+SR_API int sr_packet_ref(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **ref);
+SR_API void sr_packet_unref(struct sr_datafeed_packet *packet);
 
 /* Session control */
 SR_API int sr_session_start(struct sr_session *session);
@@ -153,6 +184,42 @@ SR_API int sr_session_stop(struct sr_session *session);
 SR_API int sr_session_is_running(struct sr_session *session);
 SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 		sr_session_stopped_callback cb, void *cb_data);
+SR_API int sr_session_threading_set(struct sr_session *session,
+		int threading);
+SR_API int sr_session_parallel_start_set(struct sr_session *session,
+		gboolean parallel_start);
+
+/*--- session_reader.c ------------------------------------------------------*/
+
+SR_API int sr_session_reader_open(const char *filename,
+		struct sr_session_reader **reader);
+SR_API int sr_session_reader_close(struct sr_session_reader *reader);
+SR_API uint64_t sr_session_reader_samplerate_get(
+		const struct sr_session_reader *reader);
+SR_API unsigned int sr_session_reader_unitsize_get(
+		const struct sr_session_reader *reader);
+SR_API uint64_t sr_session_reader_logic_samples_get(
+		const struct sr_session_reader *reader);
+SR_API unsigned int sr_session_reader_analog_channels_get(
+		const struct sr_session_reader *reader);
+SR_API uint64_t sr_session_reader_analog_samples_get(
+		const struct sr_session_reader *reader, unsigned int channel);
+SR_API int sr_session_reader_logic_map(struct sr_session_reader *reader,
+		uint64_t start, const uint8_t **data, uint64_t *count);
+SR_API int sr_session_reader_logic_read(struct sr_session_reader *reader,
+		uint64_t start, uint64_t count, uint8_t *buf);
+SR_API int sr_session_reader_analog_read(struct sr_session_reader *reader,
+		unsigned int channel, uint64_t start, uint64_t count, float *buf);
+SR_API unsigned int sr_session_reader_overview_levels_get(
+		const struct sr_session_reader *reader);
+SR_API uint64_t sr_session_reader_overview_block_size_get(
+		const struct sr_session_reader *reader, unsigned int level);
+SR_API int sr_session_reader_logic_overview_read(
+		struct sr_session_reader *reader, unsigned int level,
+		uint64_t start, uint64_t count, uint8_t *buf);
+SR_API int sr_session_reader_analog_overview_read(
+		struct sr_session_reader *reader, unsigned int channel,
+		unsigned int level, uint64_t start, uint64_t count, float *buf);
 
 /*--- input/input.c ---------------------------------------------------------*/
 
@@ -172,6 +239,8 @@ SR_API int sr_input_scan_file(const char *filename, const struct sr_input **in);
 SR_API const struct sr_input_module *sr_input_module_get(const struct sr_input *in);
 SR_API struct sr_dev_inst *sr_input_dev_inst_get(const struct sr_input *in);
 SR_API int sr_input_send(const struct sr_input *in, GString *buf);
+SR_API int sr_input_send_file(const struct sr_input *in,
+		const char *filename, gboolean *done);
 SR_API int sr_input_end(const struct sr_input *in);
 SR_API int sr_input_reset(const struct sr_input *in);
 SR_API void sr_input_free(const struct sr_input *in);
@@ -194,7 +263,16 @@ SR_API gboolean sr_output_test_flag(const struct sr_output_module *omod,
 		uint64_t flag);
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out);
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink);
 SR_API int sr_output_free(const struct sr_output *o);
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd);
+SR_API struct sr_output_sink *sr_output_sink_new_file(FILE *file);
+SR_API struct sr_output_sink *sr_output_sink_new_callback(
+		sr_output_sink_callback cb, void *cb_data);
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink);
+SR_API int sr_output_sink_free(struct sr_output_sink *sink);
 
 /*--- transform/transform.c -------------------------------------------------*/
 
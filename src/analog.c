@@ -154,6 +154,720 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 	return SR_OK;
 }
 
+/*
+ * Conversion of analog samples to float.
+ *
+ * Every supported encoding maps to one kind of kernel. A plan (struct
+ * sr_analog_conv) caches the kernel for an encoding, picking a vector
+ * version for the running CPU where there is one, along with scale and
+ * offset as floats. The vector kernels leave the last few samples to the
+ * plain C kernel of the same kind.
+ */
+
+enum {
+	CONV_U8,
+	CONV_S8,
+	CONV_U16LE,
+	CONV_S16LE,
+	CONV_U16BE,
+	CONV_S16BE,
+	CONV_U32LE,
+	CONV_S32LE,
+	CONV_U32BE,
+	CONV_S32BE,
+	CONV_FLOATLE,
+	CONV_FLOATBE,
+	CONV_KINDS,
+};
+
+typedef void (*analog_conv_kernel)(const struct sr_analog_conv *conv,
+		const uint8_t *in, float *out, size_t count);
+
+struct sr_analog_conv {
+	/** Fastest kernel for this encoding on the running CPU. */
+	analog_conv_kernel kernel;
+	/** Plain C kernel, converts what the vector kernel leaves over. */
+	analog_conv_kernel scalar;
+	unsigned int unitsize;
+	float scale;
+	float offset;
+};
+
+#define SCALAR_KERNEL(kind, size, read) \
+static void conv_c_##kind(const struct sr_analog_conv *conv, \
+		const uint8_t *in, float *out, size_t count) \
+{ \
+	const float scale = conv->scale; \
+	const float offset = conv->offset; \
+	size_t i; \
+	\
+	for (i = 0; i < count; i++, in += (size)) \
+		out[i] = scale * (float)read(in) + offset; \
+}
+
+#define R8S(x) ((int8_t)R8(x))
+
+SCALAR_KERNEL(u8, 1, R8)
+SCALAR_KERNEL(s8, 1, R8S)
+SCALAR_KERNEL(u16le, 2, RL16)
+SCALAR_KERNEL(s16le, 2, RL16S)
+SCALAR_KERNEL(u16be, 2, RB16)
+SCALAR_KERNEL(s16be, 2, RB16S)
+SCALAR_KERNEL(u32le, 4, RL32)
+SCALAR_KERNEL(s32le, 4, RL32S)
+SCALAR_KERNEL(u32be, 4, RB32)
+SCALAR_KERNEL(s32be, 4, RB32S)
+SCALAR_KERNEL(floatle, 4, RLFL)
+SCALAR_KERNEL(floatbe, 4, RBFL)
+
+static const analog_conv_kernel scalar_kernels[CONV_KINDS] = {
+	conv_c_u8, conv_c_s8,
+	conv_c_u16le, conv_c_s16le, conv_c_u16be, conv_c_s16be,
+	conv_c_u32le, conv_c_s32le, conv_c_u32be, conv_c_s32be,
+	conv_c_floatle, conv_c_floatbe,
+};
+
+/* Native floats without scale and offset. */
+static void conv_copy(const struct sr_analog_conv *conv,
+		const uint8_t *in, float *out, size_t count)
+{
+	(void)conv;
+
+	memcpy(out, in, count * sizeof(float));
+}
+
+/*
+ * Vector kernels convert a fixed number of samples per block. Scale and
+ * offset are applied with a separate multiply and add. The C kernels may
+ * be contracted into fused multiply-adds by the compiler, e.g. on aarch64,
+ * so results can differ from the vector kernels' in the last bit.
+ */
+#define VECTOR_KERNEL(isa, attr, kind, size, block, vscale) \
+static attr void conv_##isa##_##kind(const struct sr_analog_conv *conv, \
+		const uint8_t *in, float *out, size_t count) \
+{ \
+	const vscale scale = isa##_set1(conv->scale); \
+	const vscale offset = isa##_set1(conv->offset); \
+	size_t i; \
+	\
+	for (i = 0; i + (block) <= count; i += (block)) \
+		isa##_block_##kind(in + i * (size), out + i, scale, offset); \
+	conv_c_##kind(conv, in + i * (size), out + i, count - i); \
+}
+
+#if defined(__SSE2__) && !defined(WORDS_BIGENDIAN)
+#include <emmintrin.h>
+
+#define sse2_set1 _mm_set1_ps
+
+static inline void sse2_store(float *out, __m128 f,
+		__m128 scale, __m128 offset)
+{
+	_mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(f, scale), offset));
+}
+
+static inline __m128i sse2_bswap16(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i sse2_bswap32(__m128i v)
+{
+	v = sse2_bswap16(v);
+
+	return _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16));
+}
+
+/* SSE2 only converts signed integers, do it in two exact halves. */
+static inline __m128 sse2_cvt_u32(__m128i v)
+{
+	__m128 hi, lo;
+
+	hi = _mm_cvtepi32_ps(_mm_srli_epi32(v, 16));
+	lo = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xffff)));
+
+	return _mm_add_ps(_mm_mul_ps(hi, _mm_set1_ps(65536.0f)), lo);
+}
+
+static inline void sse2_store_s16(float *out, __m128i v,
+		__m128 scale, __m128 offset)
+{
+	sse2_store(out, _mm_cvtepi32_ps(_mm_srai_epi32(
+			_mm_unpacklo_epi16(v, v), 16)), scale, offset);
+	sse2_store(out + 4, _mm_cvtepi32_ps(_mm_srai_epi32(
+			_mm_unpackhi_epi16(v, v), 16)), scale, offset);
+}
+
+static inline void sse2_store_u16(float *out, __m128i v,
+		__m128 scale, __m128 offset)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	sse2_store(out, _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)),
+			scale, offset);
+	sse2_store(out + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)),
+			scale, offset);
+}
+
+static inline __m128i sse2_load(const uint8_t *in)
+{
+	return _mm_loadu_si128((const __m128i *)in);
+}
+
+static inline void sse2_block_u8(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v;
+
+	v = sse2_load(in);
+	sse2_store_u16(out, _mm_unpacklo_epi8(v, zero), scale, offset);
+	sse2_store_u16(out + 8, _mm_unpackhi_epi8(v, zero), scale, offset);
+}
+
+static inline void sse2_block_s8(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	__m128i v;
+
+	v = sse2_load(in);
+	sse2_store_s16(out, _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8),
+			scale, offset);
+	sse2_store_s16(out + 8, _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8),
+			scale, offset);
+}
+
+static inline void sse2_block_u16le(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store_u16(out, sse2_load(in), scale, offset);
+}
+
+static inline void sse2_block_s16le(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store_s16(out, sse2_load(in), scale, offset);
+}
+
+static inline void sse2_block_u16be(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store_u16(out, sse2_bswap16(sse2_load(in)), scale, offset);
+}
+
+static inline void sse2_block_s16be(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store_s16(out, sse2_bswap16(sse2_load(in)), scale, offset);
+}
+
+static inline void sse2_block_u32le(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store(out, sse2_cvt_u32(sse2_load(in)), scale, offset);
+}
+
+static inline void sse2_block_s32le(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store(out, _mm_cvtepi32_ps(sse2_load(in)), scale, offset);
+}
+
+static inline void sse2_block_u32be(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store(out, sse2_cvt_u32(sse2_bswap32(sse2_load(in))),
+			scale, offset);
+}
+
+static inline void sse2_block_s32be(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store(out, _mm_cvtepi32_ps(sse2_bswap32(sse2_load(in))),
+			scale, offset);
+}
+
+static inline void sse2_block_floatle(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store(out, _mm_loadu_ps((const float *)in), scale, offset);
+}
+
+static inline void sse2_block_floatbe(const uint8_t *in, float *out,
+		__m128 scale, __m128 offset)
+{
+	sse2_store(out, _mm_castsi128_ps(sse2_bswap32(sse2_load(in))),
+			scale, offset);
+}
+
+VECTOR_KERNEL(sse2, , u8, 1, 16, __m128)
+VECTOR_KERNEL(sse2, , s8, 1, 16, __m128)
+VECTOR_KERNEL(sse2, , u16le, 2, 8, __m128)
+VECTOR_KERNEL(sse2, , s16le, 2, 8, __m128)
+VECTOR_KERNEL(sse2, , u16be, 2, 8, __m128)
+VECTOR_KERNEL(sse2, , s16be, 2, 8, __m128)
+VECTOR_KERNEL(sse2, , u32le, 4, 4, __m128)
+VECTOR_KERNEL(sse2, , s32le, 4, 4, __m128)
+VECTOR_KERNEL(sse2, , u32be, 4, 4, __m128)
+VECTOR_KERNEL(sse2, , s32be, 4, 4, __m128)
+VECTOR_KERNEL(sse2, , floatle, 4, 4, __m128)
+VECTOR_KERNEL(sse2, , floatbe, 4, 4, __m128)
+
+static const analog_conv_kernel sse2_kernels[CONV_KINDS] = {
+	conv_sse2_u8, conv_sse2_s8,
+	conv_sse2_u16le, conv_sse2_s16le, conv_sse2_u16be, conv_sse2_s16be,
+	conv_sse2_u32le, conv_sse2_s32le, conv_sse2_u32be, conv_sse2_s32be,
+	conv_sse2_floatle, conv_sse2_floatbe,
+};
+#endif
+
+#if defined(HAVE_TARGET_AVX2) && !defined(WORDS_BIGENDIAN)
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+#define avx2_set1 _mm256_set1_ps
+
+static inline AVX2 void avx2_store(float *out, __m256 f,
+		__m256 scale, __m256 offset)
+{
+	_mm256_storeu_ps(out, _mm256_add_ps(_mm256_mul_ps(f, scale), offset));
+}
+
+static inline AVX2 __m256i avx2_bswap32(__m256i v)
+{
+	const __m256i mask = _mm256_setr_epi8(
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	return _mm256_shuffle_epi8(v, mask);
+}
+
+static inline AVX2 __m128i avx2_bswap16(__m128i v)
+{
+	const __m128i mask = _mm_setr_epi8(
+			1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+	return _mm_shuffle_epi8(v, mask);
+}
+
+static inline AVX2 __m256 avx2_cvt_u32(__m256i v)
+{
+	__m256 hi, lo;
+
+	hi = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 16));
+	lo = _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0xffff)));
+
+	return _mm256_add_ps(_mm256_mul_ps(hi, _mm256_set1_ps(65536.0f)), lo);
+}
+
+static inline AVX2 __m128i avx2_load128(const uint8_t *in)
+{
+	return _mm_loadu_si128((const __m128i *)in);
+}
+
+static inline AVX2 __m256i avx2_load(const uint8_t *in)
+{
+	return _mm256_loadu_si256((const __m256i *)in);
+}
+
+static inline AVX2 void avx2_block_u8(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	__m128i v;
+
+	v = avx2_load128(in);
+	avx2_store(out, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)),
+			scale, offset);
+	avx2_store(out + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+			_mm_srli_si128(v, 8))), scale, offset);
+}
+
+static inline AVX2 void avx2_block_s8(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	__m128i v;
+
+	v = avx2_load128(in);
+	avx2_store(out, _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)),
+			scale, offset);
+	avx2_store(out + 8, _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+			_mm_srli_si128(v, 8))), scale, offset);
+}
+
+static inline AVX2 void avx2_block_u16le(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+			avx2_load128(in))), scale, offset);
+}
+
+static inline AVX2 void avx2_block_s16le(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			avx2_load128(in))), scale, offset);
+}
+
+static inline AVX2 void avx2_block_u16be(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(
+			avx2_bswap16(avx2_load128(in)))), scale, offset);
+}
+
+static inline AVX2 void avx2_block_s16be(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(
+			avx2_bswap16(avx2_load128(in)))), scale, offset);
+}
+
+static inline AVX2 void avx2_block_u32le(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, avx2_cvt_u32(avx2_load(in)), scale, offset);
+}
+
+static inline AVX2 void avx2_block_s32le(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_cvtepi32_ps(avx2_load(in)), scale, offset);
+}
+
+static inline AVX2 void avx2_block_u32be(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, avx2_cvt_u32(avx2_bswap32(avx2_load(in))),
+			scale, offset);
+}
+
+static inline AVX2 void avx2_block_s32be(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_cvtepi32_ps(avx2_bswap32(avx2_load(in))),
+			scale, offset);
+}
+
+static inline AVX2 void avx2_block_floatle(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_loadu_ps((const float *)in), scale, offset);
+}
+
+static inline AVX2 void avx2_block_floatbe(const uint8_t *in, float *out,
+		__m256 scale, __m256 offset)
+{
+	avx2_store(out, _mm256_castsi256_ps(avx2_bswap32(avx2_load(in))),
+			scale, offset);
+}
+
+VECTOR_KERNEL(avx2, AVX2, u8, 1, 16, __m256)
+VECTOR_KERNEL(avx2, AVX2, s8, 1, 16, __m256)
+VECTOR_KERNEL(avx2, AVX2, u16le, 2, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, s16le, 2, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, u16be, 2, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, s16be, 2, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, u32le, 4, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, s32le, 4, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, u32be, 4, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, s32be, 4, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, floatle, 4, 8, __m256)
+VECTOR_KERNEL(avx2, AVX2, floatbe, 4, 8, __m256)
+
+static const analog_conv_kernel avx2_kernels[CONV_KINDS] = {
+	conv_avx2_u8, conv_avx2_s8,
+	conv_avx2_u16le, conv_avx2_s16le, conv_avx2_u16be, conv_avx2_s16be,
+	conv_avx2_u32le, conv_avx2_s32le, conv_avx2_u32be, conv_avx2_s32be,
+	conv_avx2_floatle, conv_avx2_floatbe,
+};
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__) && !defined(WORDS_BIGENDIAN)
+#include <arm_neon.h>
+
+#define neon_set1 vdupq_n_f32
+
+static inline void neon_store(float *out, float32x4_t f,
+		float32x4_t scale, float32x4_t offset)
+{
+	vst1q_f32(out, vaddq_f32(vmulq_f32(f, scale), offset));
+}
+
+static inline void neon_store_u16(float *out, uint16x8_t v,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))),
+			scale, offset);
+	neon_store(out + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))),
+			scale, offset);
+}
+
+static inline void neon_store_s16(float *out, int16x8_t v,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),
+			scale, offset);
+	neon_store(out + 4, vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))),
+			scale, offset);
+}
+
+static inline void neon_block_u8(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	uint8x16_t v;
+
+	v = vld1q_u8(in);
+	neon_store_u16(out, vmovl_u8(vget_low_u8(v)), scale, offset);
+	neon_store_u16(out + 8, vmovl_u8(vget_high_u8(v)), scale, offset);
+}
+
+static inline void neon_block_s8(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	int8x16_t v;
+
+	v = vreinterpretq_s8_u8(vld1q_u8(in));
+	neon_store_s16(out, vmovl_s8(vget_low_s8(v)), scale, offset);
+	neon_store_s16(out + 8, vmovl_s8(vget_high_s8(v)), scale, offset);
+}
+
+static inline void neon_block_u16le(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store_u16(out, vreinterpretq_u16_u8(vld1q_u8(in)), scale, offset);
+}
+
+static inline void neon_block_s16le(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store_s16(out, vreinterpretq_s16_u8(vld1q_u8(in)), scale, offset);
+}
+
+static inline void neon_block_u16be(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store_u16(out, vreinterpretq_u16_u8(vrev16q_u8(vld1q_u8(in))),
+			scale, offset);
+}
+
+static inline void neon_block_s16be(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store_s16(out, vreinterpretq_s16_u8(vrev16q_u8(vld1q_u8(in))),
+			scale, offset);
+}
+
+static inline void neon_block_u32le(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_u32(vreinterpretq_u32_u8(vld1q_u8(in))),
+			scale, offset);
+}
+
+static inline void neon_block_s32le(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_s32(vreinterpretq_s32_u8(vld1q_u8(in))),
+			scale, offset);
+}
+
+static inline void neon_block_u32be(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_u32(vreinterpretq_u32_u8(
+			vrev32q_u8(vld1q_u8(in)))), scale, offset);
+}
+
+static inline void neon_block_s32be(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vcvtq_f32_s32(vreinterpretq_s32_u8(
+			vrev32q_u8(vld1q_u8(in)))), scale, offset);
+}
+
+static inline void neon_block_floatle(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vreinterpretq_f32_u8(vld1q_u8(in)), scale, offset);
+}
+
+static inline void neon_block_floatbe(const uint8_t *in, float *out,
+		float32x4_t scale, float32x4_t offset)
+{
+	neon_store(out, vreinterpretq_f32_u8(vrev32q_u8(vld1q_u8(in))),
+			scale, offset);
+}
+
+VECTOR_KERNEL(neon, , u8, 1, 16, float32x4_t)
+VECTOR_KERNEL(neon, , s8, 1, 16, float32x4_t)
+VECTOR_KERNEL(neon, , u16le, 2, 8, float32x4_t)
+VECTOR_KERNEL(neon, , s16le, 2, 8, float32x4_t)
+VECTOR_KERNEL(neon, , u16be, 2, 8, float32x4_t)
+VECTOR_KERNEL(neon, , s16be, 2, 8, float32x4_t)
+VECTOR_KERNEL(neon, , u32le, 4, 4, float32x4_t)
+VECTOR_KERNEL(neon, , s32le, 4, 4, float32x4_t)
+VECTOR_KERNEL(neon, , u32be, 4, 4, float32x4_t)
+VECTOR_KERNEL(neon, , s32be, 4, 4, float32x4_t)
+VECTOR_KERNEL(neon, , floatle, 4, 4, float32x4_t)
+VECTOR_KERNEL(neon, , floatbe, 4, 4, float32x4_t)
+
+static const analog_conv_kernel neon_kernels[CONV_KINDS] = {
+	conv_neon_u8, conv_neon_s8,
+	conv_neon_u16le, conv_neon_s16le, conv_neon_u16be, conv_neon_s16be,
+	conv_neon_u32le, conv_neon_s32le, conv_neon_u32be, conv_neon_s32be,
+	conv_neon_floatle, conv_neon_floatbe,
+};
+#endif
+
+static int analog_conv_kind(const struct sr_analog_encoding *encoding)
+{
+	gboolean be, is_signed;
+
+	be = encoding->is_bigendian;
+	is_signed = encoding->is_signed;
+
+	if (encoding->is_float) {
+		if (encoding->unitsize == sizeof(float))
+			return be ? CONV_FLOATBE : CONV_FLOATLE;
+		return -1;
+	}
+
+	switch (encoding->unitsize) {
+	case 1:
+		return is_signed ? CONV_S8 : CONV_U8;
+	case 2:
+		if (be)
+			return is_signed ? CONV_S16BE : CONV_U16BE;
+		return is_signed ? CONV_S16LE : CONV_U16LE;
+	case 4:
+		if (be)
+			return is_signed ? CONV_S32BE : CONV_U32BE;
+		return is_signed ? CONV_S32LE : CONV_U32LE;
+	default:
+		return -1;
+	}
+}
+
+static int analog_conv_init(struct sr_analog_conv *conv,
+		const struct sr_analog_encoding *encoding)
+{
+	int kind;
+	gboolean bigendian;
+
+	if ((kind = analog_conv_kind(encoding)) < 0) {
+		sr_err("Unsupported unit size '%d' for analog-to-float"
+		       " conversion.", encoding->unitsize);
+		return SR_ERR;
+	}
+
+#ifdef WORDS_BIGENDIAN
+	bigendian = TRUE;
+#else
+	bigendian = FALSE;
+#endif
+
+	conv->unitsize = encoding->unitsize;
+	conv->scale = encoding->scale.p / (float)encoding->scale.q;
+	conv->offset = encoding->offset.p / (float)encoding->offset.q;
+	conv->scalar = scalar_kernels[kind];
+	conv->kernel = conv->scalar;
+
+	if (encoding->is_float && encoding->is_bigendian == bigendian
+			&& encoding->scale.p == 1 && encoding->scale.q == 1
+			&& conv->offset == 0) {
+		/* The data is already in the right format. */
+		conv->kernel = conv_copy;
+		return SR_OK;
+	}
+
+#if defined(HAVE_TARGET_AVX2) && !defined(WORDS_BIGENDIAN)
+	if (__builtin_cpu_supports("avx2")) {
+		conv->kernel = avx2_kernels[kind];
+		return SR_OK;
+	}
+#endif
+#if defined(__SSE2__) && !defined(WORDS_BIGENDIAN)
+	conv->kernel = sse2_kernels[kind];
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__) && !defined(WORDS_BIGENDIAN)
+	conv->kernel = neon_kernels[kind];
+#endif
+
+	return SR_OK;
+}
+
+/**
+ * Create a plan for converting samples of one encoding to float.
+ *
+ * Doing the per-encoding setup once makes sr_analog_conv_run() cheaper
+ * than sr_analog_to_float() for consumers which convert many packets of
+ * the same encoding.
+ *
+ * @param[in] encoding The sample encoding. Must not be NULL.
+ * @param[out] conv Will contain the new plan. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR Unsupported encoding.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_conv_new(const struct sr_analog_encoding *encoding,
+		struct sr_analog_conv **conv)
+{
+	struct sr_analog_conv *c;
+	int ret;
+
+	if (!encoding || !conv)
+		return SR_ERR_ARG;
+
+	c = g_malloc(sizeof(*c));
+	if ((ret = analog_conv_init(c, encoding)) != SR_OK) {
+		g_free(c);
+		return ret;
+	}
+	*conv = c;
+
+	return SR_OK;
+}
+
+/**
+ * Convert samples to float according to a plan.
+ *
+ * @param[in] conv The plan from sr_analog_conv_new(). Must not be NULL.
+ * @param[in] data The samples, in the encoding the plan was created for.
+ *                 Must not be NULL.
+ * @param[in] count The number of samples to convert.
+ * @param[out] outbuf Memory for @a count floats. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_analog_conv_run(const struct sr_analog_conv *conv,
+		const void *data, size_t count, float *outbuf)
+{
+	if (!conv || !data || !outbuf)
+		return SR_ERR_ARG;
+
+	conv->kernel(conv, data, outbuf, count);
+
+	return SR_OK;
+}
+
+/**
+ * Free a conversion plan.
+ *
+ * @param conv The plan to free. NULL is ignored.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_analog_conv_free(struct sr_analog_conv *conv)
+{
+	g_free(conv);
+}
+
 /**
  * Convert an analog datafeed payload to an array of floats.
  *
@@ -174,8 +888,9 @@ SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
 SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 		float *outbuf)
 {
-	unsigned int b, count;
-	gboolean bigendian;
+	struct sr_analog_conv conv;
+	unsigned int count;
+	int ret;
 
 	if (!analog || !(analog->data) || !(analog->meaning)
 			|| !(analog->encoding) || !outbuf)
@@ -183,113 +898,9 @@ SR_API int sr_analog_to_float(const struct sr_datafeed_analog *analog,
 
 	count = analog->num_samples * g_slist_length(analog->meaning->channels);
 
-#ifdef WORDS_BIGENDIAN
-	bigendian = TRUE;
-#else
-	bigendian = FALSE;
-#endif
-
-	if (!analog->encoding->is_float) {
-		float offset = analog->encoding->offset.p / (float)analog->encoding->offset.q;
-		float scale = analog->encoding->scale.p / (float)analog->encoding->scale.q;
-		gboolean is_signed = analog->encoding->is_signed;
-		gboolean is_bigendian = analog->encoding->is_bigendian;
-		int8_t *data8 = (int8_t *)(analog->data);
-		int16_t *data16 = (int16_t *)(analog->data);
-		int32_t *data32 = (int32_t *)(analog->data);
-
-		switch (analog->encoding->unitsize) {
-		case 1:
-			if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * data8[i];
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * R8(data8 + i);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		case 2:
-			if (is_signed && is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB16S(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB16(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL16S(&data16[i]);
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL16(&data16[i]);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		case 4:
-			if (is_signed && is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB32S(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_bigendian) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RB32(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else if (is_signed) {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL32S(&data32[i]);
-					outbuf[i] += offset;
-				}
-			} else {
-				for (unsigned int i = 0; i < count; i++) {
-					outbuf[i] = scale * RL32(&data32[i]);
-					outbuf[i] += offset;
-				}
-			}
-			break;
-		default:
-			sr_err("Unsupported unit size '%d' for analog-to-float"
-			       " conversion.", analog->encoding->unitsize);
-			return SR_ERR;
-		}
-		return SR_OK;
-	}
-
-	if (analog->encoding->unitsize == sizeof(float)
-			&& analog->encoding->is_bigendian == bigendian
-			&& analog->encoding->scale.p == 1
-			&& analog->encoding->scale.q == 1
-			&& analog->encoding->offset.p / (float)analog->encoding->offset.q == 0) {
-		/* The data is already in the right format. */
-		memcpy(outbuf, analog->data, count * sizeof(float));
-	} else {
-		for (unsigned int i = 0; i < count; i += analog->encoding->unitsize) {
-			for (b = 0; b < analog->encoding->unitsize; b++) {
-				if (analog->encoding->is_bigendian == bigendian)
-					((uint8_t *)outbuf)[i + b] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-				else
-					((uint8_t *)outbuf)[i + (analog->encoding->unitsize - b)] =
-						((uint8_t *)analog->data)[i * analog->encoding->unitsize + b];
-			}
-			if (analog->encoding->scale.p != 1
-					|| analog->encoding->scale.q != 1)
-				outbuf[i] = (outbuf[i] * analog->encoding->scale.p) / analog->encoding->scale.q;
-			float offset = ((float)analog->encoding->offset.p / (float)analog->encoding->offset.q);
-			outbuf[i] += offset;
-		}
-	}
+	if ((ret = analog_conv_init(&conv, analog->encoding)) != SR_OK)
+		return ret;
+	conv.kernel(&conv, analog->data, outbuf, count);
 
 	return SR_OK;
 }
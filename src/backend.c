@@ -20,6 +20,7 @@
 
 #include <config.h>
 #include <glib.h>
+#include <zlib.h>
 #ifdef _WIN32
 #include <winsock2.h>
 #endif
@@ -140,6 +141,11 @@ SR_API GSList *sr_buildinfo_libs_get(void)
 	m = g_slist_append(m, g_strdup_printf("%s", CONF_LIBZIP_VERSION));
 	l = g_slist_append(l, m);
 
+	m = g_slist_append(NULL, g_strdup("zlib"));
+	m = g_slist_append(m, g_strdup_printf("%s (rt: %s)",
+		ZLIB_VERSION, zlibVersion()));
+	l = g_slist_append(l, m);
+
 #ifdef HAVE_LIBSERIALPORT
 	m = g_slist_append(NULL, g_strdup("libserialport"));
 	m = g_slist_append(m, g_strdup_printf("%s/%s (rt: %s/%s)",
@@ -595,6 +601,14 @@ SR_API int sr_init(struct sr_context **ctx)
 #endif
 	sr_resource_set_hooks(context, NULL, NULL, NULL, NULL);
 
+	g_mutex_init(&context->scan_mutex);
+	g_cond_init(&context->scan_cond);
+	context->scan_busy = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	context->scan_misses = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, g_free);
+	context->scan_threads = SR_SCAN_THREADS_DEFAULT;
+
 	*ctx = context;
 	context = NULL;
 	ret = SR_OK;
@@ -631,6 +645,11 @@ SR_API int sr_exit(struct sr_context *ctx)
 	libusb_exit(ctx->libusb_ctx);
 #endif
 
+	g_hash_table_unref(ctx->scan_busy);
+	g_hash_table_unref(ctx->scan_misses);
+	g_cond_clear(&ctx->scan_cond);
+	g_mutex_clear(&ctx->scan_mutex);
+
 	g_free(sr_driver_list(ctx));
 	g_free(ctx);
 
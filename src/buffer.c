@@ -0,0 +1,335 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "buffer"
+/** @endcond */
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/**
+ * @file
+ *
+ * Reference counted, pooled payload buffers.
+ *
+ * A driver which sends its samples from an sr_buffer (see
+ * sr_session_send_buffer()) allows consumers to keep the packet past
+ * their datafeed callback without copying the sample data: the packet
+ * returned by sr_packet_ref() just holds another reference to the buffer.
+ *
+ * Drivers recycle their transfer buffers through an sr_buffer_pool. When
+ * a buffer is still referenced by a consumer after it was sent, the driver
+ * hands it over and takes a fresh one from the pool instead.
+ */
+
+/** @private */
+struct sr_buffer_pool {
+	gint refcount;
+	size_t buffer_size;
+	guint max_free;
+	/* Released buffers waiting to be reused, at most max_free. */
+	GAsyncQueue *free;
+};
+
+static void pool_unref(struct sr_buffer_pool *pool)
+{
+	uint8_t *data;
+
+	if (!g_atomic_int_dec_and_test(&pool->refcount))
+		return;
+
+	while ((data = g_async_queue_try_pop(pool->free)))
+		g_free(data);
+	g_async_queue_unref(pool->free);
+	g_free(pool);
+}
+
+static struct sr_buffer *buffer_alloc(uint8_t *data, size_t size)
+{
+	struct sr_buffer *buf;
+
+	buf = g_malloc(sizeof(*buf));
+	buf->refcount = 1;
+	buf->data = data;
+	buf->size = size;
+	buf->pool = NULL;
+	buf->free_func = NULL;
+	buf->owner = NULL;
+
+	return buf;
+}
+
+/**
+ * Allocate a new buffer.
+ *
+ * @param size The buffer size in bytes.
+ *
+ * @return The new buffer with a reference count of one, or NULL if the
+ *         memory could not be allocated.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_new(size_t size)
+{
+	struct sr_buffer *buf;
+	uint8_t *data;
+
+	if (!(data = g_try_malloc(size ? size : 1)))
+		return NULL;
+
+	buf = buffer_alloc(data, size);
+	buf->free_func = g_free;
+
+	return buf;
+}
+
+/**
+ * Wrap memory owned by the caller into a buffer.
+ *
+ * Ownership of @a data passes to the buffer, @a free_func is called on
+ * it when the last reference is dropped.
+ *
+ * @param data The memory to hand over. Must not be NULL.
+ * @param size The size of @a data in bytes.
+ * @param free_func Function used to release @a data, or NULL if the
+ *                  memory does not need to be released.
+ *
+ * @return The new buffer with a reference count of one.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_new_take(void *data, size_t size,
+		GDestroyNotify free_func)
+{
+	struct sr_buffer *buf;
+
+	buf = buffer_alloc(data, size);
+	buf->free_func = free_func;
+
+	return buf;
+}
+
+/**
+ * Wrap memory which belongs to some other object into a buffer.
+ *
+ * The buffer takes over the caller's reference to @a owner, and releases
+ * it with @a owner_free when the last reference is dropped. This lets a
+ * buffer point into a memory mapped file, for example.
+ *
+ * @param data The memory. Must not be NULL.
+ * @param size The size of @a data in bytes.
+ * @param owner The object @a data belongs to. Must not be NULL.
+ * @param owner_free Function used to release @a owner.
+ *
+ * @return The new buffer with a reference count of one.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_new_view(const void *data, size_t size,
+		gpointer owner, GDestroyNotify owner_free)
+{
+	struct sr_buffer *buf;
+
+	buf = buffer_alloc((uint8_t *)data, size);
+	buf->free_func = owner_free;
+	buf->owner = owner;
+
+	return buf;
+}
+
+/**
+ * Take another reference to a buffer.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @return @a buf.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf)
+{
+	g_atomic_int_inc(&buf->refcount);
+
+	return buf;
+}
+
+/**
+ * Drop a reference to a buffer.
+ *
+ * The memory is released, or returned to the pool the buffer came from,
+ * once the last reference is gone. May be called from any thread.
+ *
+ * @param buf The buffer. NULL is ignored.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_unref(struct sr_buffer *buf)
+{
+	struct sr_buffer_pool *pool;
+
+	if (!buf || !g_atomic_int_dec_and_test(&buf->refcount))
+		return;
+
+	if ((pool = buf->pool)) {
+		/* The length check is racy, an extra cached buffer is harmless. */
+		if ((guint)g_async_queue_length(pool->free) < pool->max_free)
+			g_async_queue_push(pool->free, buf->data);
+		else
+			g_free(buf->data);
+		pool_unref(pool);
+	} else if (buf->free_func) {
+		buf->free_func(buf->owner ? buf->owner : buf->data);
+	}
+	g_free(buf);
+}
+
+/**
+ * Check whether anybody but the caller holds a reference to a buffer.
+ *
+ * A driver which finds its transfer buffer still shared after sending
+ * it must not overwrite the contents, it should drop its reference and
+ * continue with a new buffer.
+ *
+ * @param buf The buffer. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_buffer_is_shared(struct sr_buffer *buf)
+{
+	return g_atomic_int_get(&buf->refcount) > 1;
+}
+
+/**
+ * Create a pool of equally sized buffers.
+ *
+ * The pool is reference counted by its buffers, so it may be released
+ * with sr_buffer_pool_free() while buffers are still in use.
+ *
+ * @param buffer_size Size in bytes of every buffer in the pool.
+ * @param max_free Maximum number of released buffers kept for reuse.
+ *
+ * @return The new pool.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t buffer_size,
+		unsigned int max_free)
+{
+	struct sr_buffer_pool *pool;
+
+	pool = g_malloc0(sizeof(*pool));
+	pool->refcount = 1;
+	pool->buffer_size = buffer_size;
+	pool->max_free = max_free;
+	pool->free = g_async_queue_new();
+
+	return pool;
+}
+
+/**
+ * Get a buffer from a pool.
+ *
+ * Reuses a previously released buffer if one is available. The contents
+ * of the buffer are undefined.
+ *
+ * @param pool The pool. Must not be NULL.
+ *
+ * @return A buffer with a reference count of one, or NULL if the memory
+ *         could not be allocated.
+ *
+ * @private
+ */
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool)
+{
+	struct sr_buffer *buf;
+	uint8_t *data;
+
+	if (!(data = g_async_queue_try_pop(pool->free))) {
+		if (!(data = g_try_malloc(pool->buffer_size)))
+			return NULL;
+	}
+
+	buf = buffer_alloc(data, pool->buffer_size);
+	g_atomic_int_inc(&pool->refcount);
+	buf->pool = pool;
+
+	return buf;
+}
+
+/**
+ * Release a pool.
+ *
+ * Buffers which are still in use stay valid, their memory is freed when
+ * they are released.
+ *
+ * @param pool The pool. NULL is ignored.
+ *
+ * @private
+ */
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool)
+{
+	if (!pool)
+		return;
+
+	pool_unref(pool);
+}
+
+/**
+ * Map a file copy-on-write.
+ *
+ * Sample data sent straight from a file mapping can be modified in place
+ * by transforms, which a read-only mapping turns into a crash. Writes to
+ * this mapping go to private copies of the pages, never to the file, and
+ * the file is only opened for reading.
+ *
+ * @param filename The file to map.
+ * @param error Set if the file could not be mapped.
+ *
+ * @return The mapping, or NULL on errors.
+ *
+ * @private
+ */
+SR_PRIV GMappedFile *sr_file_map_private(const char *filename, GError **error)
+{
+	GMappedFile *mapped;
+	int fd, err;
+
+	if ((fd = g_open(filename, O_RDONLY | O_BINARY, 0)) < 0) {
+		err = errno;
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+			"%s", g_strerror(err));
+		return NULL;
+	}
+	mapped = g_mapped_file_new_from_fd(fd, TRUE, error);
+	close(fd);
+
+	return mapped;
+}
@@ -805,4 +805,38 @@ SR_API GSList *sr_dev_inst_channel_groups_get(const struct sr_dev_inst *sdi)
 	return sdi->channel_groups;
 }
 
+/**
+ * Queries when a device's acquisition was last started.
+ *
+ * The times are taken right before and after the driver started the
+ * acquisition in sr_session_start(), as returned by g_get_real_time().
+ * The device starts sampling somewhere in between.
+ *
+ * @param sdi Device instance to use. Must not be NULL.
+ * @param begin_us Pointer to store the time before the start in, or NULL.
+ * @param end_us Pointer to store the time after the start in, or NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA The device has not been started yet.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_dev_inst_start_time_get(const struct sr_dev_inst *sdi,
+		int64_t *begin_us, int64_t *end_us)
+{
+	if (!sdi)
+		return SR_ERR_ARG;
+
+	if (!sdi->start_end_us)
+		return SR_ERR_NA;
+
+	if (begin_us)
+		*begin_us = sdi->start_begin_us;
+	if (end_us)
+		*end_us = sdi->start_end_us;
+
+	return SR_OK;
+}
+
 /** @} */
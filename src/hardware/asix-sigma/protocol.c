@@ -172,7 +172,7 @@ static int sigma_read_pos(uint32_t *stoppos, uint32_t *triggerpos,
 	if ((--*stoppos & 0x1ff) == 0x1ff)
 		*stoppos -= 64;
 
-	if ((*--triggerpos & 0x1ff) == 0x1ff)
+	if ((--*triggerpos & 0x1ff) == 0x1ff)
 		*triggerpos -= 64;
 
 	return 1;
@@ -768,169 +768,230 @@ static uint16_t sigma_deinterlace_200mhz_data(uint16_t indata, int idx)
 	return outdata;
 }
 
-static void store_sr_sample(uint8_t *samples, int idx, uint16_t data)
+/*
+ * Deinterlace one sample of a 16bit item according to the samplerate.
+ */
+static uint16_t sigma_deinterlace_data(const struct dev_context *devc,
+				       uint16_t indata, int idx)
 {
-	samples[2 * idx + 0] = (data >> 0) & 0xff;
-	samples[2 * idx + 1] = (data >> 8) & 0xff;
+	if (devc->cur_samplerate == SR_MHZ(200))
+		return sigma_deinterlace_200mhz_data(indata, idx);
+	if (devc->cur_samplerate == SR_MHZ(100))
+		return sigma_deinterlace_100mhz_data(indata, idx);
+	return indata;
 }
 
 /*
- * Local wrapper around sr_session_send() calls. Make sure to not send
- * more samples to the session's datafeed than what was requested by a
- * previously configured (optional) sample count.
+ * Fill the lookup tables for the current samplerate. Deinterlacing only
+ * moves bits around, so the samples of an item are the OR of the table
+ * entries for its low and its high byte. An entry holds the item's
+ * samples in 16bit units, the first sample in the lowest bits.
+ */
+static void sigma_build_deinterlace_lut(struct dev_context *devc)
+{
+	uint64_t lo, hi;
+	int b, idx;
+
+	for (b = 0; b < 256; b++) {
+		lo = 0;
+		hi = 0;
+		for (idx = 0; idx < devc->samples_per_event; idx++) {
+			lo |= (uint64_t)sigma_deinterlace_data(devc, b, idx)
+				<< (16 * idx);
+			hi |= (uint64_t)sigma_deinterlace_data(devc, b << 8, idx)
+				<< (16 * idx);
+		}
+		devc->deinterlace_lut[0][b] = lo;
+		devc->deinterlace_lut[1][b] = hi;
+	}
+}
+
+/*
+ * Local wrapper around sr_session_send_buffer() calls. Make sure to not
+ * send more samples to the session's datafeed than what was requested by
+ * a previously configured (optional) sample count.
  */
 static void sigma_session_send(struct sr_dev_inst *sdi,
-				struct sr_datafeed_packet *packet)
+				struct sr_datafeed_packet *packet,
+				struct sr_buffer *buf)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_logic *logic;
+	struct sr_datafeed_logic_rle *logic_rle;
 	uint64_t send_now;
 
 	devc = sdi->priv;
 	if (devc->limit_samples) {
-		logic = (void *)packet->payload;
-		send_now = logic->length / logic->unitsize;
+		logic = NULL;
+		logic_rle = NULL;
+		if (packet->type == SR_DF_LOGIC_RLE) {
+			logic_rle = (void *)packet->payload;
+			send_now = logic_rle->num_samples;
+		} else {
+			logic = (void *)packet->payload;
+			send_now = logic->length / logic->unitsize;
+		}
 		if (devc->sent_samples + send_now > devc->limit_samples) {
 			send_now = devc->limit_samples - devc->sent_samples;
-			logic->length = send_now * logic->unitsize;
+			if (logic_rle)
+				sr_logic_rle_truncate(logic_rle, send_now);
+			else
+				logic->length = send_now * logic->unitsize;
 		}
 		if (!send_now)
 			return;
 		devc->sent_samples += send_now;
 	}
 
-	sr_session_send(sdi, packet);
+	sr_session_send_buffer(sdi, packet, buf);
 }
 
 /*
- * This size translates to: event count (1K events per cluster), times
- * the sample width (unitsize, 16bits per event), times the maximum
- * number of samples per event.
+ * Samples are collected in buffers of this many samples, and sent to
+ * the session in one packet per buffer. A DRAM cluster is not split
+ * across buffers unless a trigger is sent in its middle.
  */
-#define SAMPLES_BUFFER_SIZE	(1024 * 2 * 4)
+#define SAMPLES_BUFFER_COUNT	(256 * 1024)
+#define SAMPLES_BUFFER_SIZE	(SAMPLES_BUFFER_COUNT * 2)
 
-static void sigma_decode_dram_cluster(struct sigma_dram_cluster *dram_cluster,
-				      unsigned int events_in_cluster,
-				      unsigned int triggered,
-				      struct sr_dev_inst *sdi)
+/*
+ * Send the collected samples to the session. The 'keep' samples which
+ * follow them move to the start of the buffer for the next packet. If
+ * a consumer kept the sent buffer, a fresh one is taken from the pool.
+ */
+static int sigma_flush_samples(struct sr_dev_inst *sdi, size_t keep)
 {
 	struct dev_context *devc = sdi->priv;
-	struct sigma_state *ss = &devc->state;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct sr_buffer *buf, *next;
+	uint8_t *rest;
+
+	buf = devc->samples_buf;
+	if (devc->samples_count) {
+		logic.length = devc->samples_count * 2;
+		logic.unitsize = 2;
+		logic.data = buf->data;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		sigma_session_send(sdi, &packet, buf);
+	}
+
+	rest = buf->data + devc->samples_count * 2;
+	devc->samples_count = 0;
+	if (!sr_buffer_is_shared(buf)) {
+		memmove(buf->data, rest, keep * 2);
+		return SR_OK;
+	}
+
+	if (!(next = sr_buffer_pool_get(devc->buffer_pool))) {
+		sr_err("Sample buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	memcpy(next->data, rest, keep * 2);
+	sr_buffer_unref(buf);
+	devc->samples_buf = next;
+
+	return SR_OK;
+}
+
+static int sigma_decode_dram_cluster(struct sigma_dram_cluster *dram_cluster,
+				     unsigned int events_in_cluster,
+				     unsigned int triggered,
+				     struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc = sdi->priv;
+	struct sigma_state *ss = &devc->state;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic_rle logic_rle;
 	uint16_t tsdiff, ts, sample, item16;
-	uint8_t samples[SAMPLES_BUFFER_SIZE];
-	uint8_t *send_ptr;
-	size_t send_count, trig_count;
+	uint8_t lastsample[2];
+	uint8_t *samples, *dst;
+	uint64_t run_length, items;
+	size_t count, trig_count;
 	unsigned int i;
-	int j;
+	int ret;
 
 	ts = sigma_dram_cluster_ts(dram_cluster);
 	tsdiff = ts - ss->lastts;
 	ss->lastts = ts + EVENTS_PER_CLUSTER;
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = 2;
-	logic.data = samples;
-
 	/*
 	 * If this cluster is not adjacent to the previously received
-	 * cluster, then send the appropriate number of samples with the
-	 * previous values to the sigrok session. This "decodes RLE".
+	 * cluster, then the previous values held until it started. Pass
+	 * them to the session as a single run, consumers which need the
+	 * samples get them expanded.
 	 */
-	for (ts = 0; ts < tsdiff; ts++) {
-		i = ts % 1024;
-		store_sr_sample(samples, i, ss->lastsample);
+	if (tsdiff > 0) {
+		if ((ret = sigma_flush_samples(sdi, 0)) != SR_OK)
+			return ret;
+		WL16(lastsample, ss->lastsample);
+		run_length = (uint64_t)tsdiff * devc->samples_per_event;
+		logic_rle.num_samples = run_length;
+		logic_rle.num_runs = 1;
+		logic_rle.unitsize = 2;
+		logic_rle.lengths = &run_length;
+		logic_rle.values = lastsample;
+		packet.type = SR_DF_LOGIC_RLE;
+		packet.payload = &logic_rle;
+		sigma_session_send(sdi, &packet, NULL);
+	}
 
-		/*
-		 * If we have 1024 samples ready or we're at the
-		 * end of submitting the padding samples, submit
-		 * the packet to Sigrok. Since constant data is
-		 * sent, duplication of data for rates above 50MHz
-		 * is simple.
-		 */
-		if ((i == 1023) || (ts == tsdiff - 1)) {
-			logic.length = (i + 1) * logic.unitsize;
-			for (j = 0; j < devc->samples_per_event; j++)
-				sigma_session_send(sdi, &packet);
-		}
+	/* Keep whole clusters within the buffer, even at 200MHz. */
+	if (devc->samples_count + EVENTS_PER_CLUSTER * 4 > SAMPLES_BUFFER_COUNT) {
+		if ((ret = sigma_flush_samples(sdi, 0)) != SR_OK)
+			return ret;
 	}
 
 	/*
-	 * Parse the samples in current cluster and prepare them
-	 * to be submitted to Sigrok. Cope with memory layouts that
-	 * vary with the samplerate.
+	 * Parse the samples in current cluster and append them to the
+	 * buffer. Cope with memory layouts that vary with the samplerate,
+	 * the lookup tables hold all samples of an item. The last item
+	 * of a cluster may write beyond its samples, the remainder of
+	 * the buffer has room for that.
 	 */
-	send_ptr = &samples[0];
-	send_count = 0;
-	sample = 0;
+	samples = devc->samples_buf->data + devc->samples_count * 2;
+	dst = samples;
 	for (i = 0; i < events_in_cluster; i++) {
 		item16 = sigma_dram_cluster_data(dram_cluster, i);
-		if (devc->cur_samplerate == SR_MHZ(200)) {
-			sample = sigma_deinterlace_200mhz_data(item16, 0);
-			store_sr_sample(samples, send_count++, sample);
-			sample = sigma_deinterlace_200mhz_data(item16, 1);
-			store_sr_sample(samples, send_count++, sample);
-			sample = sigma_deinterlace_200mhz_data(item16, 2);
-			store_sr_sample(samples, send_count++, sample);
-			sample = sigma_deinterlace_200mhz_data(item16, 3);
-			store_sr_sample(samples, send_count++, sample);
-		} else if (devc->cur_samplerate == SR_MHZ(100)) {
-			sample = sigma_deinterlace_100mhz_data(item16, 0);
-			store_sr_sample(samples, send_count++, sample);
-			sample = sigma_deinterlace_100mhz_data(item16, 1);
-			store_sr_sample(samples, send_count++, sample);
-		} else {
-			sample = item16;
-			store_sr_sample(samples, send_count++, sample);
-		}
+		items = devc->deinterlace_lut[0][item16 & 0xff] |
+			devc->deinterlace_lut[1][item16 >> 8];
+		WL32(dst, items);
+		WL32(dst + 4, items >> 32);
+		dst += devc->samples_per_event * 2;
 	}
+	count = events_in_cluster * devc->samples_per_event;
+	sample = count ? RL16(dst - 2) : 0;
 
 	/*
 	 * If a trigger position applies, then provide the datafeed with
 	 * the first part of data up to that position, then send the
 	 * trigger marker.
 	 */
-	int trigger_offset = 0;
-	if (triggered) {
+	if (triggered && devc->use_triggers) {
 		/*
 		 * Trigger is not always accurate to sample because of
 		 * pipeline delay. However, it always triggers before
 		 * the actual event. We therefore look at the next
 		 * samples to pinpoint the exact position of the trigger.
 		 */
-		trigger_offset = get_trigger_offset(samples,
-					ss->lastsample, &devc->trigger);
-
-		if (trigger_offset > 0) {
-			trig_count = trigger_offset * devc->samples_per_event;
-			packet.type = SR_DF_LOGIC;
-			logic.length = trig_count * logic.unitsize;
-			sigma_session_send(sdi, &packet);
-			send_ptr += trig_count * logic.unitsize;
-			send_count -= trig_count;
-		}
+		trig_count = get_trigger_offset(samples, ss->lastsample,
+					&devc->trigger) * devc->samples_per_event;
+		trig_count = MIN(trig_count, count);
+		devc->samples_count += trig_count;
+		count -= trig_count;
+		if ((ret = sigma_flush_samples(sdi, count)) != SR_OK)
+			return ret;
 
-		/* Only send trigger if explicitly enabled. */
-		if (devc->use_triggers) {
-			packet.type = SR_DF_TRIGGER;
-			sr_session_send(sdi, &packet);
-		}
-	}
-
-	/*
-	 * Send the data after the trigger, or all of the received data
-	 * if no trigger position applies.
-	 */
-	if (send_count) {
-		packet.type = SR_DF_LOGIC;
-		logic.length = send_count * logic.unitsize;
-		logic.data = send_ptr;
-		sigma_session_send(sdi, &packet);
+		packet.type = SR_DF_TRIGGER;
+		packet.payload = NULL;
+		sr_session_send(sdi, &packet);
 	}
 
+	devc->samples_count += count;
 	ss->lastsample = sample;
+
+	return SR_OK;
 }
 
 /*
@@ -953,6 +1014,7 @@ static int decode_chunk_ts(struct sigma_dram_line *dram_line,
 	unsigned int events_in_cluster;
 	unsigned int i;
 	uint32_t trigger_cluster, triggered;
+	int ret;
 
 	devc = sdi->priv;
 	clusters_in_line = events_in_line;
@@ -985,35 +1047,95 @@ static int decode_chunk_ts(struct sigma_dram_line *dram_line,
 		}
 
 		triggered = (i == trigger_cluster);
-		sigma_decode_dram_cluster(dram_cluster, events_in_cluster,
-					  triggered, sdi);
+		ret = sigma_decode_dram_cluster(dram_cluster, events_in_cluster,
+						triggered, sdi);
+		if (ret != SR_OK)
+			return ret;
 	}
 
 	return SR_OK;
 }
 
-static int download_capture(struct sr_dev_inst *sdi)
+/* We can download only up-to 32 DRAM lines in one go! */
+#define DRAM_LINES_PER_READ	32
+/* Reads in flight between the reader thread and the decoder. */
+#define DRAM_NUM_READS		3
+
+struct sigma_dram_read {
+	struct sigma_dram_line lines[DRAM_LINES_PER_READ];
+	uint32_t num_lines;
+	gboolean ok;
+};
+
+/*
+ * A download of the sample memory. A reader thread fetches DRAM lines
+ * over FTDI while the previously fetched lines get decoded, so that the
+ * download is limited by the USB link and not by the decoder.
+ */
+struct sigma_download {
+	struct dev_context *devc;
+	uint32_t first_line;
+	uint32_t lines_total;
+	/* Reads available to the reader, and reads ready for decoding. */
+	GAsyncQueue *free_reads;
+	GAsyncQueue *full_reads;
+	gint stop;
+	struct sigma_dram_read reads[DRAM_NUM_READS];
+};
+
+/*
+ * Read all DRAM lines of the download. The main thread does not access
+ * the FTDI context until this thread has been joined.
+ */
+static gpointer sigma_dram_reader(gpointer data)
 {
-	const uint32_t chunks_per_read = 32;
+	struct sigma_download *dl = data;
+	struct sigma_dram_read *rd;
+	uint32_t lines_done, line;
+	int ret;
+
+	for (lines_done = 0; lines_done < dl->lines_total;
+	     lines_done += rd->num_lines) {
+		rd = g_async_queue_pop(dl->free_reads);
+		if (g_atomic_int_get(&dl->stop))
+			break;
+
+		rd->num_lines = MIN(DRAM_LINES_PER_READ,
+				    dl->lines_total - lines_done);
+		line = (dl->first_line + lines_done) % 0x8000;
+		ret = sigma_read_dram(line, rd->num_lines,
+				      (uint8_t *)rd->lines, dl->devc);
+		rd->ok = ret == (int)(rd->num_lines * CHUNK_SIZE);
+		g_async_queue_push(dl->full_reads, rd);
+		if (!rd->ok)
+			break;
+	}
 
+	return NULL;
+}
+
+static int download_capture(struct sr_dev_inst *sdi)
+{
 	struct dev_context *devc;
-	struct sigma_dram_line *dram_line;
-	int bufsz;
+	struct sigma_download *dl;
+	struct sigma_dram_read *rd;
+	GThread *reader;
 	uint32_t stoppos, triggerpos;
 	uint8_t modestatus;
 	uint32_t i;
-	uint32_t dl_lines_total, dl_lines_curr, dl_lines_done;
-	uint32_t dl_first_line, dl_line;
+	uint32_t dl_lines_total, dl_lines_done;
+	uint32_t dl_first_line;
 	uint32_t dl_events_in_line;
 	uint32_t trg_line, trg_event;
+	int ret;
 
 	devc = sdi->priv;
 	dl_events_in_line = 64 * 7;
 	trg_line = ~0;
 	trg_event = ~0;
 
-	dram_line = g_try_malloc0(chunks_per_read * sizeof(*dram_line));
-	if (!dram_line)
+	dl = g_try_malloc0(sizeof(*dl));
+	if (!dl)
 		return FALSE;
 
 	sr_info("Downloading sample data.");
@@ -1044,6 +1166,11 @@ static int download_capture(struct sr_dev_inst *sdi)
 	}
 
 	devc->sent_samples = 0;
+	sigma_build_deinterlace_lut(devc);
+	devc->buffer_pool = sr_buffer_pool_new(SAMPLES_BUFFER_SIZE, 2);
+	devc->samples_buf = sr_buffer_pool_get(devc->buffer_pool);
+	devc->samples_count = 0;
+	ret = devc->samples_buf ? SR_OK : SR_ERR_MALLOC;
 
 	/*
 	 * Determine how many "DRAM lines" of 1024 bytes each we need to
@@ -1063,26 +1190,32 @@ static int download_capture(struct sr_dev_inst *sdi)
 	} else {
 		dl_first_line = 0;
 	}
-	dl_lines_done = 0;
-	while (dl_lines_total > dl_lines_done) {
-		/* We can download only up-to 32 DRAM lines in one go! */
-		dl_lines_curr = MIN(chunks_per_read, dl_lines_total - dl_lines_done);
 
-		dl_line = dl_first_line + dl_lines_done;
-		dl_line %= 0x8000;
-		bufsz = sigma_read_dram(dl_line, dl_lines_curr,
-					(uint8_t *)dram_line, devc);
-		/* TODO: Check bufsz. For now, just avoid compiler warnings. */
-		(void)bufsz;
+	dl->devc = devc;
+	dl->first_line = dl_first_line;
+	dl->lines_total = dl_lines_total;
+	dl->free_reads = g_async_queue_new();
+	dl->full_reads = g_async_queue_new();
+	for (i = 0; i < DRAM_NUM_READS; i++)
+		g_async_queue_push(dl->free_reads, &dl->reads[i]);
+	reader = g_thread_new("sigma-dram", sigma_dram_reader, dl);
+
+	dl_lines_done = 0;
+	while (ret == SR_OK && dl_lines_total > dl_lines_done) {
+		rd = g_async_queue_pop(dl->full_reads);
+		if (!rd->ok) {
+			sr_err("Failed to read sample data from DRAM.");
+			break;
+		}
 
 		/* This is the first DRAM line, so find the initial timestamp. */
 		if (dl_lines_done == 0) {
 			devc->state.lastts =
-				sigma_dram_cluster_ts(&dram_line[0].cluster[0]);
+				sigma_dram_cluster_ts(&rd->lines[0].cluster[0]);
 			devc->state.lastsample = 0;
 		}
 
-		for (i = 0; i < dl_lines_curr; i++) {
+		for (i = 0; ret == SR_OK && i < rd->num_lines; i++) {
 			uint32_t trigger_event = ~0;
 			/* The last "DRAM line" can be only partially full. */
 			if (dl_lines_done + i == dl_lines_total - 1)
@@ -1092,13 +1225,33 @@ static int download_capture(struct sr_dev_inst *sdi)
 			if (dl_lines_done + i == trg_line)
 				trigger_event = trg_event;
 
-			decode_chunk_ts(dram_line + i, dl_events_in_line,
-					trigger_event, sdi);
+			ret = decode_chunk_ts(rd->lines + i, dl_events_in_line,
+					      trigger_event, sdi);
 		}
 
-		dl_lines_done += dl_lines_curr;
+		dl_lines_done += rd->num_lines;
+		g_async_queue_push(dl->free_reads, rd);
+
+		/* No need to download what the sample limit cuts off. */
+		if (devc->limit_samples && devc->sent_samples +
+		    devc->samples_count >= devc->limit_samples)
+			break;
 	}
-	g_free(dram_line);
+
+	/* Have the reader stop early, and wait for it. */
+	g_atomic_int_set(&dl->stop, 1);
+	g_async_queue_push(dl->free_reads, &dl->reads[0]);
+	g_thread_join(reader);
+	g_async_queue_unref(dl->free_reads);
+	g_async_queue_unref(dl->full_reads);
+	g_free(dl);
+
+	if (ret == SR_OK && devc->samples_buf)
+		sigma_flush_samples(sdi, 0);
+	sr_buffer_unref(devc->samples_buf);
+	devc->samples_buf = NULL;
+	sr_buffer_pool_free(devc->buffer_pool);
+	devc->buffer_pool = NULL;
 
 	std_session_send_df_end(sdi);
 
@@ -268,6 +268,11 @@ struct dev_context {
 	struct sigma_trigger trigger;
 	int use_triggers;
 	struct sigma_state state;
+	/* Sample data download, see download_capture(). */
+	uint64_t deinterlace_lut[2][256];
+	struct sr_buffer_pool *buffer_pool;
+	struct sr_buffer *samples_buf;
+	size_t samples_count;
 };
 
 extern SR_PRIV const uint64_t samplerates[];
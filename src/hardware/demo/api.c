@@ -67,6 +67,15 @@ static const uint32_t devopts[] = {
 	SR_CONF_SAMPLERATE | SR_CONF_GET | SR_CONF_SET | SR_CONF_LIST,
 	SR_CONF_AVERAGING | SR_CONF_GET | SR_CONF_SET,
 	SR_CONF_AVG_SAMPLES | SR_CONF_GET | SR_CONF_SET,
+	SR_CONF_TRIGGER_MATCH | SR_CONF_LIST,
+};
+
+/* Analog channels only, through the analog soft trigger. */
+static const int32_t trigger_matches[] = {
+	SR_TRIGGER_RISING,
+	SR_TRIGGER_FALLING,
+	SR_TRIGGER_OVER,
+	SR_TRIGGER_UNDER,
 };
 
 static const uint32_t devopts_cg_logic[] = {
@@ -368,6 +377,9 @@ static int config_list(uint32_t key, GVariant **data,
 		case SR_CONF_SAMPLERATE:
 			*data = std_gvar_samplerates_steps(ARRAY_AND_SIZE(samplerates));
 			break;
+		case SR_CONF_TRIGGER_MATCH:
+			*data = std_gvar_array_i32(ARRAY_AND_SIZE(trigger_matches));
+			break;
 		default:
 			return SR_ERR_NA;
 		}
@@ -406,12 +418,59 @@ static int config_list(uint32_t key, GVariant **data,
 	return SR_OK;
 }
 
+/*
+ * The soft trigger runs on the pattern of one analog channel, all the
+ * trigger's matches have to be on that channel.
+ */
+static int setup_trigger(const struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct sr_trigger *trigger;
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	struct sr_channel *ch;
+	GSList *l, *m;
+
+	devc = sdi->priv;
+	devc->sta = NULL;
+	devc->trigger_ag = NULL;
+	devc->trigger_fired = FALSE;
+	devc->trigger_skipped = 0;
+
+	if (!(trigger = sr_session_trigger_get(sdi->session)))
+		return SR_OK;
+
+	ch = NULL;
+	for (l = trigger->stages; l; l = l->next) {
+		stage = l->data;
+		for (m = stage->matches; m; m = m->next) {
+			match = m->data;
+			if (match->channel->type != SR_CHANNEL_ANALOG) {
+				sr_err("Only analog channels can trigger.");
+				return SR_ERR_NA;
+			}
+			if (ch && match->channel != ch) {
+				sr_err("Only one channel can trigger.");
+				return SR_ERR_NA;
+			}
+			ch = match->channel;
+		}
+	}
+	if (!ch)
+		return SR_OK;
+
+	devc->trigger_ag = g_hash_table_lookup(devc->ch_ag, ch);
+	devc->sta = soft_trigger_analog_new(sdi, trigger, 0, 0);
+
+	return SR_OK;
+}
+
 static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
 	GSList *l;
 	struct sr_channel *ch;
-	int bitpos;
+	int bitpos, ret;
 	uint8_t mask;
 	GHashTableIter iter;
 	void *value;
@@ -467,6 +526,9 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	while (g_hash_table_iter_next(&iter, NULL, &value))
 		demo_generate_analog_pattern(value, devc->cur_samplerate);
 
+	if ((ret = setup_trigger(sdi)) != SR_OK)
+		return ret;
+
 	sr_session_source_add(sdi->session, -1, 0, 100,
 			demo_prepare_data, (struct sr_dev_inst *)sdi);
 
@@ -495,6 +557,11 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi)
 
 	std_session_send_df_end(sdi);
 
+	if (devc->sta) {
+		soft_trigger_analog_free(devc->sta);
+		devc->sta = NULL;
+	}
+
 	return SR_OK;
 }
 
@@ -444,6 +444,56 @@ do_send:
 	}
 }
 
+/*
+ * Run the analog soft trigger over the next samples of the trigger
+ * channel. Stores how many samples precede the trigger in *skip, which
+ * is all of them if it didn't fire.
+ */
+static int trigger_check(struct sr_dev_inst *sdi, uint64_t samples_todo,
+		uint64_t *skip)
+{
+	struct dev_context *devc;
+	struct analog_gen *ag;
+	struct sr_datafeed_analog analog;
+	uint64_t checked, pos, num, chunk;
+	int offset;
+
+	devc = sdi->priv;
+	ag = devc->trigger_ag;
+	analog = ag->packet;
+
+	checked = 0;
+	while (checked < samples_todo) {
+		pos = (devc->sent_samples + devc->trigger_skipped + checked)
+			% ag->num_samples;
+		num = MIN(samples_todo - checked, ag->num_samples - pos);
+		analog.data = ag->pattern_data + pos;
+		analog.num_samples = num;
+		offset = soft_trigger_analog_check(devc->sta, &analog, NULL);
+		if (offset < -1)
+			return offset;
+		if (offset >= 0) {
+			devc->trigger_fired = TRUE;
+			checked += offset;
+			break;
+		}
+		checked += num;
+	}
+
+	/* Keep the logic pattern in step with the analog ones. */
+	if (devc->num_logic_channels > 0) {
+		for (num = checked; num > 0; num -= chunk) {
+			chunk = MIN(num, LOGIC_BUFSIZE / devc->logic_unitsize);
+			logic_generator(sdi, chunk * devc->logic_unitsize);
+		}
+	}
+
+	devc->trigger_skipped += checked;
+	*skip = checked;
+
+	return SR_OK;
+}
+
 /* Callback handling data */
 SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 {
@@ -455,6 +505,7 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	GHashTableIter iter;
 	void *value;
 	uint64_t samples_todo, logic_done, analog_done, analog_sent, sending_now;
+	uint64_t skip;
 	int64_t elapsed_us, limit_us, todo_us;
 
 	(void)fd;
@@ -507,6 +558,24 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 	 */
 	todo_us = samples_todo * G_USEC_PER_SEC / devc->cur_samplerate;
 
+	/* Drop the samples before the trigger. */
+	if (devc->sta && !devc->trigger_fired) {
+		if (trigger_check(sdi, samples_todo, &skip) != SR_OK) {
+			sr_err("Failed to check the analog trigger.");
+			sr_dev_acquisition_stop(sdi);
+			return G_SOURCE_CONTINUE;
+		}
+		samples_todo -= skip;
+		if (samples_todo == 0) {
+			devc->spent_us += todo_us;
+			if (limit_us > 0 && devc->spent_us >= limit_us) {
+				sr_dbg("Time limit reached before the trigger.");
+				sr_dev_acquisition_stop(sdi);
+			}
+			return G_SOURCE_CONTINUE;
+		}
+	}
+
 	logic_done = devc->num_logic_channels > 0 ? 0 : samples_todo;
 	if (!devc->enabled_logic_channels)
 		logic_done = samples_todo;
@@ -537,7 +606,8 @@ SR_PRIV int demo_prepare_data(int fd, int revents, void *cb_data)
 			g_hash_table_iter_init(&iter, devc->ch_ag);
 			while (g_hash_table_iter_next(&iter, NULL, &value)) {
 				send_analog_packet(value, sdi, &analog_sent,
-						devc->sent_samples + analog_done,
+						devc->sent_samples + analog_done
+						+ devc->trigger_skipped,
 						samples_todo - analog_done);
 			}
 			analog_done += analog_sent;
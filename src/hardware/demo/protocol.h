@@ -117,6 +117,12 @@ struct dev_context {
 	size_t enabled_analog_channels;
 	size_t first_partial_logic_index;
 	uint8_t first_partial_logic_mask;
+	/* Analog soft trigger on one channel, or NULL. */
+	struct soft_trigger_analog *sta;
+	struct analog_gen *trigger_ag;
+	gboolean trigger_fired;
+	/* Number of samples dropped while waiting for the trigger. */
+	uint64_t trigger_skipped;
 };
 
 static const char *analog_pattern_str[] = {
@@ -724,36 +724,57 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
-static void deinterleave_buffer(const uint8_t *src, size_t length,
-	uint16_t *dst_ptr, size_t channel_count, uint16_t channel_mask)
+/*
+ * Work out the sample layout of the acquisition from the enabled channels.
+ * Samples are only as wide as the highest enabled channel needs, and the
+ * transpose kernel is picked once for that width.
+ */
+static void setup_deinterleave(const struct sr_dev_inst *sdi)
 {
-	uint16_t sample;
-
-	for (const uint64_t *src_ptr = (uint64_t*)src;
-		src_ptr < (uint64_t*)(src + length);
-		src_ptr += channel_count) {
-		for (int bit = 0; bit != 64; bit++) {
-			const uint64_t *word_ptr = src_ptr;
-			sample = 0;
-			for (unsigned int channel = 0; channel != 16;
-				channel++) {
-				const uint16_t m = channel_mask >> channel;
-				if (!m)
-					break;
-				if ((m & 1) && ((*word_ptr++ >> bit) & UINT64_C(1)))
-					sample |= 1 << channel;
-			}
-			*dst_ptr++ = sample;
+	struct dev_context *const devc = sdi->priv;
+	const uint16_t channel_mask = enabled_channel_mask(sdi);
+
+	devc->num_enabled_channels = 0;
+	for (unsigned int channel = 0; channel != NUM_CHANNELS; channel++) {
+		if (channel_mask & (1 << channel))
+			devc->plane_channels[devc->num_enabled_channels++] = channel;
+	}
+	devc->unitsize = (channel_mask & 0xff00) ? 2 : 1;
+	devc->planes_in_order =
+		channel_mask == (1 << (8 * devc->unitsize)) - 1;
+	devc->from_planes = sr_logic_from_planes_kernel(devc->unitsize);
+}
+
+static void deinterleave_buffer(struct dev_context *devc,
+	const uint8_t *src, size_t length)
+{
+	const size_t atom_size =
+		DSLOGIC_ATOMIC_BYTES * devc->num_enabled_channels;
+	uint8_t *dst_ptr = devc->deinterleave_buffer;
+	uint64_t planes[NUM_CHANNELS];
+
+	memset(planes, 0, sizeof(planes));
+	for (; length >= atom_size; src += atom_size, length -= atom_size) {
+		const uint64_t *word_ptr = (const uint64_t *)src;
+		if (!devc->planes_in_order) {
+			/* Move each word to the plane of its channel. */
+			for (unsigned int i = 0; i != devc->num_enabled_channels; i++)
+				planes[devc->plane_channels[i]] = word_ptr[i];
+			word_ptr = planes;
 		}
+		devc->from_planes(dst_ptr, word_ptr, devc->unitsize);
+		dst_ptr += DSLOGIC_ATOMIC_SAMPLES * devc->unitsize;
 	}
 }
 
 static void send_data(struct sr_dev_inst *sdi,
-	uint16_t *data, size_t sample_count)
+	uint8_t *data, size_t sample_count)
 {
+	const struct dev_context *const devc = sdi->priv;
+
 	const struct sr_datafeed_logic logic = {
-		.length = sample_count * sizeof(uint16_t),
-		.unitsize = sizeof(uint16_t),
+		.length = sample_count * devc->unitsize,
+		.unitsize = devc->unitsize,
 		.data = data
 	};
 
@@ -769,8 +790,7 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 {
 	struct sr_dev_inst *const sdi = transfer->user_data;
 	struct dev_context *const devc = sdi->priv;
-	const size_t channel_count = enabled_channel_count(sdi);
-	const uint16_t channel_mask = enabled_channel_mask(sdi);
+	const size_t channel_count = devc->num_enabled_channels;
 	const unsigned int cur_sample_count = DSLOGIC_ATOMIC_SAMPLES *
 		transfer->actual_length /
 		(DSLOGIC_ATOMIC_BYTES * channel_count);
@@ -837,14 +857,12 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 		 * channel.
 		 *
 		 * Because sigrok's internal representation is bit-interleaved channels
-		 * we must recast the data.
-		 *
-		 * Hopefully in future it will be possible to pass the data on as-is.
+		 * we must recast the data. Each round of words is transposed as
+		 * bit planes, see setup_deinterleave().
 		 */
 		if (transfer->actual_length % (DSLOGIC_ATOMIC_BYTES * channel_count) != 0)
 			sr_err("Invalid transfer length!");
-		deinterleave_buffer(transfer->buffer, transfer->actual_length,
-			devc->deinterleave_buffer, channel_count, channel_mask);
+		deinterleave_buffer(devc, transfer->buffer, transfer->actual_length);
 
 		/* Send the incoming transfer to the session bus. */
 		if (devc->trigger_pos > devc->sent_samples
@@ -862,7 +880,7 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 			/* Post trigger samples. */
 			num_samples -= trigger_offset;
 			send_data(sdi, devc->deinterleave_buffer
-				+ trigger_offset, num_samples);
+				+ trigger_offset * devc->unitsize, num_samples);
 			devc->sent_samples += num_samples;
 		} else {
 			send_data(sdi, devc->deinterleave_buffer, num_samples);
@@ -966,8 +984,9 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 		return SR_ERR_MALLOC;
 	}
 
+	setup_deinterleave(sdi);
 	devc->deinterleave_buffer = g_try_malloc(DSLOGIC_ATOMIC_SAMPLES *
-		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * sizeof(uint16_t));
+		(size / (channel_count * DSLOGIC_ATOMIC_BYTES)) * devc->unitsize);
 	if (!devc->deinterleave_buffer) {
 		sr_err("Deinterleave buffer malloc failed.");
 		g_free(devc->deinterleave_buffer);
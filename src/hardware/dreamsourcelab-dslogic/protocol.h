@@ -132,7 +132,13 @@ struct dev_context {
 	struct libusb_transfer **transfers;
 	struct sr_context *ctx;
 
-	uint16_t *deinterleave_buffer;
+	uint8_t *deinterleave_buffer;
+	/* Sample layout of the acquisition, see setup_deinterleave(). */
+	unsigned int num_enabled_channels;
+	unsigned int unitsize;
+	uint8_t plane_channels[NUM_CHANNELS];
+	gboolean planes_in_order;
+	sr_logic_planes_kernel from_planes;
 
 	uint16_t mode;
 	uint32_t trigger_pos;
@@ -289,6 +289,9 @@ static void finish_acquisition(struct sr_dev_inst *sdi)
 
 	devc->num_transfers = 0;
 	g_free(devc->transfers);
+	g_free(devc->transfer_buffers);
+	sr_buffer_pool_free(devc->buffer_pool);
+	devc->buffer_pool = NULL;
 
 	/* Free the deinterlace buffers if we had them. */
 	if (g_slist_length(devc->enabled_analog_channels) > 0) {
@@ -311,13 +314,14 @@ static void free_transfer(struct libusb_transfer *transfer)
 	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	g_free(transfer->buffer);
 	transfer->buffer = NULL;
 	libusb_free_transfer(transfer);
 
 	for (i = 0; i < devc->num_transfers; i++) {
 		if (devc->transfers[i] == transfer) {
 			devc->transfers[i] = NULL;
+			sr_buffer_unref(devc->transfer_buffers[i]);
+			devc->transfer_buffers[i] = NULL;
 			break;
 		}
 	}
@@ -339,7 +343,7 @@ static void resubmit_transfer(struct libusb_transfer *transfer)
 
 }
 
-static void mso_send_data_proc(struct sr_dev_inst *sdi,
+static void mso_send_data_proc(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 	uint8_t *data, size_t length, size_t sample_width)
 {
 	size_t i;
@@ -349,6 +353,7 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
 
+	(void)buf;
 	(void)sample_width;
 
 	devc = sdi->priv;
@@ -391,7 +396,7 @@ static void mso_send_data_proc(struct sr_dev_inst *sdi,
 	sr_session_send(sdi, &analog_packet);
 }
 
-static void la_send_data_proc(struct sr_dev_inst *sdi,
+static void la_send_data_proc(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 	uint8_t *data, size_t length, size_t sample_width)
 {
 	const struct sr_datafeed_logic logic = {
@@ -405,7 +410,40 @@ static void la_send_data_proc(struct sr_dev_inst *sdi,
 		.payload = &logic
 	};
 
-	sr_session_send(sdi, &packet);
+	/* Consumers may keep the transfer buffer instead of copying it. */
+	sr_session_send_buffer(sdi, &packet, buf);
+}
+
+/*
+ * Find the buffer a transfer received into. If a consumer kept a reference
+ * to it, leave it to them and let the transfer continue with a fresh one.
+ */
+static struct sr_buffer *transfer_buffer(struct dev_context *devc,
+	struct libusb_transfer *transfer, gboolean renew)
+{
+	struct sr_buffer *buf;
+	unsigned int i;
+
+	for (i = 0; i < devc->num_transfers; i++) {
+		if (devc->transfers[i] == transfer)
+			break;
+	}
+	if (i == devc->num_transfers)
+		return NULL;
+
+	buf = devc->transfer_buffers[i];
+	if (!renew || !sr_buffer_is_shared(buf))
+		return buf;
+
+	if (!(buf = sr_buffer_pool_get(devc->buffer_pool))) {
+		sr_err("USB transfer buffer malloc failed.");
+		return NULL;
+	}
+	sr_buffer_unref(devc->transfer_buffers[i]);
+	devc->transfer_buffers[i] = buf;
+	transfer->buffer = buf->data;
+
+	return buf;
 }
 
 static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
@@ -473,7 +511,9 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 			else
 				num_samples = cur_sample_count;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer,
+			devc->send_data_proc(sdi,
+				transfer_buffer(devc, transfer, FALSE),
+				(uint8_t *)transfer->buffer,
 				num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
 		}
@@ -487,7 +527,9 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 					num_samples > devc->limit_samples - devc->sent_samples)
 				num_samples = devc->limit_samples - devc->sent_samples;
 
-			devc->send_data_proc(sdi, (uint8_t *)transfer->buffer
+			devc->send_data_proc(sdi,
+					transfer_buffer(devc, transfer, FALSE),
+					(uint8_t *)transfer->buffer
 					+ trigger_offset * unitsize,
 					num_samples * unitsize, unitsize);
 			devc->sent_samples += num_samples;
@@ -499,6 +541,9 @@ static void LIBUSB_CALL receive_transfer(struct libusb_transfer *transfer)
 	if (devc->limit_samples && devc->sent_samples >= devc->limit_samples) {
 		fx2lafw_abort_acquisition(devc);
 		free_transfer(transfer);
+	} else if (!transfer_buffer(devc, transfer, TRUE)) {
+		fx2lafw_abort_acquisition(devc);
+		free_transfer(transfer);
 	} else
 		resubmit_transfer(transfer);
 }
@@ -603,7 +648,7 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	struct libusb_transfer *transfer;
 	unsigned int i, num_transfers;
 	int timeout, ret;
-	unsigned char *buf;
+	struct sr_buffer *buf;
 	size_t size;
 
 	devc = sdi->priv;
@@ -630,32 +675,38 @@ static int start_transfers(const struct sr_dev_inst *sdi)
 	devc->submitted_transfers = 0;
 
 	devc->transfers = g_try_malloc0(sizeof(*devc->transfers) * num_transfers);
-	if (!devc->transfers) {
+	devc->transfer_buffers = g_try_malloc0(
+			sizeof(*devc->transfer_buffers) * num_transfers);
+	if (!devc->transfers || !devc->transfer_buffers) {
 		sr_err("USB transfers malloc failed.");
+		g_free(devc->transfers);
+		g_free(devc->transfer_buffers);
 		return SR_ERR_MALLOC;
 	}
+	devc->buffer_pool = sr_buffer_pool_new(size, num_transfers);
 
 	timeout = get_timeout(devc);
 	devc->num_transfers = num_transfers;
 	for (i = 0; i < num_transfers; i++) {
-		if (!(buf = g_try_malloc(size))) {
+		if (!(buf = sr_buffer_pool_get(devc->buffer_pool))) {
 			sr_err("USB transfer buffer malloc failed.");
 			return SR_ERR_MALLOC;
 		}
 		transfer = libusb_alloc_transfer(0);
 		libusb_fill_bulk_transfer(transfer, usb->devhdl,
-				2 | LIBUSB_ENDPOINT_IN, buf, size,
+				2 | LIBUSB_ENDPOINT_IN, buf->data, size,
 				receive_transfer, (void *)sdi, timeout);
 		sr_info("submitting transfer: %d", i);
 		if ((ret = libusb_submit_transfer(transfer)) != 0) {
 			sr_err("Failed to submit transfer: %s.",
 			       libusb_error_name(ret));
 			libusb_free_transfer(transfer);
-			g_free(buf);
+			sr_buffer_unref(buf);
 			fx2lafw_abort_acquisition(devc);
 			return SR_ERR;
 		}
 		devc->transfers[i] = transfer;
+		devc->transfer_buffers[i] = buf;
 		devc->submitted_transfers++;
 	}
 
@@ -116,8 +116,11 @@ struct dev_context {
 
 	unsigned int num_transfers;
 	struct libusb_transfer **transfers;
+	/* The buffer each transfer receives into, same index as transfers. */
+	struct sr_buffer **transfer_buffers;
+	struct sr_buffer_pool *buffer_pool;
 	struct sr_context *ctx;
-	void (*send_data_proc)(struct sr_dev_inst *sdi,
+	void (*send_data_proc)(struct sr_dev_inst *sdi, struct sr_buffer *buf,
 		uint8_t *data, size_t length, size_t sample_width);
 	uint8_t *logic_buffer;
 	float *analog_buffer;
@@ -501,6 +501,10 @@ static int check_options(struct sr_dev_driver *driver, GSList *options,
  * Before calling sr_driver_scan(), the user must have previously initialized
  * the driver by calling sr_driver_init().
  *
+ * Scans of a connection given by SR_CONF_CONN, e.g. a serial port, wait
+ * while another driver probes the same connection. They are skipped while
+ * the driver is known not to find a device on it, see sr_scan_config_set().
+ *
  * @param driver The driver that should scan. This must be a pointer to one of
  *               the entries returned by sr_driver_list(). Must not be NULL.
  * @param options A list of 'struct sr_hwopt' options to pass to the driver's
@@ -515,6 +519,10 @@ static int check_options(struct sr_dev_driver *driver, GSList *options,
  */
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 {
+	struct drv_context *drvc;
+	struct sr_context *ctx;
+	struct sr_config *src;
+	const char *conn;
 	GSList *l;
 
 	if (!driver) {
@@ -532,13 +540,409 @@ SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 			return NULL;
 	}
 
+	/*
+	 * Drivers which probe a given connection, e.g. a serial port,
+	 * must not do so while another driver probes it.
+	 */
+	conn = NULL;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		if (src->key == SR_CONF_CONN) {
+			conn = g_variant_get_string(src->data, NULL);
+			break;
+		}
+	}
+	drvc = driver->context;
+	ctx = drvc->sr_ctx;
+	if (conn && !sr_scan_resource_begin(ctx, driver, conn))
+		return NULL;
+
 	l = driver->scan(driver, options);
 
+	if (conn)
+		sr_scan_resource_end(ctx, driver, conn, l != NULL);
+
 	sr_spew("Scan found %d devices (%s).", g_slist_length(l), driver->name);
 
 	return l;
 }
 
+struct drivers_scan_job {
+	struct sr_dev_driver *driver;
+	struct drivers_scan *scan;
+	GSList *devices;
+	gboolean done;
+};
+
+struct drivers_scan {
+	sr_scan_callback cb;
+	void *cb_data;
+	GSList *options;
+	/** Protects the fields below, and serializes the callback. */
+	GMutex mutex;
+	struct drivers_scan_job *jobs;
+	unsigned int num_jobs;
+	/** The first job whose devices were not reported yet. */
+	unsigned int next;
+	/** Connection IDs of the devices reported so far. */
+	GHashTable *connections;
+	GSList *devices;
+};
+
+/* Keep those options which the driver accepts for scanning. */
+static GSList *driver_scan_options(struct sr_dev_driver *driver,
+		GSList *options)
+{
+	struct sr_config *src;
+	GArray *opts;
+	GSList *l, *result;
+	unsigned int i;
+
+	if (!options || !(opts = sr_driver_scan_options_list(driver)))
+		return NULL;
+
+	result = NULL;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		for (i = 0; i < opts->len; i++) {
+			if (g_array_index(opts, uint32_t, i) == src->key) {
+				result = g_slist_append(result, src);
+				break;
+			}
+		}
+	}
+	g_array_free(opts, TRUE);
+
+	return result;
+}
+
+/* Remove devices from their driver's instances, and free them. */
+static void driver_devices_free(struct sr_dev_driver *driver, GSList *devices)
+{
+	struct drv_context *drvc;
+	GSList *l, *instances;
+
+	drvc = driver->context;
+	instances = drvc->instances;
+	for (l = devices; l; l = l->next)
+		instances = g_slist_remove(instances, l->data);
+
+	/* Have the driver clear just these devices. */
+	drvc->instances = g_slist_copy(devices);
+	sr_dev_clear(driver);
+	drvc->instances = instances;
+}
+
+/*
+ * Report the devices of a job. Several drivers may claim the same
+ * device, the one which comes first in the list of drivers wins. The
+ * instances of the others are freed.
+ */
+static void drivers_scan_report(struct drivers_scan *scan,
+		struct drivers_scan_job *job)
+{
+	struct sr_dev_inst *sdi;
+	GSList *l, *devices, *claimed;
+
+	devices = claimed = NULL;
+	for (l = job->devices; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->connection_id && g_hash_table_contains(
+				scan->connections, sdi->connection_id)) {
+			sr_dbg("Skipping %s device on %s, found before.",
+				job->driver->name, sdi->connection_id);
+			claimed = g_slist_append(claimed, sdi);
+			continue;
+		}
+		devices = g_slist_append(devices, sdi);
+	}
+	g_slist_free(job->devices);
+	job->devices = NULL;
+
+	if (claimed) {
+		driver_devices_free(job->driver, claimed);
+		g_slist_free(claimed);
+	}
+
+	for (l = devices; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->connection_id)
+			g_hash_table_add(scan->connections, sdi->connection_id);
+		if (scan->cb)
+			scan->cb(sdi, scan->cb_data);
+	}
+	scan->devices = g_slist_concat(scan->devices, devices);
+}
+
+static void drivers_scan_worker(gpointer data, gpointer user_data)
+{
+	struct drivers_scan_job *job;
+	struct drivers_scan *scan;
+	GSList *options, *devices;
+
+	(void)user_data;
+
+	job = data;
+	scan = job->scan;
+
+	options = driver_scan_options(job->driver, scan->options);
+	devices = sr_driver_scan(job->driver, options);
+	g_slist_free(options);
+
+	/* Report in driver order, whichever driver finishes first. */
+	g_mutex_lock(&scan->mutex);
+	job->devices = devices;
+	job->done = TRUE;
+	while (scan->next < scan->num_jobs && scan->jobs[scan->next].done)
+		drivers_scan_report(scan, &scan->jobs[scan->next++]);
+	g_mutex_unlock(&scan->mutex);
+}
+
+/**
+ * Scan for devices with several drivers at once.
+ *
+ * The drivers scan one after another, or concurrently in a pool of threads
+ * if sr_scan_config_set() allows more than one. Every driver is passed those of the @a options
+ * which it supports. Devices are reported in the order of @a drivers.
+ * Devices of different drivers which share a connection ID are reported
+ * only once, for the first of those drivers. The other drivers' instances
+ * of the device are freed.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ * @param drivers NULL-terminated array of initialized drivers to scan with,
+ *                or NULL for all initialized drivers.
+ * @param options A list of 'struct sr_config' scan options. Can be NULL.
+ * @param cb Callback invoked for each device as soon as it and the
+ *           devices of all drivers before it are found, or NULL. It is
+ *           called from the scanning threads, but never by two of them
+ *           at once.
+ * @param cb_data User data pointer to be passed to the callback.
+ *
+ * @return A GSList * of 'struct sr_dev_inst', or NULL if no devices were
+ *         found. The list must be freed by the caller using g_slist_free(),
+ *         but without freeing the data pointed to in the list.
+ *
+ * @since 0.6.0
+ */
+SR_API GSList *sr_drivers_scan(struct sr_context *ctx,
+		struct sr_dev_driver **drivers, GSList *options,
+		sr_scan_callback cb, void *cb_data)
+{
+	struct drivers_scan scan;
+	GThreadPool *pool;
+	unsigned int i, n;
+
+	if (!ctx) {
+		sr_err("%s: ctx was NULL", __func__);
+		return NULL;
+	}
+	if (!drivers)
+		drivers = sr_driver_list(ctx);
+
+	for (i = n = 0; drivers[i]; i++) {
+		if (drivers[i]->context)
+			n++;
+	}
+
+	scan.cb = cb;
+	scan.cb_data = cb_data;
+	scan.options = options;
+	g_mutex_init(&scan.mutex);
+	scan.jobs = g_malloc0(n * sizeof(*scan.jobs));
+	scan.num_jobs = n;
+	scan.next = 0;
+	scan.connections = g_hash_table_new(g_str_hash, g_str_equal);
+	scan.devices = NULL;
+
+	for (i = n = 0; drivers[i]; i++) {
+		if (!drivers[i]->context)
+			continue;
+		scan.jobs[n].driver = drivers[i];
+		scan.jobs[n].scan = &scan;
+		n++;
+	}
+
+	pool = NULL;
+	if (ctx->scan_threads > 1)
+		pool = g_thread_pool_new(drivers_scan_worker, NULL,
+				ctx->scan_threads, FALSE, NULL);
+	for (i = 0; i < n; i++) {
+		if (pool)
+			g_thread_pool_push(pool, &scan.jobs[i], NULL);
+		else
+			drivers_scan_worker(&scan.jobs[i], NULL);
+	}
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);
+
+	g_hash_table_unref(scan.connections);
+	g_free(scan.jobs);
+	g_mutex_clear(&scan.mutex);
+
+	sr_dbg("Scan found %d devices.", g_slist_length(scan.devices));
+
+	return scan.devices;
+}
+
+/**
+ * Configure device scans.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ * @param threads Number of drivers and resources which are probed
+ *                concurrently. 0 or 1, the default, scans one after
+ *                another. Only raise it if the drivers and the
+ *                application's callbacks cope with scanning from
+ *                several threads.
+ * @param timeout_ms Time to wait for a SCPI resource while probing it, or
+ *                   0 for the default of its transport. It bounds the wait
+ *                   for each response, and on TCP connecting, too. It
+ *                   doesn't apply to drivers which probe their connection
+ *                   on their own.
+ * @param cache_ms Time during which resources which a driver did not
+ *                 find a device on are skipped by that driver's scans,
+ *                 or 0 to always probe them.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_scan_config_set(struct sr_context *ctx, unsigned int threads,
+		unsigned int timeout_ms, unsigned int cache_ms)
+{
+	if (!ctx) {
+		sr_err("%s: ctx was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	g_mutex_lock(&ctx->scan_mutex);
+	ctx->scan_threads = threads;
+	ctx->scan_timeout_ms = timeout_ms;
+	ctx->scan_cache_ms = cache_ms;
+	g_mutex_unlock(&ctx->scan_mutex);
+
+	return SR_OK;
+}
+
+/**
+ * Forget which resources had no device, probe all of them again.
+ *
+ * @param ctx The libsigrok context. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_scan_cache_clear(struct sr_context *ctx)
+{
+	if (!ctx) {
+		sr_err("%s: ctx was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	g_mutex_lock(&ctx->scan_mutex);
+	g_hash_table_remove_all(ctx->scan_misses);
+	g_mutex_unlock(&ctx->scan_mutex);
+
+	return SR_OK;
+}
+
+/* A resource which is being probed, by one thread. */
+struct scan_busy {
+	GThread *owner;
+	/** Number of nested probes. */
+	unsigned int depth;
+};
+
+/**
+ * Prepare probing a resource for devices.
+ *
+ * Waits while another thread probes the same resource. A thread may
+ * probe a resource again while probing it, e.g. a driver which probes
+ * its connection with a helper which does the same.
+ *
+ * @param ctx The libsigrok context.
+ * @param prober Identifies the driver which probes, e.g. its probe function.
+ * @param resource The resource to probe, e.g. a port or connection string.
+ *
+ * @return FALSE if the resource had no device for @a prober recently, and
+ *         should be skipped. Otherwise sr_scan_resource_end() must be
+ *         called after probing.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_scan_resource_begin(struct sr_context *ctx,
+		const void *prober, const char *resource)
+{
+	struct scan_busy *busy;
+	const gint64 *expiry;
+	char *key;
+
+	key = g_strdup_printf("%p/%s", prober, resource);
+
+	g_mutex_lock(&ctx->scan_mutex);
+	expiry = g_hash_table_lookup(ctx->scan_misses, key);
+	if (expiry && g_get_monotonic_time() < *expiry) {
+		g_mutex_unlock(&ctx->scan_mutex);
+		sr_dbg("Skipping %s, no device found recently.", resource);
+		g_free(key);
+		return FALSE;
+	}
+	while ((busy = g_hash_table_lookup(ctx->scan_busy, resource))
+			&& busy->owner != g_thread_self())
+		g_cond_wait(&ctx->scan_cond, &ctx->scan_mutex);
+	if (!busy) {
+		busy = g_malloc0(sizeof(*busy));
+		busy->owner = g_thread_self();
+		g_hash_table_insert(ctx->scan_busy, g_strdup(resource), busy);
+	}
+	busy->depth++;
+	g_mutex_unlock(&ctx->scan_mutex);
+
+	g_free(key);
+
+	return TRUE;
+}
+
+/**
+ * Finish probing a resource, and remember whether a device was found.
+ *
+ * @param ctx The libsigrok context.
+ * @param prober As passed to sr_scan_resource_begin().
+ * @param resource As passed to sr_scan_resource_begin().
+ * @param found Whether @a prober found a device.
+ *
+ * @private
+ */
+SR_PRIV void sr_scan_resource_end(struct sr_context *ctx,
+		const void *prober, const char *resource, gboolean found)
+{
+	struct scan_busy *busy;
+	gint64 *expiry;
+	char *key;
+
+	key = g_strdup_printf("%p/%s", prober, resource);
+
+	g_mutex_lock(&ctx->scan_mutex);
+	busy = g_hash_table_lookup(ctx->scan_busy, resource);
+	if (busy && !--busy->depth)
+		g_hash_table_remove(ctx->scan_busy, resource);
+	if (!found && ctx->scan_cache_ms) {
+		expiry = g_malloc(sizeof(*expiry));
+		*expiry = g_get_monotonic_time()
+			+ (gint64)ctx->scan_cache_ms * 1000;
+		g_hash_table_replace(ctx->scan_misses, key, expiry);
+		key = NULL;
+	} else {
+		g_hash_table_remove(ctx->scan_misses, key);
+	}
+	g_cond_broadcast(&ctx->scan_cond);
+	g_mutex_unlock(&ctx->scan_mutex);
+
+	g_free(key);
+}
+
 /**
  * Call driver cleanup function for all drivers.
  *
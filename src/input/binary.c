@@ -66,7 +66,8 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static size_t process_data(struct sr_input *in, struct sr_buffer *file,
+		const uint8_t *data, size_t len)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
@@ -98,15 +99,24 @@ static int process_buffer(struct sr_input *in)
 	logic.unitsize = inc->unitsize;
 
 	/* Cut off at multiple of unitsize. */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = len / logic.unitsize * logic.unitsize;
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
+		logic.data = (uint8_t *)data + i;
 		chunk = MIN(CHUNK_SIZE, chunk_size - i);
 		logic.length = chunk;
-		sr_session_send(in->sdi, &packet);
+		sr_session_send_buffer(in->sdi, &packet, file);
 	}
-	g_string_erase(in->buf, 0, chunk_size);
+
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	size_t used;
+
+	used = process_data(in, NULL, (const uint8_t *)in->buf->str, in->buf->len);
+	g_string_erase(in->buf, 0, used);
 
 	return SR_OK;
 }
@@ -128,6 +138,22 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+static int receive_window(struct sr_input *in, struct sr_buffer *file,
+		const uint8_t *data, size_t len, size_t *used)
+{
+	*used = 0;
+
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	*used = process_data(in, file, data, len);
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -179,6 +205,7 @@ SR_PRIV struct sr_input_module input_binary = {
 	.options = get_options,
 	.init = init,
 	.receive = receive,
+	.receive_window = receive_window,
 	.end = end,
 	.reset = reset,
 };
@@ -127,7 +127,8 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int process_buffer(struct sr_input *in)
+static size_t process_data(struct sr_input *in, struct sr_buffer *file,
+		const uint8_t *data, size_t len)
 {
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
@@ -165,19 +166,28 @@ static int process_buffer(struct sr_input *in)
 	logic.unitsize = unitsize;
 
 	/* Cut off at multiple of unitsize. Avoid sending the "header". */
-	chunk_size = in->buf->len / logic.unitsize * logic.unitsize;
+	chunk_size = len / logic.unitsize * logic.unitsize;
 	chunk_size = MIN(chunk_size, inc->samples_remain * unitsize);
 
 	for (i = 0; i < chunk_size; i += chunk) {
-		logic.data = in->buf->str + i;
+		logic.data = (uint8_t *)data + i;
 		chunk = MIN(CHUNK_SIZE, chunk_size - i);
 		if (chunk) {
 			logic.length = chunk;
-			sr_session_send(in->sdi, &packet);
+			sr_session_send_buffer(in->sdi, &packet, file);
 			inc->samples_remain -= chunk / unitsize;
 		}
 	}
-	g_string_erase(in->buf, 0, chunk_size);
+
+	return chunk_size;
+}
+
+static int process_buffer(struct sr_input *in)
+{
+	size_t used;
+
+	used = process_data(in, NULL, (const uint8_t *)in->buf->str, in->buf->len);
+	g_string_erase(in->buf, 0, used);
 
 	return SR_OK;
 }
@@ -199,6 +209,29 @@ static int receive(struct sr_input *in, GString *buf)
 	return ret;
 }
 
+static int receive_window(struct sr_input *in, struct sr_buffer *file,
+		const uint8_t *data, size_t len, size_t *used)
+{
+	struct context *inc;
+
+	inc = in->priv;
+	*used = 0;
+
+	if (!in->sdi_ready) {
+		/* sdi is ready, notify frontend. */
+		in->sdi_ready = TRUE;
+		return SR_OK;
+	}
+
+	*used = process_data(in, file, data, len);
+
+	/* Nothing but the "header" follows the samples, skip it. */
+	if (!inc->samples_remain)
+		*used = len;
+
+	return SR_OK;
+}
+
 static int end(struct sr_input *in)
 {
 	struct context *inc;
@@ -252,6 +285,7 @@ SR_PRIV struct sr_input_module input_chronovu_la8 = {
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
+	.receive_window = receive_window,
 	.end = end,
 	.reset = reset,
 };
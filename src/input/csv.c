@@ -67,39 +67,27 @@
  *
  * startline:     Line number to start processing sample data. Must be greater
  *                than 0. The default line number to start processing is 1.
+ *
+ * column-formats: Specifies the content of each column, starting with the
+ *                first one, as a comma separated list of an optional count
+ *                and a type: 'l' is a logic channel ('0' or '1'), 'a' is an
+ *                analog channel (a decimal number), 't' is a timestamp in
+ *                seconds and '-' is an ignored column. Columns past the list
+ *                are ignored. E.g. "t,8l,2a" is a timestamp, eight logic and
+ *                two analog channels. Without a samplerate, the samplerate
+ *                is taken from the first two timestamps. Overrides the
+ *                numchannels and first-channel options and can't be used
+ *                in single column mode. Not used by default.
  */
 
 /*
  * TODO
  *
- * - Determine how the text line handling can get improved, regarding
- *   all of robustness and flexibility and correctness.
- *   - The current implementation splits on "any run of CR and LF". Which
- *     translates to: Line numbers are wrong in the presence of empty
- *     lines in the input stream. See below for an (expensive) fix.
- *   - Dropping support for CR style end-of-line markers could improve
- *     the situation a lot. Code could search for and split on LF, and
- *     trim optional trailing CR. This would result in proper support
- *     for CRLF (Windows) as well as LF (Unix), and allow for correct
- *     line number counts.
- *   - When support for CR-only line termination cannot get dropped,
- *     then the current implementation is inappropriate. Currently the
- *     input stream is scanned for the first occurance of either of the
- *     supported termination styles (which is good). For the remaining
- *     session a consistent encoding of the text lines is assumed (which
- *     is acceptable).
- *   - When line numbers need to be correct and reliable, _and_ the full
- *     set of previously supported line termination sequences are required,
- *     and potentially more are to get added for improved compatibility
- *     with more platforms or generators, then the current approach of
- *     splitting on runs of termination characters needs to get replaced,
- *     by the more expensive approach to scan for and count the initially
- *     determined termination sequence.
+ * - Text lines are split on the line termination sequence which is seen
+ *   first in the input stream. Streams which mix CR-only line termination
+ *   with LF or CRLF will lose lines.
  *
- * - Add support for analog input data? (optional)
- *   - Needs a syntax first for user specs which channels (columns) are
- *     logic and which are analog. May need heuristics(?) to guess from
- *     input data in the absence of user provided specs.
+ * - Guess which columns are analog in the absence of column formats?
  */
 
 /* Single column formats. */
@@ -109,6 +97,23 @@ enum {
 	FORMAT_OCT
 };
 
+/* Column content types. */
+enum {
+	COLUMN_IGNORE,
+	COLUMN_LOGIC,
+	COLUMN_SINGLE,
+	COLUMN_ANALOG,
+	COLUMN_TIMESTAMP,
+};
+
+struct column_info {
+	int type;
+	/* Logic bit or analog channel number. */
+	unsigned int index;
+	/* Logic or analog channel, or NULL. */
+	struct sr_channel *channel;
+};
+
 struct context {
 	gboolean started;
 
@@ -127,6 +132,9 @@ struct context {
 	/* Termination character(s) used in current stream. */
 	char *termination;
 
+	/* Last character of the termination, which ends a text line. */
+	char line_end;
+
 	/* Determines if sample data is stored in multiple columns. */
 	gboolean multi_column_mode;
 
@@ -158,33 +166,195 @@ struct context {
 	/* Format sample data is stored in single column mode. */
 	int format;
 
+	/* User provided column formats, or NULL. */
+	char *column_formats;
+
+	/*
+	 * Content of the columns up to the last one which is used. Lines
+	 * are not scanned past that column.
+	 */
+	struct column_info *columns;
+	unsigned int num_columns;
+
+	/* Number of analog channels. */
+	unsigned int num_analog;
+
+	/* First timestamp, and how many timestamps were seen so far. */
+	double first_timestamp;
+	unsigned int num_timestamps;
+
 	size_t sample_unit_size;	/**!< Byte count for a single sample. */
 	uint8_t *sample_buffer;		/**!< Buffer for a single sample. */
 
 	uint8_t *datafeed_buffer;	/**!< Queue for datafeed submission. */
-	size_t datafeed_buf_size;
-	size_t datafeed_buf_fill;
+	float **analog_buffers;		/**!< Queues for the analog channels. */
+	size_t samples_per_chunk;
+	size_t samples_in_buffer;
 
 	/* Current line number. */
 	size_t line_number;
 };
 
-static void strip_comment(char *buf, const GString *prefix)
+/* Find the first occurrence of str in len bytes at buf, or NULL. */
+static const char *find_str(const char *buf, size_t len, const GString *str)
 {
-	char *ptr;
+	const char *p, *end;
 
-	if (!prefix->len)
-		return;
+	if (str->len > len)
+		return NULL;
+	end = buf + len - str->len + 1;
+	for (p = buf; (p = memchr(p, str->str[0], end - p)); p++) {
+		if (!memcmp(p, str->str, str->len))
+			return p;
+	}
+
+	return NULL;
+}
+
+static void strip_whitespace(const char **str, size_t *len)
+{
+	while (*len && g_ascii_isspace((*str)[0])) {
+		(*str)++;
+		(*len)--;
+	}
+	while (*len && g_ascii_isspace((*str)[*len - 1]))
+		(*len)--;
+}
+
+/*
+ * Prepare a text line of len bytes at *line for parsing, without the
+ * line termination. Drops a trailing CR, comments and surrounding
+ * whitespace. Returns FALSE for lines which are empty after that.
+ */
+static gboolean prepare_line(const struct context *inc,
+		const char **line, size_t *len)
+{
+	const char *p;
+
+	if (*len && (*line)[*len - 1] == '\r')
+		(*len)--;
+	if (inc->comment->len && (p = find_str(*line, *len, inc->comment)))
+		*len = p - *line;
+	strip_whitespace(line, len);
+
+	return *len != 0;
+}
+
+/*
+ * Get the next column of a text line of len bytes. *pos is the start
+ * of the column within the line, and gets advanced past the delimiter.
+ * The column isn't copied, and is returned without surrounding
+ * whitespace. Returns FALSE when there are no more columns.
+ */
+static gboolean next_column(const struct context *inc, const char *line,
+		size_t len, size_t *pos, const char **column, size_t *column_len)
+{
+	const char *start, *p;
 
-	if ((ptr = strstr(buf, prefix->str)))
-		*ptr = '\0';
+	if (*pos > len)
+		return FALSE;
+
+	start = line + *pos;
+	if (inc->delimiter->len == 1)
+		p = memchr(start, inc->delimiter->str[0], len - *pos);
+	else
+		p = find_str(start, len - *pos, inc->delimiter);
+	if (p) {
+		*column_len = p - start;
+		*pos += *column_len + inc->delimiter->len;
+	} else {
+		*column_len = len - *pos;
+		*pos = len + 1;
+	}
+	*column = start;
+	strip_whitespace(column, column_len);
+
+	return TRUE;
 }
 
-static int parse_binstr(const char *str, struct context *inc)
+/*
+ * Parse a decimal number of len bytes at str, which is not terminated.
+ * Numbers of the form [+-]digits[.digits][(e|E)[+-]digits] whose
+ * mantissa and exponent allow an exactly rounded result from one
+ * multiplication or division take the fast path. Everything else is
+ * handed to g_ascii_strtod().
+ */
+static int parse_number(const char *str, size_t len, double *value)
 {
-	gsize i, j, length;
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+	char buf[64], *end;
+	uint64_t mantissa;
+	int exponent, exp_value, digits;
+	gboolean negative, exp_negative;
+	size_t i;
+
+	i = 0;
+	negative = FALSE;
+	if (i < len && (str[i] == '+' || str[i] == '-'))
+		negative = str[i++] == '-';
+
+	mantissa = 0;
+	exponent = 0;
+	digits = 0;
+	for (; i < len && g_ascii_isdigit(str[i]); i++, digits++)
+		mantissa = mantissa * 10 + (str[i] - '0');
+	if (i < len && str[i] == '.') {
+		for (i++; i < len && g_ascii_isdigit(str[i]); i++, digits++) {
+			mantissa = mantissa * 10 + (str[i] - '0');
+			exponent--;
+		}
+	}
+	if (!digits)
+		goto slow_path;
+
+	if (i < len && (str[i] == 'e' || str[i] == 'E')) {
+		i++;
+		exp_negative = FALSE;
+		if (i < len && (str[i] == '+' || str[i] == '-'))
+			exp_negative = str[i++] == '-';
+		if (i == len || !g_ascii_isdigit(str[i]))
+			return SR_ERR;
+		for (exp_value = 0; i < len && g_ascii_isdigit(str[i]); i++) {
+			if (exp_value < 10000)
+				exp_value = exp_value * 10 + (str[i] - '0');
+		}
+		exponent += exp_negative ? -exp_value : exp_value;
+	}
+	if (i != len)
+		goto slow_path;
+
+	/* Up to 2^53 and 10^22 both operands are exact doubles. */
+	if (digits > 15 || exponent < -22 || exponent > 22)
+		goto slow_path;
 
-	length = strlen(str);
+	*value = mantissa;
+	if (exponent < 0)
+		*value /= powers[-exponent];
+	else
+		*value *= powers[exponent];
+	if (negative)
+		*value = -*value;
+
+	return SR_OK;
+
+slow_path:
+	if (!len || len >= sizeof(buf))
+		return SR_ERR;
+	memcpy(buf, str, len);
+	buf[len] = '\0';
+	*value = g_ascii_strtod(buf, &end);
+	if (end != buf + len)
+		return SR_ERR;
+
+	return SR_OK;
+}
+
+static int parse_binstr(const char *str, size_t length, struct context *inc)
+{
+	gsize i, j;
 
 	if (!length) {
 		sr_err("Column %u in line %zu is empty.", inc->single_column,
@@ -192,17 +362,14 @@ static int parse_binstr(const char *str, struct context *inc)
 		return SR_ERR;
 	}
 
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, inc->sample_unit_size);
-
 	i = inc->first_channel;
 
 	for (j = 0; i < length && j < inc->num_channels; i++, j++) {
 		if (str[length - i - 1] == '1') {
 			inc->sample_buffer[j / 8] |= (1 << (j % 8));
 		} else if (str[length - i - 1] != '0') {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			sr_err("Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column, inc->line_number);
 			return SR_ERR;
 		}
 	}
@@ -210,23 +377,18 @@ static int parse_binstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
-static int parse_hexstr(const char *str, struct context *inc)
+static int parse_hexstr(const char *str, size_t length, struct context *inc)
 {
-	gsize i, j, k, length;
+	gsize i, j, k;
 	uint8_t value;
 	char c;
 
-	length = strlen(str);
-
 	if (!length) {
 		sr_err("Column %u in line %zu is empty.", inc->single_column,
 			inc->line_number);
 		return SR_ERR;
 	}
 
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, inc->sample_unit_size);
-
 	/* Calculate the position of the first hexadecimal digit. */
 	i = inc->first_channel / 4;
 
@@ -234,8 +396,8 @@ static int parse_hexstr(const char *str, struct context *inc)
 		c = str[length - i - 1];
 
 		if (!g_ascii_isxdigit(c)) {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			sr_err("Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column, inc->line_number);
 			return SR_ERR;
 		}
 
@@ -254,23 +416,18 @@ static int parse_hexstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
-static int parse_octstr(const char *str, struct context *inc)
+static int parse_octstr(const char *str, size_t length, struct context *inc)
 {
-	gsize i, j, k, length;
+	gsize i, j, k;
 	uint8_t value;
 	char c;
 
-	length = strlen(str);
-
 	if (!length) {
 		sr_err("Column %u in line %zu is empty.", inc->single_column,
 			inc->line_number);
 		return SR_ERR;
 	}
 
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, inc->sample_unit_size);
-
 	/* Calculate the position of the first octal digit. */
 	i = inc->first_channel / 3;
 
@@ -278,8 +435,8 @@ static int parse_octstr(const char *str, struct context *inc)
 		c = str[length - i - 1];
 
 		if (c < '0' || c > '7') {
-			sr_err("Invalid value '%s' in column %u in line %zu.",
-				str, inc->single_column, inc->line_number);
+			sr_err("Invalid value '%.*s' in column %u in line %zu.",
+				(int)length, str, inc->single_column, inc->line_number);
 			return SR_ERR;
 		}
 
@@ -298,100 +455,139 @@ static int parse_octstr(const char *str, struct context *inc)
 	return SR_OK;
 }
 
-static char **parse_line(char *buf, struct context *inc, int max_columns)
+static int parse_single_column(const char *column, size_t len,
+		struct context *inc)
 {
-	const char *str, *remainder;
-	GSList *list, *l;
-	char **columns;
-	char *column;
-	gsize n, k;
-
-	n = 0;
-	k = 0;
-	list = NULL;
-
-	remainder = buf;
-	str = strstr(remainder, inc->delimiter->str);
-
-	while (str && max_columns) {
-		if (n >= inc->first_column) {
-			column = g_strndup(remainder, str - remainder);
-			list = g_slist_prepend(list, g_strstrip(column));
-
-			max_columns--;
-			k++;
-		}
+	int res;
 
-		remainder = str + inc->delimiter->len;
-		str = strstr(remainder, inc->delimiter->str);
-		n++;
-	}
+	res = SR_ERR;
 
-	if (buf[0] && max_columns && n >= inc->first_column) {
-		column = g_strdup(remainder);
-		list = g_slist_prepend(list, g_strstrip(column));
-		k++;
+	switch (inc->format) {
+	case FORMAT_BIN:
+		res = parse_binstr(column, len, inc);
+		break;
+	case FORMAT_HEX:
+		res = parse_hexstr(column, len, inc);
+		break;
+	case FORMAT_OCT:
+		res = parse_octstr(column, len, inc);
+		break;
 	}
 
-	if (!(columns = g_try_new(char *, k + 1)))
-		return NULL;
-
-	columns[k--] = NULL;
+	return res;
+}
 
-	for (l = list; l; l = l->next)
-		columns[k--] = l->data;
+static void send_samplerate(const struct sr_input *in)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config *src;
+	struct context *inc;
 
-	g_slist_free(list);
+	inc = in->priv;
 
-	return columns;
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(inc->samplerate));
+	meta.config = g_slist_append(NULL, src);
+	sr_session_send(in->sdi, &packet);
+	g_slist_free(meta.config);
+	sr_config_free(src);
 }
 
-static int parse_multi_columns(char **columns, struct context *inc)
+/*
+ * Without a user specified samplerate, take the samplerate from the
+ * interval of the first two timestamps.
+ */
+static void process_timestamp(const struct sr_input *in, double timestamp)
 {
-	gsize i;
-	char *column;
+	struct context *inc;
+	double interval;
 
-	/* Clear buffer in order to set bits only. */
-	memset(inc->sample_buffer, 0, inc->sample_unit_size);
+	inc = in->priv;
 
-	for (i = 0; i < inc->num_channels; i++) {
-		column = columns[i];
-		if (column[0] == '1') {
-			inc->sample_buffer[i / 8] |= (1 << (i % 8));
-		} else if (!strlen(column)) {
-			sr_err("Column %zu in line %zu is empty.",
-				inc->first_channel + i, inc->line_number);
-			return SR_ERR;
-		} else if (column[0] != '0') {
-			sr_err("Invalid value '%s' in column %zu in line %zu.",
-				column, inc->first_channel + i,
-				inc->line_number);
-			return SR_ERR;
-		}
+	if (inc->num_timestamps++ == 0) {
+		inc->first_timestamp = timestamp;
+		return;
 	}
+	if (inc->num_timestamps != 2 || inc->samplerate)
+		return;
 
-	return SR_OK;
+	interval = timestamp - inc->first_timestamp;
+	if (interval <= 0) {
+		sr_warn("Cannot derive samplerate from timestamps in line %zu.",
+			inc->line_number);
+		return;
+	}
+	inc->samplerate = 1 / interval + 0.5;
+	sr_dbg("Samplerate from timestamps: %" PRIu64 ".", inc->samplerate);
+	send_samplerate(in);
 }
 
-static int parse_single_column(const char *column, struct context *inc)
+/* Parse the columns of a prepared text line into the sample buffers. */
+static int parse_columns(const struct sr_input *in, const char *line, size_t len)
 {
-	int res;
+	struct context *inc;
+	const struct column_info *info;
+	const char *column;
+	size_t column_len, pos;
+	unsigned int n;
+	double value;
 
-	res = SR_ERR;
+	inc = in->priv;
 
-	switch (inc->format) {
-	case FORMAT_BIN:
-		res = parse_binstr(column, inc);
-		break;
-	case FORMAT_HEX:
-		res = parse_hexstr(column, inc);
-		break;
-	case FORMAT_OCT:
-		res = parse_octstr(column, inc);
-		break;
+	/* Clear buffer in order to set bits only. */
+	memset(inc->sample_buffer, 0, inc->sample_unit_size);
+
+	pos = 0;
+	for (n = 0; n < inc->num_columns; n++) {
+		if (!next_column(inc, line, len, &pos, &column, &column_len)) {
+			if (!inc->multi_column_mode)
+				sr_err("Column %u in line %zu is out of bounds.",
+					inc->first_column, inc->line_number);
+			else
+				sr_err("Not enough columns for desired number of channels in line %zu.",
+					inc->line_number);
+			return SR_ERR;
+		}
+
+		info = &inc->columns[n];
+		switch (info->type) {
+		case COLUMN_IGNORE:
+			break;
+		case COLUMN_LOGIC:
+			if (!column_len) {
+				sr_err("Column %u in line %zu is empty.",
+					n, inc->line_number);
+				return SR_ERR;
+			} else if (column[0] == '1') {
+				inc->sample_buffer[info->index / 8] |= (1 << (info->index % 8));
+			} else if (column[0] != '0') {
+				sr_err("Invalid value '%.*s' in column %u in line %zu.",
+					(int)column_len, column, n, inc->line_number);
+				return SR_ERR;
+			}
+			break;
+		case COLUMN_SINGLE:
+			if (parse_single_column(column, column_len, inc) != SR_OK)
+				return SR_ERR;
+			break;
+		case COLUMN_ANALOG:
+		case COLUMN_TIMESTAMP:
+			if (parse_number(column, column_len, &value) != SR_OK) {
+				sr_err("Invalid value '%.*s' in column %u in line %zu.",
+					(int)column_len, column, n, inc->line_number);
+				return SR_ERR;
+			}
+			if (info->type == COLUMN_TIMESTAMP)
+				process_timestamp(in, value);
+			else
+				inc->analog_buffers[info->index][inc->samples_in_buffer] = value;
+			break;
+		}
 	}
 
-	return res;
+	return SR_OK;
 }
 
 static int flush_samples(const struct sr_input *in)
@@ -399,25 +595,51 @@ static int flush_samples(const struct sr_input *in)
 	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GSList channels;
+	unsigned int n;
 	int rc;
 
 	inc = in->priv;
-	if (!inc->datafeed_buf_fill)
+	if (!inc->samples_in_buffer)
 		return SR_OK;
 
-	memset(&packet, 0, sizeof(packet));
-	memset(&logic, 0, sizeof(logic));
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->sample_unit_size;
-	logic.length = inc->datafeed_buf_fill;
-	logic.data = inc->datafeed_buffer;
+	if (inc->sample_unit_size) {
+		memset(&packet, 0, sizeof(packet));
+		memset(&logic, 0, sizeof(logic));
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.unitsize = inc->sample_unit_size;
+		logic.length = inc->samples_in_buffer * inc->sample_unit_size;
+		logic.data = inc->datafeed_buffer;
 
-	rc = sr_session_send(in->sdi, &packet);
-	if (rc != SR_OK)
-		return rc;
+		rc = sr_session_send(in->sdi, &packet);
+		if (rc != SR_OK)
+			return rc;
+	}
+
+	for (n = 0; n < inc->num_columns; n++) {
+		if (inc->columns[n].type != COLUMN_ANALOG)
+			continue;
+		/* The text gives no precision information. */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 6);
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		analog.num_samples = inc->samples_in_buffer;
+		analog.data = inc->analog_buffers[inc->columns[n].index];
+		channels.data = inc->columns[n].channel;
+		channels.next = NULL;
+		analog.meaning->channels = &channels;
+		rc = sr_session_send(in->sdi, &packet);
+		if (rc != SR_OK)
+			return rc;
+	}
 
-	inc->datafeed_buf_fill = 0;
+	inc->samples_in_buffer = 0;
+	inc->sample_buffer = inc->datafeed_buffer;
 	return SR_OK;
 }
 
@@ -428,16 +650,85 @@ static int queue_samples(const struct sr_input *in)
 
 	inc = in->priv;
 
-	inc->datafeed_buf_fill += inc->sample_unit_size;
-	if (inc->datafeed_buf_fill == inc->datafeed_buf_size) {
+	inc->samples_in_buffer++;
+	if (inc->samples_in_buffer == inc->samples_per_chunk) {
 		rc = flush_samples(in);
 		if (rc != SR_OK)
 			return rc;
 	}
-	inc->sample_buffer = &inc->datafeed_buffer[inc->datafeed_buf_fill];
+	inc->sample_buffer = &inc->datafeed_buffer[inc->samples_in_buffer * inc->sample_unit_size];
 	return SR_OK;
 }
 
+/*
+ * Parse the column formats option, e.g. "t,8l,2a,-", into the column
+ * table. Every item is an optional count and a column type.
+ */
+static int parse_column_formats(struct context *inc)
+{
+	struct column_info *info;
+	char **items, *item, *end;
+	unsigned long count, i;
+	int type, ret;
+	size_t n;
+
+	ret = SR_OK;
+	items = g_strsplit(inc->column_formats, ",", 0);
+	for (n = 0; items[n]; n++) {
+		item = g_strstrip(items[n]);
+		count = 1;
+		if (g_ascii_isdigit(item[0]))
+			count = strtoul(item, &end, 10);
+		else
+			end = item;
+
+		switch (end[0]) {
+		case '-':
+			type = COLUMN_IGNORE;
+			break;
+		case 'l':
+			type = COLUMN_LOGIC;
+			break;
+		case 'a':
+			type = COLUMN_ANALOG;
+			break;
+		case 't':
+			type = COLUMN_TIMESTAMP;
+			break;
+		default:
+			type = -1;
+			break;
+		}
+		if (type < 0 || end[1] != '\0' || !count || count > 4096) {
+			sr_err("Invalid column format '%s'.", item);
+			ret = SR_ERR_ARG;
+			break;
+		}
+
+		inc->columns = g_renew(struct column_info, inc->columns,
+			inc->num_columns + count);
+		for (i = 0; i < count; i++) {
+			info = &inc->columns[inc->num_columns++];
+			info->type = type;
+			info->channel = NULL;
+			if (type == COLUMN_LOGIC)
+				info->index = inc->num_channels++;
+			else if (type == COLUMN_ANALOG)
+				info->index = inc->num_analog++;
+			else
+				info->index = 0;
+		}
+	}
+	g_strfreev(items);
+
+	if (ret == SR_OK && !inc->num_channels && !inc->num_analog) {
+		sr_err("Column formats don't contain any channels.");
+		ret = SR_ERR_ARG;
+	}
+
+	return ret;
+}
+
 static int init(struct sr_input *in, GHashTable *options)
 {
 	struct context *inc;
@@ -501,11 +792,22 @@ static int init(struct sr_input *in, GHashTable *options)
 		return SR_ERR_ARG;
 	}
 
+	inc->column_formats = g_strdup(g_variant_get_string(
+			g_hash_table_lookup(options, "column-formats"), NULL));
+	if (inc->column_formats[0] != '\0') {
+		if (!inc->multi_column_mode) {
+			sr_err("Column formats can't be used in single column mode.");
+			return SR_ERR_ARG;
+		}
+		/* The column formats provide the channels. */
+		inc->num_channels = 0;
+		inc->first_column = 0;
+		return parse_column_formats(inc);
+	}
+
 	return SR_OK;
 }
 
-static const char *delim_set = "\r\n";
-
 static const char *get_line_termination(GString *buf)
 {
 	const char *term;
@@ -515,125 +817,164 @@ static const char *get_line_termination(GString *buf)
 		term = "\r\n";
 	else if (memchr(buf->str, '\n', buf->len))
 		term = "\n";
-	else if (memchr(buf->str, '\r', buf->len))
+	/* A CR at the end of the buffer may be the start of a CRLF. */
+	else if (buf->len > 1 && memchr(buf->str, '\r', buf->len - 1))
 		term = "\r";
 
 	return term;
 }
 
+/* Set up the column table for the single and multi column modes. */
+static void setup_columns(struct context *inc)
+{
+	unsigned int n;
+
+	if (inc->multi_column_mode)
+		inc->num_columns = inc->first_column + inc->num_channels;
+	else
+		inc->num_columns = inc->first_column + 1;
+	inc->columns = g_new0(struct column_info, inc->num_columns);
+
+	for (n = inc->first_column; n < inc->num_columns; n++) {
+		if (inc->multi_column_mode) {
+			inc->columns[n].type = COLUMN_LOGIC;
+			inc->columns[n].index = n - inc->first_column;
+		} else {
+			inc->columns[n].type = COLUMN_SINGLE;
+		}
+	}
+}
+
 static int initial_parse(const struct sr_input *in, GString *buf)
 {
 	struct context *inc;
+	struct column_info *info;
 	GString *channel_name;
-	unsigned int num_columns, i;
-	size_t line_number, l;
+	GPtrArray *names;
+	unsigned int num_columns, n, index, i;
+	size_t line_number, pos, len, column_len;
 	int ret;
-	char **lines, *line, **columns, *column;
+	const char *line, *column, *p;
 
 	ret = SR_OK;
 	inc = in->priv;
-	columns = NULL;
 
+	line = NULL;
+	len = 0;
 	line_number = 0;
-	lines = g_strsplit_set(buf->str, delim_set, 0);
-	for (l = 0; lines[l]; l++) {
+	for (pos = 0; pos < buf->len; ) {
+		p = memchr(buf->str + pos, inc->line_end, buf->len - pos);
+		if (!p) {
+			line = NULL;
+			break;
+		}
+		line = buf->str + pos;
+		len = p - line;
+		pos = p - buf->str + 1;
 		line_number++;
-		line = lines[l];
 		if (inc->start_line > line_number) {
 			sr_spew("Line %zu skipped.", line_number);
+			line = NULL;
 			continue;
 		}
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", line_number);
-			continue;
-		}
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", line_number);
+		if (!prepare_line(inc, &line, &len)) {
+			sr_spew("Blank or comment-only line %zu skipped.", line_number);
+			line = NULL;
 			continue;
 		}
 
 		/* Reached first proper line. */
 		break;
 	}
-	if (!lines[l]) {
+	if (!line) {
 		/* Not enough data for a proper line yet. */
-		ret = SR_ERR_NA;
-		goto out;
+		return SR_ERR_NA;
 	}
 
 	/*
 	 * In order to determine the number of columns parse the current line
-	 * without limiting the number of columns.
+	 * without limiting the number of columns. Keep the column texts for
+	 * use as channel names.
 	 */
-	columns = parse_line(line, inc, -1);
-	if (!columns) {
-		sr_err("Error while parsing line %zu.", line_number);
-		ret = SR_ERR;
-		goto out;
-	}
-	num_columns = g_strv_length(columns);
+	names = g_ptr_array_new_with_free_func(g_free);
+	pos = 0;
+	while (next_column(inc, line, len, &pos, &column, &column_len))
+		g_ptr_array_add(names, g_strndup(column, column_len));
 
 	/* Ensure that the first column is not out of bounds. */
-	if (!num_columns) {
+	if (names->len <= inc->first_column) {
 		sr_err("Column %u in line %zu is out of bounds.",
 			inc->first_column, line_number);
 		ret = SR_ERR;
 		goto out;
 	}
+	num_columns = names->len - inc->first_column;
 
-	if (inc->multi_column_mode) {
+	if (!inc->columns) {
 		/*
 		 * Detect the number of channels in multi column mode
 		 * automatically if not specified.
 		 */
-		if (!inc->num_channels) {
+		if (inc->multi_column_mode && !inc->num_channels) {
 			inc->num_channels = num_columns;
 			sr_dbg("Number of auto-detected channels: %u.",
 				inc->num_channels);
 		}
+		setup_columns(inc);
+	}
 
-		/*
-		 * Ensure that the number of channels does not exceed the number
-		 * of columns in multi column mode.
-		 */
-		if (num_columns < inc->num_channels) {
-			sr_err("Not enough columns for desired number of channels in line %zu.",
-				line_number);
-			ret = SR_ERR;
-			goto out;
-		}
+	/*
+	 * Ensure that the number of channels does not exceed the number
+	 * of columns in multi column mode.
+	 */
+	if (names->len < inc->num_columns) {
+		sr_err("Not enough columns for desired number of channels in line %zu.",
+			line_number);
+		ret = SR_ERR;
+		goto out;
 	}
 
 	channel_name = g_string_sized_new(64);
-	for (i = 0; i < inc->num_channels; i++) {
-		column = columns[i];
-		if (inc->header && inc->multi_column_mode && column[0] != '\0')
+	if (!inc->multi_column_mode) {
+		for (i = 0; i < inc->num_channels; i++) {
+			g_string_printf(channel_name, "%u", i);
+			sr_channel_new(in->sdi, i, SR_CHANNEL_LOGIC, TRUE, channel_name->str);
+		}
+	}
+	for (n = 0, index = 0; inc->multi_column_mode && n < inc->num_columns; n++) {
+		info = &inc->columns[n];
+		if (info->type != COLUMN_LOGIC && info->type != COLUMN_ANALOG)
+			continue;
+		column = g_ptr_array_index(names, n);
+		if (inc->header && column[0] != '\0')
 			g_string_assign(channel_name, column);
 		else
-			g_string_printf(channel_name, "%u", i);
-		sr_channel_new(in->sdi, i, SR_CHANNEL_LOGIC, TRUE, channel_name->str);
+			g_string_printf(channel_name, "%u", index);
+		info->channel = sr_channel_new(in->sdi, index++,
+			info->type == COLUMN_LOGIC ? SR_CHANNEL_LOGIC : SR_CHANNEL_ANALOG,
+			TRUE, channel_name->str);
 	}
 	g_string_free(channel_name, TRUE);
 
 	/*
 	 * Calculate the minimum buffer size to store the set of samples
-	 * of all channels (unit size). Determine a larger buffer size
-	 * for datafeed submission that is a multiple of the unit size.
-	 * Allocate the larger buffer, and have the "sample buffer" point
-	 * to a location within that large buffer.
+	 * of all channels (unit size). Determine how many samples fit
+	 * the logic and analog buffers for datafeed submission. Have
+	 * the "sample buffer" point to a location within the logic
+	 * buffer.
 	 */
 	inc->sample_unit_size = (inc->num_channels + 7) / 8;
-	inc->datafeed_buf_size = CHUNK_SIZE;
-	inc->datafeed_buf_size *= inc->sample_unit_size;
-	inc->datafeed_buffer = g_malloc(inc->datafeed_buf_size);
-	inc->datafeed_buf_fill = 0;
-	inc->sample_buffer = &inc->datafeed_buffer[inc->datafeed_buf_fill];
+	inc->samples_per_chunk = CHUNK_SIZE /
+		(inc->sample_unit_size + inc->num_analog * sizeof(float));
+	inc->datafeed_buffer = g_malloc(inc->samples_per_chunk * inc->sample_unit_size);
+	inc->analog_buffers = g_new0(float *, inc->num_analog);
+	for (i = 0; i < inc->num_analog; i++)
+		inc->analog_buffers[i] = g_new(float, inc->samples_per_chunk);
+	inc->samples_in_buffer = 0;
+	inc->sample_buffer = inc->datafeed_buffer;
 
 out:
-	if (columns)
-		g_strfreev(columns);
-	g_strfreev(lines);
+	g_ptr_array_free(names, TRUE);
 
 	return ret;
 }
@@ -662,9 +1003,7 @@ static void initial_bom_check(const struct sr_input *in)
 static int initial_receive(const struct sr_input *in)
 {
 	struct context *inc;
-	GString *new_buf;
-	int len, ret;
-	char *p;
+	int ret;
 	const char *termination;
 
 	initial_bom_check(in);
@@ -676,160 +1015,105 @@ static int initial_receive(const struct sr_input *in)
 		/* Don't have a full line yet. */
 		return SR_ERR_NA;
 
-	p = g_strrstr_len(in->buf->str, in->buf->len, termination);
-	if (!p)
-		/* Don't have a full line yet. */
-		return SR_ERR_NA;
-	len = p - in->buf->str - 1;
-	new_buf = g_string_new_len(in->buf->str, len);
-	g_string_append_c(new_buf, '\0');
-
-	inc->termination = g_strdup(termination);
+	/* Split lines on the last character, drop the CR of CRLF later. */
+	inc->line_end = termination[strlen(termination) - 1];
 
-	if (in->buf->str[0] != '\0')
-		ret = initial_parse(in, new_buf);
-	else
-		ret = SR_OK;
-
-	g_string_free(new_buf, TRUE);
+	ret = initial_parse(in, in->buf);
+	if (ret == SR_OK)
+		inc->termination = g_strdup(termination);
 
 	return ret;
 }
 
-static int process_buffer(struct sr_input *in, gboolean is_eof)
+/* Parse a single text line of len bytes, without the termination. */
+static int process_line(const struct sr_input *in, const char *line, size_t len)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_meta meta;
-	struct sr_config *src;
 	struct context *inc;
-	gsize num_columns;
-	uint64_t samplerate;
-	int max_columns, ret, l;
-	char *p, **lines, *line, **columns;
 
 	inc = in->priv;
-	if (!inc->started) {
-		std_session_send_df_header(in->sdi);
-
-		if (inc->samplerate) {
-			packet.type = SR_DF_META;
-			packet.payload = &meta;
-			samplerate = inc->samplerate;
-			src = sr_config_new(SR_CONF_SAMPLERATE, g_variant_new_uint64(samplerate));
-			meta.config = g_slist_append(NULL, src);
-			sr_session_send(in->sdi, &packet);
-			g_slist_free(meta.config);
-			sr_config_free(src);
-		}
 
-		inc->started = TRUE;
+	inc->line_number++;
+	if (inc->start_line > inc->line_number) {
+		sr_spew("Line %zu skipped.", inc->line_number);
+		return SR_OK;
+	}
+	if (!prepare_line(inc, &line, &len)) {
+		sr_spew("Blank or comment-only line %zu skipped.", inc->line_number);
+		return SR_OK;
 	}
 
-	/* Limit the number of columns to parse. */
-	if (inc->multi_column_mode)
-		max_columns = inc->num_channels;
-	else
-		max_columns = 1;
-
-	/*
-	 * Consider empty input non-fatal. Keep accumulating input until
-	 * at least one full text line has become available. Grab the
-	 * maximum amount of accumulated data that consists of full text
-	 * lines, and process what has been received so far, leaving not
-	 * yet complete lines for the next invocation.
-	 *
-	 * Enforce that all previously buffered data gets processed in
-	 * the "EOF" condition. Do not insist in the presence of the
-	 * termination sequence for the last line (may often be missing
-	 * on Windows). A present termination sequence will just result
-	 * in the "execution of an empty line", and does not harm.
-	 */
-	if (!in->buf->len)
+	/* Skip the header line, its content was used as the channel names. */
+	if (inc->header) {
+		sr_spew("Header line %zu skipped.", inc->line_number);
+		inc->header = FALSE;
 		return SR_OK;
-	if (is_eof) {
-		p = in->buf->str + in->buf->len;
-	} else {
-		p = g_strrstr_len(in->buf->str, in->buf->len, inc->termination);
-		if (!p)
-			return SR_ERR;
-		*p = '\0';
-		p += strlen(inc->termination);
 	}
-	g_strstrip(in->buf->str);
 
-	ret = SR_OK;
-	lines = g_strsplit_set(in->buf->str, delim_set, 0);
-	for (l = 0; lines[l]; l++) {
-		inc->line_number++;
-		line = lines[l];
-		if (line[0] == '\0') {
-			sr_spew("Blank line %zu skipped.", inc->line_number);
-			continue;
-		}
+	if (parse_columns(in, line, len) != SR_OK)
+		return SR_ERR;
 
-		/* Remove trailing comment. */
-		strip_comment(line, inc->comment);
-		if (line[0] == '\0') {
-			sr_spew("Comment-only line %zu skipped.", inc->line_number);
-			continue;
-		}
+	/* Send sample data to the session bus. */
+	if (queue_samples(in) != SR_OK) {
+		sr_err("Sending samples failed.");
+		return SR_ERR;
+	}
 
-		/* Skip the header line, its content was used as the channel names. */
-		if (inc->header) {
-			sr_spew("Header line %zu skipped.", inc->line_number);
-			inc->header = FALSE;
-			continue;
-		}
+	return SR_OK;
+}
 
-		columns = parse_line(line, inc, max_columns);
-		if (!columns) {
-			sr_err("Error while parsing line %zu.", inc->line_number);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		num_columns = g_strv_length(columns);
-		if (!num_columns) {
-			sr_err("Column %u in line %zu is out of bounds.",
-				inc->first_column, inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
-		/*
-		 * Ensure that the number of channels does not exceed the number
-		 * of columns in multi column mode.
-		 */
-		if (inc->multi_column_mode && num_columns < inc->num_channels) {
-			sr_err("Not enough columns for desired number of channels in line %zu.",
-				inc->line_number);
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
+/*
+ * Parse the complete text lines in len bytes at data, in place. With
+ * is_eof, the last line doesn't need a termination. The number of bytes
+ * which were processed is returned in *consumed.
+ */
+static int process_lines(const struct sr_input *in, const char *data,
+		size_t len, gboolean is_eof, size_t *consumed)
+{
+	struct context *inc;
+	const char *p;
+	size_t pos, next;
+	int ret;
+
+	inc = in->priv;
+	if (!inc->started) {
+		std_session_send_df_header(in->sdi);
+		if (inc->samplerate)
+			send_samplerate(in);
+		inc->started = TRUE;
+	}
 
-		if (inc->multi_column_mode)
-			ret = parse_multi_columns(columns, inc);
+	ret = SR_OK;
+	for (pos = 0; pos < len; pos = next) {
+		p = memchr(data + pos, inc->line_end, len - pos);
+		if (p)
+			next = p - data + 1;
+		else if (is_eof)
+			next = len;
 		else
-			ret = parse_single_column(columns[0], inc);
-		if (ret != SR_OK) {
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
+			break;
+		ret = process_line(in, data + pos, next - pos - (p ? 1 : 0));
+		if (ret != SR_OK)
+			break;
+	}
+	*consumed = pos;
 
-		/* Send sample data to the session bus. */
-		ret = queue_samples(in);
-		if (ret != SR_OK) {
-			sr_err("Sending samples failed.");
-			g_strfreev(columns);
-			g_strfreev(lines);
-			return SR_ERR;
-		}
+	return ret;
+}
 
-		g_strfreev(columns);
-	}
-	g_strfreev(lines);
-	g_string_erase(in->buf, 0, p - in->buf->str);
+/*
+ * Process all complete lines which are buffered in in->buf, and keep
+ * the rest for the next invocation. Enforce that all previously
+ * buffered data gets processed in the "EOF" condition. Do not insist
+ * in the presence of the termination sequence for the last line (may
+ * often be missing on Windows).
+ */
+static int process_buffer(struct sr_input *in, gboolean is_eof)
+{
+	size_t consumed;
+	int ret;
+
+	ret = process_lines(in, in->buf->str, in->buf->len, is_eof, &consumed);
+	g_string_erase(in->buf, 0, consumed);
 
 	return ret;
 }
@@ -837,12 +1121,13 @@ static int process_buffer(struct sr_input *in, gboolean is_eof)
 static int receive(struct sr_input *in, GString *buf)
 {
 	struct context *inc;
+	const char *data, *p;
+	size_t len, consumed;
 	int ret;
 
-	g_string_append_len(in->buf, buf->str, buf->len);
-
 	inc = in->priv;
 	if (!inc->termination) {
+		g_string_append_len(in->buf, buf->str, buf->len);
 		ret = initial_receive(in);
 		if (ret == SR_ERR_NA)
 			/* Not enough data yet. */
@@ -855,9 +1140,30 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
-	ret = process_buffer(in, FALSE);
+	/*
+	 * Complete a line which was left over by the previous invocation.
+	 * Then process the new data where it is, and only keep its last
+	 * incomplete line.
+	 */
+	data = buf->str;
+	len = buf->len;
+	if (in->buf->len) {
+		p = memchr(data, inc->line_end, len);
+		consumed = p ? (size_t)(p - data + 1) : len;
+		g_string_append_len(in->buf, data, consumed);
+		data += consumed;
+		len -= consumed;
+		ret = process_buffer(in, FALSE);
+		if (ret != SR_OK)
+			return ret;
+	}
 
-	return ret;
+	ret = process_lines(in, data, len, FALSE, &consumed);
+	if (ret != SR_OK)
+		return ret;
+	g_string_append_len(in->buf, data + consumed, len - consumed);
+
+	return SR_OK;
 }
 
 static int end(struct sr_input *in)
@@ -886,17 +1192,30 @@ static int end(struct sr_input *in)
 static void cleanup(struct sr_input *in)
 {
 	struct context *inc;
+	unsigned int i;
 
 	inc = in->priv;
 
 	if (inc->delimiter)
 		g_string_free(inc->delimiter, TRUE);
+	inc->delimiter = NULL;
 
 	if (inc->comment)
 		g_string_free(inc->comment, TRUE);
+	inc->comment = NULL;
 
 	g_free(inc->termination);
+	inc->termination = NULL;
+	g_free(inc->column_formats);
+	inc->column_formats = NULL;
+	g_free(inc->columns);
+	inc->columns = NULL;
 	g_free(inc->datafeed_buffer);
+	inc->datafeed_buffer = NULL;
+	for (i = 0; i < inc->num_analog && inc->analog_buffers; i++)
+		g_free(inc->analog_buffers[i]);
+	g_free(inc->analog_buffers);
+	inc->analog_buffers = NULL;
 }
 
 static int reset(struct sr_input *in)
@@ -920,6 +1239,7 @@ static struct sr_option options[] = {
 	{ "first-channel", "First channel", "The column number of the first channel (multi-col. mode); bit position for the first channel (single-col. mode)", NULL, NULL },
 	{ "header", "Interpret first line as header (multi-col. mode)", "Treat the first line as header with channel names (multi-col. mode)", NULL, NULL },
 	{ "startline", "Start line", "The line number at which to start processing samples (>= 1)", NULL, NULL },
+	{ "column-formats", "Column formats", "The content of the columns (multi-col. mode): comma separated counts and types, l: logic, a: analog, t: timestamp, -: ignore", NULL, NULL },
 	ALL_ZERO
 };
 
@@ -942,6 +1262,7 @@ static const struct sr_option *get_options(void)
 		options[6].def = g_variant_ref_sink(g_variant_new_int32(0));
 		options[7].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
 		options[8].def = g_variant_ref_sink(g_variant_new_int32(1));
+		options[9].def = g_variant_ref_sink(g_variant_new_string(""));
 	}
 
 	return options;
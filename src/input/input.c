@@ -589,6 +589,140 @@ SR_API int sr_input_send(const struct sr_input *in, GString *buf)
 	return in->module->receive((struct sr_input *)in, buf);
 }
 
+static void file_release(struct sr_input *in)
+{
+	sr_buffer_unref(in->file);
+	in->file = NULL;
+	in->file_offset = 0;
+}
+
+static int file_map(struct sr_input *in, const char *filename)
+{
+	GMappedFile *mapped;
+	GError *error;
+	const char *data;
+
+	error = NULL;
+	/* Modules send sample data straight from the mapping. */
+	mapped = sr_file_map_private(filename, &error);
+	if (!mapped) {
+		sr_err("Failed to map %s: %s", filename, error->message);
+		g_error_free(error);
+		return SR_ERR_IO;
+	}
+
+	/* Empty files have no contents, but the buffer needs some pointer. */
+	if (!(data = g_mapped_file_get_contents(mapped)))
+		data = "";
+	in->file = sr_buffer_new_view(data, g_mapped_file_get_length(mapped),
+		mapped, (GDestroyNotify)g_mapped_file_unref);
+	in->file_offset = 0;
+
+	return SR_OK;
+}
+
+static int send_copy(struct sr_input *in, const uint8_t *data, size_t len)
+{
+	GString *buf;
+	int ret;
+
+	buf = g_string_new_len((const char *)data, len);
+	ret = in->module->receive(in, buf);
+	g_string_free(buf, TRUE);
+
+	return ret;
+}
+
+/**
+ * Send the contents of a file to the specified input instance.
+ *
+ * The file is memory mapped. Modules which support it read the file
+ * contents in place and send sample data straight from the mapping,
+ * others receive it in chunks like from sr_input_send().
+ *
+ * Like sr_input_send(), this returns the moment the device instance is
+ * ready, so that the caller can set up the session. Call it again with
+ * the same file until @a done gets set, then call sr_input_end().
+ *
+ * @param in The input instance.
+ * @param filename The file to send.
+ * @param done Set to TRUE once all of the file was sent.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO The file could not be mapped.
+ * @retval other Error code returned by the input module.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_input_send_file(const struct sr_input *in_ro,
+		const char *filename, gboolean *done)
+{
+	struct sr_input *in;
+	const uint8_t *data;
+	size_t remain, len, window, used;
+	gboolean was_ready;
+	int ret;
+
+	in = (struct sr_input *)in_ro;	/* "un-const" */
+	if (!in || !in->module || !done)
+		return SR_ERR_ARG;
+	*done = FALSE;
+
+	if (!in->file) {
+		if (!filename || !filename[0]) {
+			sr_err("Invalid filename.");
+			return SR_ERR_ARG;
+		}
+		if ((ret = file_map(in, filename)) != SR_OK)
+			return ret;
+		sr_spew("Sending %zu bytes of %s to %s module.",
+			in->file->size, filename, in->module->id);
+	}
+
+	window = CHUNK_SIZE;
+	while (in->file_offset < in->file->size) {
+		data = in->file->data + in->file_offset;
+		remain = in->file->size - in->file_offset;
+		len = MIN(window, remain);
+		was_ready = in->sdi_ready;
+
+		if (in->module->receive_window && !in->buf->len) {
+			used = 0;
+			ret = in->module->receive_window(in, in->file,
+				data, len, &used);
+			if (ret == SR_OK && !used && in->sdi_ready == was_ready) {
+				if (len < remain) {
+					/* Not enough to go on, try a larger window. */
+					window *= 2;
+					continue;
+				}
+				/* Leave the remainder to the module's end(). */
+				ret = send_copy(in, data, len);
+				used = len;
+			}
+		} else {
+			ret = send_copy(in, data, len);
+			used = len;
+		}
+
+		if (ret != SR_OK) {
+			file_release(in);
+			return ret;
+		}
+		in->file_offset += used;
+		window = CHUNK_SIZE;
+
+		if (!was_ready && in->sdi_ready && in->file_offset < in->file->size)
+			return SR_OK;
+	}
+
+	file_release(in);
+	*done = TRUE;
+
+	return SR_OK;
+}
+
 /**
  * Signal the input module no more data will come.
  *
@@ -652,6 +786,7 @@ SR_API int sr_input_reset(const struct sr_input *in_ro)
 	 */
 	if (in->buf)
 		g_string_truncate(in->buf, 0);
+	file_release(in);
 	in->sdi_ready = FALSE;
 
 	return rc;
@@ -687,6 +822,7 @@ SR_API void sr_input_free(const struct sr_input *in)
 			" unprocessed bytes at free time.", in->buf->len);
 	}
 	g_string_free(in->buf, TRUE);
+	sr_buffer_unref(in->file);
 	g_free(in->priv);
 	g_free((gpointer)in);
 }
@@ -45,16 +45,17 @@
  * Based on Verilog standard IEEE Std 1364-2001 Version C
  *
  * Supported features:
- * - $var with 'wire' and 'reg' types of scalar variables
+ * - $var with 'wire', 'reg' and similar types of scalar and vector
+ *   variables, every bit of a vector becomes a logic channel
+ * - $var with 'real' type, which becomes an analog channel
  * - $timescale definition for samplerate
  * - multiple character variable identifiers
+ * - identifiers shared by several variables
  *
  * Most important unsupported features:
- * - vector variables (bit vectors etc.)
- * - analog, integer and real number variables
  * - $dumpvars initial value declaration
  * - $scope namespaces
- * - more than 64 channels
+ * - 'x' and 'z' levels, which read as low
  */
 
 #include <config.h>
@@ -69,6 +70,19 @@
 
 #define CHUNK_SIZE (4 * 1024 * 1024)
 
+struct vcd_channel {
+	gchar *name;
+	gchar *identifier;
+	size_t id_len;
+	/* Number of bits, 0 for a real variable. */
+	unsigned int size;
+	/* The first logic channel, or the analog channel number. */
+	unsigned int index;
+	struct sr_channel *analog_ch;
+	/* The next variable with the same identifier, or NULL. */
+	struct vcd_channel *alias;
+};
+
 struct context {
 	gboolean started;
 	gboolean got_header;
@@ -81,15 +95,18 @@ struct context {
 	int64_t skip;
 	gboolean skip_until_end;
 	GSList *channels;
+	/* Open addressing hash table of the variables by identifier. */
+	struct vcd_channel **id_table;
+	size_t id_table_mask;
+	unsigned int num_analog;
 	size_t bytes_per_sample;
+	size_t samples_per_chunk;
 	size_t samples_in_buffer;
 	uint8_t *buffer;
 	uint8_t *current_levels;
-};
-
-struct vcd_channel {
-	gchar *name;
-	gchar *identifier;
+	/* Current value and pending samples of each analog channel. */
+	float *current_values;
+	float **analog_buffers;
 };
 
 /*
@@ -171,6 +188,172 @@ static void remove_empty_parts(gchar **parts)
 	*dest = NULL;
 }
 
+/* FNV-1a hash of a variable identifier. */
+static uint32_t hash_identifier(const char *id, size_t len)
+{
+	uint32_t hash;
+	size_t i;
+
+	hash = 2166136261U;
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t)id[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+ * Build the identifier lookup table. Variables sharing an identifier
+ * are chained through their alias pointer, so that every lookup is a
+ * single probe sequence which doesn't allocate.
+ */
+static void build_id_table(struct context *inc)
+{
+	struct vcd_channel *vcd_ch, **slot;
+	GSList *l;
+	size_t size, i;
+
+	size = 16;
+	while (size < 2 * g_slist_length(inc->channels))
+		size *= 2;
+	inc->id_table = g_malloc0(size * sizeof(*inc->id_table));
+	inc->id_table_mask = size - 1;
+
+	for (l = inc->channels; l; l = l->next) {
+		vcd_ch = l->data;
+		i = hash_identifier(vcd_ch->identifier, vcd_ch->id_len);
+		for (;; i++) {
+			slot = &inc->id_table[i & inc->id_table_mask];
+			if (!*slot) {
+				*slot = vcd_ch;
+				break;
+			}
+			if ((*slot)->id_len == vcd_ch->id_len &&
+					!memcmp((*slot)->identifier, vcd_ch->identifier, vcd_ch->id_len)) {
+				slot = &(*slot)->alias;
+				while (*slot)
+					slot = &(*slot)->alias;
+				*slot = vcd_ch;
+				break;
+			}
+		}
+	}
+}
+
+static struct vcd_channel *lookup_identifier(struct context *inc,
+		const char *id, size_t len)
+{
+	struct vcd_channel *vcd_ch;
+	size_t i;
+
+	i = hash_identifier(id, len);
+	for (;; i++) {
+		vcd_ch = inc->id_table[i & inc->id_table_mask];
+		if (!vcd_ch)
+			return NULL;
+		if (vcd_ch->id_len == len && !memcmp(vcd_ch->identifier, id, len))
+			return vcd_ch;
+	}
+}
+
+static gboolean is_logic_type(const char *type)
+{
+	static const char *const types[] = {
+		"wire", "reg", "integer", "time", "parameter", "logic", "bit",
+		"tri", "tri0", "tri1", "triand", "trior", "trireg",
+		"wand", "wor", "supply0", "supply1",
+	};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(types); i++) {
+		if (!strcmp(type, types[i]))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Add the channels of a $var section.
+ * Format: $var type size identifier reference [opt. index] $end
+ */
+static void parse_var(const struct sr_input *in, gchar **parts)
+{
+	struct context *inc;
+	struct vcd_channel *vcd_ch;
+	unsigned int length, size, k;
+	int msb, lsb;
+	gboolean real;
+	gchar *name;
+
+	inc = in->priv;
+	length = g_strv_length(parts);
+
+	if (length != 4 && length != 5) {
+		sr_warn("$var section should have 4 or 5 items");
+		return;
+	}
+
+	real = !strcmp(parts[0], "real") || !strcmp(parts[0], "realtime");
+	if (!real && !is_logic_type(parts[0])) {
+		sr_info("Unsupported signal type: '%s'", parts[0]);
+		return;
+	}
+
+	size = strtoul(parts[1], NULL, 10);
+	if (!real && size == 0) {
+		sr_info("Unsupported signal size: '%s'", parts[1]);
+		return;
+	}
+
+	if (!real && inc->maxchannels && inc->channelcount + size > inc->maxchannels) {
+		sr_warn("Skipping '%s%s' because only %d channels requested.",
+			parts[3], parts[4] ? : "", inc->maxchannels);
+		return;
+	}
+
+	vcd_ch = g_malloc0(sizeof(struct vcd_channel));
+	vcd_ch->identifier = g_strdup(parts[2]);
+	vcd_ch->id_len = strlen(parts[2]);
+	if (length == 4)
+		vcd_ch->name = g_strdup(parts[3]);
+	else
+		vcd_ch->name = g_strconcat(parts[3], parts[4], NULL);
+	inc->channels = g_slist_append(inc->channels, vcd_ch);
+
+	if (real) {
+		/* Analog channels are created once all logic channels exist. */
+		vcd_ch->index = inc->num_analog++;
+		sr_info("Analog channel '%s' identified by '%s'.",
+			vcd_ch->name, vcd_ch->identifier);
+		return;
+	}
+
+	vcd_ch->size = size;
+	vcd_ch->index = inc->channelcount;
+	if (size == 1) {
+		sr_info("Channel %d is '%s' identified by '%s'.",
+			inc->channelcount, vcd_ch->name, vcd_ch->identifier);
+		sr_channel_new(in->sdi, inc->channelcount++, SR_CHANNEL_LOGIC, TRUE, vcd_ch->name);
+		return;
+	}
+
+	/* One channel per bit, LSB first, numbered after the declared range. */
+	if (length != 5 || sscanf(parts[4], "[%d:%d]", &msb, &lsb) != 2) {
+		msb = size - 1;
+		lsb = 0;
+	}
+	sr_info("Channels %d-%d are '%s' identified by '%s'.", inc->channelcount,
+		inc->channelcount + size - 1, vcd_ch->name, vcd_ch->identifier);
+	for (k = 0; k < size; k++) {
+		name = g_strdup_printf("%s[%d]", parts[3],
+			msb >= lsb ? lsb + (int)k : lsb - (int)k);
+		sr_channel_new(in->sdi, inc->channelcount++, SR_CHANNEL_LOGIC, TRUE, name);
+		g_free(name);
+	}
+}
+
 /*
  * Parse VCD header to get values for context structure.
  * The context structure should be zeroed before calling this.
@@ -182,6 +365,8 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	struct context *inc;
 	gboolean status;
 	gchar *name, *contents, **parts;
+	GSList *l;
+	unsigned int i;
 
 	inc = in->priv;
 	name = contents = NULL;
@@ -210,37 +395,9 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 				sr_err("Parsing timescale failed.");
 			}
 		} else if (g_strcmp0(name, "var") == 0) {
-			/* Format: $var type size identifier reference [opt. index] $end */
-			unsigned int length;
-
 			parts = g_strsplit_set(contents, " \r\n\t", 0);
 			remove_empty_parts(parts);
-			length = g_strv_length(parts);
-
-			if (length != 4 && length != 5)
-				sr_warn("$var section should have 4 or 5 items");
-			else if (g_strcmp0(parts[0], "reg") != 0 && g_strcmp0(parts[0], "wire") != 0)
-				sr_info("Unsupported signal type: '%s'", parts[0]);
-			else if (strtol(parts[1], NULL, 10) != 1)
-				sr_info("Unsupported signal size: '%s'", parts[1]);
-			else if (inc->maxchannels && inc->channelcount >= inc->maxchannels)
-				sr_warn("Skipping '%s%s' because only %d channels requested.",
-					parts[3], parts[4] ? : "", inc->maxchannels);
-			else {
-				vcd_ch = g_malloc(sizeof(struct vcd_channel));
-				vcd_ch->identifier = g_strdup(parts[2]);
-				if (length == 4)
-					vcd_ch->name = g_strdup(parts[3]);
-				else
-					vcd_ch->name = g_strconcat(parts[3], parts[4], NULL);
-
-				sr_info("Channel %d is '%s' identified by '%s'.",
-						inc->channelcount, vcd_ch->name, vcd_ch->identifier);
-
-				sr_channel_new(in->sdi, inc->channelcount++, SR_CHANNEL_LOGIC, TRUE, vcd_ch->name);
-				inc->channels = g_slist_append(inc->channels, vcd_ch);
-			}
-
+			parse_var(in, parts);
 			g_strfreev(parts);
 		}
 
@@ -252,6 +409,23 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	g_free(name);
 	g_free(contents);
 
+	if (status && !inc->channels) {
+		sr_err("No supported variables found.");
+		status = FALSE;
+	}
+	if (!status)
+		return FALSE;
+
+	for (l = inc->channels; l; l = l->next) {
+		vcd_ch = l->data;
+		if (vcd_ch->size)
+			continue;
+		vcd_ch->analog_ch = sr_channel_new(in->sdi,
+			inc->channelcount + vcd_ch->index, SR_CHANNEL_ANALOG,
+			TRUE, vcd_ch->name);
+	}
+	build_id_table(inc);
+
 	/*
 	 * Compute how many bytes each sample will have and initialize the
 	 * current levels. The current levels will be updated whenever VCD
@@ -259,10 +433,17 @@ static gboolean parse_header(const struct sr_input *in, GString *buf)
 	 */
 	inc->bytes_per_sample = (inc->channelcount + 7) / 8;
 	inc->current_levels = g_malloc0(inc->bytes_per_sample);
+	inc->samples_per_chunk = CHUNK_SIZE /
+		(inc->bytes_per_sample + inc->num_analog * sizeof(float));
+	inc->buffer = g_malloc(inc->samples_per_chunk * inc->bytes_per_sample);
+	inc->current_values = g_malloc0(inc->num_analog * sizeof(float));
+	inc->analog_buffers = g_malloc0(inc->num_analog * sizeof(float *));
+	for (i = 0; i < inc->num_analog; i++)
+		inc->analog_buffers[i] = g_malloc(inc->samples_per_chunk * sizeof(float));
 
-	inc->got_header = status;
+	inc->got_header = TRUE;
 
-	return status;
+	return TRUE;
 }
 
 static int format_match(GHashTable *metadata, unsigned int *confidence)
@@ -290,27 +471,71 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	return SR_OK;
 }
 
-/* Send all accumulated bytes from inc->buffer. */
+/* Send all accumulated samples from the logic and analog buffers. */
 static void send_buffer(const struct sr_input *in)
 {
 	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct vcd_channel *vcd_ch;
+	GSList *l, channels;
 
 	inc = in->priv;
 
 	if (inc->samples_in_buffer == 0)
 		return;
 
-	packet.type = SR_DF_LOGIC;
-	packet.payload = &logic;
-	logic.unitsize = inc->bytes_per_sample;
-	logic.data = inc->buffer;
-	logic.length = inc->bytes_per_sample * inc->samples_in_buffer;
-	sr_session_send(in->sdi, &packet);
+	if (inc->bytes_per_sample) {
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.unitsize = inc->bytes_per_sample;
+		logic.data = inc->buffer;
+		logic.length = inc->bytes_per_sample * inc->samples_in_buffer;
+		sr_session_send(in->sdi, &packet);
+	}
+
+	for (l = inc->channels; l; l = l->next) {
+		vcd_ch = l->data;
+		if (vcd_ch->size)
+			continue;
+		/* VCD carries no precision information for real values. */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 6);
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		analog.num_samples = inc->samples_in_buffer;
+		analog.data = inc->analog_buffers[vcd_ch->index];
+		channels.data = vcd_ch->analog_ch;
+		channels.next = NULL;
+		analog.meaning->channels = &channels;
+		sr_session_send(in->sdi, &packet);
+	}
+
 	inc->samples_in_buffer = 0;
 }
 
+/* Fill count samples of unitsize bytes at p with copies of sample. */
+static void fill_samples(uint8_t *p, const uint8_t *sample,
+		size_t unitsize, size_t count)
+{
+	size_t filled, n;
+
+	if (unitsize == 1) {
+		memset(p, sample[0], count);
+		return;
+	}
+
+	/* Double the filled area with every copy. */
+	memcpy(p, sample, unitsize);
+	for (filled = 1; filled < count; filled += n) {
+		n = MIN(filled, count - filled);
+		memcpy(p + filled * unitsize, p, n * unitsize);
+	}
+}
+
 /*
  * Add N copies of the current sample to buffer.
  * When the buffer fills up, automatically send it.
@@ -318,174 +543,257 @@ static void send_buffer(const struct sr_input *in)
 static void add_samples(const struct sr_input *in, size_t count)
 {
 	struct context *inc;
-	size_t samples_per_chunk;
-	size_t space_left, i;
-	uint8_t *p;
+	size_t space_left, i, j;
+	float value, *f;
 
 	inc = in->priv;
-	samples_per_chunk = CHUNK_SIZE / inc->bytes_per_sample;
 
 	while (count) {
-		space_left = samples_per_chunk - inc->samples_in_buffer;
+		space_left = inc->samples_per_chunk - inc->samples_in_buffer;
 
 		if (space_left > count)
 			space_left = count;
 
-		p = inc->buffer + inc->samples_in_buffer * inc->bytes_per_sample;
-		for (i = 0; i < space_left; i++) {
-			memcpy(p, inc->current_levels, inc->bytes_per_sample);
-			p += inc->bytes_per_sample;
-			inc->samples_in_buffer++;
-			count--;
+		if (inc->bytes_per_sample)
+			fill_samples(inc->buffer + inc->samples_in_buffer * inc->bytes_per_sample,
+				inc->current_levels, inc->bytes_per_sample, space_left);
+		for (i = 0; i < inc->num_analog; i++) {
+			f = inc->analog_buffers[i] + inc->samples_in_buffer;
+			value = inc->current_values[i];
+			for (j = 0; j < space_left; j++)
+				f[j] = value;
 		}
+		inc->samples_in_buffer += space_left;
+		count -= space_left;
 
-		if (inc->samples_in_buffer == samples_per_chunk)
+		if (inc->samples_in_buffer == inc->samples_per_chunk)
 			send_buffer(in);
 	}
 }
 
-/* Set the channel level depending on the identifier and parsed value. */
-static void process_bit(struct context *inc, char *identifier, unsigned int bit)
+/*
+ * Set the channel levels of all variables using the identifier from a
+ * binary value, given MSB first. Shorter values are zero-extended.
+ */
+static void process_vector(struct context *inc, const char *identifier,
+		size_t id_len, const char *value, size_t len)
 {
-	GSList *l;
 	struct vcd_channel *vcd_ch;
-	unsigned int j;
-
-	for (j = 0, l = inc->channels; j < inc->channelcount && l; j++, l = l->next) {
-		vcd_ch = l->data;
-		if (g_strcmp0(identifier, vcd_ch->identifier) == 0) {
-			/* Found our channel. */
-			size_t byte_idx = (j / 8);
-			size_t bit_idx = j - 8 * byte_idx;
-			if (bit)
-				inc->current_levels[byte_idx] |= (uint8_t)1 << bit_idx;
+	unsigned int k, idx;
+	uint8_t mask;
+
+	vcd_ch = lookup_identifier(inc, identifier, id_len);
+	if (!vcd_ch)
+		sr_dbg("Did not find channel for identifier '%.*s'.",
+			(int)id_len, identifier);
+
+	for (; vcd_ch; vcd_ch = vcd_ch->alias) {
+		if (!vcd_ch->size) {
+			sr_dbg("Ignoring binary value of real variable '%s'.", vcd_ch->name);
+			continue;
+		}
+		for (k = 0; k < vcd_ch->size; k++) {
+			idx = vcd_ch->index + k;
+			mask = (uint8_t)1 << (idx % 8);
+			if (k < len && value[len - 1 - k] == '1')
+				inc->current_levels[idx / 8] |= mask;
 			else
-				inc->current_levels[byte_idx] &= ~((uint8_t)1 << bit_idx);
-			break;
+				inc->current_levels[idx / 8] &= ~mask;
 		}
 	}
-	if (j == inc->channelcount)
-		sr_dbg("Did not find channel for identifier '%s'.", identifier);
 }
 
-/* Parse a set of lines from the data section. */
-static void parse_contents(const struct sr_input *in, char *data)
+/* Set the value of all real variables using the identifier. */
+static void process_real(struct context *inc, const char *identifier,
+		size_t id_len, double value)
+{
+	struct vcd_channel *vcd_ch;
+
+	vcd_ch = lookup_identifier(inc, identifier, id_len);
+	if (!vcd_ch)
+		sr_dbg("Did not find channel for identifier '%.*s'.",
+			(int)id_len, identifier);
+
+	for (; vcd_ch; vcd_ch = vcd_ch->alias) {
+		if (vcd_ch->size)
+			sr_dbg("Ignoring real value of variable '%s'.", vcd_ch->name);
+		else
+			inc->current_values[vcd_ch->index] = value;
+	}
+}
+
+static void process_timestamp(const struct sr_input *in, uint64_t timestamp)
 {
 	struct context *inc;
+
+	inc = in->priv;
+
+	if (inc->downsample > 1)
+		timestamp /= inc->downsample;
+
+	/*
+	 * Skip < 0 => skip until first timestamp.
+	 * Skip = 0 => don't skip
+	 * Skip > 0 => skip until timestamp >= skip.
+	 */
+	if (inc->skip < 0) {
+		inc->skip = timestamp;
+		inc->prev_timestamp = timestamp;
+	} else if (inc->skip > 0 && timestamp < (uint64_t)inc->skip) {
+		inc->prev_timestamp = inc->skip;
+	} else if (timestamp == inc->prev_timestamp) {
+		/* Ignore repeated timestamps (e.g. sigrok outputs these) */
+	} else if (timestamp < inc->prev_timestamp) {
+		sr_err("Invalid timestamp: %" PRIu64 " (smaller than previous timestamp).", timestamp);
+		inc->skip_until_end = TRUE;
+	} else {
+		if (inc->compress != 0 && timestamp - inc->prev_timestamp > inc->compress) {
+			/* Compress long idle periods */
+			inc->prev_timestamp = timestamp - inc->compress;
+		}
+
+		sr_dbg("New timestamp: %" PRIu64, timestamp);
+
+		/* Generate samples from prev_timestamp up to timestamp - 1. */
+		add_samples(in, timestamp - inc->prev_timestamp);
+		inc->prev_timestamp = timestamp;
+	}
+}
+
+/*
+ * Find the next whitespace-delimited token in [*pos, end) and advance
+ * *pos past it. The token is not terminated, its length is returned in
+ * *len. Returns NULL when there are no more tokens.
+ */
+static const char *next_token(const char **pos, const char *end, size_t *len)
+{
+	const char *p, *token;
+
+	p = *pos;
+	while (p < end && g_ascii_isspace(*p))
+		p++;
+	if (p == end)
+		return NULL;
+
+	token = p;
+	while (p < end && !g_ascii_isspace(*p))
+		p++;
+	*pos = p;
+	*len = p - token;
+
+	return token;
+}
+
+static gboolean token_equal(const char *token, size_t len, const char *str)
+{
+	return len == strlen(str) && !memcmp(token, str, len);
+}
+
+/*
+ * Parse a set of lines from the data section, len bytes at data. The
+ * tokens are used in place and nothing is allocated per value change.
+ */
+static void parse_contents(const struct sr_input *in, const char *data, size_t len)
+{
+	struct context *inc;
+	const char *pos, *end, *token, *id, *num_end;
+	size_t token_len, id_len, i;
 	uint64_t timestamp;
-	unsigned int bit, i;
-	char **tokens;
+	double value;
 
 	inc = in->priv;
+	pos = data;
+	end = data + len;
 
-	/* Read one space-delimited token at a time. */
-	tokens = g_strsplit_set(data, " \t\r\n", 0);
-	remove_empty_parts(tokens);
-	for (i = 0; tokens[i]; i++) {
+	while ((token = next_token(&pos, end, &token_len))) {
 		if (inc->skip_until_end) {
-			if (!strcmp(tokens[i], "$end")) {
-				/* Done with unhandled/unknown section. */
+			/* Done with unhandled/unknown section? */
+			if (token_equal(token, token_len, "$end"))
 				inc->skip_until_end = FALSE;
-				break;
-			}
+			continue;
 		}
-		if (tokens[i][0] == '#' && g_ascii_isdigit(tokens[i][1])) {
-			/* Numeric value beginning with # is a new timestamp value */
-			timestamp = strtoull(tokens[i] + 1, NULL, 10);
 
-			if (inc->downsample > 1)
-				timestamp /= inc->downsample;
-
-			/*
-			 * Skip < 0 => skip until first timestamp.
-			 * Skip = 0 => don't skip
-			 * Skip > 0 => skip until timestamp >= skip.
-			 */
-			if (inc->skip < 0) {
-				inc->skip = timestamp;
-				inc->prev_timestamp = timestamp;
-			} else if (inc->skip > 0 && timestamp < (uint64_t)inc->skip) {
-				inc->prev_timestamp = inc->skip;
-			} else if (timestamp == inc->prev_timestamp) {
-				/* Ignore repeated timestamps (e.g. sigrok outputs these) */
-			} else if (timestamp < inc->prev_timestamp) {
-				sr_err("Invalid timestamp: %" PRIu64 " (smaller than previous timestamp).", timestamp);
-				inc->skip_until_end = TRUE;
+		switch (token[0]) {
+		case '#':
+			/* Numeric value beginning with # is a new timestamp value */
+			timestamp = 0;
+			for (i = 1; i < token_len && g_ascii_isdigit(token[i]); i++)
+				timestamp = timestamp * 10 + (token[i] - '0');
+			if (i == 1 || i != token_len) {
+				sr_warn("Skipping invalid timestamp '%.*s'.",
+					(int)token_len, token);
 				break;
-			} else {
-				if (inc->compress != 0 && timestamp - inc->prev_timestamp > inc->compress) {
-					/* Compress long idle periods */
-					inc->prev_timestamp = timestamp - inc->compress;
-				}
-
-				sr_dbg("New timestamp: %" PRIu64, timestamp);
-
-				/* Generate samples from prev_timestamp up to timestamp - 1. */
-				add_samples(in, timestamp - inc->prev_timestamp);
-				inc->prev_timestamp = timestamp;
 			}
-		} else if (tokens[i][0] == '$' && tokens[i][1] != '\0') {
+			process_timestamp(in, timestamp);
+			break;
+		case '$':
 			/*
 			 * This is probably a $dumpvars, $comment or similar.
 			 * $dump* contain useful data.
 			 */
-			if (g_strcmp0(tokens[i], "$dumpvars") == 0
-					|| g_strcmp0(tokens[i], "$dumpon") == 0
-					|| g_strcmp0(tokens[i], "$dumpoff") == 0
-					|| g_strcmp0(tokens[i], "$end") == 0) {
+			if (token_equal(token, token_len, "$dumpvars")
+					|| token_equal(token, token_len, "$dumpall")
+					|| token_equal(token, token_len, "$dumpon")
+					|| token_equal(token, token_len, "$dumpoff")
+					|| token_equal(token, token_len, "$end")) {
 				/* Ignore, parse contents as normally. */
 			} else {
-				/* Ignore this and future lines until $end. */
+				/* Ignore this and future tokens until $end. */
 				inc->skip_until_end = TRUE;
+			}
+			break;
+		case 'r':
+		case 'R':
+			if (!(id = next_token(&pos, end, &id_len))) {
+				sr_dbg("Identifier missing!");
 				break;
 			}
-		} else if (strchr("rR", tokens[i][0]) != NULL) {
-			sr_dbg("Real type vector values not supported yet!");
-			if (!tokens[++i])
-				/* No tokens left, bail out */
+			/* The value is followed by whitespace, which ends it. */
+			value = g_ascii_strtod(token + 1, (char **)&num_end);
+			if (token_len == 1 || num_end != token + token_len) {
+				sr_warn("Skipping invalid real value '%.*s'.",
+					(int)token_len, token);
 				break;
-			else
-				/* Process next token */
-				continue;
-		} else if (strchr("bB", tokens[i][0]) != NULL) {
-			bit = (tokens[i][1] == '1');
-
-			/*
-			 * Bail out if a) char after 'b' is NUL, or b) there is
-			 * a second character after 'b', or c) there is no
-			 * identifier.
-			 */
-			if (!tokens[i][1] || tokens[i][2] || !tokens[++i]) {
+			}
+			process_real(inc, id, id_len, value);
+			break;
+		case 'b':
+		case 'B':
+			if (!(id = next_token(&pos, end, &id_len))) {
+				sr_dbg("Identifier missing!");
+				break;
+			}
+			if (token_len == 1) {
 				sr_dbg("Unexpected vector format!");
 				break;
 			}
-
-			process_bit(inc, tokens[i], bit);
-		} else if (strchr("01xXzZ", tokens[i][0]) != NULL) {
-			char *identifier;
-
-			/* A new 1-bit sample value */
-			bit = (tokens[i][0] == '1');
-
+			process_vector(inc, id, id_len, token + 1, token_len - 1);
+			break;
+		case '0':
+		case '1':
+		case 'x':
+		case 'X':
+		case 'z':
+		case 'Z':
 			/*
-			 * The identifier is either the next character, or, if
-			 * there was whitespace after the bit, the next token.
+			 * A new 1-bit sample value. The identifier is either
+			 * the rest of the token, or, if there was whitespace
+			 * after the bit, the next token.
 			 */
-			if (tokens[i][1] == '\0') {
-				if (!tokens[++i]) {
-					sr_dbg("Identifier missing!");
-					break;
-				}
-				identifier = tokens[i];
-			} else {
-				identifier = tokens[i] + 1;
+			if (token_len > 1) {
+				id = token + 1;
+				id_len = token_len - 1;
+			} else if (!(id = next_token(&pos, end, &id_len))) {
+				sr_dbg("Identifier missing!");
+				break;
 			}
-			process_bit(inc, identifier, bit);
-		} else {
-			sr_warn("Skipping unknown token '%s'.", tokens[i]);
+			process_vector(inc, id, id_len, token, 1);
+			break;
+		default:
+			sr_warn("Skipping unknown token '%.*s'.", (int)token_len, token);
+			break;
 		}
 	}
-	g_strfreev(tokens);
 }
 
 static int init(struct sr_input *in, GHashTable *options)
@@ -506,8 +814,6 @@ static int init(struct sr_input *in, GHashTable *options)
 	in->sdi = g_malloc0(sizeof(struct sr_dev_inst));
 	in->priv = inc;
 
-	inc->buffer = g_malloc(CHUNK_SIZE);
-
 	return SR_OK;
 }
 
@@ -552,11 +858,10 @@ static int process_buffer(struct sr_input *in)
 		inc->started = TRUE;
 	}
 
-	while ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
+	/* Parse all complete lines, keep the rest for the next call. */
+	if ((p = g_strrstr_len(in->buf->str, in->buf->len, "\n"))) {
 		*p = '\0';
-		g_strstrip(in->buf->str);
-		if (in->buf->str[0] != '\0')
-			parse_contents(in, in->buf->str);
+		parse_contents(in, in->buf->str, p - in->buf->str);
 		g_string_erase(in->buf, 0, p - in->buf->str + 1);
 	}
 
@@ -612,13 +917,23 @@ static int end(struct sr_input *in)
 static void cleanup(struct sr_input *in)
 {
 	struct context *inc;
+	unsigned int i;
 
 	inc = in->priv;
 	g_slist_free_full(inc->channels, free_channel);
+	inc->channels = NULL;
+	g_free(inc->id_table);
+	inc->id_table = NULL;
 	g_free(inc->buffer);
 	inc->buffer = NULL;
 	g_free(inc->current_levels);
 	inc->current_levels = NULL;
+	g_free(inc->current_values);
+	inc->current_values = NULL;
+	for (i = 0; i < inc->num_analog && inc->analog_buffers; i++)
+		g_free(inc->analog_buffers[i]);
+	g_free(inc->analog_buffers);
+	inc->analog_buffers = NULL;
 }
 
 static int reset(struct sr_input *in)
@@ -54,19 +54,19 @@ struct context {
 	gboolean create_channels;
 };
 
-static int parse_wav_header(GString *buf, struct context *inc)
+static int parse_wav_header(const char *buf, size_t len, struct context *inc)
 {
 	uint64_t samplerate;
 	unsigned int fmt_code, samplesize, num_channels, unitsize;
 
-	if (buf->len < MIN_DATA_CHUNK_OFFSET)
+	if (len < MIN_DATA_CHUNK_OFFSET)
 		return SR_ERR_NA;
 
-	fmt_code = RL16(buf->str + 20);
-	samplerate = RL32(buf->str + 24);
+	fmt_code = RL16(buf + 20);
+	samplerate = RL32(buf + 24);
 
-	samplesize = RL16(buf->str + 32);
-	num_channels = RL16(buf->str + 22);
+	samplesize = RL16(buf + 32);
+	num_channels = RL16(buf + 22);
 	if (num_channels == 0)
 		return SR_ERR;
 	unitsize = samplesize / num_channels;
@@ -82,24 +82,24 @@ static int parse_wav_header(GString *buf, struct context *inc)
 			return SR_ERR_DATA;
 		}
 	} else if (fmt_code == WAVE_FORMAT_EXTENSIBLE_) {
-		if (buf->len < 70)
+		if (len < 70)
 			/* Not enough for extensible header and next chunk. */
 			return SR_ERR_NA;
 
-		if (RL16(buf->str + 16) != 40) {
+		if (RL16(buf + 16) != 40) {
 			sr_err("WAV extensible format chunk must be 40 bytes.");
 			return SR_ERR;
 		}
-		if (RL16(buf->str + 36) != 22) {
+		if (RL16(buf + 36) != 22) {
 			sr_err("WAV extension must be 22 bytes.");
 			return SR_ERR;
 		}
-		if (RL16(buf->str + 34) != RL16(buf->str + 38)) {
+		if (RL16(buf + 34) != RL16(buf + 38)) {
 			sr_err("Reduced valid bits per sample not supported.");
 			return SR_ERR_DATA;
 		}
 		/* Real format code is the first two bytes of the GUID. */
-		fmt_code = RL16(buf->str + 44);
+		fmt_code = RL16(buf + 44);
 		if (fmt_code != WAVE_FORMAT_PCM_ && fmt_code != WAVE_FORMAT_IEEE_FLOAT_) {
 			sr_err("Only PCM and floating point samples are supported.");
 			return SR_ERR_DATA;
@@ -141,7 +141,7 @@ static int format_match(GHashTable *metadata, unsigned int *confidence)
 	 * Only gets called when we already know this is a WAV file, so
 	 * this parser can log error messages.
 	 */
-	if ((ret = parse_wav_header(buf, NULL)) != SR_OK)
+	if ((ret = parse_wav_header(buf->str, buf->len, NULL)) != SR_OK)
 		return ret;
 
 	*confidence = 1;
@@ -164,23 +164,23 @@ static int init(struct sr_input *in, GHashTable *options)
 	return SR_OK;
 }
 
-static int find_data_chunk(GString *buf, int initial_offset)
+static int find_data_chunk(const char *buf, size_t len, int initial_offset)
 {
 	unsigned int offset, i;
 
 	offset = initial_offset;
-	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, buf->len)) {
-		if (!memcmp(buf->str + offset, "data", 4))
+	while (offset < MIN(MAX_DATA_CHUNK_OFFSET, len)) {
+		if (!memcmp(buf + offset, "data", 4))
 			/* Skip into the samples. */
 			return offset + 8;
 		for (i = 0; i < 4; i++) {
-			if (!isalnum(buf->str[offset + i])
-					&& !isblank(buf->str[offset + i]))
+			if (!isalnum(buf[offset + i])
+					&& !isblank(buf[offset + i]))
 				/* Doesn't look like a chunk ID. */
 				return -1;
 		}
 		/* Skip past this chunk. */
-		offset += 8 + RL32(buf->str + offset + 4);
+		offset += 8 + RL32(buf + offset + 4);
 	}
 
 	if (offset > MAX_DATA_CHUNK_OFFSET)
@@ -189,23 +189,12 @@ static int find_data_chunk(GString *buf, int initial_offset)
 	return offset;
 }
 
-static void send_chunk(const struct sr_input *in, int offset, int num_samples)
+static void convert_samples(const struct context *inc, const char *s,
+		float *fdata, int total_samples)
 {
-	struct sr_datafeed_packet packet;
-	struct sr_datafeed_analog analog;
-	struct sr_analog_encoding encoding;
-	struct sr_analog_meaning meaning;
-	struct sr_analog_spec spec;
-	struct context *inc;
-	float *fdata;
-	int total_samples, samplenum;
-	char *s, *d;
-
-	inc = in->priv;
+	int samplenum;
+	char *d;
 
-	total_samples = num_samples * inc->num_channels;
-	fdata = g_malloc0(total_samples * sizeof(float));
-	s = in->buf->str + offset;
 	d = (char *)fdata;
 
 	for (samplenum = 0; samplenum < total_samples; samplenum++) {
@@ -235,29 +224,63 @@ static void send_chunk(const struct sr_input *in, int offset, int num_samples)
 		s += inc->unitsize;
 		d += inc->unitsize;
 	}
+}
+
+static void send_chunk(const struct sr_input *in, struct sr_buffer *file,
+		const char *s, int num_samples)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct context *inc;
+	float *fdata;
+	int total_samples;
+	gboolean in_place;
+
+	inc = in->priv;
+
+	/* Aligned native floats need no conversion, send them in place. */
+	in_place = inc->fmt_code == WAVE_FORMAT_IEEE_FLOAT_
+		&& (uintptr_t)s % sizeof(float) == 0;
+#ifdef WORDS_BIGENDIAN
+	in_place = FALSE;
+#endif
+
+	fdata = NULL;
+	if (!in_place) {
+		total_samples = num_samples * inc->num_channels;
+		fdata = g_malloc0(total_samples * sizeof(float));
+		convert_samples(inc, s, fdata, total_samples);
+	}
 
 	/* TODO: Use proper 'digits' value for this device (and its modes). */
 	sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
 	packet.type = SR_DF_ANALOG;
 	packet.payload = &analog;
 	analog.num_samples = num_samples;
-	analog.data = fdata;
+	analog.data = in_place ? (void *)s : fdata;
 	analog.meaning->channels = in->sdi->channels;
 	analog.meaning->mq = 0;
 	analog.meaning->mqflags = 0;
 	analog.meaning->unit = 0;
-	sr_session_send(in->sdi, &packet);
+	sr_session_send_buffer(in->sdi, &packet, in_place ? file : NULL);
 	g_free(fdata);
 }
 
-static int process_buffer(struct sr_input *in)
+static int process_data(struct sr_input *in, struct sr_buffer *file,
+		const char *data, size_t len, size_t *used)
 {
 	struct context *inc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_meta meta;
 	struct sr_config *src;
-	int offset, chunk_samples, total_samples, processed, max_chunk_samples;
-	int num_samples, i;
+	int chunk_samples, total_samples, processed, max_chunk_samples;
+	int num_samples, i, data_offset;
+	size_t offset;
+
+	*used = 0;
 
 	inc = in->priv;
 	if (!inc->started) {
@@ -276,20 +299,23 @@ static int process_buffer(struct sr_input *in)
 
 	if (!inc->found_data) {
 		/* Skip past size of 'fmt ' chunk. */
-		i = 20 + RL32(in->buf->str + 16);
-		offset = find_data_chunk(in->buf, i);
-		if (offset < 0) {
-			if (in->buf->len > MAX_DATA_CHUNK_OFFSET) {
+		i = 20 + RL32(data + 16);
+		data_offset = find_data_chunk(data, len, i);
+		if (data_offset < 0 || (size_t)data_offset > len) {
+			if (len > MAX_DATA_CHUNK_OFFSET) {
 				sr_err("Couldn't find data chunk.");
 				return SR_ERR;
 			}
+			/* Not enough data yet. */
+			return SR_OK;
 		}
 		inc->found_data = TRUE;
+		offset = data_offset;
 	} else
 		offset = 0;
 
 	/* Round off up to the last channels * unitsize boundary. */
-	chunk_samples = (in->buf->len - offset) / inc->samplesize;
+	chunk_samples = (len - offset) / inc->samplesize;
 	max_chunk_samples = CHUNK_SIZE / inc->samplesize;
 	processed = 0;
 	total_samples = chunk_samples;
@@ -298,30 +324,62 @@ static int process_buffer(struct sr_input *in)
 			num_samples = max_chunk_samples;
 		else
 			num_samples = chunk_samples;
-		send_chunk(in, offset, num_samples);
+		send_chunk(in, file, data + offset, num_samples);
 		offset += num_samples * inc->samplesize;
 		chunk_samples -= num_samples;
 		processed += num_samples;
 	}
-
-	if ((unsigned int)offset < in->buf->len) {
-		/*
-		 * The incoming buffer wasn't processed completely. Stash
-		 * the leftover data for next time.
-		 */
-		g_string_erase(in->buf, 0, offset);
-	} else
-		g_string_truncate(in->buf, 0);
+	*used = offset;
 
 	return SR_OK;
 }
 
-static int receive(struct sr_input *in, GString *buf)
+static int process_buffer(struct sr_input *in)
+{
+	size_t used;
+	int ret;
+
+	ret = process_data(in, NULL, in->buf->str, in->buf->len, &used);
+
+	/*
+	 * The incoming buffer may not have been processed completely.
+	 * Stash the leftover data for next time.
+	 */
+	g_string_erase(in->buf, 0, used);
+
+	return ret;
+}
+
+static int check_header(struct sr_input *in, const char *data, size_t len)
 {
 	struct context *inc;
 	int ret;
 	char channelname[16];
 
+	inc = in->priv;
+	if ((ret = parse_wav_header(data, len, inc)) == SR_ERR_NA)
+		/* Not enough data yet. */
+		return SR_OK;
+	else if (ret != SR_OK)
+		return ret;
+
+	if (inc->create_channels) {
+		for (int i = 0; i < inc->num_channels; i++) {
+			snprintf(channelname, sizeof(channelname), "CH%d", i + 1);
+			sr_channel_new(in->sdi, i, SR_CHANNEL_ANALOG, TRUE, channelname);
+		}
+	}
+
+	inc->create_channels = FALSE;
+
+	/* sdi is ready, notify frontend. */
+	in->sdi_ready = TRUE;
+
+	return SR_OK;
+}
+
+static int receive(struct sr_input *in, GString *buf)
+{
 	g_string_append_len(in->buf, buf->str, buf->len);
 
 	if (in->buf->len < MIN_DATA_CHUNK_OFFSET) {
@@ -332,31 +390,22 @@ static int receive(struct sr_input *in, GString *buf)
 		return SR_OK;
 	}
 
-	inc = in->priv;
-	if (!in->sdi_ready) {
-		if ((ret = parse_wav_header(in->buf, inc)) == SR_ERR_NA)
-			/* Not enough data yet. */
-			return SR_OK;
-		else if (ret != SR_OK)
-			return ret;
+	if (!in->sdi_ready)
+		return check_header(in, in->buf->str, in->buf->len);
 
-		if (inc->create_channels) {
-			for (int i = 0; i < inc->num_channels; i++) {
-				snprintf(channelname, sizeof(channelname), "CH%d", i + 1);
-				sr_channel_new(in->sdi, i, SR_CHANNEL_ANALOG, TRUE, channelname);
-			}
-		}
-
-		inc->create_channels = FALSE;
+	return process_buffer(in);
+}
 
-		/* sdi is ready, notify frontend. */
-		in->sdi_ready = TRUE;
-		return SR_OK;
-	}
+static int receive_window(struct sr_input *in, struct sr_buffer *file,
+		const uint8_t *data, size_t len, size_t *used)
+{
+	*used = 0;
 
-	ret = process_buffer(in);
+	/* The header gets offered again, process_data() skips it. */
+	if (!in->sdi_ready)
+		return check_header(in, (const char *)data, len);
 
-	return ret;
+	return process_data(in, file, (const char *)data, len, used);
 }
 
 static int end(struct sr_input *in)
@@ -399,6 +448,7 @@ SR_PRIV struct sr_input_module input_wav = {
 	.format_match = format_match,
 	.init = init,
 	.receive = receive,
+	.receive_window = receive_window,
 	.end = end,
 	.reset = reset,
 };
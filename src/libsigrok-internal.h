@@ -336,6 +336,9 @@ struct zip_stat;
 
 SR_API void sr_drivers_init(struct sr_context *context);
 
+/** Default number of concurrent probes in sr_drivers_scan(), one at a time. */
+#define SR_SCAN_THREADS_DEFAULT 1
+
 struct sr_context {
 	struct sr_dev_driver **driver_list;
 #ifdef HAVE_LIBUSB_1_0
@@ -345,6 +348,20 @@ struct sr_context {
 	sr_resource_close_callback resource_close_cb;
 	sr_resource_read_callback resource_read_cb;
 	void *resource_cb_data;
+	/** Serializes probes of a resource, and protects the scan cache. */
+	GMutex scan_mutex;
+	/** Signalled when a resource probe ends. */
+	GCond scan_cond;
+	/** Resources which are being probed. */
+	GHashTable *scan_busy;
+	/** Expiry times of probes which found no device, by prober/resource. */
+	GHashTable *scan_misses;
+	/** Number of concurrent probes in sr_drivers_scan(). */
+	unsigned int scan_threads;
+	/** Per-resource probe timeout, or 0 for the transport's default. */
+	unsigned int scan_timeout_ms;
+	/** How long resources without devices are skipped, or 0. */
+	unsigned int scan_cache_ms;
 };
 
 /** Input module metadata keys. */
@@ -370,6 +387,10 @@ struct sr_input {
 	struct sr_dev_inst *sdi;
 	gboolean sdi_ready;
 	void *priv;
+	/** The file being sent by sr_input_send_file(), or NULL. */
+	struct sr_buffer *file;
+	/** Offset of the first byte not yet consumed from @a file. */
+	size_t file_offset;
 };
 
 /** Input (file) module driver. */
@@ -471,6 +492,34 @@ struct sr_input_module {
 	 */
 	int (*receive) (struct sr_input *in, GString *buf);
 
+	/**
+	 * Send a window of a memory mapped file to the input instance.
+	 *
+	 * Called by sr_input_send_file() instead of receive(), with the same
+	 * semantics, but the module reads the data in place and must not
+	 * keep any of it in in->buf. Sample data sent straight from @a data
+	 * should be sent with sr_session_send_buffer() and @a file, so that
+	 * consumers which retain the packet keep the mapping alive.
+	 *
+	 * The module reports how many leading bytes it consumed in @a used.
+	 * The next window starts right after them, and is grown if nothing
+	 * was consumed. Bytes left over at the end of the file are passed
+	 * to receive() before the caller calls end().
+	 *
+	 * This function is optional.
+	 *
+	 * @param[in] in The input instance.
+	 * @param[in] file The buffer holding the mapped file.
+	 * @param[in] data Start of the window, somewhere in @a file.
+	 * @param[in] len Length of the window in bytes.
+	 * @param[out] used Number of bytes consumed from the window.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_window) (struct sr_input *in, struct sr_buffer *file,
+			const uint8_t *data, size_t len, size_t *used);
+
 	/**
 	 * Signal the input module no more data will come.
 	 *
@@ -610,6 +659,23 @@ struct sr_output_module {
 	int (*receive) (const struct sr_output *o,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * Like receive(), but the output goes into a sink. Modules which
+	 * implement this append their text to sr_output_sink_text(), and
+	 * pass packet data on with sr_output_sink_write_ref(). If set,
+	 * receive() is not used and can be NULL.
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param packet The complete packet.
+	 * @param sink The sink to write the output to.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 */
+	int (*receive_sink) (const struct sr_output *o,
+			const struct sr_datafeed_packet *packet,
+			struct sr_output_sink *sink);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -813,6 +879,11 @@ struct sr_dev_inst {
 	void *priv;
 	/** Session to which this device is currently assigned. */
 	struct sr_session *session;
+	/** Packets held back for merging, see sr_session_coalesce_set(). */
+	struct datafeed_stage *stage;
+	/** Wall clock time before and after the acquisition start, in us. */
+	int64_t start_begin_us;
+	int64_t start_end_us;
 };
 
 /* Generic device instances */
@@ -841,11 +912,48 @@ SR_PRIV void sr_usbtmc_dev_inst_free(struct sr_usbtmc_dev_inst *usbtmc);
 SR_PRIV const GVariantType *sr_variant_type_get(int datatype);
 SR_PRIV int sr_variant_type_check(uint32_t key, GVariant *data);
 SR_PRIV void sr_hw_cleanup_all(const struct sr_context *ctx);
+SR_PRIV gboolean sr_scan_resource_begin(struct sr_context *ctx,
+		const void *prober, const char *resource);
+SR_PRIV void sr_scan_resource_end(struct sr_context *ctx,
+		const void *prober, const char *resource, gboolean found);
 SR_PRIV struct sr_config *sr_config_new(uint32_t key, GVariant *data);
 SR_PRIV void sr_config_free(struct sr_config *src);
 SR_PRIV int sr_dev_acquisition_start(struct sr_dev_inst *sdi);
 SR_PRIV int sr_dev_acquisition_stop(struct sr_dev_inst *sdi);
 
+/*--- buffer.c --------------------------------------------------------------*/
+
+struct sr_buffer_pool;
+
+/** A reference counted block of sample memory. */
+struct sr_buffer {
+	gint refcount;
+	/** The memory, valid for as long as a reference is held. */
+	uint8_t *data;
+	/** Size of @a data in bytes. */
+	size_t size;
+	/** Pool to return the memory to, or NULL. */
+	struct sr_buffer_pool *pool;
+	/** Releases @a data if the buffer is not pooled. */
+	GDestroyNotify free_func;
+	/** Passed to @a free_func instead of @a data if not NULL. */
+	gpointer owner;
+};
+
+SR_PRIV struct sr_buffer *sr_buffer_new(size_t size);
+SR_PRIV struct sr_buffer *sr_buffer_new_take(void *data, size_t size,
+		GDestroyNotify free_func);
+SR_PRIV struct sr_buffer *sr_buffer_new_view(const void *data, size_t size,
+		gpointer owner, GDestroyNotify owner_free);
+SR_PRIV struct sr_buffer *sr_buffer_ref(struct sr_buffer *buf);
+SR_PRIV void sr_buffer_unref(struct sr_buffer *buf);
+SR_PRIV gboolean sr_buffer_is_shared(struct sr_buffer *buf);
+SR_PRIV struct sr_buffer_pool *sr_buffer_pool_new(size_t buffer_size,
+		unsigned int max_free);
+SR_PRIV struct sr_buffer *sr_buffer_pool_get(struct sr_buffer_pool *pool);
+SR_PRIV void sr_buffer_pool_free(struct sr_buffer_pool *pool);
+SR_PRIV GMappedFile *sr_file_map_private(const char *filename, GError **error);
+
 /*--- session.c -------------------------------------------------------------*/
 
 struct sr_session {
@@ -865,7 +973,7 @@ struct sr_session {
 	/** User data to be passed to the session stop callback. */
 	void *stopped_cb_data;
 
-	/** Mutex protecting the main context pointer. */
+	/** Mutex protecting the main context pointer and the event sources. */
 	GMutex main_mutex;
 	/** Context of the session main loop. */
 	GMainContext *main_context;
@@ -878,6 +986,19 @@ struct sr_session {
 	unsigned int stop_check_id;
 	/** Whether the session has been started. */
 	gboolean running;
+	/** Size of merged data packets, or 0 to send packets as they come. */
+	size_t coalesce_size;
+	/** Maximum time small packets are held back for merging, or 0. */
+	unsigned int coalesce_latency_ms;
+
+	/** Event loop threads to use, enum sr_session_threading. */
+	int threading;
+	/** Event loop threads of the running session, or NULL. */
+	GSList *loops;
+	/** Keeps datafeed callbacks from running in several threads at once. */
+	GRecMutex dispatch_mutex;
+	/** Commit and start the devices concurrently. */
+	gboolean parallel_start;
 };
 
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
@@ -906,12 +1027,11 @@ SR_PRIV int sr_session_source_remove_channel(struct sr_session *session,
 
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buffer);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 SR_PRIV struct sr_dev_inst *sr_session_prepare_sdi(const char *filename,
 		struct sr_session **session);
-SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
-		struct sr_datafeed_packet **copy);
-SR_PRIV void sr_packet_free(struct sr_datafeed_packet *packet);
 
 /*--- session_file.c --------------------------------------------------------*/
 
@@ -924,6 +1044,102 @@ SR_PRIV void sr_zip_discard(struct zip *archive);
 SR_PRIV GKeyFile *sr_sessionfile_read_metadata(struct zip *archive,
 			const struct zip_stat *entry);
 
+/*--- zip_writer.c ----------------------------------------------------------*/
+
+struct sr_zip_writer;
+
+struct sr_zip_writer_stats {
+	/** Number of entries written to the file. */
+	uint64_t entries;
+	/** Uncompressed size of the written entries, in bytes. */
+	uint64_t size;
+	/** Compressed size of the written entries, in bytes. */
+	uint64_t compressed_size;
+	/** Entries added, but not written yet. */
+	unsigned int backlog;
+	/** Highest backlog so far. */
+	unsigned int max_backlog;
+	/** Number of times adding an entry waited for the backlog to drain. */
+	unsigned int stalls;
+	/** Total time spent waiting for the backlog to drain, in microseconds. */
+	uint64_t stall_time;
+};
+
+SR_PRIV struct sr_zip_writer *sr_zip_writer_new(const char *filename,
+		int level, unsigned int num_threads);
+SR_PRIV int sr_zip_writer_add_buffer(struct sr_zip_writer *zw,
+		const char *name, struct sr_buffer *buf, size_t size);
+SR_PRIV int sr_zip_writer_add(struct sr_zip_writer *zw, const char *name,
+		const void *data, size_t size);
+SR_PRIV void sr_zip_writer_stats_get(struct sr_zip_writer *zw,
+		struct sr_zip_writer_stats *stats);
+SR_PRIV int sr_zip_writer_close(struct sr_zip_writer *zw);
+
+/*--- overview.c ------------------------------------------------------------*/
+
+/** Number of levels in an overview. */
+#define SR_OVERVIEW_LEVELS 5
+/** Number of samples summarized by a record on the lowest level. */
+#define SR_OVERVIEW_BLOCK_SIZE 256
+/** Number of records summarized by a record on the next level. */
+#define SR_OVERVIEW_FACTOR 16
+
+struct sr_overview;
+
+SR_PRIV struct sr_overview *sr_overview_logic_new(unsigned int unitsize);
+SR_PRIV struct sr_overview *sr_overview_analog_new(void);
+SR_PRIV void sr_overview_logic(struct sr_overview *ov, const uint8_t *data,
+		size_t num_samples);
+SR_PRIV void sr_overview_analog(struct sr_overview *ov, const float *data,
+		size_t num_samples);
+SR_PRIV void sr_overview_finish(struct sr_overview *ov);
+SR_PRIV GByteArray *sr_overview_take(struct sr_overview *ov,
+		unsigned int level, size_t min_size);
+SR_PRIV void sr_overview_free(struct sr_overview *ov);
+
+/*--- logic_planes.c --------------------------------------------------------*/
+
+SR_PRIV void sr_logic_to_planes(uint64_t *planes, const uint8_t *samples,
+		unsigned int unitsize, unsigned int count);
+SR_PRIV void sr_logic_from_planes(uint8_t *samples, const uint64_t *planes,
+		unsigned int unitsize, unsigned int count);
+
+/* Builds 64 samples from bit planes, see sr_logic_from_planes_kernel(). */
+typedef void (*sr_logic_planes_kernel)(uint8_t *samples,
+		const uint64_t *planes, unsigned int unitsize);
+
+SR_PRIV sr_logic_planes_kernel sr_logic_from_planes_kernel(unsigned int unitsize);
+
+/*--- logic_rle.c -----------------------------------------------------------*/
+
+/** Size of the SR_DF_LOGIC packets SR_DF_LOGIC_RLE data is expanded into. */
+#define LOGIC_RLE_EXPAND_SIZE (1024 * 1024)
+
+/** Position within an SR_DF_LOGIC_RLE payload. */
+struct sr_logic_rle_iter {
+	const struct sr_datafeed_logic_rle *rle;
+	/** The current run. */
+	uint64_t run;
+	/** The number of samples of the current run already passed. */
+	uint64_t offset;
+};
+
+SR_PRIV void sr_logic_rle_iter_init(struct sr_logic_rle_iter *iter,
+		const struct sr_datafeed_logic_rle *rle);
+SR_PRIV uint64_t sr_logic_rle_iter_expand(struct sr_logic_rle_iter *iter,
+		uint64_t count, uint8_t *data);
+SR_PRIV void sr_logic_rle_truncate(struct sr_datafeed_logic_rle *rle,
+		uint64_t num_samples);
+
+/*--- output/output.c -------------------------------------------------------*/
+
+SR_PRIV GString *sr_output_sink_text(struct sr_output_sink *sink);
+SR_PRIV void sr_output_sink_write(struct sr_output_sink *sink,
+		const void *data, size_t len);
+SR_PRIV void sr_output_sink_write_ref(struct sr_output_sink *sink,
+		const void *data, size_t len);
+SR_PRIV void sr_output_sink_commit(struct sr_output_sink *sink);
+
 /*--- analog.c --------------------------------------------------------------*/
 
 SR_PRIV int sr_analog_init(struct sr_datafeed_analog *analog,
@@ -1025,6 +1241,8 @@ SR_PRIV int sr_atof_ascii(const char *str, float *ret);
 
 /*--- soft-trigger.c --------------------------------------------------------*/
 
+struct soft_trigger_stage;
+
 struct soft_trigger_logic {
 	const struct sr_dev_inst *sdi;
 	const struct sr_trigger *trigger;
@@ -1036,6 +1254,9 @@ struct soft_trigger_logic {
 	uint8_t *pre_trigger_head;
 	int pre_trigger_size;
 	int pre_trigger_fill;
+	/* The trigger stages, compiled to bitmaps. */
+	struct soft_trigger_stage *stages;
+	int num_stages;
 };
 
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
@@ -1045,6 +1266,42 @@ SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *st);
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *st, uint8_t *buf,
 		int len, int *pre_trigger_samples);
 
+struct soft_trigger_analog_stage;
+
+struct soft_trigger_analog {
+	const struct sr_dev_inst *sdi;
+	const struct sr_trigger *trigger;
+	float hysteresis;
+	int cur_stage;
+	/* The channels of every packet, in order, taken from the first one. */
+	GSList *channels;
+	int num_channels;
+	/* The trigger stages, compiled once the channels are known. */
+	struct soft_trigger_analog_stage *stages;
+	int num_stages;
+	/* Ring of pre-trigger samples, num_channels floats per sample. */
+	float *pre_trigger_buffer;
+	int pre_trigger_size;
+	int pre_trigger_head;
+	int pre_trigger_fill;
+	/* The current packet as floats, and the channels matched on as columns. */
+	const float *samples;
+	float *values;
+	float *columns;
+	int values_size;
+	/* Meaning of the last packet, the pre-trigger data is sent with it. */
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int digits;
+};
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, float hysteresis);
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta);
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const struct sr_datafeed_analog *analog, int *pre_trigger_samples);
+
 /*--- hardware/serial.c -----------------------------------------------------*/
 
 #ifdef HAVE_LIBSERIALPORT
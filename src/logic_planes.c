@@ -0,0 +1,415 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "logic-planes"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Conversion between logic samples and per-channel bit planes.
+ *
+ * A logic sample holds one bit per channel. Text output modules print
+ * each channel on a line of its own, and some devices deliver each
+ * channel's bits in a word of its own. Both need the transpose of the
+ * sample bits. Here it is done 64 samples at a time: a bit plane is a
+ * 64-bit word with one channel's value at 64 consecutive samples, the
+ * first sample in the least significant bit.
+ */
+
+/*
+ * Transpose an 8x8 bit matrix held in a 64-bit word, with row r in byte
+ * r and column c in bit c of each byte.
+ */
+static inline uint64_t transpose8(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/*
+ * Add the bits of 16 sample bytes to eight planes, at bit offset 'shift'.
+ * The byte's most significant bit goes into the last plane.
+ */
+static inline void bytes_to_planes(uint64_t *planes, __m128i v,
+		unsigned int shift)
+{
+	int j;
+
+	for (j = 7; j >= 0; j--) {
+		planes[j] |= (uint64_t)(uint16_t)_mm_movemask_epi8(v) << shift;
+		v = _mm_add_epi8(v, v);
+	}
+}
+
+/* Transpose 64 samples of the common sizes, returns FALSE for others. */
+static gboolean to_planes_vector(uint64_t *planes, const uint8_t *samples,
+		unsigned int unitsize)
+{
+	const __m128i low = _mm_set1_epi16(0x00ff);
+	__m128i a, b;
+	unsigned int g;
+
+	if (unitsize != 1 && unitsize != 2)
+		return FALSE;
+
+	memset(planes, 0, unitsize * 8 * sizeof(*planes));
+	for (g = 0; g < 64; g += 16) {
+		if (unitsize == 1) {
+			a = _mm_loadu_si128((const __m128i *)(samples + g));
+			bytes_to_planes(planes, a, g);
+			continue;
+		}
+		/* Split 16 two-byte samples into their low and high bytes. */
+		a = _mm_loadu_si128((const __m128i *)(samples + 2 * g));
+		b = _mm_loadu_si128((const __m128i *)(samples + 2 * g + 16));
+		bytes_to_planes(planes, _mm_packus_epi16(_mm_and_si128(a, low),
+				_mm_and_si128(b, low)), g);
+		bytes_to_planes(planes + 8, _mm_packus_epi16(_mm_srli_epi16(a, 8),
+				_mm_srli_epi16(b, 8)), g);
+	}
+
+	return TRUE;
+}
+
+/* Transpose the 8x8 bit matrix in each 64-bit lane, as transpose8(). */
+static inline __m128i sse2_transpose8(__m128i x)
+{
+	__m128i t;
+
+	t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 7)),
+		_mm_set1_epi64x(0x00aa00aa00aa00aaLL));
+	x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 7)));
+	t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 14)),
+		_mm_set1_epi64x(0x0000cccc0000ccccLL));
+	x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 14)));
+	t = _mm_and_si128(_mm_xor_si128(x, _mm_srli_epi64(x, 28)),
+		_mm_set1_epi64x(0x00000000f0f0f0f0LL));
+	x = _mm_xor_si128(x, _mm_xor_si128(t, _mm_slli_epi64(t, 28)));
+
+	return x;
+}
+
+/*
+ * Build 64 sample bytes from eight planes. Byte g of every plane is
+ * gathered into lane g with a byte transpose, then each lane's 8x8 bit
+ * matrix is transposed.
+ */
+static inline void sse2_planes_to_bytes(__m128i *out, const uint64_t *planes)
+{
+	__m128i v[4], u[4], w[4];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		v[i] = _mm_loadu_si128((const __m128i *)(planes + 2 * i));
+		u[i] = _mm_unpacklo_epi8(v[i], _mm_srli_si128(v[i], 8));
+	}
+	w[0] = _mm_unpacklo_epi16(u[0], u[1]);
+	w[1] = _mm_unpackhi_epi16(u[0], u[1]);
+	w[2] = _mm_unpacklo_epi16(u[2], u[3]);
+	w[3] = _mm_unpackhi_epi16(u[2], u[3]);
+	out[0] = sse2_transpose8(_mm_unpacklo_epi32(w[0], w[2]));
+	out[1] = sse2_transpose8(_mm_unpackhi_epi32(w[0], w[2]));
+	out[2] = sse2_transpose8(_mm_unpacklo_epi32(w[1], w[3]));
+	out[3] = sse2_transpose8(_mm_unpackhi_epi32(w[1], w[3]));
+}
+
+/* Build 64 samples of one or two bytes. */
+static void from_planes_sse2(uint8_t *samples, const uint64_t *planes,
+		unsigned int unitsize)
+{
+	__m128i lo[4], hi[4];
+	int i;
+
+	sse2_planes_to_bytes(lo, planes);
+	if (unitsize == 1) {
+		for (i = 0; i < 4; i++)
+			_mm_storeu_si128((__m128i *)(samples + 16 * i), lo[i]);
+		return;
+	}
+	sse2_planes_to_bytes(hi, planes + 8);
+	for (i = 0; i < 4; i++) {
+		_mm_storeu_si128((__m128i *)(samples + 32 * i),
+			_mm_unpacklo_epi8(lo[i], hi[i]));
+		_mm_storeu_si128((__m128i *)(samples + 32 * i + 16),
+			_mm_unpackhi_epi8(lo[i], hi[i]));
+	}
+}
+#endif
+
+#if defined(HAVE_TARGET_AVX2)
+#include <immintrin.h>
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i avx2_transpose8(__m256i x)
+{
+	__m256i t;
+
+	t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 7)),
+		_mm256_set1_epi64x(0x00aa00aa00aa00aaLL));
+	x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 7)));
+	t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 14)),
+		_mm256_set1_epi64x(0x0000cccc0000ccccLL));
+	x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 14)));
+	t = _mm256_and_si256(_mm256_xor_si256(x, _mm256_srli_epi64(x, 28)),
+		_mm256_set1_epi64x(0x00000000f0f0f0f0LL));
+	x = _mm256_xor_si256(x, _mm256_xor_si256(t, _mm256_slli_epi64(t, 28)));
+
+	return x;
+}
+
+/*
+ * Build 64 two-byte samples. The low and high byte planes take the two
+ * 128-bit lanes, so both go through the steps of sse2_planes_to_bytes()
+ * at once.
+ */
+static AVX2 void from_planes_avx2(uint8_t *samples, const uint64_t *planes,
+		unsigned int unitsize)
+{
+	__m256i v[4], u[4], w[4], out[4];
+	__m128i lo, hi;
+	int i;
+
+	(void)unitsize;
+
+	for (i = 0; i < 4; i++) {
+		v[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(
+				_mm_loadu_si128((const __m128i *)(planes + 2 * i))),
+			_mm_loadu_si128((const __m128i *)(planes + 8 + 2 * i)), 1);
+		u[i] = _mm256_unpacklo_epi8(v[i], _mm256_bsrli_epi128(v[i], 8));
+	}
+	w[0] = _mm256_unpacklo_epi16(u[0], u[1]);
+	w[1] = _mm256_unpackhi_epi16(u[0], u[1]);
+	w[2] = _mm256_unpacklo_epi16(u[2], u[3]);
+	w[3] = _mm256_unpackhi_epi16(u[2], u[3]);
+	out[0] = avx2_transpose8(_mm256_unpacklo_epi32(w[0], w[2]));
+	out[1] = avx2_transpose8(_mm256_unpackhi_epi32(w[0], w[2]));
+	out[2] = avx2_transpose8(_mm256_unpacklo_epi32(w[1], w[3]));
+	out[3] = avx2_transpose8(_mm256_unpackhi_epi32(w[1], w[3]));
+
+	for (i = 0; i < 4; i++) {
+		lo = _mm256_castsi256_si128(out[i]);
+		hi = _mm256_extracti128_si256(out[i], 1);
+		_mm_storeu_si128((__m128i *)(samples + 32 * i),
+			_mm_unpacklo_epi8(lo, hi));
+		_mm_storeu_si128((__m128i *)(samples + 32 * i + 16),
+			_mm_unpackhi_epi8(lo, hi));
+	}
+}
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__) && !defined(WORDS_BIGENDIAN)
+#include <arm_neon.h>
+
+static inline uint64x2_t neon_transpose8(uint64x2_t x)
+{
+	uint64x2_t t;
+
+	t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 7)),
+		vdupq_n_u64(0x00aa00aa00aa00aaULL));
+	x = veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 7)));
+	t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 14)),
+		vdupq_n_u64(0x0000cccc0000ccccULL));
+	x = veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 14)));
+	t = vandq_u64(veorq_u64(x, vshrq_n_u64(x, 28)),
+		vdupq_n_u64(0x00000000f0f0f0f0ULL));
+	x = veorq_u64(x, veorq_u64(t, vshlq_n_u64(t, 28)));
+
+	return x;
+}
+
+/* The steps of sse2_planes_to_bytes(). */
+static inline void neon_planes_to_bytes(uint8x16_t *out, const uint64_t *planes)
+{
+	uint8x16_t v;
+	uint16x8_t u[4];
+	uint32x4_t w[4];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		v = vld1q_u8((const uint8_t *)(planes + 2 * i));
+		u[i] = vreinterpretq_u16_u8(vzip1q_u8(v, vextq_u8(v, v, 8)));
+	}
+	w[0] = vreinterpretq_u32_u16(vzip1q_u16(u[0], u[1]));
+	w[1] = vreinterpretq_u32_u16(vzip2q_u16(u[0], u[1]));
+	w[2] = vreinterpretq_u32_u16(vzip1q_u16(u[2], u[3]));
+	w[3] = vreinterpretq_u32_u16(vzip2q_u16(u[2], u[3]));
+	out[0] = vreinterpretq_u8_u64(neon_transpose8(
+		vreinterpretq_u64_u32(vzip1q_u32(w[0], w[2]))));
+	out[1] = vreinterpretq_u8_u64(neon_transpose8(
+		vreinterpretq_u64_u32(vzip2q_u32(w[0], w[2]))));
+	out[2] = vreinterpretq_u8_u64(neon_transpose8(
+		vreinterpretq_u64_u32(vzip1q_u32(w[1], w[3]))));
+	out[3] = vreinterpretq_u8_u64(neon_transpose8(
+		vreinterpretq_u64_u32(vzip2q_u32(w[1], w[3]))));
+}
+
+static void from_planes_neon(uint8_t *samples, const uint64_t *planes,
+		unsigned int unitsize)
+{
+	uint8x16_t lo[4], hi[4];
+	int i;
+
+	neon_planes_to_bytes(lo, planes);
+	if (unitsize == 1) {
+		for (i = 0; i < 4; i++)
+			vst1q_u8(samples + 16 * i, lo[i]);
+		return;
+	}
+	neon_planes_to_bytes(hi, planes + 8);
+	for (i = 0; i < 4; i++) {
+		vst1q_u8(samples + 32 * i, vzip1q_u8(lo[i], hi[i]));
+		vst1q_u8(samples + 32 * i + 16, vzip2q_u8(lo[i], hi[i]));
+	}
+}
+#endif
+
+/**
+ * Transpose logic samples into bit planes.
+ *
+ * Bit k of planes[c] is set to the value of channel c in sample k. Bits
+ * beyond the last sample are cleared.
+ *
+ * @param planes Room for unitsize * 8 planes.
+ * @param samples The samples.
+ * @param unitsize Size of a sample in bytes.
+ * @param count Number of samples, at most 64.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_to_planes(uint64_t *planes, const uint8_t *samples,
+		unsigned int unitsize, unsigned int count)
+{
+	uint64_t x;
+	unsigned int g, b, j, k, n;
+
+#if defined(__SSE2__)
+	if (count == 64 && to_planes_vector(planes, samples, unitsize))
+		return;
+#endif
+
+	memset(planes, 0, unitsize * 8 * sizeof(*planes));
+	for (g = 0; g < count; g += 8) {
+		n = MIN(count - g, 8);
+		for (b = 0; b < unitsize; b++) {
+			x = 0;
+			for (k = 0; k < n; k++)
+				x |= (uint64_t)samples[(g + k) * unitsize + b] << (8 * k);
+			x = transpose8(x);
+			for (j = 0; j < 8; j++)
+				planes[b * 8 + j] |= ((x >> (8 * j)) & 0xff) << g;
+		}
+	}
+}
+
+/**
+ * Build logic samples from bit planes, the inverse of sr_logic_to_planes().
+ *
+ * @param samples Room for count samples.
+ * @param planes The unitsize * 8 planes.
+ * @param unitsize Size of a sample in bytes.
+ * @param count Number of samples, at most 64.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_from_planes(uint8_t *samples, const uint64_t *planes,
+		unsigned int unitsize, unsigned int count)
+{
+	uint64_t x;
+	unsigned int g, b, j, k, n;
+
+	if (count == 64 && (unitsize == 1 || unitsize == 2)) {
+#if defined(__SSE2__)
+		from_planes_sse2(samples, planes, unitsize);
+		return;
+#elif defined(__ARM_NEON) && defined(__aarch64__) && !defined(WORDS_BIGENDIAN)
+		from_planes_neon(samples, planes, unitsize);
+		return;
+#endif
+	}
+
+	for (g = 0; g < count; g += 8) {
+		n = MIN(count - g, 8);
+		for (b = 0; b < unitsize; b++) {
+			x = 0;
+			for (j = 0; j < 8; j++)
+				x |= ((planes[b * 8 + j] >> g) & 0xff) << (8 * j);
+			x = transpose8(x);
+			for (k = 0; k < n; k++)
+				samples[(g + k) * unitsize + b] = x >> (8 * k);
+		}
+	}
+}
+
+static void from_planes_block(uint8_t *samples, const uint64_t *planes,
+		unsigned int unitsize)
+{
+	sr_logic_from_planes(samples, planes, unitsize, 64);
+}
+
+/**
+ * Pick the fastest kernel for building blocks of 64 samples from bit
+ * planes.
+ *
+ * This is for callers which convert many blocks of the same size, like
+ * drivers for devices delivering a word per channel. The choice is made
+ * once, including the check for AVX2 support at runtime. The kernel
+ * takes the arguments of sr_logic_from_planes() without the count.
+ *
+ * @param unitsize Size of a sample in bytes.
+ *
+ * @return The kernel, never NULL.
+ *
+ * @private
+ */
+SR_PRIV sr_logic_planes_kernel sr_logic_from_planes_kernel(unsigned int unitsize)
+{
+#if defined(HAVE_TARGET_AVX2)
+	if (unitsize == 2 && __builtin_cpu_supports("avx2"))
+		return from_planes_avx2;
+#endif
+#if defined(__SSE2__)
+	if (unitsize == 1 || unitsize == 2)
+		return from_planes_sse2;
+#elif defined(__ARM_NEON) && defined(__aarch64__) && !defined(WORDS_BIGENDIAN)
+	if (unitsize == 1 || unitsize == 2)
+		return from_planes_neon;
+#endif
+
+	return from_planes_block;
+}
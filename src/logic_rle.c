@@ -0,0 +1,218 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "logic-rle"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Transition-encoded logic data.
+ *
+ * Slowly changing signals sampled at a high rate mostly repeat the same
+ * sample. Drivers which get the data from the device as timestamps and
+ * values can send it as SR_DF_LOGIC_RLE packets, which hold one value
+ * per run of identical samples, and skip expanding it into a dense array
+ * which would only be compressed again by the consumer.
+ *
+ * The session and sr_output_send() convert these packets into plain
+ * SR_DF_LOGIC packets for every consumer which did not ask for them.
+ */
+
+/**
+ * @defgroup grp_logic_rle Transition-encoded logic data
+ *
+ * Converting transition-encoded logic data to dense sample arrays.
+ *
+ * @{
+ */
+
+/* Store count copies of a sample at dst. */
+static void fill_samples(uint8_t *dst, const uint8_t *value,
+		unsigned int unitsize, uint64_t count)
+{
+	uint64_t done, n;
+
+	if (count == 0)
+		return;
+
+	if (unitsize == 1) {
+		memset(dst, value[0], count);
+		return;
+	}
+
+	/* Double the filled part on every round. */
+	memcpy(dst, value, unitsize);
+	for (done = 1; done < count; done += n) {
+		n = MIN(done, count - done);
+		memcpy(dst + done * unitsize, dst, n * unitsize);
+	}
+}
+
+/**
+ * Start walking a payload from its first sample.
+ *
+ * @param iter The iterator to set up. Must not be NULL.
+ * @param rle The payload. Must not be NULL, and must not change while
+ *            the iterator is used.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_rle_iter_init(struct sr_logic_rle_iter *iter,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	iter->rle = rle;
+	iter->run = 0;
+	iter->offset = 0;
+}
+
+/* Skip samples, return how many; fewer at the end of the payload. */
+static uint64_t iter_skip(struct sr_logic_rle_iter *iter, uint64_t count)
+{
+	const struct sr_datafeed_logic_rle *rle;
+	uint64_t done, n;
+
+	rle = iter->rle;
+	for (done = 0; done < count && iter->run < rle->num_runs; done += n) {
+		n = MIN(rle->lengths[iter->run] - iter->offset, count - done);
+		iter->offset += n;
+		if (iter->offset == rle->lengths[iter->run]) {
+			iter->run++;
+			iter->offset = 0;
+		}
+	}
+
+	return done;
+}
+
+/**
+ * Expand the next samples of a payload into a dense array.
+ *
+ * @param iter The iterator. Must not be NULL.
+ * @param count The maximum number of samples to expand.
+ * @param data Buffer for @a count samples of the payload's unit size.
+ *             Must not be NULL.
+ *
+ * @return The number of samples stored, less than @a count at the end
+ *         of the payload.
+ *
+ * @private
+ */
+SR_PRIV uint64_t sr_logic_rle_iter_expand(struct sr_logic_rle_iter *iter,
+		uint64_t count, uint8_t *data)
+{
+	const struct sr_datafeed_logic_rle *rle;
+	const uint8_t *values;
+	uint64_t done, n;
+
+	rle = iter->rle;
+	values = rle->values;
+	for (done = 0; done < count && iter->run < rle->num_runs; done += n) {
+		n = MIN(rle->lengths[iter->run] - iter->offset, count - done);
+		fill_samples(data + done * rle->unitsize,
+				values + iter->run * rle->unitsize,
+				rle->unitsize, n);
+		iter->offset += n;
+		if (iter->offset == rle->lengths[iter->run]) {
+			iter->run++;
+			iter->offset = 0;
+		}
+	}
+
+	return done;
+}
+
+/**
+ * Cut a payload down to its first samples.
+ *
+ * Only adjusts the counts and the length of the last remaining run, so
+ * the arrays of the payload stay with their owner.
+ *
+ * @param rle The payload. Must not be NULL.
+ * @param num_samples The number of samples to keep. A payload which is
+ *                    not longer is left alone.
+ *
+ * @private
+ */
+SR_PRIV void sr_logic_rle_truncate(struct sr_datafeed_logic_rle *rle,
+		uint64_t num_samples)
+{
+	uint64_t i, total;
+
+	if (num_samples >= rle->num_samples)
+		return;
+
+	total = 0;
+	for (i = 0; i < rle->num_runs; i++) {
+		if (total + rle->lengths[i] >= num_samples)
+			break;
+		total += rle->lengths[i];
+	}
+	if (num_samples == 0) {
+		rle->num_runs = 0;
+	} else {
+		rle->lengths[i] = num_samples - total;
+		rle->num_runs = i + 1;
+	}
+	rle->num_samples = num_samples;
+}
+
+/**
+ * Expand a range of samples of a transition-encoded payload.
+ *
+ * @param rle The payload. Must not be NULL.
+ * @param start The first sample, counting from 0.
+ * @param count The number of samples.
+ * @param data Buffer to store @a count samples of the payload's unit
+ *             size in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range exceeds the payload.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_logic_rle_expand(const struct sr_datafeed_logic_rle *rle,
+		uint64_t start, uint64_t count, void *data)
+{
+	struct sr_logic_rle_iter iter;
+
+	if (!rle || !data)
+		return SR_ERR_ARG;
+
+	if (start > rle->num_samples || count > rle->num_samples - start)
+		return SR_ERR_ARG;
+
+	sr_logic_rle_iter_init(&iter, rle);
+	if (iter_skip(&iter, start) != start)
+		return SR_ERR_ARG;
+	if (sr_logic_rle_iter_expand(&iter, count, data) != count)
+		return SR_ERR_ARG;
+
+	return SR_OK;
+}
+
+/** @} */
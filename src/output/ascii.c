@@ -46,9 +46,13 @@ struct context {
 	int *channel_index;
 	char **channel_names;
 	char **line_values;
-	uint8_t *prev_sample;
+	/* Value of each channel in the previous sample. */
+	uint8_t *prev_bits;
 	gboolean header_done;
 	GString **lines;
+	/* Bit planes of the samples being written, see sr_logic_to_planes(). */
+	uint64_t *planes;
+	unsigned int num_planes;
 	GString *header;
 	const char *charset;
 	gboolean edges;
@@ -87,7 +91,7 @@ static int init(struct sr_output *o, GHashTable *options)
 	ctx->channel_index = g_malloc(sizeof(int) * ctx->num_enabled_channels);
 	ctx->channel_names = g_malloc(sizeof(char *) * ctx->num_enabled_channels);
 	ctx->lines = g_malloc(sizeof(GString *) * ctx->num_enabled_channels);
-	ctx->prev_sample = g_malloc(g_slist_length(o->sdi->channels));
+	ctx->prev_bits = g_malloc0(ctx->num_enabled_channels);
 
 	j = 0;
 	for (i = 0, l = o->sdi->channels; l; l = l->next, i++) {
@@ -106,11 +110,10 @@ static int init(struct sr_output *o, GHashTable *options)
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	GVariant *gvar;
-	GString *header;
 	int num_channels;
 	char *samplerate_s;
 
@@ -123,8 +126,7 @@ static GString *gen_header(const struct sr_output *o)
 		}
 	}
 
-	header = g_string_sized_new(512);
-	g_string_printf(header, "%s %s\n", PACKAGE_NAME, SR_PACKAGE_VERSION_STRING);
+	g_string_append_printf(header, "%s %s\n", PACKAGE_NAME, SR_PACKAGE_VERSION_STRING);
 	num_channels = g_slist_length(o->sdi->channels);
 	g_string_append_printf(header, "Acquisition with %d/%d channels",
 			ctx->num_enabled_channels, num_channels);
@@ -134,28 +136,83 @@ static GString *gen_header(const struct sr_output *o)
 		g_free(samplerate_s);
 	}
 	g_string_append_printf(header, "\n");
+}
+
+/* Make room for the bit planes of samples of the given size. */
+static void reserve_planes(struct context *ctx, unsigned int unitsize)
+{
+	if (ctx->num_planes >= 8 * unitsize)
+		return;
+	ctx->num_planes = 8 * unitsize;
+	ctx->planes = g_renew(uint64_t, ctx->planes, ctx->num_planes);
+}
 
-	return header;
+/* Append the bits of one channel to its line, drawing edges if enabled. */
+static void append_samples(struct context *ctx, unsigned int j,
+		uint64_t plane, unsigned int count)
+{
+	char buf[64];
+	uint64_t edges;
+	unsigned int k, charidx;
+
+	edges = 0;
+	if (ctx->edges) {
+		edges = plane ^ ((plane << 1) | ctx->prev_bits[j]);
+		/* The first sample of a line has no edge. */
+		if (ctx->spl_cnt == 0)
+			edges &= ~(uint64_t)1;
+	}
+	for (k = 0; k < count; k++) {
+		charidx = (plane >> k) & 1;
+		if ((edges >> k) & 1)
+			charidx += 2;
+		buf[k] = ctx->charset[charidx];
+	}
+	ctx->prev_bits[j] = (plane >> (count - 1)) & 1;
+	g_string_append_len(ctx->lines[j], buf, count);
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+/* Write out the completed lines, and the trigger marker below them. */
+static void flush_lines(struct context *ctx, GString *out)
+{
+	unsigned int j;
+	int offset;
+
+	for (j = 0; j < ctx->num_enabled_channels; j++) {
+		g_string_append_len(out, ctx->lines[j]->str, ctx->lines[j]->len);
+		g_string_append_c(out, '\n');
+		g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
+	}
+	if (ctx->num_enabled_channels && ctx->trigger > -1) {
+		/*
+		 * Sample data lines have one character per bit and
+		 * no separator between bytes. Align trigger marker
+		 * to this layout.
+		 */
+		offset = ctx->trigger;
+		g_string_append_printf(out, "T:%*s^ %d\n", offset, "", ctx->trigger);
+		ctx->trigger = -1;
+	}
+}
+
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	int idx, offset, curbit, prevbit;
-	uint64_t i, j;
-	gchar *p, c;
-	size_t charidx;
+	GString *out;
+	unsigned int idx;
+	uint64_t i, j, n, num_samples, plane;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
 		return SR_ERR_ARG;
+	out = sr_output_sink_text(sink);
 
 	switch (packet->type) {
 	case SR_DF_META:
@@ -172,58 +229,42 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_LOGIC:
 		if (!ctx->header_done) {
-			*out = gen_header(o);
+			gen_header(o, out);
 			ctx->header_done = TRUE;
-		} else
-			*out = g_string_sized_new(512);
+		}
 
 		logic = packet->payload;
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			ctx->spl_cnt++;
+		if (logic->unitsize == 0)
+			break;
+		reserve_planes(ctx, logic->unitsize);
+		num_samples = logic->length / logic->unitsize;
+		for (i = 0; i < num_samples; i += n) {
+			/* Up to 64 samples at a time, up to the end of the line. */
+			n = MIN(num_samples - i, 64);
+			if (ctx->spl > ctx->spl_cnt)
+				n = MIN(n, (uint64_t)(ctx->spl - ctx->spl_cnt));
+			sr_logic_to_planes(ctx->planes,
+				(const uint8_t *)logic->data + i * logic->unitsize,
+				logic->unitsize, n);
 			for (j = 0; j < ctx->num_enabled_channels; j++) {
 				idx = ctx->channel_index[j];
-				p = logic->data + i + idx / 8;
-				curbit = *p & (1 << (idx % 8));
-				prevbit = (ctx->prev_sample[idx / 8] & ((uint8_t) 1 << (idx % 8)));
-
-				charidx = curbit ? 1 : 0;
-				if (ctx->edges && ctx->spl_cnt > 1) {
-					if (curbit != prevbit)
-						charidx += 2;
-				}
-				c = ctx->charset[charidx];
-				g_string_append_c(ctx->lines[j], c);
-
-				if (ctx->spl_cnt == ctx->spl) {
-					/* Flush line buffers. */
-					g_string_append_len(*out, ctx->lines[j]->str, ctx->lines[j]->len);
-					g_string_append_c(*out, '\n');
-					if (j == ctx->num_enabled_channels - 1 && ctx->trigger > -1) {
-						/*
-						 * Sample data lines have one character per bit and
-						 * no separator between bytes. Align trigger marker
-						 * to this layout.
-						 */
-						offset = ctx->trigger;
-						g_string_append_printf(*out, "T:%*s^ %d\n", offset, "", ctx->trigger);
-						ctx->trigger = -1;
-					}
-					g_string_printf(ctx->lines[j], "%s:", ctx->channel_names[j]);
-				}
+				plane = idx < 8 * logic->unitsize ? ctx->planes[idx] : 0;
+				append_samples(ctx, j, plane, n);
 			}
-			if (ctx->spl_cnt == ctx->spl)
-				/* Line buffers were already flushed. */
+			ctx->spl_cnt += n;
+			if (ctx->spl_cnt == ctx->spl) {
+				flush_lines(ctx, out);
 				ctx->spl_cnt = 0;
-			memcpy(ctx->prev_sample, logic->data + i, logic->unitsize);
+				sr_output_sink_commit(sink);
+			}
 		}
 		break;
 	case SR_DF_END:
 		if (ctx->spl_cnt) {
 			/* Line buffers need flushing. */
-			*out = g_string_sized_new(512);
 			for (i = 0; i < ctx->num_enabled_channels; i++) {
-				g_string_append_len(*out, ctx->lines[i]->str, ctx->lines[i]->len);
-				g_string_append_c(*out, '\n');
+				g_string_append_len(out, ctx->lines[i]->str, ctx->lines[i]->len);
+				g_string_append_c(out, '\n');
 			}
 		}
 		break;
@@ -244,11 +285,12 @@ static int cleanup(struct sr_output *o)
 		return SR_OK;
 
 	g_free(ctx->channel_index);
-	g_free(ctx->prev_sample);
+	g_free(ctx->prev_bits);
 	g_free(ctx->channel_names);
 	for (i = 0; i < ctx->num_enabled_channels; i++)
 		g_string_free(ctx->lines[i], TRUE);
 	g_free(ctx->lines);
+	g_free(ctx->planes);
 	g_free((gpointer)ctx->charset);
 	g_free(ctx);
 	o->priv = NULL;
@@ -282,6 +324,6 @@ SR_PRIV struct sr_output_module output_ascii = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
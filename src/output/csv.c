@@ -63,10 +63,16 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Longest formatted uint64_t and float value, as printed by "%g". */
+#define MAX_U64_LEN	20
+#define MAX_FLOAT_LEN	16
+
 struct ctx_channel {
 	struct sr_channel *ch;
 	char *label;
 	float min, max;
+	/* Column in the analog samples, or bit in the logic samples. */
+	unsigned int pos;
 };
 
 struct context {
@@ -82,6 +88,7 @@ struct context {
 	gboolean time;
 	gboolean do_trigger;
 	gboolean dedup;
+	size_t value_len, record_len;
 
 	/* Plot data */
 	unsigned int num_analog_channels;
@@ -91,15 +98,28 @@ struct context {
 	/* Metadata */
 	gboolean trigger;
 	uint32_t num_samples;
-	uint32_t channel_count, logic_channel_count;
-	uint32_t channels_seen;
 	uint64_t period;
 	uint64_t sample_time;
-	uint8_t *previous_sample;
-	float *analog_samples;
-	uint8_t *logic_samples;
 	const char *xlabel;	/* Don't free: will point to a static string. */
 	const char *title;	/* Don't free: will point into the driver struct. */
+
+	/* Samples waiting for the rest of their rows. */
+	gboolean have_analog, have_logic;
+	unsigned int analog_seen;
+	uint16_t unitsize;
+	const uint8_t *logic_data;
+
+	/* Scratch space, kept across packets. */
+	float *analog_samples;
+	size_t analog_samples_size;
+	float *fdata;
+	size_t fdata_size;
+	uint8_t *logic_samples;
+	size_t logic_samples_size;
+	uint8_t *logic_mask;
+	uint8_t *previous_logic;
+	float *previous_analog;
+	char *row;
 };
 
 /*
@@ -111,6 +131,7 @@ struct context {
 static int init(struct sr_output *o, GHashTable *options)
 {
 	unsigned int i, analog_channels, logic_channels;
+	size_t row_size;
 	struct context *ctx;
 	struct sr_channel *ch;
 	const char *label_string;
@@ -162,11 +183,8 @@ static int init(struct sr_output *o, GHashTable *options)
 	/* Get the number of channels, and the unitsize. */
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
-		if (ch->type == SR_CHANNEL_LOGIC) {
-			ctx->logic_channel_count++;
-			if (ch->enabled)
-				logic_channels++;
-		}
+		if (ch->type == SR_CHANNEL_LOGIC && ch->enabled)
+			logic_channels++;
 		if (ch->type == SR_CHANNEL_ANALOG && ch->enabled)
 			analog_channels++;
 	}
@@ -178,20 +196,22 @@ static int init(struct sr_output *o, GHashTable *options)
 		sr_info("Outputting %d logic values", logic_channels);
 		ctx->num_logic_channels = logic_channels;
 	}
-	ctx->channels = g_malloc(sizeof(struct ctx_channel)
+	ctx->channels = g_malloc0(sizeof(struct ctx_channel)
 		* (ctx->num_analog_channels + ctx->num_logic_channels));
 
 	/* Once more to map the enabled channels. */
-	ctx->channel_count = g_slist_length(o->sdi->channels);
+	analog_channels = 0;
 	for (i = 0, l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
 		if (ch->enabled) {
 			if (ch->type == SR_CHANNEL_ANALOG) {
 				ctx->channels[i].min = FLT_MAX;
 				ctx->channels[i].max = FLT_MIN;
+				ctx->channels[i].pos = analog_channels++;
 			} else if (ch->type == SR_CHANNEL_LOGIC) {
 				ctx->channels[i].min = 0;
 				ctx->channels[i].max = 1;
+				ctx->channels[i].pos = ch->index;
 			} else {
 				sr_warn("Unknown channel type %d.", ch->type);
 			}
@@ -201,6 +221,18 @@ static int init(struct sr_output *o, GHashTable *options)
 		}
 	}
 
+	/* Room for the longest possible row, with time and trigger. */
+	ctx->value_len = strlen(ctx->value);
+	ctx->record_len = strlen(ctx->record);
+	row_size = MAX_U64_LEN + 1 + 2 * ctx->value_len + ctx->record_len;
+	row_size += ctx->num_logic_channels * (1 + ctx->value_len);
+	row_size += ctx->num_analog_channels * (MAX_FLOAT_LEN + ctx->value_len);
+	ctx->row = g_malloc(row_size);
+
+	if (ctx->dedup)
+		ctx->previous_analog = g_malloc0(sizeof(float)
+			* MAX(ctx->num_analog_channels, 1));
+
 	return SR_OK;
 }
 
@@ -209,20 +241,18 @@ static const char *xlabels[] = {
 	"femtoseconds", "attoseconds",
 };
 
-static GString *gen_header(const struct sr_output *o,
-			   const struct sr_datafeed_header *hdr)
+static void gen_header(const struct sr_output *o,
+			   const struct sr_datafeed_header *hdr, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *channels, *l;
 	unsigned int num_channels, i;
 	uint64_t samplerate = 0, sr;
 	char *samplerate_s;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 
 	if (ctx->period == 0) {
 		if (sr_config_get(o->sdi->driver, o->sdi, NULL,
@@ -279,8 +309,6 @@ static GString *gen_header(const struct sr_output *o,
 		}
 		ctx->did_header = TRUE;
 	}
-
-	return header;
 }
 
 /*
@@ -309,202 +337,426 @@ static GString *gen_header(const struct sr_output *o,
 static void process_analog(struct context *ctx,
 			   const struct sr_datafeed_analog *analog)
 {
-	int ret;
-	size_t num_rcvd_ch, num_have_ch;
-	size_t idx_have, idx_smpl, idx_rcvd;
-	size_t idx_send;
+	size_t num_rcvd_ch, num_have_ch, num_samples;
+	size_t idx_have, idx_smpl, idx_rcvd, pos;
 	struct sr_analog_meaning *meaning;
+	struct ctx_channel *have;
 	GSList *l;
-	float *fdata = NULL;
-	struct sr_channel *ch;
+	float *src, *dst;
 
-	if (!ctx->analog_samples) {
-		ctx->analog_samples = g_malloc(analog->num_samples
-			* sizeof(float) * ctx->num_analog_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = analog->num_samples;
-	}
+	if (!ctx->num_samples)
+		ctx->num_samples = analog->num_samples;
 	if (ctx->num_samples != analog->num_samples)
 		sr_warn("Expecting %u analog samples, got %u.",
 			ctx->num_samples, analog->num_samples);
+	num_samples = MIN(ctx->num_samples, analog->num_samples);
+
+	if (ctx->analog_samples_size < ctx->num_samples) {
+		g_free(ctx->analog_samples);
+		ctx->analog_samples = g_malloc0(ctx->num_samples
+			* sizeof(float) * ctx->num_analog_channels);
+		ctx->analog_samples_size = ctx->num_samples;
+	}
+	ctx->have_analog = TRUE;
 
 	meaning = analog->meaning;
 	num_rcvd_ch = g_slist_length(meaning->channels);
-	ctx->channels_seen += num_rcvd_ch;
 	sr_dbg("Processing packet of %zu analog channels", num_rcvd_ch);
-	fdata = g_malloc(analog->num_samples * num_rcvd_ch * sizeof(float));
-	if ((ret = sr_analog_to_float(analog, fdata)) != SR_OK)
+	if (ctx->fdata_size < analog->num_samples * num_rcvd_ch) {
+		g_free(ctx->fdata);
+		ctx->fdata_size = analog->num_samples * num_rcvd_ch;
+		ctx->fdata = g_malloc(ctx->fdata_size * sizeof(float));
+	}
+	if (sr_analog_to_float(analog, ctx->fdata) != SR_OK)
 		sr_warn("Problems converting data to floating point values.");
 
 	num_have_ch = ctx->num_analog_channels + ctx->num_logic_channels;
-	idx_send = 0;
-	for (idx_have = 0; idx_have < num_have_ch; idx_have++) {
-		if (ctx->channels[idx_have].ch->type != SR_CHANNEL_ANALOG)
+	for (l = meaning->channels, idx_rcvd = 0; l; l = l->next, idx_rcvd++) {
+		for (idx_have = 0; idx_have < num_have_ch; idx_have++) {
+			if (ctx->channels[idx_have].ch == l->data)
+				break;
+		}
+		if (idx_have == num_have_ch)
 			continue;
-		sr_dbg("Looking for channel %s",
-		       ctx->channels[idx_have].ch->name);
-		for (l = meaning->channels, idx_rcvd = 0; l; l = l->next, idx_rcvd++) {
-			ch = l->data;
-			sr_dbg("Checking %s", ch->name);
-			if (ctx->channels[idx_have].ch != ch)
-				continue;
-			if (ctx->label_do && !ctx->label_names) {
-				sr_analog_unit_to_string(analog,
-					&ctx->channels[idx_have].label);
-			}
-			for (idx_smpl = 0; idx_smpl < analog->num_samples; idx_smpl++)
-				ctx->analog_samples[idx_smpl * ctx->num_analog_channels + idx_send] = fdata[idx_smpl * num_rcvd_ch + idx_rcvd];
-			break;
+		have = &ctx->channels[idx_have];
+		if (ctx->label_do && !ctx->label_names && !have->label)
+			sr_analog_unit_to_string(analog, &have->label);
+
+		/* Scatter into this channel's column. */
+		src = ctx->fdata + idx_rcvd;
+		pos = have->pos;
+		dst = ctx->analog_samples + pos;
+		for (idx_smpl = 0; idx_smpl < num_samples; idx_smpl++) {
+			*dst = *src;
+			dst += ctx->num_analog_channels;
+			src += num_rcvd_ch;
 		}
-		idx_send++;
+		ctx->analog_seen++;
 	}
-	g_free(fdata);
 }
 
 /*
  * We treat logic packets the same as analog packets, though it's not
  * strictly required. This allows us to process mixed signals properly.
+ *
+ * Without analog channels the rows are written right away, straight
+ * from the packet. Otherwise its samples are kept until the analog
+ * values for the same rows have arrived.
  */
 static void process_logic(struct context *ctx,
 			  const struct sr_datafeed_logic *logic)
 {
-	unsigned int i, j, ch, num_samples;
-	int idx;
-	uint8_t *sample;
+	unsigned int j, idx, num_samples;
+	size_t size;
 
 	num_samples = logic->length / logic->unitsize;
-	ctx->channels_seen += ctx->logic_channel_count;
 	sr_dbg("Logic packet had %d channels", logic->unitsize * 8);
-	if (!ctx->logic_samples) {
-		ctx->logic_samples = g_malloc(num_samples * ctx->num_logic_channels);
-		if (!ctx->num_samples)
-			ctx->num_samples = num_samples;
-	}
+	if (!ctx->num_samples)
+		ctx->num_samples = num_samples;
 	if (ctx->num_samples != num_samples)
 		sr_warn("Expecting %u samples, got %u",
 			ctx->num_samples, num_samples);
 
-	for (j = ch = 0; ch < ctx->num_logic_channels; j++) {
-		if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-			for (i = 0; i < num_samples; i++) {
-				sample = logic->data + i * logic->unitsize;
-				idx = ctx->channels[j].ch->index;
-				if (ctx->label_do && !ctx->label_names)
-					ctx->channels[j].label = "logic";
-				ctx->logic_samples[i * ctx->num_logic_channels + ch] = sample[idx / 8] & (1 << (idx % 8));
-			}
-			ch++;
+	/* Which bits of a sample are enabled, for dedup. */
+	if (ctx->unitsize != logic->unitsize) {
+		ctx->unitsize = logic->unitsize;
+		g_free(ctx->logic_mask);
+		g_free(ctx->previous_logic);
+		ctx->logic_mask = g_malloc0(ctx->unitsize);
+		ctx->previous_logic = g_malloc0(ctx->unitsize);
+		for (j = 0; j < ctx->num_analog_channels + ctx->num_logic_channels; j++) {
+			if (ctx->channels[j].ch->type != SR_CHANNEL_LOGIC)
+				continue;
+			idx = ctx->channels[j].pos;
+			if (idx / 8 < ctx->unitsize)
+				ctx->logic_mask[idx / 8] |= 1 << (idx % 8);
 		}
 	}
+
+	if (ctx->label_do && !ctx->label_names) {
+		for (j = 0; j < ctx->num_analog_channels + ctx->num_logic_channels; j++) {
+			if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC)
+				ctx->channels[j].label = "logic";
+		}
+	}
+
+	if (ctx->num_analog_channels) {
+		size = (size_t)ctx->num_samples * logic->unitsize;
+		if (ctx->logic_samples_size < size) {
+			g_free(ctx->logic_samples);
+			ctx->logic_samples = g_malloc0(size);
+			ctx->logic_samples_size = size;
+		}
+		memcpy(ctx->logic_samples, logic->data,
+			MIN(ctx->num_samples, num_samples) * logic->unitsize);
+		ctx->logic_data = ctx->logic_samples;
+	} else {
+		ctx->logic_data = logic->data;
+	}
+	ctx->have_logic = TRUE;
+}
+
+static gboolean have_all_channels(const struct context *ctx)
+{
+	if (!ctx->have_analog && !ctx->have_logic)
+		return FALSE;
+	if (ctx->num_logic_channels && !ctx->have_logic)
+		return FALSE;
+
+	return ctx->analog_seen >= ctx->num_analog_channels;
+}
+
+static char *append_u64(char *p, uint64_t value)
+{
+	char digits[MAX_U64_LEN];
+	int n;
+
+	n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (n)
+		*p++ = digits[--n];
+
+	return p;
 }
 
-static void dump_saved_values(struct context *ctx, GString **out)
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/* Multiply by 10^exp, exactly for |exp| <= 22. */
+static double scale10(double v, int exp)
 {
-	unsigned int i, j, analog_size, num_channels;
-	float *analog_sample, value;
-	uint8_t *logic_sample;
+	while (exp > 22) {
+		v *= powers_of_ten[22];
+		exp -= 22;
+	}
+	while (exp < -22) {
+		v /= powers_of_ten[22];
+		exp += 22;
+	}
+
+	return exp >= 0 ? v * powers_of_ten[exp] : v / powers_of_ten[-exp];
+}
+
+/*
+ * Print a value the way "%g" does, which is what this module always
+ * used. The six significant digits are found with a single scaling
+ * step; values which end up too close to a rounding tie for that to
+ * be exact are left to the C library.
+ */
+static char *append_float(char *p, float value)
+{
+	double v, scaled, frac;
+	uint32_t m;
+	int exp, num_digits, i;
+	char digits[6], *start;
+
+	v = value;
+	start = p;
+	if (!isfinite(v))
+		return p + g_snprintf(p, MAX_FLOAT_LEN, "%g", v);
+	if (signbit(v)) {
+		*p++ = '-';
+		v = -v;
+	}
+	if (v == 0) {
+		*p++ = '0';
+		return p;
+	}
+
+	exp = (int)floor(log10(v));
+	scaled = scale10(v, 5 - exp);
+	if (scaled < 100000) {
+		exp--;
+		scaled = scale10(v, 5 - exp);
+	} else if (scaled >= 1000000) {
+		exp++;
+		scaled = scale10(v, 5 - exp);
+	}
+	frac = scaled - floor(scaled);
+	if (fabs(frac - 0.5) < 1e-6)
+		return start + g_snprintf(start, MAX_FLOAT_LEN, "%g", (double)value);
+	m = (uint32_t)(scaled + 0.5);
+	if (m >= 1000000) {
+		m /= 10;
+		exp++;
+	}
+
+	for (i = 5; i >= 0; i--) {
+		digits[i] = '0' + m % 10;
+		m /= 10;
+	}
+	for (num_digits = 6; num_digits > 1 && digits[num_digits - 1] == '0'; )
+		num_digits--;
+
+	if (exp < -4 || exp >= 6) {
+		*p++ = digits[0];
+		if (num_digits > 1) {
+			*p++ = '.';
+			memcpy(p, digits + 1, num_digits - 1);
+			p += num_digits - 1;
+		}
+		*p++ = 'e';
+		*p++ = exp < 0 ? '-' : '+';
+		exp = abs(exp);
+		if (exp >= 100)
+			*p++ = '0' + exp / 100;
+		*p++ = '0' + exp / 10 % 10;
+		*p++ = '0' + exp % 10;
+	} else if (exp >= 0) {
+		for (i = 0; i <= exp; i++)
+			*p++ = i < num_digits ? digits[i] : '0';
+		if (num_digits > exp + 1) {
+			*p++ = '.';
+			memcpy(p, digits + exp + 1, num_digits - exp - 1);
+			p += num_digits - exp - 1;
+		}
+	} else {
+		*p++ = '0';
+		*p++ = '.';
+		for (i = -1; i > exp; i--)
+			*p++ = '0';
+		memcpy(p, digits, num_digits);
+		p += num_digits;
+	}
+
+	return p;
+}
+
+static gboolean logic_bit(const uint8_t *sample, uint16_t unitsize,
+		unsigned int idx)
+{
+	uint64_t word;
+
+	/* Whole words for the common sizes, bytes otherwise. */
+	switch (unitsize) {
+	case 1:
+		word = R8(sample);
+		break;
+	case 2:
+		word = RL16(sample);
+		break;
+	case 4:
+		word = RL32(sample);
+		break;
+	case 8:
+		word = RL64(sample);
+		break;
+	default:
+		if (idx / 8 >= unitsize)
+			return FALSE;
+		return (sample[idx / 8] >> (idx % 8)) & 1;
+	}
+	if (idx >= 64)
+		return FALSE;
+
+	return (word >> idx) & 1;
+}
+
+static gboolean same_as_previous(const struct context *ctx,
+		const uint8_t *logic_sample, const float *analog_sample)
+{
+	unsigned int i;
+
+	for (i = 0; logic_sample && i < ctx->unitsize; i++) {
+		if ((logic_sample[i] ^ ctx->previous_logic[i]) & ctx->logic_mask[i])
+			return FALSE;
+	}
+
+	return !memcmp(analog_sample, ctx->previous_analog,
+		ctx->num_analog_channels * sizeof(float));
+}
+
+static void write_labels(struct context *ctx, GString *out)
+{
+	unsigned int i, num_channels;
+	const char *label;
+	gboolean first;
+
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+	first = TRUE;
+	if (ctx->time) {
+		g_string_append(out, ctx->label_names ? "Time" :
+			ctx->xlabel ? ctx->xlabel : xlabels[0]);
+		first = FALSE;
+	}
+	for (i = 0; i < num_channels; i++) {
+		if (!first)
+			g_string_append_len(out, ctx->value, ctx->value_len);
+		label = ctx->channels[i].label;
+		g_string_append(out, label ? label : ctx->channels[i].ch->name);
+		first = FALSE;
+	}
+	if (ctx->do_trigger) {
+		if (!first)
+			g_string_append_len(out, ctx->value, ctx->value_len);
+		g_string_append(out, "Trigger");
+	}
+	g_string_append_len(out, ctx->record, ctx->record_len);
+}
+
+static void dump_saved_values(struct context *ctx,
+		struct sr_output_sink *sink)
+{
+	unsigned int i, j, num_channels;
+	const uint8_t *logic_sample;
+	const float *analog_sample;
+	struct ctx_channel *channel;
+	float value;
+	GString *out;
+	char *p;
 
 	/* If we haven't seen samples we're expecting, skip them. */
-	if ((ctx->num_analog_channels && !ctx->analog_samples) ||
-	    (ctx->num_logic_channels && !ctx->logic_samples)) {
+	if ((ctx->num_analog_channels && !ctx->have_analog) ||
+	    (ctx->num_logic_channels && !ctx->have_logic)) {
 		sr_warn("Discarding partial packet");
-	} else {
-		sr_info("Dumping %u samples", ctx->num_samples);
-
-		*out = g_string_sized_new(512);
-		num_channels =
-		    ctx->num_logic_channels + ctx->num_analog_channels;
-
-		if (ctx->label_do) {
-			if (ctx->time)
-				g_string_append_printf(*out, "%s%s",
-					ctx->label_names ? "Time" :
-					ctx->xlabel, ctx->value);
-			for (i = 0; i < num_channels; i++) {
-				g_string_append_printf(*out, "%s%s",
-					ctx->channels[i].label, ctx->value);
-				if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG
-						&& ctx->label_names)
-					g_free(ctx->channels[i].label);
-			}
-			if (ctx->do_trigger)
-				g_string_append_printf(*out, "Trigger%s",
-						       ctx->value);
-			/* Drop last separator. */
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+		goto done;
+	}
 
-			ctx->label_do = FALSE;
+	sr_info("Dumping %u samples", ctx->num_samples);
+	out = sr_output_sink_text(sink);
+	num_channels = ctx->num_logic_channels + ctx->num_analog_channels;
+
+	if (ctx->label_do) {
+		write_labels(ctx, out);
+		ctx->label_do = FALSE;
+	}
+
+	logic_sample = NULL;
+	analog_sample = NULL;
+	for (i = 0; i < ctx->num_samples; i++) {
+		ctx->sample_time += ctx->period;
+		if (ctx->have_logic && ctx->num_logic_channels)
+			logic_sample = ctx->logic_data + i * ctx->unitsize;
+		if (ctx->num_analog_channels)
+			analog_sample = ctx->analog_samples
+				+ i * ctx->num_analog_channels;
+
+		if (ctx->dedup) {
+			if (i > 0 && i < ctx->num_samples - 1 &&
+			    same_as_previous(ctx, logic_sample, analog_sample))
+				continue;
+			if (logic_sample)
+				memcpy(ctx->previous_logic, logic_sample,
+				       ctx->unitsize);
+			if (analog_sample)
+				memcpy(ctx->previous_analog, analog_sample,
+				       ctx->num_analog_channels * sizeof(float));
 		}
 
-		analog_size = ctx->num_analog_channels * sizeof(float);
-		if (ctx->dedup && !ctx->previous_sample)
-			ctx->previous_sample = g_malloc0(analog_size + ctx->num_logic_channels);
-
-		for (i = 0; i < ctx->num_samples; i++) {
-			ctx->sample_time += ctx->period;
-			analog_sample =
-			    &ctx->analog_samples[i * ctx->num_analog_channels];
-			logic_sample =
-			    &ctx->logic_samples[i * ctx->num_logic_channels];
-
-			if (ctx->dedup) {
-				if (i > 0 && i < ctx->num_samples - 1 &&
-				    !memcmp(logic_sample, ctx->previous_sample,
-					    ctx->num_logic_channels) &&
-				    !memcmp(analog_sample,
-					    ctx->previous_sample +
-					    ctx->num_logic_channels,
-					    analog_size))
-					continue;
-				memcpy(ctx->previous_sample, logic_sample,
-				       ctx->num_logic_channels);
-				memcpy(ctx->previous_sample
-				       + ctx->num_logic_channels,
-				       analog_sample, analog_size);
-			}
+		p = ctx->row;
+		if (ctx->time) {
+			p = append_u64(p, ctx->sample_time);
+			memcpy(p, ctx->value, ctx->value_len);
+			p += ctx->value_len;
+		}
 
-			if (ctx->time)
-				g_string_append_printf(*out, "%" PRIu64 "%s",
-					ctx->sample_time, ctx->value);
-
-			for (j = 0; j < num_channels; j++) {
-				if (ctx->channels[j].ch->type == SR_CHANNEL_ANALOG) {
-					value = ctx->analog_samples[i * ctx->num_analog_channels + j];
-					ctx->channels[j].max =
-					    fmax(value, ctx->channels[j].max);
-					ctx->channels[j].min =
-					    fmin(value, ctx->channels[j].min);
-					g_string_append_printf(*out, "%g%s",
-						value, ctx->value);
-				} else if (ctx->channels[j].ch->type == SR_CHANNEL_LOGIC) {
-					g_string_append_printf(*out, "%c%s",
-							       ctx->logic_samples[i * ctx->num_logic_channels + j] ? '1' : '0', ctx->value);
-				} else {
-					sr_warn("Unexpected channel type: %d",
-						ctx->channels[i].ch->type);
+		for (j = 0; j < num_channels; j++) {
+			channel = &ctx->channels[j];
+			if (channel->ch->type == SR_CHANNEL_ANALOG) {
+				value = analog_sample[channel->pos];
+				if (*ctx->gnuplot) {
+					channel->max = fmax(value, channel->max);
+					channel->min = fmin(value, channel->min);
 				}
+				p = append_float(p, value);
+			} else if (channel->ch->type == SR_CHANNEL_LOGIC) {
+				*p++ = logic_bit(logic_sample, ctx->unitsize,
+					channel->pos) ? '1' : '0';
+			} else {
+				sr_warn("Unexpected channel type: %d",
+					channel->ch->type);
 			}
+			memcpy(p, ctx->value, ctx->value_len);
+			p += ctx->value_len;
+		}
 
-			if (ctx->do_trigger) {
-				g_string_append_printf(*out, "%d%s",
-					ctx->trigger, ctx->value);
-				ctx->trigger = FALSE;
-			}
-			g_string_truncate(*out, (*out)->len - 1);
-			g_string_append(*out, ctx->record);
+		if (ctx->do_trigger) {
+			*p++ = ctx->trigger ? '1' : '0';
+			memcpy(p, ctx->value, ctx->value_len);
+			p += ctx->value_len;
+			ctx->trigger = FALSE;
 		}
+
+		/* Drop last separator. */
+		if (p > ctx->row)
+			p -= ctx->value_len;
+		memcpy(p, ctx->record, ctx->record_len);
+		p += ctx->record_len;
+		g_string_append_len(out, ctx->row, p - ctx->row);
+		sr_output_sink_commit(sink);
 	}
 
-	/* Discard all of the working space. */
-	g_free(ctx->previous_sample);
-	g_free(ctx->analog_samples);
-	g_free(ctx->logic_samples);
-	ctx->channels_seen = 0;
+done:
+	/* The scratch space is kept for the next set of samples. */
+	ctx->have_analog = ctx->have_logic = FALSE;
+	ctx->analog_seen = 0;
 	ctx->num_samples = 0;
-	ctx->previous_sample = NULL;
-	ctx->analog_samples = NULL;
-	ctx->logic_samples = NULL;
+	ctx->logic_data = NULL;
 }
 
 static void save_gnuplot(struct context *ctx)
@@ -559,12 +811,12 @@ static void save_gnuplot(struct context *ctx)
 	g_string_free(script, TRUE);
 }
 
-static int receive(const struct sr_output *o,
-		   const struct sr_datafeed_packet *packet, GString **out)
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
 {
 	struct context *ctx;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	if (!(ctx = o->priv))
@@ -573,7 +825,7 @@ static int receive(const struct sr_output *o,
 	sr_dbg("Got packet of type %d", packet->type);
 	switch (packet->type) {
 	case SR_DF_HEADER:
-		*out = gen_header(o, packet->payload);
+		gen_header(o, packet->payload, sr_output_sink_text(sink));
 		break;
 	case SR_DF_TRIGGER:
 		ctx->trigger = TRUE;
@@ -585,20 +837,20 @@ static int receive(const struct sr_output *o,
 		process_analog(ctx, packet->payload);
 		break;
 	case SR_DF_FRAME_BEGIN:
-		*out = g_string_new(ctx->frame);
-		/* Fallthrough */
 	case SR_DF_END:
 		/* Got to end of frame/session with part of the data. */
-		if (ctx->channels_seen)
-			ctx->channels_seen = ctx->channel_count;
+		if (ctx->have_analog || ctx->have_logic)
+			dump_saved_values(ctx, sink);
+		if (packet->type == SR_DF_FRAME_BEGIN)
+			g_string_append(sr_output_sink_text(sink), ctx->frame);
 		if (*ctx->gnuplot)
 			save_gnuplot(ctx);
 		break;
 	}
 
 	/* If we've got them all, dump the values. */
-	if (ctx->channels_seen >= ctx->channel_count)
-		dump_saved_values(ctx, out);
+	if (have_all_channels(ctx))
+		dump_saved_values(ctx, sink);
 
 	return SR_OK;
 }
@@ -606,18 +858,31 @@ static int receive(const struct sr_output *o,
 static int cleanup(struct sr_output *o)
 {
 	struct context *ctx;
+	unsigned int i;
 
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 
 	if (o->priv) {
 		ctx = o->priv;
+		/* Unit labels were allocated, channel names were not. */
+		for (i = 0; !ctx->label_names && i < ctx->num_analog_channels
+				+ ctx->num_logic_channels; i++) {
+			if (ctx->channels[i].ch->type == SR_CHANNEL_ANALOG)
+				g_free(ctx->channels[i].label);
+		}
 		g_free((gpointer)ctx->record);
 		g_free((gpointer)ctx->frame);
 		g_free((gpointer)ctx->comment);
 		g_free((gpointer)ctx->gnuplot);
 		g_free((gpointer)ctx->value);
-		g_free(ctx->previous_sample);
+		g_free(ctx->analog_samples);
+		g_free(ctx->fdata);
+		g_free(ctx->logic_samples);
+		g_free(ctx->logic_mask);
+		g_free(ctx->previous_logic);
+		g_free(ctx->previous_analog);
+		g_free(ctx->row);
 		g_free(ctx->channels);
 		g_free(o->priv);
 		o->priv = NULL;
@@ -674,6 +939,6 @@ SR_PRIV struct sr_output_module output_csv = {
 	.flags = 0,
 	.options = get_options,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
@@ -18,7 +18,13 @@
  */
 
 #include <config.h>
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -49,6 +55,11 @@
  * Output modules generate a newly allocated GString. The caller is then
  * expected to free this with g_string_free() when finished with it.
  *
+ * Alternatively, sr_output_send_sink() writes the output to a file
+ * descriptor, a stdio stream or a callback. The built-in modules then
+ * generate their output into reused buffers, and hand logic data on
+ * without copying it where the format allows.
+ *
  * @{
  */
 
@@ -323,18 +334,571 @@ SR_API const struct sr_output *sr_output_new(const struct sr_output_module *omod
 	return op;
 }
 
+/* Amount of pending sink output which sr_output_sink_commit() flushes. */
+#define SINK_FLUSH_SIZE (64 * 1024)
+
+/* Number of buffers passed to a single writev() call. */
+#define SINK_IOV_MAX 64
+
+/** @cond PRIVATE */
+enum sink_type {
+	SINK_MEMORY,
+	SINK_FD,
+	SINK_FILE,
+	SINK_CALLBACK,
+};
+
+/*
+ * A piece of pending output: either 'len' bytes at 'data', which the
+ * module still owns, or 'len' bytes at 'offset' in the sink's buffer.
+ */
+struct sink_chunk {
+	const uint8_t *data;
+	size_t offset;
+	size_t len;
+};
+
+struct sr_output_sink {
+	enum sink_type type;
+	int fd;
+	FILE *file;
+	sr_output_sink_callback cb;
+	void *cb_data;
+	/* Text the modules generate, reused across flushes. */
+	GString *buf;
+	/* Start of the text in buf which has no chunk yet. */
+	size_t text_start;
+	GArray *chunks;
+	/* Pending bytes referenced from module owned memory. */
+	size_t ref_len;
+	/* First write error, reported until the sink is freed. */
+	int error;
+};
+/** @endcond */
+
+static void sink_init(struct sr_output_sink *sink, enum sink_type type)
+{
+	memset(sink, 0, sizeof(*sink));
+	sink->type = type;
+	sink->fd = -1;
+	sink->buf = g_string_sized_new(512);
+	sink->chunks = g_array_new(FALSE, FALSE, sizeof(struct sink_chunk));
+}
+
+static struct sr_output_sink *sink_new(enum sink_type type)
+{
+	struct sr_output_sink *sink;
+
+	sink = g_malloc(sizeof(*sink));
+	sink_init(sink, type);
+
+	return sink;
+}
+
+/* Turn the text appended since the last chunk into a chunk of its own. */
+static void sink_close_text(struct sr_output_sink *sink)
+{
+	struct sink_chunk chunk;
+
+	if (sink->buf->len == sink->text_start)
+		return;
+	chunk.data = NULL;
+	chunk.offset = sink->text_start;
+	chunk.len = sink->buf->len - sink->text_start;
+	g_array_append_val(sink->chunks, chunk);
+	sink->text_start = sink->buf->len;
+}
+
+static const uint8_t *chunk_data(const struct sr_output_sink *sink,
+		const struct sink_chunk *chunk)
+{
+	if (chunk->data)
+		return chunk->data;
+
+	return (const uint8_t *)sink->buf->str + chunk->offset;
+}
+
+#ifndef _WIN32
+static int sink_write_fd(struct sr_output_sink *sink)
+{
+	const struct sink_chunk *chunk;
+	struct iovec iov[SINK_IOV_MAX], *p;
+	ssize_t ret;
+	guint i;
+	int cnt, left;
+
+	for (i = 0; i < sink->chunks->len; i += cnt) {
+		cnt = MIN(sink->chunks->len - i, SINK_IOV_MAX);
+		for (left = 0; left < cnt; left++) {
+			chunk = &g_array_index(sink->chunks, struct sink_chunk,
+					i + left);
+			iov[left].iov_base = (void *)chunk_data(sink, chunk);
+			iov[left].iov_len = chunk->len;
+		}
+		p = iov;
+		while (left) {
+			ret = writev(sink->fd, p, left);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0)
+				return SR_ERR_IO;
+			/* Skip what was written, resume within a partial buffer. */
+			while (left && (size_t)ret >= p->iov_len) {
+				ret -= p->iov_len;
+				p++;
+				left--;
+			}
+			if (left) {
+				p->iov_base = (uint8_t *)p->iov_base + ret;
+				p->iov_len -= ret;
+			}
+		}
+	}
+
+	return SR_OK;
+}
+#else
+static int sink_write_fd(struct sr_output_sink *sink)
+{
+	const struct sink_chunk *chunk;
+	const uint8_t *data;
+	size_t len;
+	ssize_t ret;
+	guint i;
+
+	for (i = 0; i < sink->chunks->len; i++) {
+		chunk = &g_array_index(sink->chunks, struct sink_chunk, i);
+		data = chunk_data(sink, chunk);
+		len = chunk->len;
+		while (len) {
+			ret = write(sink->fd, data, len);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret < 0)
+				return SR_ERR_IO;
+			data += ret;
+			len -= ret;
+		}
+	}
+
+	return SR_OK;
+}
+#endif
+
+static int sink_write(struct sr_output_sink *sink)
+{
+	const struct sink_chunk *chunk;
+	guint i;
+	int ret;
+
+	if (sink->type == SINK_FD)
+		return sink_write_fd(sink);
+
+	for (i = 0; i < sink->chunks->len; i++) {
+		chunk = &g_array_index(sink->chunks, struct sink_chunk, i);
+		if (!chunk->len)
+			continue;
+		if (sink->type == SINK_FILE) {
+			if (fwrite(chunk_data(sink, chunk), 1, chunk->len,
+					sink->file) != chunk->len)
+				return SR_ERR_IO;
+		} else {
+			ret = sink->cb(chunk_data(sink, chunk), chunk->len,
+					sink->cb_data);
+			if (ret != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+/* Write out all pending output, and start over with an empty buffer. */
+static int sink_flush(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (sink->type == SINK_MEMORY)
+		return sink->error;
+
+	sink_close_text(sink);
+	if (!sink->error && (ret = sink_write(sink)) != SR_OK) {
+		if (ret == SR_ERR_IO)
+			sr_err("Failed to write output: %s.", g_strerror(errno));
+		sink->error = ret;
+	}
+	g_string_truncate(sink->buf, 0);
+	sink->text_start = 0;
+	g_array_set_size(sink->chunks, 0);
+	sink->ref_len = 0;
+
+	return sink->error;
+}
+
+static void sink_clear(struct sr_output_sink *sink)
+{
+	if (sink->buf)
+		g_string_free(sink->buf, TRUE);
+	g_array_free(sink->chunks, TRUE);
+}
+
+/**
+ * Create an output sink which writes to a file descriptor.
+ *
+ * The sink collects the output of one or more output instances and
+ * writes it with as few system calls as possible. The file descriptor
+ * is not closed when the sink is freed.
+ *
+ * @param fd The file descriptor to write to.
+ *
+ * @return A new sink, or NULL if fd is invalid. Free it with
+ *         sr_output_sink_free().
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_fd(int fd)
+{
+	struct sr_output_sink *sink;
+
+	if (fd < 0) {
+		sr_err("Invalid output file descriptor %d.", fd);
+		return NULL;
+	}
+	sink = sink_new(SINK_FD);
+	sink->fd = fd;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which writes to a stdio stream.
+ *
+ * The stream is not closed when the sink is freed.
+ *
+ * @param file The stream to write to. Must not be NULL.
+ *
+ * @return A new sink, or NULL if file is NULL. Free it with
+ *         sr_output_sink_free().
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_file(FILE *file)
+{
+	struct sr_output_sink *sink;
+
+	if (!file) {
+		sr_err("Invalid output stream NULL!");
+		return NULL;
+	}
+	sink = sink_new(SINK_FILE);
+	sink->file = file;
+
+	return sink;
+}
+
+/**
+ * Create an output sink which passes the output to a callback.
+ *
+ * The callback receives the output in pieces. The data is only valid
+ * during the call. A return value other than SR_OK stops the output,
+ * and is returned by the sink functions from then on.
+ *
+ * @param cb The callback. Must not be NULL.
+ * @param cb_data Opaque pointer passed to the callback.
+ *
+ * @return A new sink, or NULL if cb is NULL. Free it with
+ *         sr_output_sink_free().
+ *
+ * @since 0.6.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new_callback(
+		sr_output_sink_callback cb, void *cb_data)
+{
+	struct sr_output_sink *sink;
+
+	if (!cb) {
+		sr_err("Invalid output callback NULL!");
+		return NULL;
+	}
+	sink = sink_new(SINK_CALLBACK);
+	sink->cb = cb;
+	sink->cb_data = cb_data;
+
+	return sink;
+}
+
+/**
+ * Write out all output the sink holds.
+ *
+ * Sinks buffer output across packets, and are flushed automatically
+ * after SR_DF_END packets.
+ *
+ * @param sink The sink.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Writing failed, now or on an earlier flush.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!sink)
+		return SR_ERR_ARG;
+
+	ret = sink_flush(sink);
+	if (ret == SR_OK && sink->type == SINK_FILE && fflush(sink->file)) {
+		sr_err("Failed to write output: %s.", g_strerror(errno));
+		ret = sink->error = SR_ERR_IO;
+	}
+
+	return ret;
+}
+
+/**
+ * Flush and free an output sink.
+ *
+ * @param sink The sink.
+ *
+ * @return The result of the final flush, see sr_output_sink_flush().
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_sink_free(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!sink)
+		return SR_ERR_ARG;
+
+	ret = sr_output_sink_flush(sink);
+	sink_clear(sink);
+	g_free(sink);
+
+	return ret;
+}
+
+/**
+ * Get the buffer an output module appends its text output to.
+ *
+ * Modules must only append to the buffer. It is reused once the
+ * sink is flushed, so pointers into it don't stay valid.
+ *
+ * @private
+ */
+SR_PRIV GString *sr_output_sink_text(struct sr_output_sink *sink)
+{
+	return sink->buf;
+}
+
+/**
+ * Append a copy of some bytes to the output.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_sink_write(struct sr_output_sink *sink,
+		const void *data, size_t len)
+{
+	g_string_append_len(sink->buf, data, len);
+}
+
+/**
+ * Append some bytes to the output without copying them.
+ *
+ * The data must stay valid until the module's receive_sink() callback
+ * returns. This is meant for passing packet payloads on as they are.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_sink_write_ref(struct sr_output_sink *sink,
+		const void *data, size_t len)
+{
+	struct sink_chunk chunk;
+
+	/* Small pieces are cheaper to copy than to write separately. */
+	if (sink->type == SINK_MEMORY || len < 256) {
+		sr_output_sink_write(sink, data, len);
+		return;
+	}
+	sink_close_text(sink);
+	chunk.data = data;
+	chunk.offset = 0;
+	chunk.len = len;
+	g_array_append_val(sink->chunks, chunk);
+	sink->ref_len += len;
+}
+
+/**
+ * Flush the sink if it holds enough output.
+ *
+ * Modules which generate a lot of output from a single packet call
+ * this between rows, which keeps the buffer small.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_sink_commit(struct sr_output_sink *sink)
+{
+	if (sink->buf->len + sink->ref_len >= SINK_FLUSH_SIZE)
+		sink_flush(sink);
+}
+
+/*
+ * Pass a packet to a module, and put its output into the sink. Data
+ * the sink references must be written before the module regains control
+ * over it, i.e. before this returns.
+ */
+static int module_receive(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	GString *out;
+	int ret;
+
+	if (o->module->receive_sink) {
+		ret = o->module->receive_sink(o, packet, sink);
+		if (sink->ref_len)
+			sink_flush(sink);
+		return ret;
+	}
+
+	out = NULL;
+	ret = o->module->receive(o, packet, &out);
+	if (out) {
+		if (ret == SR_OK)
+			sr_output_sink_write_ref(sink, out->str, out->len);
+		if (sink->ref_len)
+			sink_flush(sink);
+		g_string_free(out, TRUE);
+	}
+
+	return ret;
+}
+
+/*
+ * Pass transition-encoded data to a module which only takes dense data,
+ * in pieces, and collect the output of all of them.
+ */
+static int send_expanded(const struct sr_output *o,
+		const struct sr_datafeed_logic_rle *rle,
+		struct sr_output_sink *sink)
+{
+	struct sr_logic_rle_iter iter;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t *buf;
+	uint64_t max_samples, n;
+	int ret;
+
+	if (rle->unitsize == 0)
+		return SR_ERR_ARG;
+	max_samples = MAX(LOGIC_RLE_EXPAND_SIZE / rle->unitsize, 1);
+	max_samples = MIN(max_samples, rle->num_samples);
+	if (!(buf = g_try_malloc(max_samples * rle->unitsize + 1)))
+		return SR_ERR_MALLOC;
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = rle->unitsize;
+	logic.data = buf;
+	sr_logic_rle_iter_init(&iter, rle);
+	ret = SR_OK;
+	while ((n = sr_logic_rle_iter_expand(&iter, max_samples, buf))) {
+		logic.length = n * rle->unitsize;
+		if ((ret = module_receive(o, &packet, sink)) != SR_OK)
+			break;
+	}
+	g_free(buf);
+
+	return ret;
+}
+
+static int send_packet(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	if (packet->type == SR_DF_LOGIC_RLE
+			&& !(o->module->flags & SR_OUTPUT_LOGIC_RLE))
+		return send_expanded(o, packet->payload, sink);
+
+	return module_receive(o, packet, sink);
+}
+
 /**
  * Send a packet to the specified output instance.
  *
  * The instance's output is returned as a newly allocated GString,
  * which must be freed by the caller.
  *
+ * SR_DF_LOGIC_RLE packets are expanded into SR_DF_LOGIC packets for
+ * modules without the SR_OUTPUT_LOGIC_RLE flag.
+ *
+ * @see sr_output_send_sink()
+ *
  * @since 0.4.0
  */
 SR_API int sr_output_send(const struct sr_output *o,
 		const struct sr_datafeed_packet *packet, GString **out)
 {
-	return o->module->receive(o, packet, out);
+	struct sr_output_sink sink;
+	int ret;
+
+	if (!o->module->receive_sink && (packet->type != SR_DF_LOGIC_RLE
+			|| (o->module->flags & SR_OUTPUT_LOGIC_RLE)))
+		return o->module->receive(o, packet, out);
+
+	*out = NULL;
+	sink_init(&sink, SINK_MEMORY);
+	ret = send_packet(o, packet, &sink);
+	if (ret == SR_OK && sink.buf->len) {
+		*out = sink.buf;
+		sink.buf = NULL;
+	}
+	sink_clear(&sink);
+
+	return ret;
+}
+
+/**
+ * Send a packet to the specified output instance, and write its output
+ * to a sink.
+ *
+ * Built-in modules generate their output right into the sink's buffers,
+ * and pass logic data on without copying it where the format allows.
+ * The same sink can take the output of several instances.
+ *
+ * SR_DF_LOGIC_RLE packets are expanded into SR_DF_LOGIC packets for
+ * modules without the SR_OUTPUT_LOGIC_RLE flag. The sink is flushed
+ * after SR_DF_END packets.
+ *
+ * @param o The output instance.
+ * @param packet The packet.
+ * @param sink The sink, see sr_output_sink_new_fd() and friends.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Writing the output failed.
+ * @retval other The module failed to handle the packet.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_output_send_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!o || !packet || !sink)
+		return SR_ERR_ARG;
+
+	ret = send_packet(o, packet, sink);
+	if (packet->type == SR_DF_END)
+		sr_output_sink_flush(sink);
+	if (ret != SR_OK)
+		return ret;
+
+	return sink->error;
 }
 
 /**
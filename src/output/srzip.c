@@ -22,27 +22,69 @@
 #include <string.h>
 #include <errno.h>
 #include <glib.h>
-#include <glib/gstdio.h>
-#include <zip.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
 #define LOG_PREFIX "output/srzip"
 
+/*
+ * Samples are collected into chunks of this size before they are added
+ * to the archive, which is kept open for the whole acquisition. The
+ * metadata is only written at the end, when it is complete.
+ */
+#define CHUNK_SIZE (4 * 1024 * 1024)
+
+/*
+ * Chunks are handed to the archive writer without copying, and its
+ * worker threads compress them while the next ones are collected.
+ */
+#define DEFAULT_LEVEL 6
+
+/*
+ * The overview of a stream is stored in chunks of its own per level,
+ * see overview.c.
+ */
+struct overview_stream {
+	struct sr_overview *ov;
+	unsigned int next_chunk_num[SR_OVERVIEW_LEVELS];
+};
+
+struct analog_chunk {
+	/* Floats, NULL until data is received. */
+	struct sr_buffer *buf;
+	size_t fill;
+	unsigned int next_chunk_num;
+	struct overview_stream overview;
+};
+
 struct out_context {
 	gboolean zip_created;
 	uint64_t samplerate;
 	char *filename;
 	gint first_analog_index;
 	gint *analog_index_map;
+	unsigned int level;
+	unsigned int num_threads;
+	gboolean overview;
+	struct sr_zip_writer *archive;
+	struct sr_buffer_pool *pool;
+	/* Highest backlog reported so far. */
+	unsigned int max_backlog;
+	gboolean stalled;
+	/* Logic data for the next chunk, NULL until data is received. */
+	struct sr_buffer *logic_buf;
+	size_t logic_fill;
+	int unitsize;
+	unsigned int next_chunk_num;
+	struct overview_stream logic_overview;
+	/* Analog data for the next chunks, in analog_index_map order. */
+	struct analog_chunk *analog;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
 {
 	struct out_context *outc;
 
-	(void)options;
-
 	if (!o->filename || o->filename[0] == '\0') {
 		sr_info("srzip output module requires a file name, cannot save.");
 		return SR_ERR_ARG;
@@ -50,16 +92,115 @@ static int init(struct sr_output *o, GHashTable *options)
 
 	outc = g_malloc0(sizeof(struct out_context));
 	outc->filename = g_strdup(o->filename);
+	outc->next_chunk_num = 1;
+	outc->level = g_variant_get_uint32(g_hash_table_lookup(options, "level"));
+	if (g_variant_get_boolean(g_hash_table_lookup(options, "store")))
+		outc->level = 0;
+	outc->num_threads = g_variant_get_uint32(
+			g_hash_table_lookup(options, "threads"));
+	outc->overview = g_variant_get_boolean(
+			g_hash_table_lookup(options, "overview"));
 	o->priv = outc;
 
+	if (outc->level > 9) {
+		sr_err("Invalid compression level %u.", outc->level);
+		g_free(outc->filename);
+		g_free(outc);
+		o->priv = NULL;
+		return SR_ERR_ARG;
+	}
+
 	return SR_OK;
 }
 
+static void overview_stream_init(struct overview_stream *os,
+		struct sr_overview *ov)
+{
+	unsigned int level;
+
+	os->ov = ov;
+	for (level = 0; level < SR_OVERVIEW_LEVELS; level++)
+		os->next_chunk_num[level] = 1;
+}
+
 static int zip_create(const struct sr_output *o)
 {
 	struct out_context *outc;
-	struct zip *zipfile;
-	struct zip_source *versrc, *metasrc;
+	struct sr_channel *ch;
+	GSList *l;
+	guint logic_channels = 0, enabled_logic_channels = 0;
+	guint enabled_analog_channels = 0;
+	guint index;
+	int ret;
+
+	outc = o->priv;
+
+	if (!(outc->archive = sr_zip_writer_new(outc->filename, outc->level,
+			outc->num_threads)))
+		return SR_ERR;
+	sr_dbg("Compressing at level %u with %u threads.", outc->level,
+			outc->num_threads);
+
+	/* Every pending chunk holds a buffer, keep enough for all of them. */
+	outc->pool = sr_buffer_pool_new(CHUNK_SIZE, 2 * outc->num_threads + 2);
+
+	/* "version" */
+	if ((ret = sr_zip_writer_add(outc->archive, "version", "2", 1)) != SR_OK) {
+		sr_err("Error saving version into zipfile.");
+		sr_zip_writer_close(outc->archive);
+		outc->archive = NULL;
+		return ret;
+	}
+
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+
+		switch (ch->type) {
+		case SR_CHANNEL_LOGIC:
+			if (ch->enabled)
+				enabled_logic_channels++;
+			logic_channels++;
+			break;
+		case SR_CHANNEL_ANALOG:
+			if (ch->enabled)
+				enabled_analog_channels++;
+			break;
+		}
+	}
+
+	/* When reading the file, the first index of the analog channels
+	 * can only be deduced through the "total probes" count, so the
+	 * first analog index must follow the last logic one, enabled or not. */
+	if (enabled_logic_channels > 0)
+		outc->first_analog_index = logic_channels + 1;
+	else
+		outc->first_analog_index = 1;
+
+	/* Make the array one entry larger than needed so we can use the final
+	 * entry as terminator, which is set to -1. */
+	outc->analog_index_map = g_malloc0(sizeof(gint) * (enabled_analog_channels + 1));
+	outc->analog_index_map[enabled_analog_channels] = -1;
+	outc->analog = g_malloc0(sizeof(struct analog_chunk) * enabled_analog_channels);
+
+	index = 0;
+	for (l = o->sdi->channels; l; l = l->next) {
+		ch = l->data;
+		if (ch->enabled && ch->type == SR_CHANNEL_ANALOG) {
+			outc->analog_index_map[index] = ch->index;
+			outc->analog[index].next_chunk_num = 1;
+			if (outc->overview)
+				overview_stream_init(&outc->analog[index].overview,
+						sr_overview_analog_new());
+			index++;
+		}
+	}
+
+	return SR_OK;
+}
+
+static int zip_add_metadata(const struct sr_output *o)
+{
+	struct out_context *outc;
 	struct sr_channel *ch;
 	GVariant *gvar;
 	GKeyFile *meta;
@@ -70,6 +211,8 @@ static int zip_create(const struct sr_output *o)
 	guint logic_channels = 0, enabled_logic_channels = 0;
 	guint enabled_analog_channels = 0;
 	guint index;
+	gint block_sizes[SR_OVERVIEW_LEVELS];
+	int ret;
 
 	outc = o->priv;
 
@@ -79,22 +222,6 @@ static int zip_create(const struct sr_output *o)
 		g_variant_unref(gvar);
 	}
 
-	/* Quietly delete it first, libzip wants replace ops otherwise. */
-	g_unlink(outc->filename);
-	zipfile = zip_open(outc->filename, ZIP_CREATE, NULL);
-	if (!zipfile)
-		return SR_ERR;
-
-	/* "version" */
-	versrc = zip_source_buffer(zipfile, "2", 1, FALSE);
-	if (zip_add(zipfile, "version", versrc) < 0) {
-		sr_err("Error saving version into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(versrc);
-		zip_discard(zipfile);
-		return SR_ERR;
-	}
-
 	/* init "metadata" */
 	meta = g_key_file_new();
 
@@ -119,14 +246,6 @@ static int zip_create(const struct sr_output *o)
 		}
 	}
 
-	/* When reading the file, the first index of the analog channels
-	 * can only be deduced through the "total probes" count, so the
-	 * first analog index must follow the last logic one, enabled or not. */
-	if (enabled_logic_channels > 0)
-		outc->first_analog_index = logic_channels + 1;
-	else
-		outc->first_analog_index = 1;
-
 	/* Only set capturefile and probes if we will actually save logic data. */
 	if (enabled_logic_channels > 0) {
 		g_key_file_set_string(meta, devgroup, "capturefile", "logic-1");
@@ -139,11 +258,6 @@ static int zip_create(const struct sr_output *o)
 
 	g_key_file_set_integer(meta, devgroup, "total analog", enabled_analog_channels);
 
-	/* Make the array one entry larger than needed so we can use the final
-	 * entry as terminator, which is set to -1. */
-	outc->analog_index_map = g_malloc0(sizeof(gint) * (enabled_analog_channels + 1));
-	outc->analog_index_map[enabled_analog_channels] = -1;
-
 	index = 0;
 	for (l = o->sdi->channels; l; l = l->next) {
 		ch = l->data;
@@ -156,7 +270,6 @@ static int zip_create(const struct sr_output *o)
 			s = g_strdup_printf("probe%d", ch->index + 1);
 			break;
 		case SR_CHANNEL_ANALOG:
-			outc->analog_index_map[index] = ch->index;
 			s = g_strdup_printf("analog%d", outc->first_analog_index + index);
 			index++;
 			break;
@@ -167,146 +280,204 @@ static int zip_create(const struct sr_output *o)
 		}
 	}
 
+	/* Only known once logic data was received. */
+	if (outc->unitsize)
+		g_key_file_set_integer(meta, devgroup, "unitsize", outc->unitsize);
+
+	if (outc->overview) {
+		block_sizes[0] = SR_OVERVIEW_BLOCK_SIZE;
+		for (index = 1; index < SR_OVERVIEW_LEVELS; index++)
+			block_sizes[index] = block_sizes[index - 1] * SR_OVERVIEW_FACTOR;
+		g_key_file_set_integer_list(meta, devgroup, "overview",
+				block_sizes, SR_OVERVIEW_LEVELS);
+	}
+
 	metabuf = g_key_file_to_data(meta, &metalen, NULL);
 	g_key_file_free(meta);
 
-	metasrc = zip_source_buffer(zipfile, metabuf, metalen, FALSE);
-	if (zip_add(zipfile, "metadata", metasrc) < 0) {
-		sr_err("Error saving metadata into zipfile: %s",
-			zip_strerror(zipfile));
-		zip_source_free(metasrc);
-		zip_discard(zipfile);
-		g_free(metabuf);
-		return SR_ERR;
+	if ((ret = sr_zip_writer_add(outc->archive, "metadata",
+			metabuf, metalen)) != SR_OK)
+		sr_err("Error saving metadata into zipfile.");
+	g_free(metabuf);
+
+	return ret;
+}
+
+static void report_backlog(struct out_context *outc)
+{
+	struct sr_zip_writer_stats stats;
+
+	sr_zip_writer_stats_get(outc->archive, &stats);
+	if (stats.max_backlog > outc->max_backlog) {
+		outc->max_backlog = stats.max_backlog;
+		sr_dbg("Compression backlog: %u chunks.", stats.max_backlog);
+	}
+	if (stats.stalls > 0 && !outc->stalled) {
+		outc->stalled = TRUE;
+		sr_warn("Compression can't keep up, holding up the acquisition.");
 	}
+}
 
-	if (zip_close(zipfile) < 0) {
-		sr_err("Error saving zipfile: %s", zip_strerror(zipfile));
-		zip_discard(zipfile);
-		g_free(metabuf);
-		return SR_ERR;
+/* Add a chunk to the archive. The writer takes its own reference to buf. */
+static int zip_add_chunk(struct out_context *outc, const char *basename,
+		unsigned int *next_chunk_num, struct sr_buffer *buf, size_t size)
+{
+	char *chunkname;
+	int ret;
+
+	chunkname = g_strdup_printf("%s-%u", basename, *next_chunk_num);
+	ret = sr_zip_writer_add_buffer(outc->archive, chunkname, buf, size);
+	if (ret != SR_OK)
+		sr_err("Failed to add chunk '%s'.", chunkname);
+	else
+		(*next_chunk_num)++;
+	g_free(chunkname);
+	report_backlog(outc);
+
+	return ret;
+}
+
+/*
+ * Add the overview records of each level to the archive, once they fill
+ * a chunk or when all of them are requested.
+ */
+static int flush_overview(struct out_context *outc, struct overview_stream *os,
+		const char *basename, gboolean all)
+{
+	struct sr_buffer *buf;
+	GByteArray *records;
+	unsigned int level;
+	size_t size;
+	char *name;
+	int ret;
+
+	if (!os->ov)
+		return SR_OK;
+
+	for (level = 0; level < SR_OVERVIEW_LEVELS; level++) {
+		records = sr_overview_take(os->ov, level, all ? 1 : CHUNK_SIZE);
+		if (!records)
+			continue;
+		size = records->len;
+		buf = sr_buffer_new_take(g_byte_array_free(records, FALSE),
+				size, g_free);
+		name = g_strdup_printf("%s-%u", basename, level);
+		ret = zip_add_chunk(outc, name, &os->next_chunk_num[level],
+				buf, size);
+		g_free(name);
+		sr_buffer_unref(buf);
+		if (ret != SR_OK)
+			return ret;
 	}
-	g_free(metabuf);
 
 	return SR_OK;
 }
 
+static int flush_analog_overview(struct out_context *outc, unsigned int index,
+		gboolean all)
+{
+	char *basename;
+	int ret;
+
+	basename = g_strdup_printf("overview-analog-1-%u",
+			index + outc->first_analog_index);
+	ret = flush_overview(outc, &outc->analog[index].overview, basename, all);
+	g_free(basename);
+
+	return ret;
+}
+
+static int flush_logic(struct out_context *outc)
+{
+	int ret;
+
+	if (outc->logic_fill == 0)
+		return SR_OK;
+
+	ret = zip_add_chunk(outc, "logic-1", &outc->next_chunk_num,
+			outc->logic_buf, outc->logic_fill);
+	sr_buffer_unref(outc->logic_buf);
+	outc->logic_buf = NULL;
+	outc->logic_fill = 0;
+
+	return ret;
+}
+
+static int flush_analog(struct out_context *outc, unsigned int index)
+{
+	struct analog_chunk *chunk;
+	char *basename;
+	int ret;
+
+	chunk = &outc->analog[index];
+	if (chunk->fill == 0)
+		return SR_OK;
+
+	basename = g_strdup_printf("analog-1-%u", index + outc->first_analog_index);
+	ret = zip_add_chunk(outc, basename, &chunk->next_chunk_num,
+			chunk->buf, chunk->fill * sizeof(float));
+	g_free(basename);
+	sr_buffer_unref(chunk->buf);
+	chunk->buf = NULL;
+	chunk->fill = 0;
+
+	return ret;
+}
+
 static int zip_append(const struct sr_output *o, unsigned char *buf,
 		int unitsize, int length)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *logicsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	struct zip_source *metasrc;
-	GKeyFile *kf;
-	GError *error;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *metabuf;
-	gsize metalen;
-	char *chunkname;
-	unsigned int next_chunk_num;
+	struct sr_buffer *chunkbuf;
+	int ret;
 
 	outc = o->priv;
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
+	if (!outc->archive) {
+		sr_err("Session file was already completed.");
 		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		zip_discard(archive);
-		return SR_ERR;
-	}
-	kf = sr_sessionfile_read_metadata(archive, &zs);
-	if (!kf) {
-		zip_discard(archive);
-		return SR_ERR_DATA;
 	}
-	/*
-	 * If the file was only initialized but doesn't yet have any
-	 * data it in, it won't have a unitsize field in metadata yet.
-	 */
-	error = NULL;
-	metabuf = NULL;
-	if (!g_key_file_has_key(kf, "device 1", "unitsize", &error)) {
-		if (error && error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND) {
-			sr_err("Failed to check unitsize key: %s", error->message);
-			g_error_free(error);
-			g_key_file_free(kf);
-			zip_discard(archive);
-			return SR_ERR;
-		}
-		g_clear_error(&error);
-
-		/* Add unitsize field. */
-		g_key_file_set_integer(kf, "device 1", "unitsize", unitsize);
-		metabuf = g_key_file_to_data(kf, &metalen, NULL);
-		metasrc = zip_source_buffer(archive, metabuf, metalen, FALSE);
-
-		if (zip_replace(archive, zs.index, metasrc) < 0) {
-			sr_err("Failed to replace metadata: %s",
-				zip_strerror(archive));
-			g_key_file_free(kf);
-			zip_source_free(metasrc);
-			zip_discard(archive);
-			g_free(metabuf);
-			return SR_ERR;
-		}
-	}
-	g_key_file_free(kf);
 
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, "logic-1", 7) != 0)
-			continue;
-		if (entry_name[7] == '\0') {
-			/*
-			 * This file has no extra chunks, just a single
-			 * "logic-1". Rename it to "logic-1-1" and continue
-			 * with chunk 2.
-			 */
-			if (zip_rename(archive, i, "logic-1-1") < 0) {
-				sr_err("Failed to rename 'logic-1' to 'logic-1-1': %s",
-					zip_strerror(archive));
-				zip_discard(archive);
-				g_free(metabuf);
-				return SR_ERR;
-			}
-			next_chunk_num = 2;
-			break;
-		} else if (entry_name[7] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + 8, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
-		}
+	if (!outc->unitsize) {
+		outc->unitsize = unitsize;
+	} else if (unitsize != outc->unitsize) {
+		sr_err("Unit size changed from %d to %d.", outc->unitsize, unitsize);
+		return SR_ERR_DATA;
 	}
-
 	if (length % unitsize != 0) {
 		sr_warn("Chunk size %d not a multiple of the"
 			" unit size %d.", length, unitsize);
 	}
-	logicsrc = zip_source_buffer(archive, buf, length, FALSE);
-	chunkname = g_strdup_printf("logic-1-%u", next_chunk_num);
-	i = zip_add(archive, chunkname, logicsrc);
-	g_free(chunkname);
-	if (i < 0) {
-		sr_err("Failed to add chunk 'logic-1-%u': %s",
-			next_chunk_num, zip_strerror(archive));
-		zip_source_free(logicsrc);
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
+
+	if (outc->overview) {
+		if (!outc->logic_overview.ov)
+			overview_stream_init(&outc->logic_overview,
+					sr_overview_logic_new(unitsize));
+		sr_overview_logic(outc->logic_overview.ov, buf, length / unitsize);
+		if ((ret = flush_overview(outc, &outc->logic_overview,
+				"overview-logic-1", FALSE)) != SR_OK)
+			return ret;
 	}
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		zip_discard(archive);
-		g_free(metabuf);
-		return SR_ERR;
+
+	if (outc->logic_fill + length > CHUNK_SIZE) {
+		if ((ret = flush_logic(outc)) != SR_OK)
+			return ret;
+	}
+
+	/* Packets too large to be buffered make a chunk of their own. */
+	if (length > CHUNK_SIZE) {
+		if (!(chunkbuf = sr_buffer_new(length)))
+			return SR_ERR_MALLOC;
+		memcpy(chunkbuf->data, buf, length);
+		ret = zip_add_chunk(outc, "logic-1", &outc->next_chunk_num,
+				chunkbuf, length);
+		sr_buffer_unref(chunkbuf);
+		return ret;
 	}
-	g_free(metabuf);
+
+	if (!outc->logic_buf && !(outc->logic_buf = sr_buffer_pool_get(outc->pool)))
+		return SR_ERR_MALLOC;
+	memcpy(outc->logic_buf->data + outc->logic_fill, buf, length);
+	outc->logic_fill += length;
 
 	return SR_OK;
 }
@@ -315,21 +486,18 @@ static int zip_append_analog(const struct sr_output *o,
 		const struct sr_datafeed_analog *analog)
 {
 	struct out_context *outc;
-	struct zip *archive;
-	struct zip_source *analogsrc;
-	int64_t i, num_files;
-	struct zip_stat zs;
-	uint64_t chunk_num;
-	const char *entry_name;
-	char *basename;
-	gsize baselen;
+	struct analog_chunk *chunk;
 	struct sr_channel *channel;
-	float *chunkbuf;
-	gsize chunksize;
-	char *chunkname;
-	unsigned int next_chunk_num, index;
+	struct sr_buffer *chunkbuf;
+	char *basename;
+	unsigned int index;
+	int ret;
 
 	outc = o->priv;
+	if (!outc->archive) {
+		sr_err("Session file was already completed.");
+		return SR_ERR;
+	}
 
 	/* TODO: support packets covering multiple channels */
 	if (g_slist_length(analog->meaning->channels) != 1) {
@@ -347,66 +515,94 @@ static int zip_append_analog(const struct sr_output *o,
 	if (outc->analog_index_map[index] == -1)
 		return SR_ERR_ARG; /* Channel index was not in the list */
 
-	index += outc->first_analog_index;
-
-	if (!(archive = zip_open(outc->filename, 0, NULL)))
-		return SR_ERR;
-
-	if (zip_stat(archive, "metadata", 0, &zs) < 0) {
-		sr_err("Failed to open metadata: %s", zip_strerror(archive));
-		goto err_zip_discard;
+	chunk = &outc->analog[index];
+	if ((chunk->fill + analog->num_samples) * sizeof(float) > CHUNK_SIZE) {
+		if ((ret = flush_analog(outc, index)) != SR_OK)
+			return ret;
 	}
 
-	basename = g_strdup_printf("analog-1-%u", index);
-	baselen = strlen(basename);
-	next_chunk_num = 1;
-	num_files = zip_get_num_entries(archive, 0);
-	for (i = 0; i < num_files; i++) {
-		entry_name = zip_get_name(archive, i, 0);
-		if (!entry_name || strncmp(entry_name, basename, baselen) != 0) {
-			continue;
-		} else if (entry_name[baselen] == '-') {
-			chunk_num = g_ascii_strtoull(entry_name + baselen + 1, NULL, 10);
-			if (chunk_num < G_MAXINT && chunk_num >= next_chunk_num)
-				next_chunk_num = chunk_num + 1;
+	/* Packets too large to be buffered make a chunk of their own. */
+	if (analog->num_samples * sizeof(float) > CHUNK_SIZE) {
+		if (!(chunkbuf = sr_buffer_new(sizeof(float) * analog->num_samples)))
+			return SR_ERR_MALLOC;
+		ret = sr_analog_to_float(analog, (float *)chunkbuf->data);
+		if (ret == SR_OK && chunk->overview.ov) {
+			sr_overview_analog(chunk->overview.ov,
+					(float *)chunkbuf->data, analog->num_samples);
+			ret = flush_analog_overview(outc, index, FALSE);
+		}
+		if (ret == SR_OK) {
+			basename = g_strdup_printf("analog-1-%u",
+					index + outc->first_analog_index);
+			ret = zip_add_chunk(outc, basename, &chunk->next_chunk_num,
+					chunkbuf, sizeof(float) * analog->num_samples);
+			g_free(basename);
 		}
+		sr_buffer_unref(chunkbuf);
+		return ret;
 	}
 
-	chunksize = sizeof(float) * analog->num_samples;
-	if (!(chunkbuf = g_try_malloc(chunksize)))
-		goto err_free_basename;
-
-	if (sr_analog_to_float(analog, chunkbuf) != SR_OK)
-		goto err_free_chunkbuf;
-
-	analogsrc = zip_source_buffer(archive, chunkbuf, chunksize, FALSE);
-	chunkname = g_strdup_printf("%s-%u", basename, next_chunk_num);
-	i = zip_add(archive, chunkname, analogsrc);
-	if (i < 0) {
-		sr_err("Failed to add chunk '%s': %s", chunkname, zip_strerror(archive));
-		g_free(chunkname);
-		zip_source_free(analogsrc);
-		goto err_free_chunkbuf;
-	}
-	g_free(chunkname);
-	if (zip_close(archive) < 0) {
-		sr_err("Error saving session file: %s", zip_strerror(archive));
-		goto err_free_chunkbuf;
+	if (!chunk->buf && !(chunk->buf = sr_buffer_pool_get(outc->pool)))
+		return SR_ERR_MALLOC;
+	ret = sr_analog_to_float(analog, (float *)chunk->buf->data + chunk->fill);
+	if (ret != SR_OK)
+		return ret;
+	if (chunk->overview.ov) {
+		sr_overview_analog(chunk->overview.ov,
+				(float *)chunk->buf->data + chunk->fill,
+				analog->num_samples);
+		if ((ret = flush_analog_overview(outc, index, FALSE)) != SR_OK)
+			return ret;
 	}
-
-	g_free(basename);
-	g_free(chunkbuf);
+	chunk->fill += analog->num_samples;
 
 	return SR_OK;
+}
 
-err_free_chunkbuf:
-	g_free(chunkbuf);
-err_free_basename:
-	g_free(basename);
-err_zip_discard:
-	zip_discard(archive);
+/* Write out all buffered data and the metadata, and close the archive. */
+static int zip_finish(const struct sr_output *o)
+{
+	struct out_context *outc;
+	struct sr_zip_writer_stats stats;
+	unsigned int index;
+	int ret, r;
 
-	return SR_ERR;
+	outc = o->priv;
+	if (!outc->archive)
+		return SR_OK;
+
+	ret = flush_logic(outc);
+	if (outc->logic_overview.ov) {
+		sr_overview_finish(outc->logic_overview.ov);
+		if ((r = flush_overview(outc, &outc->logic_overview,
+				"overview-logic-1", TRUE)) != SR_OK)
+			ret = r;
+	}
+	for (index = 0; outc->analog_index_map[index] != -1; index++) {
+		if ((r = flush_analog(outc, index)) != SR_OK)
+			ret = r;
+		if (outc->analog[index].overview.ov) {
+			sr_overview_finish(outc->analog[index].overview.ov);
+			if ((r = flush_analog_overview(outc, index, TRUE)) != SR_OK)
+				ret = r;
+		}
+	}
+	if ((r = zip_add_metadata(o)) != SR_OK)
+		ret = r;
+
+	sr_zip_writer_stats_get(outc->archive, &stats);
+	sr_dbg("Wrote %" PRIu64 " entries, %" PRIu64 " of %" PRIu64 " bytes "
+		"compressed, highest backlog %u, held up %u times for %" PRIu64
+		" ms.", stats.entries, stats.compressed_size, stats.size,
+		stats.max_backlog, stats.stalls, stats.stall_time / 1000);
+
+	if ((r = sr_zip_writer_close(outc->archive)) != SR_OK) {
+		sr_err("Error saving session file.");
+		ret = r;
+	}
+	outc->archive = NULL;
+
+	return ret;
 }
 
 static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
@@ -457,25 +653,52 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		if (ret != SR_OK)
 			return ret;
 		break;
+	case SR_DF_END:
+		return zip_finish(o);
 	}
 
 	return SR_OK;
 }
 
 static struct sr_option options[] = {
+	{"level", "Compression level", "Compression level from 1 (fastest) to 9 (best), 0 stores data uncompressed", NULL, NULL},
+	{"store", "Store only", "Store data uncompressed", NULL, NULL},
+	{"threads", "Compression threads", "Number of threads compressing data, 0 to compress in the acquisition thread", NULL, NULL},
+	{"overview", "Overview", "Store min/max summaries for fast zoomed-out views", NULL, NULL},
 	ALL_ZERO
 };
 
 static const struct sr_option *get_options(void)
 {
+	if (!options[0].def) {
+		options[0].def = g_variant_ref_sink(g_variant_new_uint32(DEFAULT_LEVEL));
+		options[1].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+		options[2].def = g_variant_ref_sink(
+				g_variant_new_uint32(g_get_num_processors()));
+		options[3].def = g_variant_ref_sink(g_variant_new_boolean(FALSE));
+	}
+
 	return options;
 }
 
 static int cleanup(struct sr_output *o)
 {
 	struct out_context *outc;
+	unsigned int i;
 
 	outc = o->priv;
+	/* The acquisition may have been cut short without an end packet. */
+	zip_finish(o);
+	if (outc->analog_index_map) {
+		for (i = 0; outc->analog_index_map[i] != -1; i++) {
+			sr_buffer_unref(outc->analog[i].buf);
+			sr_overview_free(outc->analog[i].overview.ov);
+		}
+	}
+	sr_overview_free(outc->logic_overview.ov);
+	g_free(outc->analog);
+	sr_buffer_unref(outc->logic_buf);
+	sr_buffer_pool_free(outc->pool);
 	g_free(outc->analog_index_map);
 	g_free(outc->filename);
 	g_free(outc);
@@ -27,14 +27,30 @@
 
 #define LOG_PREFIX "output/vcd"
 
+/* VCD identifiers are the 94 printable characters from '!' on. */
+#define MAX_CHANNELS 94
+/* Number of 64 bit words needed for the bits of all channels. */
+#define SAMPLE_WORDS ((MAX_CHANNELS + 63) / 64)
+/* Bytes written per sample at most: the timestamp and every channel. */
+#define MAX_LINE_SIZE (1 + 20 + 3 * MAX_CHANNELS + 1)
+
 struct context {
 	int num_enabled_channels;
-	uint8_t *prevsample;
 	gboolean header_done;
 	int period;
 	int *channel_index;
 	uint64_t samplerate;
 	uint64_t samplecount;
+	/* Channel bits of the previous sample, and of all enabled channels. */
+	uint64_t prev[SAMPLE_WORDS];
+	uint64_t mask[SAMPLE_WORDS];
+	/*
+	 * For unit sizes of 1, 2 and 4 bytes, the previous sample and the
+	 * mask repeated across a 64 bit word, to skip unchanged samples a
+	 * word at a time.
+	 */
+	uint64_t prev_rep;
+	uint64_t mask_rep;
 };
 
 static int init(struct sr_output *o, GHashTable *options)
@@ -55,8 +71,8 @@ static int init(struct sr_output *o, GHashTable *options)
 			continue;
 		num_enabled_channels++;
 	}
-	if (num_enabled_channels > 94) {
-		sr_err("VCD only supports 94 channels.");
+	if (num_enabled_channels > MAX_CHANNELS) {
+		sr_err("VCD only supports %d channels.", MAX_CHANNELS);
 		return SR_ERR;
 	}
 
@@ -75,29 +91,31 @@ static int init(struct sr_output *o, GHashTable *options)
 		ctx->channel_index[i++] = ch->index;
 	}
 
+	/* The data image packs the bits of the enabled channels. */
+	for (i = 0; i < num_enabled_channels; i++)
+		ctx->mask[i / 64] |= (uint64_t)1 << (i % 64);
+
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_output *o)
+static void gen_header(const struct sr_output *o, GString *header)
 {
 	struct context *ctx;
 	struct sr_channel *ch;
 	GVariant *gvar;
-	GString *header;
 	GSList *l;
 	time_t t;
 	int num_channels, i;
 	char *samplerate_s, *frequency_s, *timestamp;
 
 	ctx = o->priv;
-	header = g_string_sized_new(512);
 	num_channels = g_slist_length(o->sdi->channels);
 
 	/* timestamp */
 	t = time(NULL);
 	timestamp = g_strdup(ctime(&t));
 	timestamp[strlen(timestamp) - 1] = 0;
-	g_string_printf(header, "$date %s $end\n", timestamp);
+	g_string_append_printf(header, "$date %s $end\n", timestamp);
 	g_free(timestamp);
 
 	/* generator */
@@ -148,27 +166,212 @@ static GString *gen_header(const struct sr_output *o)
 	}
 
 	g_string_append(header, "$upscope $end\n$enddefinitions $end\n");
+}
+
+/* Start the output of a data packet, with the header before the first one. */
+static void begin_data(const struct sr_output *o, GString *out)
+{
+	struct context *ctx;
+
+	ctx = o->priv;
+	if (ctx->header_done)
+		return;
+
+	ctx->header_done = TRUE;
+	gen_header(o, out);
+}
+
+/*
+ * Convert a sample number to VCD time units. Integer math keeps this
+ * exact for any capture length, rounding half to even like the "%.0f"
+ * which was used before. Without a samplerate, the unit is one sample.
+ */
+static uint64_t timestamp(const struct context *ctx, uint64_t samplecount)
+{
+	uint64_t ts, frac, rem;
+
+	if (ctx->samplerate == 0)
+		return samplecount;
+
+	ts = samplecount / ctx->samplerate * ctx->period;
+	frac = samplecount % ctx->samplerate * ctx->period;
+	ts += frac / ctx->samplerate;
+	rem = frac % ctx->samplerate;
+	if (2 * rem > ctx->samplerate || (2 * rem == ctx->samplerate && (ts & 1)))
+		ts++;
+
+	return ts;
+}
+
+/* Write "#<timestamp>" to p, return the end. */
+static char *write_timestamp(char *p, uint64_t ts)
+{
+	char digits[20];
+	int n;
+
+	n = 0;
+	do {
+		digits[n++] = '0' + ts % 10;
+		ts /= 10;
+	} while (ts);
+
+	*p++ = '#';
+	while (n)
+		*p++ = digits[--n];
 
-	return header;
+	return p;
 }
 
-static int receive(const struct sr_output *o, const struct sr_datafeed_packet *packet,
-		GString **out)
+/* Make room for size more bytes, return where they go. */
+static char *reserve(GString *out, size_t size)
+{
+	size_t len;
+
+	len = out->len;
+	if (len + size >= out->allocated_len) {
+		g_string_set_size(out, MAX(2 * len, len + size));
+		g_string_truncate(out, len);
+	}
+
+	return out->str + len;
+}
+
+static inline unsigned int lowest_bit(uint64_t x)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(x);
+#else
+	unsigned int n;
+
+	for (n = 0; !(x & 1); n++)
+		x >>= 1;
+
+	return n;
+#endif
+}
+
+/* Load the channel bits of a sample, bit n is channel n. */
+static void load_sample(uint64_t *bits, const uint8_t *sample,
+		unsigned int unitsize)
+{
+	uint64_t word;
+	unsigned int i, n;
+
+	for (i = 0; i < SAMPLE_WORDS; i++) {
+		word = 0;
+		if (unitsize > 8 * i) {
+			n = MIN(unitsize - 8 * i, 8);
+			memcpy(&word, sample + 8 * i, n);
+		}
+		bits[i] = GUINT64_FROM_LE(word);
+	}
+}
+
+static void set_prev(struct context *ctx, const uint64_t *bits,
+		unsigned int unitsize)
+{
+	static const uint64_t spread[] = {
+		0, 0x0101010101010101ULL, 0x0001000100010001ULL,
+		0, 0x0000000100000001ULL,
+	};
+
+	memcpy(ctx->prev, bits, sizeof(ctx->prev));
+	if (unitsize <= 4 && spread[unitsize]) {
+		ctx->prev_rep = (bits[0] & ctx->mask[0]) * spread[unitsize];
+		ctx->mask_rep = ctx->mask[0] * spread[unitsize];
+	}
+}
+
+/*
+ * Write the channels which differ from the previous sample, or all of
+ * them for the first sample of the stream.
+ */
+static void write_changes(struct context *ctx, struct sr_output_sink *sink,
+		const uint64_t *bits, unsigned int unitsize)
+{
+	uint64_t changed[SAMPLE_WORDS], any, x;
+	unsigned int i, ch;
+	GString *out;
+	char *p, *start;
+
+	any = 0;
+	for (i = 0; i < SAMPLE_WORDS; i++) {
+		changed[i] = ctx->mask[i];
+		if (ctx->samplecount > 0)
+			changed[i] &= bits[i] ^ ctx->prev[i];
+		any |= changed[i];
+	}
+	if (!any)
+		return;
+
+	out = sr_output_sink_text(sink);
+	p = start = reserve(out, MAX_LINE_SIZE);
+	p = write_timestamp(p, timestamp(ctx, ctx->samplecount));
+	for (i = 0; i < SAMPLE_WORDS; i++) {
+		for (x = changed[i]; x; x &= x - 1) {
+			ch = lowest_bit(x);
+			*p++ = ' ';
+			*p++ = '0' + ((bits[i] >> ch) & 1);
+			*p++ = '!' + 64 * i + ch;
+		}
+	}
+	*p++ = '\n';
+	*p = '\0';
+	out->len += p - start;
+	sr_output_sink_commit(sink);
+
+	set_prev(ctx, bits, unitsize);
+}
+
+static void write_logic(struct context *ctx, struct sr_output_sink *sink,
+		const uint8_t *data, uint64_t num_samples, unsigned int unitsize)
+{
+	uint64_t bits[SAMPLE_WORDS], i, per_word, word;
+
+	if (unitsize == 0)
+		return;
+	per_word = (unitsize <= 4 && 4 % unitsize == 0) ? 8 / unitsize : 0;
+
+	for (i = 0; i < num_samples; ) {
+		/* Skip whole words of samples which repeat the previous one. */
+		if (per_word && ctx->samplecount > 0) {
+			while (i + per_word <= num_samples) {
+				memcpy(&word, data + i * unitsize, sizeof(word));
+				word = GUINT64_FROM_LE(word);
+				if ((word ^ ctx->prev_rep) & ctx->mask_rep)
+					break;
+				i += per_word;
+				ctx->samplecount += per_word;
+			}
+			if (i == num_samples)
+				break;
+		}
+		load_sample(bits, data + i * unitsize, unitsize);
+		write_changes(ctx, sink, bits, unitsize);
+		ctx->samplecount++;
+		i++;
+	}
+}
+
+static int receive_sink(const struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
 {
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *logic_rle;
 	const struct sr_config *src;
 	GSList *l;
 	struct context *ctx;
-	unsigned int i;
-	int p, curbit, prevbit, index;
-	uint8_t *sample;
-	gboolean timestamp_written;
+	uint64_t bits[SAMPLE_WORDS], i;
+	const uint8_t *values;
+	GString *out;
+	char *p, *start;
 
-	*out = NULL;
 	if (!o || !o->priv)
 		return SR_ERR_BUG;
 	ctx = o->priv;
+	out = sr_output_sink_text(sink);
 
 	switch (packet->type) {
 	case SR_DF_META:
@@ -182,70 +385,31 @@ static int receive(const struct sr_output *o, const struct sr_datafeed_packet *p
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-
-		if (!ctx->header_done) {
-			*out = gen_header(o);
-			ctx->header_done = TRUE;
-		} else {
-			*out = g_string_sized_new(512);
-		}
-
-		if (!ctx->prevsample) {
-			/* Can't allocate this until we know the stream's unitsize. */
-			ctx->prevsample = g_malloc0(logic->unitsize);
-		}
-
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			sample = logic->data + i;
-			timestamp_written = FALSE;
-
-			for (p = 0; p < ctx->num_enabled_channels; p++) {
-				/*
-				 * TODO Check whether the mapping from
-				 * data image positions to channel numbers
-				 * is required. Experiments suggest that
-				 * the data image "is dense", and packs
-				 * bits of enabled channels, and leaves no
-				 * room for positions of disabled channels.
-				 */
-				/* index = ctx->channel_index[p]; */
-				index = p;
-
-				curbit = ((unsigned)sample[index / 8]
-						>> (index % 8)) & 1;
-				prevbit = ((unsigned)ctx->prevsample[index / 8]
-						>> (index % 8)) & 1;
-
-				/* VCD only contains deltas/changes of signals. */
-				if (prevbit == curbit && ctx->samplecount > 0)
-					continue;
-
-				/* Output timestamp of subsequent signal changes. */
-				if (!timestamp_written)
-					g_string_append_printf(*out, "#%.0f",
-						(double)ctx->samplecount /
-							ctx->samplerate * ctx->period);
-
-				/* Output which signal changed to which value. */
-				g_string_append_c(*out, ' ');
-				g_string_append_c(*out, '0' + curbit);
-				g_string_append_c(*out, '!' + p);
-
-				timestamp_written = TRUE;
-			}
-
-			if (timestamp_written)
-				g_string_append_c(*out, '\n');
-
-			ctx->samplecount++;
-			memcpy(ctx->prevsample, sample, logic->unitsize);
+		begin_data(o, out);
+		if (logic->unitsize)
+			write_logic(ctx, sink, logic->data,
+					logic->length / logic->unitsize,
+					logic->unitsize);
+		break;
+	case SR_DF_LOGIC_RLE:
+		/* Only the first sample of each run can hold a change. */
+		logic_rle = packet->payload;
+		begin_data(o, out);
+		values = logic_rle->values;
+		for (i = 0; i < logic_rle->num_runs; i++) {
+			load_sample(bits, values + i * logic_rle->unitsize,
+					logic_rle->unitsize);
+			write_changes(ctx, sink, bits, logic_rle->unitsize);
+			ctx->samplecount += logic_rle->lengths[i];
 		}
 		break;
 	case SR_DF_END:
 		/* Write final timestamp as length indicator. */
-		*out = g_string_sized_new(512);
-		g_string_printf(*out, "#%.0f\n",
-				(double)ctx->samplecount / ctx->samplerate * ctx->period);
+		p = start = reserve(out, MAX_LINE_SIZE);
+		p = write_timestamp(p, timestamp(ctx, ctx->samplecount));
+		*p++ = '\n';
+		*p = '\0';
+		out->len += p - start;
 		break;
 	}
 
@@ -260,7 +424,6 @@ static int cleanup(struct sr_output *o)
 		return SR_ERR_ARG;
 
 	ctx = o->priv;
-	g_free(ctx->prevsample);
 	g_free(ctx->channel_index);
 	g_free(ctx);
 
@@ -272,9 +435,9 @@ struct sr_output_module output_vcd = {
 	.name = "VCD",
 	.desc = "Value Change Dump data",
 	.exts = (const char*[]){"vcd", NULL},
-	.flags = 0,
+	.flags = SR_OUTPUT_LOGIC_RLE,
 	.options = NULL,
 	.init = init,
-	.receive = receive,
+	.receive_sink = receive_sink,
 	.cleanup = cleanup,
 };
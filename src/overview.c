@@ -0,0 +1,336 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "overview"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Multi-resolution summaries of sample data.
+ *
+ * An overview has SR_OVERVIEW_LEVELS levels. Level 0 has one record per
+ * SR_OVERVIEW_BLOCK_SIZE samples, each further level one record per
+ * SR_OVERVIEW_FACTOR records of the level below. The last record of a
+ * level may cover fewer samples.
+ *
+ * For logic data a record is two samples: the AND and the OR of all
+ * samples in the block. A channel whose bit differs between the two
+ * changes its level within the block, otherwise it is constant at that
+ * level. For analog data a record is the minimum and maximum sample
+ * value of the block, as two floats.
+ *
+ * Samples are summarized as they are added, completed records collect
+ * per level until they are taken with sr_overview_take().
+ */
+
+/** @private */
+struct sr_overview {
+	gboolean is_logic;
+	size_t unitsize;
+	size_t record_size;
+	/* Per level: the record being built and the number of samples or
+	 * records of the level below in it. */
+	uint8_t *acc[SR_OVERVIEW_LEVELS];
+	unsigned int fill[SR_OVERVIEW_LEVELS];
+	/* Per level: completed records. */
+	GByteArray *records[SR_OVERVIEW_LEVELS];
+};
+
+static struct sr_overview *overview_new(gboolean is_logic, size_t unitsize)
+{
+	struct sr_overview *ov;
+	unsigned int i;
+
+	ov = g_malloc0(sizeof(*ov));
+	ov->is_logic = is_logic;
+	ov->unitsize = unitsize;
+	ov->record_size = 2 * unitsize;
+	for (i = 0; i < SR_OVERVIEW_LEVELS; i++) {
+		ov->acc[i] = g_malloc(ov->record_size);
+		ov->records[i] = g_byte_array_new();
+	}
+
+	return ov;
+}
+
+/**
+ * Create an overview of logic data.
+ *
+ * @param unitsize The size of a sample in bytes.
+ *
+ * @return The new overview.
+ *
+ * @private
+ */
+SR_PRIV struct sr_overview *sr_overview_logic_new(unsigned int unitsize)
+{
+	return overview_new(TRUE, unitsize);
+}
+
+/**
+ * Create an overview of analog data of one channel.
+ *
+ * @return The new overview.
+ *
+ * @private
+ */
+SR_PRIV struct sr_overview *sr_overview_analog_new(void)
+{
+	return overview_new(FALSE, sizeof(float));
+}
+
+/* Merge a record into the record being built for a level. */
+static void merge_record(const struct sr_overview *ov, uint8_t *acc,
+		const uint8_t *rec)
+{
+	const uint8_t *and, *or;
+	float min, max, rmin, rmax;
+	size_t i;
+
+	if (ov->is_logic) {
+		and = rec;
+		or = rec + ov->unitsize;
+		for (i = 0; i < ov->unitsize; i++) {
+			acc[i] &= and[i];
+			acc[ov->unitsize + i] |= or[i];
+		}
+	} else {
+		memcpy(&min, acc, sizeof(float));
+		memcpy(&max, acc + sizeof(float), sizeof(float));
+		memcpy(&rmin, rec, sizeof(float));
+		memcpy(&rmax, rec + sizeof(float), sizeof(float));
+		min = MIN(min, rmin);
+		max = MAX(max, rmax);
+		memcpy(acc, &min, sizeof(float));
+		memcpy(acc + sizeof(float), &max, sizeof(float));
+	}
+}
+
+/* Add a completed record to a level and pass it on to the next one. */
+static void add_record(struct sr_overview *ov, unsigned int level,
+		const uint8_t *rec)
+{
+	g_byte_array_append(ov->records[level], rec, ov->record_size);
+
+	if (++level == SR_OVERVIEW_LEVELS)
+		return;
+	if (ov->fill[level] == 0)
+		memcpy(ov->acc[level], rec, ov->record_size);
+	else
+		merge_record(ov, ov->acc[level], rec);
+	if (++ov->fill[level] == SR_OVERVIEW_FACTOR) {
+		ov->fill[level] = 0;
+		add_record(ov, level, ov->acc[level]);
+	}
+}
+
+/*
+ * Summarize logic samples into a record. With unit sizes dividing eight,
+ * whole 64-bit words are folded and reduced to one sample at the end.
+ */
+static void logic_summary(const struct sr_overview *ov, const uint8_t *data,
+		size_t num_samples, uint8_t *rec)
+{
+	uint64_t w, and, or;
+	size_t len, i, j;
+
+	len = num_samples * ov->unitsize;
+	i = 0;
+	memset(rec, 0xff, ov->unitsize);
+	memset(rec + ov->unitsize, 0x00, ov->unitsize);
+
+	if (8 % ov->unitsize == 0 && len >= 8) {
+		and = ~(uint64_t)0;
+		or = 0;
+		for (; i + 8 <= len; i += 8) {
+			memcpy(&w, data + i, sizeof(w));
+			and &= w;
+			or |= w;
+		}
+		for (j = 0; j < 8; j++) {
+			rec[j % ov->unitsize] &= ((uint8_t *)&and)[j];
+			rec[ov->unitsize + j % ov->unitsize] |= ((uint8_t *)&or)[j];
+		}
+	}
+	for (; i < len; i++) {
+		rec[i % ov->unitsize] &= data[i];
+		rec[ov->unitsize + i % ov->unitsize] |= data[i];
+	}
+}
+
+static void analog_summary(const float *data, size_t num_samples,
+		uint8_t *rec)
+{
+	float min, max;
+	size_t i;
+
+	min = max = data[0];
+	for (i = 1; i < num_samples; i++) {
+		min = data[i] < min ? data[i] : min;
+		max = data[i] > max ? data[i] : max;
+	}
+	memcpy(rec, &min, sizeof(float));
+	memcpy(rec + sizeof(float), &max, sizeof(float));
+}
+
+static void summarize(struct sr_overview *ov, const uint8_t *data,
+		size_t num_samples, uint8_t *rec)
+{
+	if (ov->is_logic)
+		logic_summary(ov, data, num_samples, rec);
+	else
+		analog_summary((const float *)data, num_samples, rec);
+}
+
+static void overview_add(struct sr_overview *ov, const uint8_t *data,
+		size_t num_samples)
+{
+	uint8_t rec[2 * sizeof(uint64_t) * 64];
+	uint8_t *tmp;
+	size_t n;
+
+	/* Records of very wide logic samples don't fit on the stack. */
+	tmp = ov->record_size <= sizeof(rec) ? rec : g_malloc(ov->record_size);
+
+	while (num_samples > 0) {
+		n = MIN(num_samples, SR_OVERVIEW_BLOCK_SIZE - ov->fill[0]);
+		summarize(ov, data, n, tmp);
+		if (ov->fill[0] == 0)
+			memcpy(ov->acc[0], tmp, ov->record_size);
+		else
+			merge_record(ov, ov->acc[0], tmp);
+		ov->fill[0] += n;
+		if (ov->fill[0] == SR_OVERVIEW_BLOCK_SIZE) {
+			ov->fill[0] = 0;
+			add_record(ov, 0, ov->acc[0]);
+		}
+		data += n * ov->unitsize;
+		num_samples -= n;
+	}
+
+	if (tmp != rec)
+		g_free(tmp);
+}
+
+/**
+ * Add logic samples to an overview.
+ *
+ * @param ov The overview. Must not be NULL.
+ * @param data The samples.
+ * @param num_samples The number of samples in @a data.
+ *
+ * @private
+ */
+SR_PRIV void sr_overview_logic(struct sr_overview *ov, const uint8_t *data,
+		size_t num_samples)
+{
+	overview_add(ov, data, num_samples);
+}
+
+/**
+ * Add analog samples to an overview.
+ *
+ * @param ov The overview. Must not be NULL.
+ * @param data The samples.
+ * @param num_samples The number of samples in @a data.
+ *
+ * @private
+ */
+SR_PRIV void sr_overview_analog(struct sr_overview *ov, const float *data,
+		size_t num_samples)
+{
+	overview_add(ov, (const uint8_t *)data, num_samples);
+}
+
+/**
+ * Complete the partial records at the end of the data.
+ *
+ * No samples may be added afterwards.
+ *
+ * @param ov The overview. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_overview_finish(struct sr_overview *ov)
+{
+	unsigned int level;
+
+	for (level = 0; level < SR_OVERVIEW_LEVELS; level++) {
+		if (ov->fill[level] > 0) {
+			ov->fill[level] = 0;
+			add_record(ov, level, ov->acc[level]);
+		}
+	}
+}
+
+/**
+ * Take the completed records of a level.
+ *
+ * @param ov The overview. Must not be NULL.
+ * @param level The level.
+ * @param min_size Only take the records if there are at least this many
+ *                 bytes of them.
+ *
+ * @return The records, which the caller must free, or NULL if there are
+ *         not enough of them.
+ *
+ * @private
+ */
+SR_PRIV GByteArray *sr_overview_take(struct sr_overview *ov,
+		unsigned int level, size_t min_size)
+{
+	GByteArray *records;
+
+	records = ov->records[level];
+	if (records->len == 0 || records->len < min_size)
+		return NULL;
+	ov->records[level] = g_byte_array_new();
+
+	return records;
+}
+
+/**
+ * Free an overview.
+ *
+ * @param ov The overview. NULL is ignored.
+ *
+ * @private
+ */
+SR_PRIV void sr_overview_free(struct sr_overview *ov)
+{
+	unsigned int i;
+
+	if (!ov)
+		return;
+
+	for (i = 0; i < SR_OVERVIEW_LEVELS; i++) {
+		g_free(ov->acc[i]);
+		g_byte_array_free(ov->records[i], TRUE);
+	}
+	g_free(ov);
+}
@@ -96,6 +96,8 @@ struct sr_scpi_dev_inst {
 	int (*close)(struct sr_scpi_dev_inst *scpi);
 	void (*free)(void *priv);
 	unsigned int read_timeout_us;
+	/** Bounds connecting and each read while probing, or 0. */
+	unsigned int probe_timeout_us;
 	void *priv;
 	/* Only used for quirk workarounds, notably the Rigol DS1000 series. */
 	uint64_t firmware_version;
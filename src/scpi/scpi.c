@@ -28,6 +28,7 @@
 #define LOG_PREFIX "scpi"
 
 #define SCPI_READ_RETRIES 100
+#define SCPI_READ_TIMEOUT_US (1000 * 1000)
 #define SCPI_READ_RETRY_TIMEOUT_US (10 * 1000)
 
 static const char *scpi_vendors[][2] = {
@@ -108,26 +109,49 @@ static struct sr_dev_inst *sr_scpi_scan_resource(struct drv_context *drvc,
 		const char *resource, const char *serialcomm,
 		struct sr_dev_inst *(*probe_device)(struct sr_scpi_dev_inst *scpi))
 {
+	struct sr_context *ctx;
 	struct sr_scpi_dev_inst *scpi;
 	struct sr_dev_inst *sdi;
+	unsigned int timeout_us;
 
-	if (!(scpi = scpi_dev_inst_new(drvc, resource, serialcomm)))
+	/* Skip resources without a device, and wait for other probes. */
+	ctx = drvc->sr_ctx;
+	if (!sr_scan_resource_begin(ctx, (const void *)probe_device, resource))
 		return NULL;
 
+	sdi = NULL;
+	if (!(scpi = scpi_dev_inst_new(drvc, resource, serialcomm)))
+		goto done;
+
+	timeout_us = ctx->scan_timeout_ms * 1000;
+	if (timeout_us) {
+		scpi->read_timeout_us = timeout_us;
+		scpi->probe_timeout_us = timeout_us;
+	}
+
 	if (sr_scpi_open(scpi) != SR_OK) {
 		sr_info("Couldn't open SCPI device.");
 		sr_scpi_free(scpi);
-		return NULL;
+		goto done;
 	};
 
 	sdi = probe_device(scpi);
 
 	sr_scpi_close(scpi);
+	scpi->probe_timeout_us = 0;
 
-	if (sdi)
+	if (sdi) {
 		sdi->status = SR_ST_INACTIVE;
-	else
+		/* The scan timeout only applies to probing. */
+		if (timeout_us && scpi->read_timeout_us == timeout_us)
+			scpi->read_timeout_us = SCPI_READ_TIMEOUT_US;
+	} else {
 		sr_scpi_free(scpi);
+	}
+
+done:
+	sr_scan_resource_end(ctx, (const void *)probe_device, resource,
+		sdi != NULL);
 
 	return sdi;
 }
@@ -309,14 +333,40 @@ static int scpi_get_data(struct sr_scpi_dev_inst *scpi,
 	return SR_OK;
 }
 
+struct scpi_scan_job {
+	struct drv_context *drvc;
+	const char *connection_id;
+	const char *serialcomm;
+	struct sr_dev_inst *(*probe_device)(struct sr_scpi_dev_inst *scpi);
+	struct sr_dev_inst *sdi;
+};
+
+static void scpi_scan_job_run(gpointer data, gpointer user_data)
+{
+	struct scpi_scan_job *job;
+	gchar **res;
+
+	job = data;
+	(void)user_data;
+
+	res = g_strsplit(job->connection_id, ":", 2);
+	if (res[0])
+		job->sdi = sr_scpi_scan_resource(job->drvc, res[0],
+			job->serialcomm ? job->serialcomm : res[1],
+			job->probe_device);
+	g_strfreev(res);
+}
+
 SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
 		struct sr_dev_inst *(*probe_device)(struct sr_scpi_dev_inst *scpi))
 {
 	GSList *resources, *l, *devices;
 	struct sr_dev_inst *sdi;
+	struct scpi_scan_job *jobs;
+	GThreadPool *pool;
 	const char *resource = NULL;
 	const char *serialcomm = NULL;
-	gchar **res;
+	unsigned int num_jobs, threads;
 	unsigned i;
 
 	for (l = options; l; l = l->next) {
@@ -331,23 +381,47 @@ SR_PRIV GSList *sr_scpi_scan(struct drv_context *drvc, GSList *options,
 		}
 	}
 
-	devices = NULL;
+	resources = NULL;
 	for (i = 0; i < ARRAY_SIZE(scpi_devs); i++) {
 		if ((resource && strcmp(resource, scpi_devs[i]->prefix))
 		    || !scpi_devs[i]->scan)
 			continue;
-		resources = scpi_devs[i]->scan(drvc);
-		for (l = resources; l; l = l->next) {
-			res = g_strsplit(l->data, ":", 2);
-			if (res[0] && (sdi = sr_scpi_scan_resource(drvc, res[0],
-			               serialcomm ? serialcomm : res[1], probe_device))) {
-				devices = g_slist_append(devices, sdi);
-				sdi->connection_id = g_strdup(l->data);
-			}
-			g_strfreev(res);
-		}
-		g_slist_free_full(resources, g_free);
+		resources = g_slist_concat(resources, scpi_devs[i]->scan(drvc));
+	}
+
+	num_jobs = g_slist_length(resources);
+	jobs = g_new0(struct scpi_scan_job, num_jobs);
+	for (l = resources, i = 0; l; l = l->next, i++) {
+		jobs[i].drvc = drvc;
+		jobs[i].connection_id = l->data;
+		jobs[i].serialcomm = serialcomm;
+		jobs[i].probe_device = probe_device;
+	}
+
+	/* Probe concurrently if allowed, resources may take a while to time out. */
+	threads = MIN(drvc->sr_ctx->scan_threads, num_jobs);
+	pool = NULL;
+	if (threads > 1)
+		pool = g_thread_pool_new(scpi_scan_job_run, NULL, threads,
+				FALSE, NULL);
+	for (i = 0; i < num_jobs; i++) {
+		if (pool)
+			g_thread_pool_push(pool, &jobs[i], NULL);
+		else
+			scpi_scan_job_run(&jobs[i], NULL);
+	}
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);
+
+	devices = NULL;
+	for (i = 0; i < num_jobs; i++) {
+		if (!(sdi = jobs[i].sdi))
+			continue;
+		sdi->connection_id = g_strdup(jobs[i].connection_id);
+		devices = g_slist_append(devices, sdi);
 	}
+	g_free(jobs);
+	g_slist_free_full(resources, g_free);
 
 	if (!devices && resource) {
 		sdi = sr_scpi_scan_resource(drvc, resource, serialcomm, probe_device);
@@ -377,7 +451,7 @@ SR_PRIV struct sr_scpi_dev_inst *scpi_dev_inst_new(struct drv_context *drvc,
 			scpi = g_malloc(sizeof(*scpi));
 			*scpi = *scpi_dev;
 			scpi->priv = g_malloc0(scpi->priv_size);
-			scpi->read_timeout_us = 1000 * 1000;
+			scpi->read_timeout_us = SCPI_READ_TIMEOUT_US;
 			params = g_strsplit(resource, "/", 0);
 			if (scpi->dev_inst_new(scpi->priv, drvc, resource,
 			                       params, serialcomm) != SR_OK) {
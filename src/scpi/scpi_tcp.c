@@ -27,6 +27,8 @@
 #include <string.h>
 #include <unistd.h>
 #ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -72,6 +74,86 @@ static int scpi_tcp_dev_inst_new(void *priv, struct drv_context *drvc,
 	return SR_OK;
 }
 
+/*
+ * Connect a socket. With a timeout, give up connecting after it, and
+ * have each read on the socket fail after it, too.
+ */
+static int tcp_connect(int fd, const struct addrinfo *res,
+		unsigned int timeout_us)
+{
+	socklen_t len;
+	int err;
+#ifdef _WIN32
+	struct timeval tv;
+	fd_set fds;
+	u_long nonblock;
+	DWORD ms;
+#else
+	struct pollfd pfd;
+	struct timeval tv;
+	int flags;
+#endif
+
+	if (!timeout_us)
+		return connect(fd, res->ai_addr, res->ai_addrlen);
+
+#ifdef _WIN32
+	nonblock = 1;
+	ioctlsocket(fd, FIONBIO, &nonblock);
+#else
+	flags = fcntl(fd, F_GETFL, 0);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+#endif
+
+	if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+#ifdef _WIN32
+		if (WSAGetLastError() != WSAEWOULDBLOCK)
+			return -1;
+		/* Winsock's fd_set lists sockets, any socket fits in. */
+		FD_ZERO(&fds);
+		FD_SET(fd, &fds);
+		tv.tv_sec = timeout_us / 1000000;
+		tv.tv_usec = timeout_us % 1000000;
+		err = select(fd + 1, NULL, &fds, NULL, &tv);
+#else
+		if (errno != EINPROGRESS)
+			return -1;
+		/* Unlike select(), poll() takes descriptors above FD_SETSIZE. */
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		do {
+			err = poll(&pfd, 1, MAX(timeout_us / 1000, 1));
+		} while (err < 0 && errno == EINTR);
+#endif
+		if (err <= 0) {
+			errno = ETIMEDOUT;
+			return -1;
+		}
+		len = sizeof(err);
+		if (getsockopt(fd, SOL_SOCKET, SO_ERROR, (char *)&err, &len) != 0)
+			return -1;
+		if (err) {
+			errno = err;
+			return -1;
+		}
+	}
+
+#ifdef _WIN32
+	nonblock = 0;
+	ioctlsocket(fd, FIONBIO, &nonblock);
+	ms = timeout_us / 1000;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&ms, sizeof(ms));
+#else
+	fcntl(fd, F_SETFL, flags);
+	tv.tv_sec = timeout_us / 1000000;
+	tv.tv_usec = timeout_us % 1000000;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+#endif
+
+	return 0;
+}
+
 static int scpi_tcp_open(struct sr_scpi_dev_inst *scpi)
 {
 	struct scpi_tcp *tcp = scpi->priv;
@@ -96,7 +178,7 @@ static int scpi_tcp_open(struct sr_scpi_dev_inst *scpi)
 		if ((tcp->socket = socket(res->ai_family, res->ai_socktype,
 						res->ai_protocol)) < 0)
 			continue;
-		if (connect(tcp->socket, res->ai_addr, res->ai_addrlen) != 0) {
+		if (tcp_connect(tcp->socket, res, scpi->probe_timeout_us) != 0) {
 			close(tcp->socket);
 			tcp->socket = -1;
 			continue;
@@ -46,9 +46,147 @@
  * @{
  */
 
+/** Default number of packets an asynchronous callback queue can hold. */
+#define DATAFEED_QUEUE_DEFAULT_SIZE 256
+
+/** One packet waiting in an asynchronous callback queue. */
+struct datafeed_queue_entry {
+	const struct sr_dev_inst *sdi;
+	struct sr_datafeed_packet *packet;
+};
+
+/**
+ * Bounded single-producer/single-consumer packet ring buffer.
+ *
+ * The session thread (the producer) and the worker thread (the consumer)
+ * only communicate through the atomically accessed head and tail indices.
+ * The mutex and condition variables are only touched when one side has
+ * to sleep because the ring is empty (worker) or full (control packets).
+ */
+struct datafeed_queue {
+	struct datafeed_queue_entry *entries;
+	/** Number of slots, always a power of two. */
+	guint capacity;
+	/** Index of the next slot to read, owned by the consumer. */
+	gint head;
+	/** Index of the next slot to write, owned by the producer. */
+	gint tail;
+
+	GThread *worker;
+	GMutex mutex;
+	GCond data_cond;
+	GCond space_cond;
+	gint consumer_waiting;
+	gint producer_waiting;
+	gint quit;
+	/** Set when the callback was removed by its own worker thread. */
+	gint orphaned;
+
+	/* Written by the producer only. */
+	uint64_t queued;
+	uint64_t dropped;
+	guint high_water;
+	gboolean overrun;
+	/* Written by the consumer only. */
+	uint64_t delivered;
+};
+
 struct datafeed_callback {
 	sr_datafeed_callback cb;
 	void *cb_data;
+	/** Packet queue for asynchronous delivery, or NULL. */
+	struct datafeed_queue *queue;
+	/** Bitmask of enum sr_datafeed_callback_flag. */
+	uint64_t flags;
+};
+
+/**
+ * A datafeed packet which outlives the callback it was delivered to.
+ *
+ * The packet and copies of its payload structs share one allocation.
+ * Sample data is held by reference, in the sender's buffer when it was
+ * sent with sr_session_send_buffer(), or in a private copy otherwise.
+ */
+struct packet_ref {
+	/* Must come first, sr_packet_unref() casts the packet back. */
+	struct sr_datafeed_packet packet;
+	gint refcount;
+	/** Holds the sample data, or NULL for packets without samples. */
+	struct sr_buffer *buffer;
+	union {
+		struct sr_datafeed_header header;
+		struct sr_datafeed_meta meta;
+		struct sr_datafeed_logic logic;
+		struct sr_datafeed_logic_rle logic_rle;
+		struct {
+			struct sr_datafeed_analog analog;
+			struct sr_analog_encoding encoding;
+			struct sr_analog_meaning meaning;
+			struct sr_analog_spec spec;
+		} analog;
+	} payload;
+};
+
+/** The packet which is being passed to datafeed callbacks on this thread. */
+struct packet_dispatch {
+	const struct sr_datafeed_packet *packet;
+	/** The buffer holding the sample data, or NULL if unknown. */
+	struct sr_buffer *buffer;
+	/** Retained version of the packet, created on first request. */
+	struct packet_ref *ref;
+	/** The dispatch this one is nested in, or NULL. */
+	struct packet_dispatch *prev;
+};
+
+static GPrivate current_dispatch = G_PRIVATE_INIT(NULL);
+
+/**
+ * Packets of one device held back for merging.
+ *
+ * A stage is only used with the session's dispatch_mutex held, which
+ * keeps the merged packets in order with the ones passed on directly.
+ * The mutex is recursive, so datafeed callbacks may send packets.
+ *
+ * @see sr_session_coalesce_set()
+ */
+struct datafeed_stage {
+	gint refcount;
+	/** Set once the device left the session or sent SR_DF_END. */
+	gboolean closed;
+	struct sr_buffer_pool *pool;
+	/** Holds the staged samples, or NULL if none were staged yet. */
+	struct sr_buffer *buf;
+	/** Size of the merged packets in bytes. */
+	size_t size;
+	/** Maximum time samples are held back, or 0. */
+	int64_t latency_us;
+	/** Time at which the oldest staged samples arrived. */
+	int64_t first_us;
+	/** Flushes the stage once the latency bound is reached, or NULL. */
+	GSource *timer;
+	struct sr_session *session;
+	const struct sr_dev_inst *sdi;
+
+	/** SR_DF_LOGIC or SR_DF_ANALOG, or 0 if nothing is staged. */
+	int type;
+	/** Number of bytes staged. */
+	size_t fill;
+	uint16_t unitsize;
+	uint32_t num_samples;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+};
+
+/** Event loop thread of a running session, see sr_session_threading_set(). */
+struct session_loop {
+	/** Device, or SR_INST_* transport, whose devices this loop services. */
+	const void *key;
+	/** List of struct sr_dev_inst pointers. */
+	GSList *devs;
+	GMainContext *context;
+	GMainLoop *loop;
+	GThread *thread;
 };
 
 /** Custom GLib event source for generic descriptor I/O.
@@ -198,6 +336,250 @@ static GSource *fd_source_new(struct sr_session *session, void *key,
 	return source;
 }
 
+static void dispatch_begin(struct packet_dispatch *dispatch,
+		const struct sr_datafeed_packet *packet,
+		struct sr_buffer *buffer, struct packet_ref *ref)
+{
+	dispatch->packet = packet;
+	dispatch->buffer = buffer;
+	dispatch->ref = ref;
+	dispatch->prev = g_private_get(&current_dispatch);
+	g_private_set(&current_dispatch, dispatch);
+}
+
+static void dispatch_end(struct packet_dispatch *dispatch)
+{
+	g_private_set(&current_dispatch, dispatch->prev);
+	if (dispatch->ref)
+		sr_packet_unref(&dispatch->ref->packet);
+}
+
+static struct datafeed_queue *datafeed_queue_new(size_t size)
+{
+	struct datafeed_queue *queue;
+	guint capacity;
+
+	capacity = 2;
+	while (capacity < size && capacity < (1U << 30))
+		capacity <<= 1;
+
+	queue = g_malloc0(sizeof(*queue));
+	queue->entries = g_malloc0(capacity * sizeof(queue->entries[0]));
+	queue->capacity = capacity;
+	g_mutex_init(&queue->mutex);
+	g_cond_init(&queue->data_cond);
+	g_cond_init(&queue->space_cond);
+
+	return queue;
+}
+
+static guint datafeed_queue_fill(struct datafeed_queue *queue)
+{
+	return (guint)g_atomic_int_get(&queue->tail)
+		- (guint)g_atomic_int_get(&queue->head);
+}
+
+/** Store a packet copy in the queue. Called by the session thread only. */
+static gboolean datafeed_queue_push(struct datafeed_queue *queue,
+		const struct sr_dev_inst *sdi, struct sr_datafeed_packet *packet,
+		gboolean may_drop)
+{
+	struct datafeed_queue_entry *entry;
+	guint tail, fill;
+
+	tail = (guint)g_atomic_int_get(&queue->tail);
+	while ((fill = tail - (guint)g_atomic_int_get(&queue->head))
+			>= queue->capacity) {
+		if (may_drop) {
+			if (!queue->overrun)
+				sr_warn("Datafeed queue overrun, dropping packets.");
+			queue->overrun = TRUE;
+			queue->dropped++;
+			return FALSE;
+		}
+		/* Packets which carry state must not get lost. */
+		g_mutex_lock(&queue->mutex);
+		g_atomic_int_set(&queue->producer_waiting, 1);
+		if (tail - (guint)g_atomic_int_get(&queue->head) >= queue->capacity)
+			g_cond_wait(&queue->space_cond, &queue->mutex);
+		g_atomic_int_set(&queue->producer_waiting, 0);
+		g_mutex_unlock(&queue->mutex);
+	}
+
+	entry = &queue->entries[tail & (queue->capacity - 1)];
+	entry->sdi = sdi;
+	entry->packet = packet;
+	g_atomic_int_set(&queue->tail, (gint)(tail + 1));
+
+	queue->overrun = FALSE;
+	queue->queued++;
+	if (fill + 1 > queue->high_water)
+		queue->high_water = fill + 1;
+
+	if (g_atomic_int_get(&queue->consumer_waiting)) {
+		g_mutex_lock(&queue->mutex);
+		g_cond_signal(&queue->data_cond);
+		g_mutex_unlock(&queue->mutex);
+	}
+
+	return TRUE;
+}
+
+/** Take the oldest entry from the queue. Called by the worker only. */
+static gboolean datafeed_queue_pop(struct datafeed_queue *queue,
+		struct datafeed_queue_entry *entry)
+{
+	guint head;
+
+	head = (guint)g_atomic_int_get(&queue->head);
+	if (head == (guint)g_atomic_int_get(&queue->tail))
+		return FALSE;
+
+	*entry = queue->entries[head & (queue->capacity - 1)];
+	g_atomic_int_set(&queue->head, (gint)(head + 1));
+
+	if (g_atomic_int_get(&queue->producer_waiting)) {
+		g_mutex_lock(&queue->mutex);
+		g_cond_signal(&queue->space_cond);
+		g_mutex_unlock(&queue->mutex);
+	}
+
+	return TRUE;
+}
+
+/* Drop the packets left in the queue, and free the callback. */
+static void datafeed_callback_release(struct datafeed_callback *cb_struct)
+{
+	struct datafeed_queue *queue;
+	struct datafeed_queue_entry entry;
+
+	if ((queue = cb_struct->queue)) {
+		while (datafeed_queue_pop(queue, &entry))
+			sr_packet_unref(entry.packet);
+		g_cond_clear(&queue->data_cond);
+		g_cond_clear(&queue->space_cond);
+		g_mutex_clear(&queue->mutex);
+		g_free(queue->entries);
+		g_free(queue);
+	}
+	g_free(cb_struct);
+}
+
+static gpointer datafeed_queue_worker(gpointer data)
+{
+	struct datafeed_callback *cb_struct;
+	struct datafeed_queue *queue;
+	struct datafeed_queue_entry entry;
+	struct packet_dispatch dispatch;
+
+	cb_struct = data;
+	queue = cb_struct->queue;
+
+	for (;;) {
+		/* The callback removed itself, nobody joins this thread. */
+		if (g_atomic_int_get(&queue->orphaned)) {
+			datafeed_callback_release(cb_struct);
+			break;
+		}
+		if (datafeed_queue_pop(queue, &entry)) {
+			/* The dispatch takes over the queue's reference. */
+			dispatch_begin(&dispatch, entry.packet, NULL,
+					(struct packet_ref *)entry.packet);
+			cb_struct->cb(entry.sdi, entry.packet, cb_struct->cb_data);
+			dispatch_end(&dispatch);
+			queue->delivered++;
+			continue;
+		}
+		/*
+		 * Announce that we are going to sleep before re-checking
+		 * the ring, so that the producer either sees the flag or
+		 * we see its packet.
+		 */
+		g_mutex_lock(&queue->mutex);
+		g_atomic_int_set(&queue->consumer_waiting, 1);
+		if (datafeed_queue_fill(queue) == 0) {
+			if (g_atomic_int_get(&queue->quit)) {
+				g_atomic_int_set(&queue->consumer_waiting, 0);
+				g_mutex_unlock(&queue->mutex);
+				break;
+			}
+			g_cond_wait(&queue->data_cond, &queue->mutex);
+		}
+		g_atomic_int_set(&queue->consumer_waiting, 0);
+		g_mutex_unlock(&queue->mutex);
+	}
+
+	return NULL;
+}
+
+static void datafeed_queue_start(struct datafeed_callback *cb_struct)
+{
+	struct datafeed_queue *queue;
+
+	queue = cb_struct->queue;
+	if (queue->worker)
+		return;
+
+	g_atomic_int_set(&queue->quit, 0);
+	queue->worker = g_thread_new("sr-datafeed", datafeed_queue_worker,
+			cb_struct);
+}
+
+/**
+ * Let the worker deliver all pending packets, then terminate it.
+ *
+ * Blocks until the callback has returned for the last queued packet.
+ */
+static void datafeed_queue_stop(struct datafeed_queue *queue)
+{
+	if (!queue->worker)
+		return;
+
+	g_mutex_lock(&queue->mutex);
+	g_atomic_int_set(&queue->quit, 1);
+	g_cond_signal(&queue->data_cond);
+	g_mutex_unlock(&queue->mutex);
+
+	g_thread_join(queue->worker);
+	queue->worker = NULL;
+}
+
+static void datafeed_callback_free(struct datafeed_callback *cb_struct)
+{
+	struct datafeed_queue *queue;
+
+	/*
+	 * A callback which removes itself runs on the worker, which can't
+	 * join itself. It frees the callback once the callback returned,
+	 * and drops the packets still queued.
+	 */
+	queue = cb_struct->queue;
+	if (queue && queue->worker == g_thread_self()) {
+		g_thread_unref(queue->worker);
+		queue->worker = NULL;
+		g_atomic_int_set(&queue->orphaned, 1);
+		return;
+	}
+
+	/* The worker drains the ring, but it may never have run. */
+	if (queue)
+		datafeed_queue_stop(queue);
+	datafeed_callback_release(cb_struct);
+}
+
+/** Wait until all asynchronous callbacks have consumed their packets. */
+static void datafeed_queues_flush(struct sr_session *session)
+{
+	struct datafeed_callback *cb_struct;
+	GSList *l;
+
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (cb_struct->queue)
+			datafeed_queue_stop(cb_struct->queue);
+	}
+}
+
 /**
  * Create a new session.
  *
@@ -224,6 +606,7 @@ SR_API int sr_session_new(struct sr_context *ctx,
 	session->ctx = ctx;
 
 	g_mutex_init(&session->main_mutex);
+	g_rec_mutex_init(&session->dispatch_mutex);
 
 	/* To maintain API compatibility, we need a lookup table
 	 * which maps poll_object IDs to GSource* pointers.
@@ -261,12 +644,59 @@ SR_API int sr_session_destroy(struct sr_session *session)
 	g_hash_table_unref(session->event_sources);
 
 	g_mutex_clear(&session->main_mutex);
+	g_rec_mutex_clear(&session->dispatch_mutex);
 
 	g_free(session);
 
 	return SR_OK;
 }
 
+static void datafeed_stage_clear(struct datafeed_stage *stage)
+{
+	if (stage->type == SR_DF_ANALOG)
+		g_slist_free(stage->meaning.channels);
+	stage->type = 0;
+	stage->fill = 0;
+	stage->num_samples = 0;
+	if (stage->timer) {
+		g_source_destroy(stage->timer);
+		g_source_unref(stage->timer);
+		stage->timer = NULL;
+	}
+}
+
+static void datafeed_stage_unref(struct datafeed_stage *stage)
+{
+	if (!g_atomic_int_dec_and_test(&stage->refcount))
+		return;
+
+	sr_buffer_unref(stage->buf);
+	sr_buffer_pool_free(stage->pool);
+	g_free(stage);
+}
+
+/*
+ * Detach the device's stage, dropping any samples still in it. A pending
+ * latency timer keeps the stage alive until it was removed.
+ */
+static void datafeed_stage_close(struct sr_dev_inst *sdi)
+{
+	struct datafeed_stage *stage;
+
+	if (!(stage = sdi->stage))
+		return;
+	sdi->stage = NULL;
+
+	g_rec_mutex_lock(&stage->session->dispatch_mutex);
+	if (stage->fill)
+		sr_warn("Dropping %zu staged bytes of a removed device.",
+			stage->fill);
+	datafeed_stage_clear(stage);
+	stage->closed = TRUE;
+	g_rec_mutex_unlock(&stage->session->dispatch_mutex);
+	datafeed_stage_unref(stage);
+}
+
 /**
  * Remove all the devices from a session.
  *
@@ -292,6 +722,7 @@ SR_API int sr_session_dev_remove_all(struct sr_session *session)
 
 	for (l = session->devs; l; l = l->next) {
 		sdi = (struct sr_dev_inst *) l->data;
+		datafeed_stage_close(sdi);
 		sdi->session = NULL;
 	}
 
@@ -438,6 +869,7 @@ SR_API int sr_session_dev_remove(struct sr_session *session,
 	}
 
 	session->devs = g_slist_remove(session->devs, sdi);
+	datafeed_stage_close(sdi);
 	sdi->session = NULL;
 
 	return SR_OK;
@@ -446,6 +878,10 @@ SR_API int sr_session_dev_remove(struct sr_session *session,
 /**
  * Remove all datafeed callbacks in a session.
  *
+ * Waits until the asynchronous callbacks consumed their queued packets.
+ * When called from an asynchronous callback, the packets still queued for
+ * that callback are dropped instead.
+ *
  * @param session The session to use. Must not be NULL.
  *
  * @retval SR_OK Success.
@@ -460,7 +896,8 @@ SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session)
 		return SR_ERR_ARG;
 	}
 
-	g_slist_free_full(session->datafeed_callbacks, g_free);
+	g_slist_free_full(session->datafeed_callbacks,
+			(GDestroyNotify)datafeed_callback_free);
 	session->datafeed_callbacks = NULL;
 
 	return SR_OK;
@@ -469,6 +906,13 @@ SR_API int sr_session_datafeed_callback_remove_all(struct sr_session *session)
 /**
  * Add a datafeed callback to a session.
  *
+ * The callback runs in the thread which sent the packet. That is the
+ * thread dispatching the session's main context, an event loop thread of
+ * the session, see sr_session_threading_set(), or for the packets sent
+ * while the devices start concurrently, such as SR_DF_HEADER, a thread of
+ * sr_session_start(), see sr_session_parallel_start_set(). It is never
+ * invoked from two threads at once.
+ *
  * @param session The session to use. Must not be NULL.
  * @param cb Function to call when a chunk of data is received.
  *           Must not be NULL.
@@ -504,6 +948,193 @@ SR_API int sr_session_datafeed_callback_add(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Add a datafeed callback which runs in its own thread.
+ *
+ * Packets sent to the session are copied into a bounded queue which is
+ * private to this callback, and the callback is invoked from a worker
+ * thread. This decouples slow consumers (file writers, decoders) from
+ * the acquisition, which never waits for the callback to return.
+ *
+ * When the queue is full, SR_DF_LOGIC, SR_DF_LOGIC_RLE and SR_DF_ANALOG
+ * packets are dropped and accounted for in the callback's statistics, see
+ * sr_session_datafeed_callback_stats_get(). All other packet types
+ * carry stream state and are never dropped; the sender waits for the
+ * worker to make room instead.
+ *
+ * The callback receives the packets in the order they were sent. All
+ * queued packets have been delivered by the time the session's stopped
+ * callback runs, or sr_session_run() returns.
+ *
+ * The callback may remove the session's datafeed callbacks, or destroy
+ * the session. Its worker thread then ends once the callback returned.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb Function to call when a chunk of data is received.
+ *           Must not be NULL.
+ * @param cb_data Opaque pointer passed in by the caller.
+ * @param queue_size Maximum number of packets waiting for the callback,
+ *                   or 0 to use the default. Rounded up to a power of two.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_callback_add_async(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data, size_t queue_size)
+{
+	struct datafeed_callback *cb_struct;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (!cb) {
+		sr_err("%s: cb was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (queue_size == 0)
+		queue_size = DATAFEED_QUEUE_DEFAULT_SIZE;
+
+	cb_struct = g_malloc0(sizeof(struct datafeed_callback));
+	cb_struct->cb = cb;
+	cb_struct->cb_data = cb_data;
+	cb_struct->queue = datafeed_queue_new(queue_size);
+
+	session->datafeed_callbacks =
+	    g_slist_append(session->datafeed_callbacks, cb_struct);
+
+	return SR_OK;
+}
+
+/**
+ * Get the queue statistics of an asynchronous datafeed callback.
+ *
+ * The counters are maintained without locking and are a snapshot, which
+ * may already be outdated when the function returns.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb The callback, as passed to sr_session_datafeed_callback_add_async().
+ * @param cb_data The callback data, as passed to
+ *                sr_session_datafeed_callback_add_async().
+ * @param stats Pointer to the structure to fill in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or no such asynchronous callback.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_callback_stats_get(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data,
+		struct sr_datafeed_queue_stats *stats)
+{
+	struct datafeed_callback *cb_struct;
+	struct datafeed_queue *queue;
+	GSList *l;
+
+	if (!session || !stats)
+		return SR_ERR_ARG;
+
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (cb_struct->cb != cb || cb_struct->cb_data != cb_data)
+			continue;
+		if (!(queue = cb_struct->queue))
+			continue;
+		stats->queued = queue->queued;
+		stats->delivered = queue->delivered;
+		stats->dropped = queue->dropped;
+		stats->fill = datafeed_queue_fill(queue);
+		stats->high_water = queue->high_water;
+		stats->capacity = queue->capacity;
+		return SR_OK;
+	}
+
+	return SR_ERR_ARG;
+}
+
+/**
+ * Set the flags of a datafeed callback.
+ *
+ * The flags announce which optional packet formats the callback can
+ * handle. Without SR_DF_CALLBACK_LOGIC_RLE, SR_DF_LOGIC_RLE packets are
+ * expanded into SR_DF_LOGIC packets for this callback.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param cb The callback, as passed to sr_session_datafeed_callback_add()
+ *           or sr_session_datafeed_callback_add_async().
+ * @param cb_data The callback data, as passed along with @a cb.
+ * @param flags Bitmask of enum sr_datafeed_callback_flag values.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or no such callback.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_datafeed_callback_flags_set(struct sr_session *session,
+		sr_datafeed_callback cb, void *cb_data, uint64_t flags)
+{
+	struct datafeed_callback *cb_struct;
+	GSList *l;
+
+	if (!session)
+		return SR_ERR_ARG;
+
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (cb_struct->cb != cb || cb_struct->cb_data != cb_data)
+			continue;
+		cb_struct->flags = flags;
+		return SR_OK;
+	}
+
+	return SR_ERR_ARG;
+}
+
+/**
+ * Merge small data packets before they reach the datafeed callbacks.
+ *
+ * Devices which send many small packets, like multimeters or drivers
+ * handing over every USB transfer, make transforms and callbacks run once
+ * per few samples. With merging enabled, adjacent SR_DF_LOGIC packets of
+ * the same unitsize and adjacent single channel SR_DF_ANALOG packets of
+ * the same channel and format are held back per device, and passed on as
+ * one packet of up to @a max_bytes. Any other packet, e.g. SR_DF_TRIGGER,
+ * SR_DF_FRAME_END or SR_DF_END, first flushes the held back samples, so
+ * the order of the datafeed is kept. Packets of at least half the merged
+ * size are passed on unchanged.
+ *
+ * The setting applies to devices from their next SR_DF_HEADER on.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param max_bytes Size of the merged packets in bytes, or 0 to pass
+ *                  every packet on as it comes (the default).
+ * @param max_latency_ms Maximum time in milliseconds samples are held
+ *                       back, or 0 for no limit. Samples are flushed from
+ *                       the session main loop once it is reached, even if
+ *                       the device does not send anything else.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_coalesce_set(struct sr_session *session,
+		size_t max_bytes, unsigned int max_latency_ms)
+{
+	if (!session)
+		return SR_ERR_ARG;
+
+	session->coalesce_size = max_bytes;
+	session->coalesce_latency_ms = max_latency_ms;
+
+	return SR_OK;
+}
+
 /**
  * Get the trigger assigned to this session.
  *
@@ -653,47 +1284,372 @@ static int unset_main_context(struct sr_session *session)
 	return ret;
 }
 
-static unsigned int session_source_attach(struct sr_session *session,
+/* Attach a source to the session main context, with main_mutex held. */
+static unsigned int main_source_attach(struct sr_session *session,
 		GSource *source)
 {
-	unsigned int id = 0;
-
-	g_mutex_lock(&session->main_mutex);
-
-	if (session->main_context)
-		id = g_source_attach(source, session->main_context);
-	else
+	if (!session->main_context) {
 		sr_err("Cannot add event source without main context.");
+		return 0;
+	}
 
-	g_mutex_unlock(&session->main_mutex);
-
-	return id;
+	return g_source_attach(source, session->main_context);
 }
 
-/* Idle handler; invoked when the number of registered event sources
- * for a running session drops to zero.
+/*
+ * Attach a device's event source, with main_mutex held. Devices started
+ * with their own event loop thread have its context set as the thread
+ * default while they add sources, see sr_session_threading_set().
  */
-static gboolean delayed_stop_check(void *data)
+static unsigned int device_source_attach(struct sr_session *session,
+		GSource *source)
 {
-	struct sr_session *session;
+	struct session_loop *loop;
+	GMainContext *context;
+	GSList *l;
 
-	session = data;
-	session->stop_check_id = 0;
+	if (session->main_context && session->loops
+			&& (context = g_main_context_get_thread_default())) {
+		for (l = session->loops; l; l = l->next) {
+			loop = l->data;
+			if (loop->context == context)
+				return g_source_attach(source, context);
+		}
+	}
 
-	/* Session already ended? */
-	if (!session->running)
-		return G_SOURCE_REMOVE;
+	return main_source_attach(session, source);
+}
 
-	/* New event sources may have been installed in the meantime. */
-	if (g_hash_table_size(session->event_sources) != 0)
-		return G_SOURCE_REMOVE;
+static void session_loops_free(struct sr_session *session)
+{
+	struct session_loop *loop;
+	GSList *l;
 
-	session->running = FALSE;
-	unset_main_context(session);
+	for (l = session->loops; l; l = l->next) {
+		loop = l->data;
+		if (loop->thread) {
+			g_main_loop_quit(loop->loop);
+			g_thread_join(loop->thread);
+		}
+		g_main_loop_unref(loop->loop);
+		g_main_context_unref(loop->context);
+		g_slist_free(loop->devs);
+		g_free(loop);
+	}
 
-	sr_info("Stopped.");
+	g_mutex_lock(&session->main_mutex);
+	g_slist_free(session->loops);
+	session->loops = NULL;
+	g_mutex_unlock(&session->main_mutex);
+}
 
-	/* This indicates a bug in user code, since it is not valid to
+/*
+ * Assign the session's devices to event loops. USB devices always share
+ * one loop, since libusb services all of them through a single source.
+ */
+static void session_loops_new(struct sr_session *session)
+{
+	struct session_loop *loop;
+	struct sr_dev_inst *sdi;
+	const void *key;
+	GSList *l, *m;
+
+	for (l = session->devs; l; l = l->next) {
+		sdi = l->data;
+		if (sdi->inst_type == SR_INST_USB
+				|| session->threading == SR_SESSION_THREADING_TRANSPORT)
+			key = GINT_TO_POINTER(sdi->inst_type);
+		else
+			key = sdi;
+
+		for (m = session->loops; m; m = m->next) {
+			loop = m->data;
+			if (loop->key == key)
+				break;
+		}
+		if (!m) {
+			loop = g_malloc0(sizeof(*loop));
+			loop->key = key;
+			loop->context = g_main_context_new();
+			loop->loop = g_main_loop_new(loop->context, FALSE);
+			g_mutex_lock(&session->main_mutex);
+			session->loops = g_slist_append(session->loops, loop);
+			g_mutex_unlock(&session->main_mutex);
+		}
+		loop->devs = g_slist_append(loop->devs, sdi);
+	}
+}
+
+static struct session_loop *session_loop_find(struct sr_session *session,
+		const struct sr_dev_inst *sdi)
+{
+	struct session_loop *loop;
+	GSList *l;
+
+	for (l = session->loops; l; l = l->next) {
+		loop = l->data;
+		if (g_slist_find(loop->devs, sdi))
+			return loop;
+	}
+
+	return NULL;
+}
+
+static gpointer session_loop_thread(gpointer data)
+{
+	struct session_loop *loop;
+
+	loop = data;
+
+	/* Sources added by the devices' callbacks go to this loop, too. */
+	g_main_context_push_thread_default(loop->context);
+	g_main_loop_run(loop->loop);
+	g_main_context_pop_thread_default(loop->context);
+
+	return NULL;
+}
+
+/*
+ * Start or stop a device's acquisition in the context of its event loop,
+ * before the loop's thread runs.
+ */
+static int device_acquisition_start(struct sr_session *session,
+		struct sr_dev_inst *sdi)
+{
+	struct session_loop *loop;
+	int ret;
+
+	if ((loop = session_loop_find(session, sdi)))
+		g_main_context_push_thread_default(loop->context);
+	sdi->start_begin_us = g_get_real_time();
+	ret = sr_dev_acquisition_start(sdi);
+	sdi->start_end_us = g_get_real_time();
+	if (loop)
+		g_main_context_pop_thread_default(loop->context);
+
+	return ret;
+}
+
+static void device_acquisition_stop(struct sr_session *session,
+		struct sr_dev_inst *sdi)
+{
+	struct session_loop *loop;
+
+	if ((loop = session_loop_find(session, sdi)))
+		g_main_context_push_thread_default(loop->context);
+	sr_dev_acquisition_stop(sdi);
+	if (loop)
+		g_main_context_pop_thread_default(loop->context);
+}
+
+/* Releases the device start threads once all of them are ready. */
+struct start_barrier {
+	GMutex mutex;
+	GCond cond;
+	unsigned int count;
+	/** Whether any of the threads failed to get ready. */
+	gboolean failed;
+};
+
+struct device_start {
+	struct sr_dev_inst *sdi;
+	int commit_ret;
+	int start_ret;
+	gboolean started;
+};
+
+/*
+ * The devices which share an event loop. They are started one after
+ * another from one thread, since only one thread at a time can make a
+ * main context its thread-default one.
+ */
+struct start_group {
+	struct sr_session *session;
+	/** The devices' loop, or the device which has none. */
+	const void *key;
+	/** The devices' struct device_start. */
+	GSList *starts;
+	struct start_barrier *barrier;
+	GThread *thread;
+};
+
+/* Wait for the other threads, return FALSE if any of them failed. */
+static gboolean start_barrier_wait(struct start_barrier *barrier,
+		gboolean ready)
+{
+	gboolean failed;
+
+	g_mutex_lock(&barrier->mutex);
+	if (!ready)
+		barrier->failed = TRUE;
+	if (--barrier->count == 0)
+		g_cond_broadcast(&barrier->cond);
+	while (barrier->count > 0)
+		g_cond_wait(&barrier->cond, &barrier->mutex);
+	failed = barrier->failed;
+	g_mutex_unlock(&barrier->mutex);
+
+	return !failed;
+}
+
+static gpointer start_group_thread(gpointer data)
+{
+	struct start_group *group;
+	struct device_start *start;
+	gboolean ready;
+	GSList *l;
+
+	group = data;
+
+	/* Round-trips to the instruments overlap with the other groups'. */
+	ready = TRUE;
+	for (l = group->starts; l && ready; l = l->next) {
+		start = l->data;
+		start->commit_ret = sr_config_commit(start->sdi);
+		ready = start->commit_ret == SR_OK;
+	}
+
+	/* Start all devices at the same time, or none. */
+	if (!start_barrier_wait(group->barrier, ready))
+		return NULL;
+
+	for (l = group->starts; l; l = l->next) {
+		start = l->data;
+		start->start_ret = device_acquisition_start(group->session,
+				start->sdi);
+		start->started = TRUE;
+		if (start->start_ret != SR_OK)
+			break;
+	}
+
+	return NULL;
+}
+
+/* Commit the settings of all devices and start them, one thread per loop. */
+static int session_start_parallel(struct sr_session *session)
+{
+	struct start_barrier barrier;
+	struct device_start *starts;
+	struct start_group *group;
+	struct session_loop *loop;
+	struct sr_dev_inst *sdi;
+	const void *key;
+	unsigned int num_devs, i;
+	GSList *groups, *l, *m;
+	int ret;
+
+	num_devs = g_slist_length(session->devs);
+	starts = g_new0(struct device_start, num_devs);
+
+	/*
+	 * Group the devices by their loop. Without loops, USB devices still
+	 * share one group, since they share the libusb event source.
+	 */
+	groups = NULL;
+	for (l = session->devs, i = 0; l; l = l->next, i++) {
+		sdi = l->data;
+		starts[i].sdi = sdi;
+		if ((loop = session_loop_find(session, sdi)))
+			key = loop;
+		else if (sdi->inst_type == SR_INST_USB)
+			key = GINT_TO_POINTER(sdi->inst_type);
+		else
+			key = sdi;
+		for (m = groups; m; m = m->next) {
+			group = m->data;
+			if (group->key == key)
+				break;
+		}
+		if (!m) {
+			group = g_malloc0(sizeof(*group));
+			group->session = session;
+			group->key = key;
+			group->barrier = &barrier;
+			groups = g_slist_append(groups, group);
+		}
+		group->starts = g_slist_append(group->starts, &starts[i]);
+	}
+
+	g_mutex_init(&barrier.mutex);
+	g_cond_init(&barrier.cond);
+	barrier.count = g_slist_length(groups);
+	barrier.failed = FALSE;
+
+	for (l = groups; l; l = l->next) {
+		group = l->data;
+		group->thread = g_thread_new("sr-start",
+				start_group_thread, group);
+	}
+	for (l = groups; l; l = l->next) {
+		group = l->data;
+		g_thread_join(group->thread);
+		g_slist_free(group->starts);
+	}
+	g_slist_free_full(groups, g_free);
+
+	ret = SR_OK;
+	for (i = 0; i < num_devs; i++) {
+		sdi = starts[i].sdi;
+		if (starts[i].commit_ret != SR_OK) {
+			sr_err("Failed to commit %s device %s settings "
+				"before starting acquisition.",
+				sdi->driver->name, sdi->connection_id);
+			ret = starts[i].commit_ret;
+		} else if (starts[i].started && starts[i].start_ret != SR_OK) {
+			sr_err("Could not start %s device %s acquisition.",
+				sdi->driver->name, sdi->connection_id);
+			ret = starts[i].start_ret;
+		}
+	}
+
+	/* Stop the devices which were started, as the serial path does. */
+	if (ret != SR_OK) {
+		for (i = 0; i < num_devs; i++) {
+			if (starts[i].started)
+				device_acquisition_stop(session, starts[i].sdi);
+		}
+	}
+
+	g_cond_clear(&barrier.cond);
+	g_mutex_clear(&barrier.mutex);
+	g_free(starts);
+
+	return ret;
+}
+
+/* Idle handler; invoked when the number of registered event sources
+ * for a running session drops to zero.
+ */
+static gboolean delayed_stop_check(void *data)
+{
+	struct sr_session *session;
+	unsigned int num_sources;
+
+	session = data;
+
+	g_mutex_lock(&session->main_mutex);
+	session->stop_check_id = 0;
+	num_sources = g_hash_table_size(session->event_sources);
+	g_mutex_unlock(&session->main_mutex);
+
+	/* Session already ended? */
+	if (!session->running)
+		return G_SOURCE_REMOVE;
+
+	/* New event sources may have been installed in the meantime. */
+	if (num_sources != 0)
+		return G_SOURCE_REMOVE;
+
+	session->running = FALSE;
+	session_loops_free(session);
+	unset_main_context(session);
+
+	/* Let asynchronous consumers catch up before reporting the stop. */
+	datafeed_queues_flush(session);
+
+	sr_info("Stopped.");
+
+	/* This indicates a bug in user code, since it is not valid to
 	 * restart or destroy a session while it may still be running.
 	 */
 	if (!session->main_loop && !session->stopped_callback) {
@@ -709,6 +1665,7 @@ static gboolean delayed_stop_check(void *data)
 	return G_SOURCE_REMOVE;
 }
 
+/* Check for the end of the session from its main loop, with main_mutex held. */
 static int stop_check_later(struct sr_session *session)
 {
 	GSource *source;
@@ -720,7 +1677,7 @@ static int stop_check_later(struct sr_session *session)
 	source = g_idle_source_new();
 	g_source_set_callback(source, &delayed_stop_check, session, NULL);
 
-	source_id = session_source_attach(session, source);
+	source_id = main_source_attach(session, source);
 	session->stop_check_id = source_id;
 
 	g_source_unref(source);
@@ -741,6 +1698,11 @@ static int stop_check_later(struct sr_session *session)
  * any other thread, it will be used. Otherwise, libsigrok will create its
  * own main context for the current thread.
  *
+ * The packets which the devices send while starting, such as SR_DF_HEADER,
+ * reach the datafeed callbacks before this function returns. With
+ * sr_session_parallel_start_set(), they are sent from threads which start
+ * the devices, not from the calling thread.
+ *
  * @param session The session to use. Must not be NULL.
  *
  * @retval SR_OK Success.
@@ -753,6 +1715,7 @@ SR_API int sr_session_start(struct sr_session *session)
 {
 	struct sr_dev_inst *sdi;
 	struct sr_channel *ch;
+	struct session_loop *loop;
 	GSList *l, *c, *lend;
 	int ret;
 
@@ -792,6 +1755,10 @@ SR_API int sr_session_start(struct sr_session *session)
 			return SR_ERR;
 		}
 
+		/* Committed along with the start, see below. */
+		if (session->parallel_start)
+			continue;
+
 		ret = sr_config_commit(sdi);
 		if (ret != SR_OK) {
 			sr_err("Failed to commit %s device %s settings "
@@ -805,43 +1772,62 @@ SR_API int sr_session_start(struct sr_session *session)
 	if (ret != SR_OK)
 		return ret;
 
+	if (session->threading != SR_SESSION_THREADING_NONE)
+		session_loops_new(session);
+
 	sr_info("Starting.");
 
 	session->running = TRUE;
 
-	/* Have all devices start acquisition. */
-	for (l = session->devs; l; l = l->next) {
-		if (!(sdi = l->data)) {
-			sr_err("Device sdi was NULL, can't start session.");
-			ret = SR_ERR;
-			break;
+	if (session->parallel_start) {
+		ret = session_start_parallel(session);
+	} else {
+		/* Have all devices start acquisition. */
+		for (l = session->devs; l; l = l->next) {
+			if (!(sdi = l->data)) {
+				sr_err("Device sdi was NULL, can't start session.");
+				ret = SR_ERR;
+				break;
+			}
+			ret = device_acquisition_start(session, sdi);
+			if (ret != SR_OK) {
+				sr_err("Could not start %s device %s acquisition.",
+					sdi->driver->name, sdi->connection_id);
+				break;
+			}
 		}
-		ret = sr_dev_acquisition_start(sdi);
 		if (ret != SR_OK) {
-			sr_err("Could not start %s device %s acquisition.",
-				sdi->driver->name, sdi->connection_id);
-			break;
+			/* If there are multiple devices, some of them may
+			 * already have started successfully. Stop them now
+			 * before returning. */
+			lend = l->next;
+			for (l = session->devs; l != lend; l = l->next) {
+				sdi = l->data;
+				device_acquisition_stop(session, sdi);
+			}
 		}
 	}
 
 	if (ret != SR_OK) {
-		/* If there are multiple devices, some of them may already have
-		 * started successfully. Stop them now before returning. */
-		lend = l->next;
-		for (l = session->devs; l != lend; l = l->next) {
-			sdi = l->data;
-			sr_dev_acquisition_stop(sdi);
-		}
 		/* TODO: Handle delayed stops. Need to iterate the event
 		 * sources... */
 		session->running = FALSE;
 
+		session_loops_free(session);
 		unset_main_context(session);
 		return ret;
 	}
 
+	/* The devices' event sources are in place, run their loops. */
+	for (l = session->loops; l; l = l->next) {
+		loop = l->data;
+		loop->thread = g_thread_new("sr-session", session_loop_thread, loop);
+	}
+
+	g_mutex_lock(&session->main_mutex);
 	if (g_hash_table_size(session->event_sources) == 0)
 		stop_check_later(session);
+	g_mutex_unlock(&session->main_mutex);
 
 	return SR_OK;
 }
@@ -898,10 +1884,18 @@ SR_API int sr_session_run(struct sr_session *session)
 	return SR_OK;
 }
 
+static gboolean device_stop_sync(void *user_data)
+{
+	sr_dev_acquisition_stop(user_data);
+
+	return G_SOURCE_REMOVE;
+}
+
 static gboolean session_stop_sync(void *user_data)
 {
 	struct sr_session *session;
 	struct sr_dev_inst *sdi;
+	struct session_loop *loop;
 	GSList *node;
 
 	session = user_data;
@@ -913,7 +1907,11 @@ static gboolean session_stop_sync(void *user_data)
 
 	for (node = session->devs; node; node = node->next) {
 		sdi = node->data;
-		sr_dev_acquisition_stop(sdi);
+		/* Devices with their own event loop stop in its thread. */
+		if ((loop = session_loop_find(session, sdi)))
+			g_main_context_invoke(loop->context, device_stop_sync, sdi);
+		else
+			sr_dev_acquisition_stop(sdi);
 	}
 
 	return G_SOURCE_REMOVE;
@@ -1025,6 +2023,95 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 	return SR_OK;
 }
 
+/**
+ * Set how the event sources of a session's devices are serviced.
+ *
+ * With SR_SESSION_THREADING_NONE, all event sources are dispatched from
+ * the main context of the thread which calls sr_session_start(). The other
+ * modes move the devices' event sources into event loops of their own,
+ * each running in a separate thread, so that a slow device or transport
+ * does not hold up the others. USB devices always share one loop, as
+ * libusb handles the events of all of them in one place.
+ *
+ * Datafeed callbacks are never invoked concurrently, and each device's
+ * packets arrive in the order they were sent. Packets of different devices
+ * are passed on as they come in, there is no ordering between them: a
+ * frontend which needs the samples of several devices in time order has
+ * to line them up itself, by their sample positions.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param threading One of enum sr_session_threading.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_threading_set(struct sr_session *session, int threading)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (threading < SR_SESSION_THREADING_NONE
+			|| threading > SR_SESSION_THREADING_TRANSPORT)
+		return SR_ERR_ARG;
+	if (session->running) {
+		sr_err("Cannot change threading of a running session.");
+		return SR_ERR;
+	}
+	session->threading = threading;
+
+	return SR_OK;
+}
+
+/**
+ * Set whether the devices of a session are started concurrently.
+ *
+ * By default, sr_session_start() commits the settings of each device and
+ * starts its acquisition, one device after another. With this option, the
+ * settings of the devices are committed concurrently. Once all of them
+ * succeeded, the acquisitions are started at once. This shortens the start
+ * of instruments which need several round-trips to be configured, and
+ * reduces the skew between them. See sr_dev_inst_start_time_get() for when
+ * each device was started.
+ *
+ * Devices which share an event loop, see sr_session_threading_set(), are
+ * committed and started one after another from the same thread, and so
+ * are USB devices. The drivers must tolerate being called for different
+ * devices from different threads at the same time.
+ *
+ * The packets which the drivers send while starting, SR_DF_HEADER among
+ * them, are passed to the datafeed callbacks from these threads, not from
+ * the thread which calls sr_session_start(). The callbacks still never
+ * run concurrently.
+ *
+ * @param session The session to use. Must not be NULL.
+ * @param parallel_start TRUE to start the devices concurrently.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid session passed.
+ * @retval SR_ERR_BUG The session is running.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_parallel_start_set(struct sr_session *session,
+		gboolean parallel_start)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+	if (session->running) {
+		sr_err("Cannot change the start of a running session.");
+		return SR_ERR_BUG;
+	}
+	session->parallel_start = parallel_start;
+
+	return SR_OK;
+}
+
 /**
  * Debug helper.
  *
@@ -1033,6 +2120,7 @@ SR_API int sr_session_stopped_callback_set(struct sr_session *session,
 static void datafeed_dump(const struct sr_datafeed_packet *packet)
 {
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *logic_rle;
 	const struct sr_datafeed_analog *analog;
 
 	/* Please use the same order as in libsigrok.h. */
@@ -1065,12 +2153,123 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 		sr_dbg("bus: Received SR_DF_ANALOG packet (%d samples).",
 		       analog->num_samples);
 		break;
+	case SR_DF_LOGIC_RLE:
+		logic_rle = packet->payload;
+		sr_dbg("bus: Received SR_DF_LOGIC_RLE packet (%" PRIu64
+		       " samples in %" PRIu64 " runs, unitsize = %d).",
+		       logic_rle->num_samples, logic_rle->num_runs,
+		       logic_rle->unitsize);
+		break;
 	default:
 		sr_dbg("bus: Received unknown packet type: %d.", packet->type);
 		break;
 	}
 }
 
+/** Pass a packet to one datafeed callback. */
+static void datafeed_deliver(const struct sr_dev_inst *sdi,
+		struct datafeed_callback *cb_struct,
+		const struct sr_datafeed_packet *packet)
+{
+	struct sr_datafeed_packet *packet_ref;
+
+	if (!cb_struct->queue) {
+		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+		return;
+	}
+
+	/*
+	 * The sender may reuse the packet as soon as we return, so the
+	 * worker gets a retained one. All asynchronous callbacks share it,
+	 * and the samples are only copied if the sender didn't provide a
+	 * buffer.
+	 */
+	if (sr_packet_ref(packet, &packet_ref) != SR_OK) {
+		sr_err("Failed to queue packet for asynchronous callback.");
+		return;
+	}
+	datafeed_queue_start(cb_struct);
+	if (!datafeed_queue_push(cb_struct->queue, sdi, packet_ref,
+			packet->type == SR_DF_LOGIC
+			|| packet->type == SR_DF_ANALOG
+			|| packet->type == SR_DF_LOGIC_RLE))
+		sr_packet_unref(packet_ref);
+}
+
+static gboolean logic_rle_wanted(const struct sr_session *session)
+{
+	const struct datafeed_callback *cb_struct;
+	GSList *l;
+
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		if (cb_struct->flags & SR_DF_CALLBACK_LOGIC_RLE)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static int session_dispatch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buffer);
+
+/*
+ * Expand an SR_DF_LOGIC_RLE payload into SR_DF_LOGIC packets of at most
+ * LOGIC_RLE_EXPAND_SIZE bytes. These go to one callback, or through the
+ * transforms to all callbacks if cb_struct is NULL.
+ */
+static int datafeed_deliver_expanded(const struct sr_dev_inst *sdi,
+		struct datafeed_callback *cb_struct,
+		const struct sr_datafeed_logic_rle *rle)
+{
+	struct sr_logic_rle_iter iter;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct packet_dispatch dispatch;
+	struct sr_buffer *buf;
+	uint64_t max_samples, n;
+	int ret;
+
+	if (rle->unitsize == 0) {
+		sr_err("%s: unitsize was 0", __func__);
+		return SR_ERR_ARG;
+	}
+	max_samples = MAX(LOGIC_RLE_EXPAND_SIZE / rle->unitsize, 1);
+	max_samples = MIN(max_samples, rle->num_samples);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = rle->unitsize;
+	sr_logic_rle_iter_init(&iter, rle);
+	buf = NULL;
+	ret = SR_OK;
+	while (ret == SR_OK) {
+		/* Consumers which retained the last packet keep its buffer. */
+		if (buf && sr_buffer_is_shared(buf)) {
+			sr_buffer_unref(buf);
+			buf = NULL;
+		}
+		if (!buf && !(buf = sr_buffer_new(max_samples * rle->unitsize))) {
+			ret = SR_ERR_MALLOC;
+			break;
+		}
+		if (!(n = sr_logic_rle_iter_expand(&iter, max_samples, buf->data)))
+			break;
+		logic.length = n * rle->unitsize;
+		logic.data = buf->data;
+		if (cb_struct) {
+			dispatch_begin(&dispatch, &packet, buf, NULL);
+			datafeed_deliver(sdi, cb_struct, &packet);
+			dispatch_end(&dispatch);
+		} else {
+			ret = session_dispatch(sdi, &packet, buf);
+		}
+	}
+	sr_buffer_unref(buf);
+
+	return ret;
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -1086,27 +2285,28 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
  */
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet)
+{
+	return sr_session_send_buffer(sdi, packet, NULL);
+}
+
+/* Pass a packet through the transforms to all datafeed callbacks. */
+static int dispatch_packet(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buffer)
 {
 	GSList *l;
 	struct datafeed_callback *cb_struct;
 	struct sr_datafeed_packet *packet_in, *packet_out;
 	struct sr_transform *t;
+	struct packet_dispatch dispatch;
 	int ret;
 
-	if (!sdi) {
-		sr_err("%s: sdi was NULL", __func__);
-		return SR_ERR_ARG;
-	}
-
-	if (!packet) {
-		sr_err("%s: packet was NULL", __func__);
-		return SR_ERR_ARG;
-	}
-
-	if (!sdi->session) {
-		sr_err("%s: session was NULL", __func__);
-		return SR_ERR_BUG;
-	}
+	/*
+	 * Transforms only handle dense logic data. Expand transition-encoded
+	 * data once for everybody, unless some callback takes it as is.
+	 */
+	if (packet->type == SR_DF_LOGIC_RLE && (sdi->session->transforms
+			|| !logic_rle_wanted(sdi->session)))
+		return datafeed_deliver_expanded(sdi, NULL, packet->payload);
 
 	/*
 	 * Pass the packet to the first transform module. If that returns
@@ -1143,16 +2343,354 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 	 * If the last transform did output a packet, pass it to all datafeed
 	 * callbacks.
 	 */
+	if (sdi->session->datafeed_callbacks
+			&& sr_log_loglevel_get() >= SR_LOG_DBG)
+		datafeed_dump(packet);
+	dispatch_begin(&dispatch, packet, buffer, NULL);
 	for (l = sdi->session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
 		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+		if (packet->type == SR_DF_LOGIC_RLE
+				&& !(cb_struct->flags & SR_DF_CALLBACK_LOGIC_RLE))
+			datafeed_deliver_expanded(sdi, cb_struct, packet->payload);
+		else
+			datafeed_deliver(sdi, cb_struct, packet);
 	}
+	dispatch_end(&dispatch);
 
 	return SR_OK;
 }
 
+/*
+ * Devices may send from their own event loop threads. Serialize the
+ * transforms and callbacks, which keeps each device's packets in order.
+ */
+static int session_dispatch(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buffer)
+{
+	int ret;
+
+	g_rec_mutex_lock(&sdi->session->dispatch_mutex);
+	ret = dispatch_packet(sdi, packet, buffer);
+	g_rec_mutex_unlock(&sdi->session->dispatch_mutex);
+
+	return ret;
+}
+
+static struct datafeed_stage *datafeed_stage_new(const struct sr_dev_inst *sdi)
+{
+	struct datafeed_stage *stage;
+
+	stage = g_malloc0(sizeof(*stage));
+	stage->refcount = 1;
+	stage->size = sdi->session->coalesce_size;
+	stage->latency_us = (int64_t)sdi->session->coalesce_latency_ms * 1000;
+	stage->pool = sr_buffer_pool_new(stage->size, 2);
+	stage->session = sdi->session;
+	stage->sdi = sdi;
+
+	return stage;
+}
+
+/*
+ * Pass the staged samples on as one packet. The stage is emptied before
+ * the packet is dispatched, callbacks which send more packets of the
+ * device start a new one. Called with the dispatch mutex held.
+ */
+static int datafeed_stage_flush(struct datafeed_stage *stage)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_buffer *buf;
+	int ret;
+
+	if (!stage->type)
+		return SR_OK;
+
+	buf = stage->buf;
+	stage->buf = NULL;
+	packet.type = stage->type;
+	if (stage->type == SR_DF_LOGIC) {
+		packet.payload = &logic;
+		logic.length = stage->fill;
+		logic.unitsize = stage->unitsize;
+		logic.data = buf->data;
+	} else {
+		encoding = stage->encoding;
+		meaning = stage->meaning;
+		spec = stage->spec;
+		stage->meaning.channels = NULL;
+		packet.payload = &analog;
+		analog.data = buf->data;
+		analog.num_samples = stage->num_samples;
+		analog.encoding = &encoding;
+		analog.meaning = &meaning;
+		analog.spec = &spec;
+	}
+	datafeed_stage_clear(stage);
+
+	g_atomic_int_inc(&stage->refcount);
+	ret = session_dispatch(stage->sdi, &packet, buf);
+	if (packet.type == SR_DF_ANALOG)
+		g_slist_free(meaning.channels);
+
+	/* Consumers which retained the packet keep its buffer. */
+	if (!stage->closed && !stage->buf && !sr_buffer_is_shared(buf))
+		stage->buf = buf;
+	else
+		sr_buffer_unref(buf);
+	datafeed_stage_unref(stage);
+
+	return ret;
+}
+
+static gboolean datafeed_stage_timeout(gpointer user_data)
+{
+	struct datafeed_stage *stage;
+
+	stage = user_data;
+
+	g_rec_mutex_lock(&stage->session->dispatch_mutex);
+	/* The stage may have been flushed while this waited for the lock. */
+	if (!stage->closed && stage->timer == g_main_current_source())
+		datafeed_stage_flush(stage);
+	g_rec_mutex_unlock(&stage->session->dispatch_mutex);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Flush the stage from the session main loop once the latency is due. */
+static void datafeed_stage_arm(struct datafeed_stage *stage)
+{
+	struct sr_session *session;
+
+	session = stage->session;
+
+	g_mutex_lock(&session->main_mutex);
+	if (session->main_context) {
+		stage->timer = g_timeout_source_new(stage->latency_us / 1000);
+		g_atomic_int_inc(&stage->refcount);
+		g_source_set_callback(stage->timer, datafeed_stage_timeout,
+			stage, (GDestroyNotify)datafeed_stage_unref);
+		g_source_attach(stage->timer, session->main_context);
+	}
+	g_mutex_unlock(&session->main_mutex);
+}
+
+/*
+ * Number of bytes a packet adds to a stage, or 0 if it can't be staged.
+ * Analog packets are only merged if they hold a single channel.
+ */
+static size_t datafeed_stage_length(const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		if (!logic->unitsize || logic->length % logic->unitsize)
+			return 0;
+		return logic->length;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		if (!analog->encoding || !analog->meaning || !analog->spec)
+			return 0;
+		if (!analog->meaning->channels || analog->meaning->channels->next)
+			return 0;
+		return (size_t)analog->num_samples * analog->encoding->unitsize;
+	default:
+		return 0;
+	}
+}
+
+static gboolean rational_equal(const struct sr_rational *a,
+		const struct sr_rational *b)
+{
+	return a->p == b->p && a->q == b->q;
+}
+
+/* Whether a packet continues the staged samples. */
+static gboolean datafeed_stage_continues(const struct datafeed_stage *stage,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_analog_encoding *a, *b;
+	const struct sr_analog_meaning *m;
+
+	if (packet->type != stage->type)
+		return FALSE;
+
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		return logic->unitsize == stage->unitsize;
+	}
+
+	analog = packet->payload;
+	a = &stage->encoding;
+	b = analog->encoding;
+	m = analog->meaning;
+
+	return stage->num_samples <= UINT32_MAX - analog->num_samples
+		&& a->unitsize == b->unitsize
+		&& a->is_signed == b->is_signed
+		&& a->is_float == b->is_float
+		&& a->is_bigendian == b->is_bigendian
+		&& a->digits == b->digits
+		&& a->is_digits_decimal == b->is_digits_decimal
+		&& rational_equal(&a->scale, &b->scale)
+		&& rational_equal(&a->offset, &b->offset)
+		&& m->mq == stage->meaning.mq
+		&& m->unit == stage->meaning.unit
+		&& m->mqflags == stage->meaning.mqflags
+		&& m->channels->data == stage->meaning.channels->data
+		&& analog->spec->spec_digits == stage->spec.spec_digits;
+}
+
+/* Append a packet's samples to the stage. Called with the dispatch mutex held. */
+static void datafeed_stage_append(struct datafeed_stage *stage,
+		const struct sr_datafeed_packet *packet, size_t length)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		stage->unitsize = logic->unitsize;
+		memcpy(stage->buf->data + stage->fill, logic->data, length);
+	} else {
+		analog = packet->payload;
+		if (!stage->type) {
+			stage->encoding = *analog->encoding;
+			stage->meaning = *analog->meaning;
+			stage->meaning.channels = g_slist_copy(analog->meaning->channels);
+			stage->spec = *analog->spec;
+		}
+		stage->num_samples += analog->num_samples;
+		memcpy(stage->buf->data + stage->fill, analog->data, length);
+	}
+	stage->type = packet->type;
+	stage->fill += length;
+}
+
+/*
+ * Merge a packet into the stage, or send it after the staged samples if
+ * it can't be merged.
+ */
+static int datafeed_stage_send(struct datafeed_stage *stage,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buffer)
+{
+	size_t length;
+	int64_t now;
+	int ret;
+
+	g_atomic_int_inc(&stage->refcount);
+	g_rec_mutex_lock(&stage->session->dispatch_mutex);
+
+	/* Callbacks may stage more samples while the stage is flushed. */
+	length = datafeed_stage_length(packet);
+	while (stage->type && (!length || !datafeed_stage_continues(stage, packet)
+			|| stage->fill + length > stage->size)) {
+		if ((ret = datafeed_stage_flush(stage)) != SR_OK)
+			goto out;
+	}
+
+	/* A callback removed the device while the stage was flushed. */
+	if (stage->closed) {
+		ret = SR_OK;
+		goto out;
+	}
+
+	/* Large packets gain nothing from being copied. */
+	if (!length || length >= stage->size / 2 || (!stage->buf
+			&& !(stage->buf = sr_buffer_pool_get(stage->pool)))) {
+		ret = session_dispatch(stage->sdi, packet, buffer);
+		goto out;
+	}
+
+	datafeed_stage_append(stage, packet, length);
+
+	ret = SR_OK;
+	if (stage->latency_us) {
+		now = g_get_monotonic_time();
+		if (!stage->timer && stage->fill == length) {
+			stage->first_us = now;
+			datafeed_stage_arm(stage);
+		} else if (now - stage->first_us >= stage->latency_us) {
+			ret = datafeed_stage_flush(stage);
+		}
+	}
+
+out:
+	g_rec_mutex_unlock(&stage->session->dispatch_mutex);
+	datafeed_stage_unref(stage);
+
+	return ret;
+}
+
+/**
+ * Send a packet whose sample data lives in a reference counted buffer.
+ *
+ * Consumers which retain the packet with sr_packet_ref() take a reference
+ * to @a buffer instead of copying the samples. The caller keeps its own
+ * reference; if sr_buffer_is_shared() reports the buffer as still in use
+ * afterwards, the caller must not write to it again.
+ *
+ * If the session merges small packets, the samples may be copied and
+ * passed on later, see sr_session_coalesce_set().
+ *
+ * @param sdi The device instance that generated the packet.
+ * @param packet The datafeed packet to send to the session bus.
+ * @param buffer The buffer holding the packet's sample data, or NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_send_buffer(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, struct sr_buffer *buffer)
+{
+	struct sr_dev_inst *dev;
+	int ret;
+
+	if (!sdi) {
+		sr_err("%s: sdi was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!packet) {
+		sr_err("%s: packet was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!sdi->session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	/* The stage lives from SR_DF_HEADER to SR_DF_END. */
+	dev = (struct sr_dev_inst *)sdi;
+	if (packet->type == SR_DF_HEADER) {
+		datafeed_stage_close(dev);
+		if (sdi->session->coalesce_size)
+			dev->stage = datafeed_stage_new(sdi);
+	}
+
+	if (!sdi->stage)
+		return session_dispatch(sdi, packet, buffer);
+
+	ret = datafeed_stage_send(sdi->stage, packet, buffer);
+	if (packet->type == SR_DF_END)
+		datafeed_stage_close(dev);
+
+	return ret;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -1170,6 +2708,9 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
 		void *key, GSource *source)
 {
+	unsigned int source_id;
+
+	g_mutex_lock(&session->main_mutex);
 	/*
 	 * This must not ever happen, since the source has already been
 	 * created and its finalize() method will remove the key for the
@@ -1177,15 +2718,15 @@ SR_PRIV int sr_session_source_add_internal(struct sr_session *session,
 	 * another sanity check there.)
 	 */
 	if (g_hash_table_contains(session->event_sources, key)) {
+		g_mutex_unlock(&session->main_mutex);
 		sr_err("Event source with key %p already exists.", key);
 		return SR_ERR_BUG;
 	}
 	g_hash_table_insert(session->event_sources, key, source);
+	source_id = device_source_attach(session, source);
+	g_mutex_unlock(&session->main_mutex);
 
-	if (session_source_attach(session, source) == 0)
-		return SR_ERR;
-
-	return SR_OK;
+	return (source_id != 0) ? SR_OK : SR_ERR;
 }
 
 /** @private */
@@ -1320,7 +2861,11 @@ SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 {
 	GSource *source;
 
+	g_mutex_lock(&session->main_mutex);
 	source = g_hash_table_lookup(session->event_sources, key);
+	if (source)
+		g_source_ref(source);
+	g_mutex_unlock(&session->main_mutex);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
@@ -1329,7 +2874,9 @@ SR_PRIV int sr_session_source_remove_internal(struct sr_session *session,
 		sr_warn("Cannot remove non-existing event source %p.", key);
 		return SR_ERR_BUG;
 	}
+	/* Finalizing the source unregisters it, outside of the lock. */
 	g_source_destroy(source);
+	g_source_unref(source);
 
 	return SR_OK;
 }
@@ -1416,31 +2963,37 @@ SR_PRIV int sr_session_source_destroyed(struct sr_session *session,
 		void *key, GSource *source)
 {
 	GSource *registered_source;
+	int ret;
 
+	g_mutex_lock(&session->main_mutex);
 	registered_source = g_hash_table_lookup(session->event_sources, key);
 	/*
 	 * Trying to remove an already removed event source is problematic
 	 * since the poll_object handle may have been reused in the meantime.
 	 */
 	if (!registered_source) {
+		g_mutex_unlock(&session->main_mutex);
 		sr_err("No event source for key %p found.", key);
 		return SR_ERR_BUG;
 	}
 	if (registered_source != source) {
+		g_mutex_unlock(&session->main_mutex);
 		sr_err("Event source for key %p does not match"
 			" destroyed source.", key);
 		return SR_ERR_BUG;
 	}
 	g_hash_table_remove(session->event_sources, key);
 
-	if (g_hash_table_size(session->event_sources) > 0)
-		return SR_OK;
-
 	/* If no event sources are left, consider the acquisition finished.
 	 * This is pretty crude, as it requires all event sources to be
 	 * registered via the libsigrok API.
 	 */
-	return stop_check_later(session);
+	ret = SR_OK;
+	if (g_hash_table_size(session->event_sources) == 0)
+		ret = stop_check_later(session);
+	g_mutex_unlock(&session->main_mutex);
+
+	return ret;
 }
 
 static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
@@ -1450,124 +3003,229 @@ static void copy_src(struct sr_config *src, struct sr_datafeed_meta *meta_copy)
 	                                   g_memdup(src, sizeof(struct sr_config)));
 }
 
-/** @private */
-SR_PRIV int sr_packet_copy(const struct sr_datafeed_packet *packet,
-		struct sr_datafeed_packet **copy)
+static gboolean buffer_holds(const struct sr_buffer *buf,
+		const void *data, uint64_t size)
 {
-	const struct sr_datafeed_meta *meta;
-	struct sr_datafeed_meta *meta_copy;
-	const struct sr_datafeed_logic *logic;
-	struct sr_datafeed_logic *logic_copy;
-	const struct sr_datafeed_analog *analog;
-	struct sr_datafeed_analog *analog_copy;
-	uint8_t *payload;
+	uintptr_t start, ptr;
 
-	*copy = g_malloc0(sizeof(struct sr_datafeed_packet));
-	(*copy)->type = packet->type;
+	if (!buf)
+		return FALSE;
 
-	switch (packet->type) {
-	case SR_DF_TRIGGER:
-	case SR_DF_END:
-		/* No payload. */
-		break;
-	case SR_DF_HEADER:
-		payload = g_malloc(sizeof(struct sr_datafeed_header));
-		memcpy(payload, packet->payload, sizeof(struct sr_datafeed_header));
-		(*copy)->payload = payload;
-		break;
+	start = (uintptr_t)buf->data;
+	ptr = (uintptr_t)data;
+
+	return ptr >= start && size <= buf->size
+		&& ptr - start <= buf->size - size;
+}
+
+static void packet_ref_free(struct packet_ref *ref)
+{
+	struct sr_config *src;
+	GSList *l;
+
+	switch (ref->packet.type) {
 	case SR_DF_META:
-		meta = packet->payload;
-		meta_copy = g_malloc0(sizeof(struct sr_datafeed_meta));
-		g_slist_foreach(meta->config, (GFunc)copy_src, meta_copy->config);
-		(*copy)->payload = meta_copy;
-		break;
-	case SR_DF_LOGIC:
-		logic = packet->payload;
-		logic_copy = g_malloc(sizeof(*logic_copy));
-		if (!logic_copy)
-			return SR_ERR;
-		logic_copy->length = logic->length;
-		logic_copy->unitsize = logic->unitsize;
-		logic_copy->data = g_malloc(logic->length * logic->unitsize);
-		if (!logic_copy->data) {
-			g_free(logic_copy);
-			return SR_ERR;
+		for (l = ref->payload.meta.config; l; l = l->next) {
+			src = l->data;
+			g_variant_unref(src->data);
+			g_free(src);
 		}
-		memcpy(logic_copy->data, logic->data, logic->length * logic->unitsize);
-		(*copy)->payload = logic_copy;
+		g_slist_free(ref->payload.meta.config);
 		break;
 	case SR_DF_ANALOG:
-		analog = packet->payload;
-		analog_copy = g_malloc(sizeof(*analog_copy));
-		analog_copy->data = g_malloc(
-				analog->encoding->unitsize * analog->num_samples);
-		memcpy(analog_copy->data, analog->data,
-				analog->encoding->unitsize * analog->num_samples);
-		analog_copy->num_samples = analog->num_samples;
-		analog_copy->encoding = g_memdup(analog->encoding,
-				sizeof(struct sr_analog_encoding));
-		analog_copy->meaning = g_memdup(analog->meaning,
-				sizeof(struct sr_analog_meaning));
-		analog_copy->meaning->channels = g_slist_copy(
-				analog->meaning->channels);
-		analog_copy->spec = g_memdup(analog->spec,
-				sizeof(struct sr_analog_spec));
-		(*copy)->payload = analog_copy;
+		g_slist_free(ref->payload.analog.meaning.channels);
 		break;
 	default:
-		sr_err("Unknown packet type %d", packet->type);
-		return SR_ERR;
+		break;
 	}
-
-	return SR_OK;
+	sr_buffer_unref(ref->buffer);
+	g_free(ref);
 }
 
-void sr_packet_free(struct sr_datafeed_packet *packet)
+static int packet_ref_new(const struct sr_datafeed_packet *packet,
+		struct sr_buffer *buffer, struct packet_ref **ref)
 {
+	struct packet_ref *pr;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_logic_rle *rle;
 	const struct sr_datafeed_analog *analog;
-	struct sr_config *src;
-	GSList *l;
+	const void *data;
+	uint64_t size, lengths_size, values_size;
+
+	pr = g_malloc0(sizeof(*pr));
+	pr->refcount = 1;
+	pr->packet.type = packet->type;
+	data = NULL;
+	size = 0;
 
 	switch (packet->type) {
 	case SR_DF_TRIGGER:
 	case SR_DF_END:
+	case SR_DF_FRAME_BEGIN:
+	case SR_DF_FRAME_END:
 		/* No payload. */
 		break;
 	case SR_DF_HEADER:
-		/* Payload is a simple struct. */
-		g_free((void *)packet->payload);
+		pr->payload.header = *(const struct sr_datafeed_header *)packet->payload;
+		pr->packet.payload = &pr->payload.header;
 		break;
 	case SR_DF_META:
 		meta = packet->payload;
-		for (l = meta->config; l; l = l->next) {
-			src = l->data;
-			g_variant_unref(src->data);
-			g_free(src);
-		}
-		g_slist_free(meta->config);
-		g_free((void *)packet->payload);
+		g_slist_foreach(meta->config, (GFunc)copy_src, &pr->payload.meta);
+		pr->packet.payload = &pr->payload.meta;
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		g_free(logic->data);
-		g_free((void *)packet->payload);
+		pr->payload.logic = *logic;
+		pr->packet.payload = &pr->payload.logic;
+		data = logic->data;
+		size = logic->length;
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
-		g_free(analog->data);
-		g_free(analog->encoding);
-		g_slist_free(analog->meaning->channels);
-		g_free(analog->meaning);
-		g_free(analog->spec);
-		g_free((void *)packet->payload);
+		pr->payload.analog.analog = *analog;
+		pr->payload.analog.encoding = *analog->encoding;
+		pr->payload.analog.meaning = *analog->meaning;
+		pr->payload.analog.meaning.channels =
+				g_slist_copy(analog->meaning->channels);
+		pr->payload.analog.spec = *analog->spec;
+		pr->payload.analog.analog.encoding = &pr->payload.analog.encoding;
+		pr->payload.analog.analog.meaning = &pr->payload.analog.meaning;
+		pr->payload.analog.analog.spec = &pr->payload.analog.spec;
+		pr->packet.payload = &pr->payload.analog.analog;
+		data = analog->data;
+		size = (uint64_t)analog->encoding->unitsize * analog->num_samples;
+		break;
+	case SR_DF_LOGIC_RLE:
+		rle = packet->payload;
+		pr->payload.logic_rle = *rle;
+		pr->packet.payload = &pr->payload.logic_rle;
+		lengths_size = rle->num_runs * sizeof(rle->lengths[0]);
+		values_size = rle->num_runs * rle->unitsize;
+		if (buffer_holds(buffer, rle->lengths, lengths_size)
+				&& buffer_holds(buffer, rle->values, values_size)) {
+			pr->buffer = sr_buffer_ref(buffer);
+			break;
+		}
+		/* Both arrays go into one copy, the lengths first. */
+		if (!(pr->buffer = sr_buffer_new(lengths_size + values_size))) {
+			sr_err("Failed to allocate %" PRIu64 " bytes for packet.",
+					lengths_size + values_size);
+			packet_ref_free(pr);
+			return SR_ERR_MALLOC;
+		}
+		memcpy(pr->buffer->data, rle->lengths, lengths_size);
+		memcpy(pr->buffer->data + lengths_size, rle->values, values_size);
+		pr->payload.logic_rle.lengths = (uint64_t *)pr->buffer->data;
+		pr->payload.logic_rle.values = pr->buffer->data + lengths_size;
 		break;
 	default:
 		sr_err("Unknown packet type %d", packet->type);
+		g_free(pr);
+		return SR_ERR_ARG;
+	}
+
+	if (data) {
+		if (buffer_holds(buffer, data, size)) {
+			pr->buffer = sr_buffer_ref(buffer);
+		} else if ((pr->buffer = sr_buffer_new(size))) {
+			memcpy(pr->buffer->data, data, size);
+			data = pr->buffer->data;
+		} else {
+			sr_err("Failed to allocate %" PRIu64 " bytes for packet.",
+					size);
+			packet_ref_free(pr);
+			return SR_ERR_MALLOC;
+		}
+		if (packet->type == SR_DF_LOGIC)
+			pr->payload.logic.data = (void *)data;
+		else
+			pr->payload.analog.analog.data = (void *)data;
+	}
+
+	*ref = pr;
+
+	return SR_OK;
+}
+
+/**
+ * Retain a datafeed packet beyond the callback it was passed to.
+ *
+ * The sample data is shared with the sender if it was sent from a
+ * reference counted buffer, and with any other consumer which retained
+ * the same packet. Otherwise the samples are copied once.
+ *
+ * Sharing is only possible while the datafeed callback that received
+ * @a packet is running; called from elsewhere, this always copies.
+ *
+ * The returned packet and its payload must be treated as read-only.
+ *
+ * @param packet The packet to retain. Must not be NULL.
+ * @param ref Will be set to the retained packet, which is to be released
+ *            with sr_packet_unref(). Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Out of memory.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_packet_ref(const struct sr_datafeed_packet *packet,
+		struct sr_datafeed_packet **ref)
+{
+	struct packet_dispatch *dispatch;
+	struct packet_ref *pr;
+	int ret;
+
+	if (!packet || !ref)
+		return SR_ERR_ARG;
+
+	for (dispatch = g_private_get(&current_dispatch); dispatch;
+			dispatch = dispatch->prev) {
+		if (dispatch->packet == packet)
+			break;
+	}
+
+	if (dispatch && dispatch->ref) {
+		g_atomic_int_inc(&dispatch->ref->refcount);
+		*ref = &dispatch->ref->packet;
+		return SR_OK;
 	}
-	g_free(packet);
 
+	ret = packet_ref_new(packet, dispatch ? dispatch->buffer : NULL, &pr);
+	if (ret != SR_OK)
+		return ret;
+
+	if (dispatch) {
+		/* Let further consumers of this packet share it. */
+		g_atomic_int_inc(&pr->refcount);
+		dispatch->ref = pr;
+	}
+	*ref = &pr->packet;
+
+	return SR_OK;
+}
+
+/**
+ * Release a packet retained with sr_packet_ref().
+ *
+ * May be called from any thread.
+ *
+ * @param packet The packet to release. NULL is ignored.
+ *
+ * @since 0.6.0
+ */
+SR_API void sr_packet_unref(struct sr_datafeed_packet *packet)
+{
+	struct packet_ref *ref;
+
+	if (!packet)
+		return;
+
+	ref = (struct packet_ref *)packet;
+	if (g_atomic_int_dec_and_test(&ref->refcount))
+		packet_ref_free(ref);
 }
 
 /** @} */
@@ -23,7 +23,6 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
-#include <zip.h>
 #include <libsigrok/libsigrok.h>
 #include "libsigrok-internal.h"
 
@@ -39,16 +38,16 @@ SR_PRIV struct sr_dev_driver session_driver_info;
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
-	struct zip *archive;
-	struct zip_file *capfile;
-	int bytes_read;
+	struct sr_session_reader *reader;
 	uint64_t samplerate;
 	int unitsize;
 	int num_logic_channels;
 	int num_analog_channels;
 	int cur_analog_channel;
 	GArray *analog_channels;
-	int cur_chunk;
+	/* Next sample of the logic data or current analog channel. */
+	uint64_t cur_sample;
+	float *analog_buf;
 	gboolean finished;
 };
 
@@ -70,134 +69,68 @@ static gboolean stream_session_data(struct sr_dev_inst *sdi)
 	struct sr_analog_encoding encoding;
 	struct sr_analog_meaning meaning;
 	struct sr_analog_spec spec;
-	struct zip_stat zs;
-	int ret, got_data;
-	char capturefile[128];
-	void *buf;
+	const uint8_t *data;
+	uint64_t count;
+	unsigned int index;
 
-	got_data = FALSE;
 	vdev = sdi->priv;
 
-	if (!vdev->capfile) {
-		/* No capture file opened yet, or finished with the last
-		 * chunked one. */
-		if (vdev->capturefile && (vdev->cur_chunk == 0)) {
-			/* capturefile is always the unchunked base name. */
-			if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-				/* No chunks, just a single capture file. */
-				vdev->cur_chunk = 0;
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						vdev->capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", vdev->capturefile);
-			} else {
-				/* Try as first chunk filename. */
-				snprintf(capturefile, sizeof(capturefile) - 1, "%s-1", vdev->capturefile);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					vdev->cur_chunk = 1;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					sr_err("No capture file '%s' in " "session file '%s'.",
-							vdev->capturefile, vdev->sessionfile);
-					return FALSE;
-				}
-			}
-		} else {
-			/* Capture data is chunked, advance to the next chunk. */
-			vdev->cur_chunk++;
-			snprintf(capturefile, sizeof(capturefile) - 1, "%s-%d", vdev->capturefile,
-					vdev->cur_chunk);
-			if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-				if (!(vdev->capfile = zip_fopen(vdev->archive,
-						capturefile, 0)))
-					return FALSE;
-				sr_dbg("Opened %s.", capturefile);
-			} else if (vdev->cur_analog_channel < vdev->num_analog_channels) {
-				vdev->capturefile = g_strdup_printf("analog-1-%d",
-						vdev->num_logic_channels + vdev->cur_analog_channel + 1);
-				vdev->cur_analog_channel++;
-				vdev->cur_chunk = 0;
-				return TRUE;
-			} else {
-				/* We got all the chunks, finish up. */
-				g_free(vdev->capturefile);
-
-				/* If the file has logic channels, the initial value for
-				 * capturefile is set by stream_session_data() - however only
-				 * once. In order to not mess this mechanism up, we simulate
-				 * this here if needed. For purely analog files, capturefile
-				 * is not set.
-				 */
-				if (vdev->num_logic_channels)
-					vdev->capturefile = g_strdup("logic-1");
-				else
-					vdev->capturefile = NULL;
+	/* The logic data comes first, then one analog channel after another. */
+	if (vdev->cur_analog_channel == 0) {
+		if (vdev->capturefile && vdev->unitsize) {
+			/* Send right from the mapped file where possible. */
+			if (sr_session_reader_logic_map(vdev->reader,
+					vdev->cur_sample, &data, &count) != SR_OK)
 				return FALSE;
+			if (count > 0) {
+				count = MIN(count, CHUNKSIZE / vdev->unitsize);
+				packet.type = SR_DF_LOGIC;
+				packet.payload = &logic;
+				logic.length = count * vdev->unitsize;
+				logic.unitsize = vdev->unitsize;
+				logic.data = (void *)data;
+				sr_session_send(sdi, &packet);
+				vdev->cur_sample += count;
+				return TRUE;
 			}
 		}
+		vdev->cur_analog_channel = 1;
+		vdev->cur_sample = 0;
 	}
 
-	buf = g_malloc(CHUNKSIZE);
-
-	/* unitsize is not defined for purely analog session files. */
-	if (vdev->unitsize)
-		ret = zip_fread(vdev->capfile, buf,
-				CHUNKSIZE / vdev->unitsize * vdev->unitsize);
-	else
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
-
-	if (ret > 0) {
-		if (vdev->cur_analog_channel != 0) {
-			got_data = TRUE;
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			/* TODO: Use proper 'digits' value for this device (and its modes). */
-			sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
-			analog.meaning->channels = g_slist_prepend(NULL,
-					g_array_index(vdev->analog_channels,
-						struct sr_channel *, vdev->cur_analog_channel - 1));
-			analog.num_samples = ret / sizeof(float);
-			analog.meaning->mq = SR_MQ_VOLTAGE;
-			analog.meaning->unit = SR_UNIT_VOLT;
-			analog.meaning->mqflags = SR_MQFLAG_DC;
-			analog.data = (float *) buf;
-		} else if (vdev->unitsize) {
-			got_data = TRUE;
-			if (ret % vdev->unitsize != 0)
-				sr_warn("Read size %d not a multiple of the"
-					" unit size %d.", ret, vdev->unitsize);
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = ret;
-			logic.unitsize = vdev->unitsize;
-			logic.data = buf;
-		} else {
-			/*
-			 * Neither analog data, nor logic which has
-			 * unitsize, must be an unexpected API use.
-			 */
-			sr_warn("Neither analog nor logic data. Ignoring.");
-		}
-		if (got_data) {
-			vdev->bytes_read += ret;
-			sr_session_send(sdi, &packet);
-		}
-	} else {
-		/* done with this capture file */
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-		if (vdev->cur_chunk != 0) {
-			/* There might be more chunks, so don't fall through
-			 * to the SR_DF_END here. */
-			got_data = TRUE;
+	while (vdev->cur_analog_channel <= (int)vdev->analog_channels->len) {
+		index = vdev->cur_analog_channel - 1;
+		count = sr_session_reader_analog_samples_get(vdev->reader, index)
+			- vdev->cur_sample;
+		if (count == 0) {
+			vdev->cur_analog_channel++;
+			vdev->cur_sample = 0;
+			continue;
 		}
+		count = MIN(count, CHUNKSIZE / sizeof(float));
+		if (sr_session_reader_analog_read(vdev->reader, index,
+				vdev->cur_sample, count, vdev->analog_buf) != SR_OK)
+			return FALSE;
+
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		/* TODO: Use proper 'digits' value for this device (and its modes). */
+		sr_analog_init(&analog, &encoding, &meaning, &spec, 2);
+		analog.meaning->channels = g_slist_prepend(NULL,
+				g_array_index(vdev->analog_channels,
+					struct sr_channel *, index));
+		analog.num_samples = count;
+		analog.meaning->mq = SR_MQ_VOLTAGE;
+		analog.meaning->unit = SR_UNIT_VOLT;
+		analog.meaning->mqflags = SR_MQFLAG_DC;
+		analog.data = vdev->analog_buf;
+		sr_session_send(sdi, &packet);
+		g_slist_free(analog.meaning->channels);
+		vdev->cur_sample += count;
+		return TRUE;
 	}
-	g_free(buf);
 
-	return got_data;
+	return FALSE;
 }
 
 static int receive_data(int fd, int revents, void *cb_data)
@@ -216,14 +149,12 @@ static int receive_data(int fd, int revents, void *cb_data)
 	if (!vdev->finished)
 		return G_SOURCE_CONTINUE;
 
-	if (vdev->capfile) {
-		zip_fclose(vdev->capfile);
-		vdev->capfile = NULL;
-	}
-	if (vdev->archive) {
-		zip_discard(vdev->archive);
-		vdev->archive = NULL;
-	}
+	sr_session_reader_close(vdev->reader);
+	vdev->reader = NULL;
+	g_free(vdev->analog_buf);
+	vdev->analog_buf = NULL;
+	g_array_free(vdev->analog_channels, TRUE);
+	vdev->analog_channels = NULL;
 
 	std_session_send_df_end(sdi);
 
@@ -339,8 +270,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 	struct sr_channel *ch;
 
 	vdev = sdi->priv;
-	vdev->bytes_read = 0;
 	vdev->cur_analog_channel = 0;
+	vdev->cur_sample = 0;
 	vdev->analog_channels = g_array_sized_new(FALSE, FALSE,
 			sizeof(struct sr_channel *), vdev->num_analog_channels);
 	for (l = sdi->channels; l; l = l->next) {
@@ -348,17 +279,20 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi)
 		if (ch->type == SR_CHANNEL_ANALOG)
 			g_array_append_val(vdev->analog_channels, ch);
 	}
-	vdev->cur_chunk = 0;
 	vdev->finished = FALSE;
 
 	sr_info("Opening archive %s file %s", vdev->sessionfile,
 		vdev->capturefile);
 
-	if (!(vdev->archive = zip_open(vdev->sessionfile, 0, &ret))) {
-		sr_err("Failed to open session file '%s': "
-		       "zip error %d.", vdev->sessionfile, ret);
-		return SR_ERR;
+	if ((ret = sr_session_reader_open(vdev->sessionfile,
+			&vdev->reader)) != SR_OK) {
+		sr_err("Failed to open session file '%s'.", vdev->sessionfile);
+		g_array_free(vdev->analog_channels, TRUE);
+		vdev->analog_channels = NULL;
+		return ret;
 	}
+	if (vdev->analog_channels->len > 0)
+		vdev->analog_buf = g_malloc(CHUNKSIZE);
 
 	std_session_send_df_header(sdi);
 
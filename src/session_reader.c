@@ -0,0 +1,1026 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <zlib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "session-reader"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Random access to the sample data in session files.
+ */
+
+/**
+ * @addtogroup grp_session
+ *
+ * @{
+ */
+
+#define ZIP_LOCAL_HEADER	0x04034b50
+#define ZIP_CENTRAL_HEADER	0x02014b50
+#define ZIP_END_OF_DIR		0x06054b50
+#define ZIP64_END_OF_DIR	0x06064b50
+#define ZIP64_END_LOCATOR	0x07064b50
+#define ZIP64_EXTRA		0x0001
+
+#define ZIP_STORE		0
+#define ZIP_DEFLATE		8
+#define ZIP_ENCRYPTED		0x0001
+
+#define ZIP_MAX16		0xffff
+#define ZIP_MAX32		0xffffffff
+
+/* An archive entry, located in the mapped file. */
+struct reader_entry {
+	const uint8_t *data;
+	uint64_t compressed_size;
+	uint64_t size;
+	uint16_t method;
+};
+
+/* One chunk of a logic or analog data stream. */
+struct reader_chunk {
+	unsigned int chunk_num;
+	uint64_t first_sample;
+	uint64_t num_samples;
+	struct reader_entry entry;
+};
+
+/* The chunks of one data stream, ordered by sample number. */
+struct reader_stream {
+	GArray *chunks;
+	size_t sample_size;
+	uint64_t num_samples;
+	/* The last inflated chunk, -1 if none. */
+	int cached_chunk;
+	uint8_t *cache;
+	size_t cache_size;
+};
+
+/** @private */
+struct sr_session_reader {
+	GMappedFile *file;
+	const uint8_t *base;
+	uint64_t length;
+	uint64_t samplerate;
+	unsigned int unitsize;
+	unsigned int num_logic_channels;
+	unsigned int num_analog_channels;
+	/* Name of the logic chunks, NULL if there are none. */
+	char *logic_name;
+	char *logic_overview_name;
+	/* Channel number in the name of the first analog channel's chunks. */
+	unsigned int first_analog;
+	struct reader_stream logic;
+	struct reader_stream *analog;
+	/* Overview levels, see overview.c. */
+	unsigned int num_levels;
+	uint64_t *block_sizes;
+	/* Per level, and per analog channel and level. */
+	struct reader_stream *logic_overview;
+	struct reader_stream *analog_overview;
+};
+
+static void stream_init(struct reader_stream *stream, size_t sample_size)
+{
+	stream->chunks = g_array_new(FALSE, FALSE, sizeof(struct reader_chunk));
+	stream->sample_size = sample_size;
+	stream->cached_chunk = -1;
+}
+
+static void stream_clear(struct reader_stream *stream)
+{
+	if (stream->chunks)
+		g_array_free(stream->chunks, TRUE);
+	g_free(stream->cache);
+}
+
+static gint chunk_cmp(gconstpointer a, gconstpointer b)
+{
+	const struct reader_chunk *ca, *cb;
+
+	ca = a;
+	cb = b;
+
+	return (ca->chunk_num > cb->chunk_num) - (ca->chunk_num < cb->chunk_num);
+}
+
+/* Order the chunks and work out which samples each one holds. */
+static int stream_index(struct reader_stream *stream)
+{
+	struct reader_chunk *chunk;
+	unsigned int i;
+
+	g_array_sort(stream->chunks, chunk_cmp);
+	stream->num_samples = 0;
+	for (i = 0; i < stream->chunks->len; i++) {
+		chunk = &g_array_index(stream->chunks, struct reader_chunk, i);
+		if (i > 0 && chunk->chunk_num == (chunk - 1)->chunk_num) {
+			sr_err("Duplicate chunk %u.", chunk->chunk_num);
+			return SR_ERR_DATA;
+		}
+		if (chunk->entry.size % stream->sample_size)
+			sr_warn("Chunk %u size %" PRIu64 " not a multiple of "
+				"the sample size %zu.", chunk->chunk_num,
+				chunk->entry.size, stream->sample_size);
+		chunk->first_sample = stream->num_samples;
+		chunk->num_samples = chunk->entry.size / stream->sample_size;
+		stream->num_samples += chunk->num_samples;
+	}
+
+	return SR_OK;
+}
+
+/* Find the chunk holding a sample, by binary search. */
+static int stream_find(const struct reader_stream *stream, uint64_t sample)
+{
+	const struct reader_chunk *chunk;
+	unsigned int lo, hi, mid;
+
+	lo = 0;
+	hi = stream->chunks->len;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		chunk = &g_array_index(stream->chunks, struct reader_chunk, mid);
+		if (sample < chunk->first_sample)
+			hi = mid;
+		else if (sample >= chunk->first_sample + chunk->num_samples)
+			lo = mid + 1;
+		else
+			return mid;
+	}
+
+	return -1;
+}
+
+/*
+ * Get the uncompressed contents of an entry. Stored entries are used
+ * right from the mapped file, others are inflated into *buf, which is
+ * (re)allocated if it is smaller than the entry.
+ */
+static const uint8_t *entry_contents(const struct reader_entry *entry,
+		uint8_t **buf, size_t *buf_size)
+{
+	z_stream zs;
+	int ret;
+
+	if (entry->method == ZIP_STORE)
+		return entry->data;
+
+	/* zlib takes 32-bit sizes, chunks are much smaller than that. */
+	if (entry->size > G_MAXUINT || entry->compressed_size > G_MAXUINT)
+		return NULL;
+	if (*buf_size < MAX(entry->size, 1)) {
+		g_free(*buf);
+		*buf_size = 0;
+		if (!(*buf = g_try_malloc(MAX(entry->size, 1))))
+			return NULL;
+		*buf_size = MAX(entry->size, 1);
+	}
+
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+		return NULL;
+	zs.next_in = (Bytef *)entry->data;
+	zs.avail_in = entry->compressed_size;
+	zs.next_out = *buf;
+	zs.avail_out = entry->size;
+	ret = inflate(&zs, Z_FINISH);
+	inflateEnd(&zs);
+	if (ret != Z_STREAM_END || zs.total_out != entry->size) {
+		sr_err("Failed to inflate archive entry.");
+		return NULL;
+	}
+
+	return *buf;
+}
+
+/* Get the contents of a chunk, inflating it into the cache if needed. */
+static const uint8_t *chunk_contents(struct reader_stream *stream, int index)
+{
+	const struct reader_chunk *chunk;
+	const uint8_t *data;
+
+	chunk = &g_array_index(stream->chunks, struct reader_chunk, index);
+	if (chunk->entry.method == ZIP_STORE)
+		return chunk->entry.data;
+	if (stream->cached_chunk == index)
+		return stream->cache;
+
+	stream->cached_chunk = -1;
+	data = entry_contents(&chunk->entry, &stream->cache, &stream->cache_size);
+	if (!data)
+		return NULL;
+	stream->cached_chunk = index;
+
+	return data;
+}
+
+/* Find the start of the entry data from its local header. */
+static int locate_entry(const struct sr_session_reader *reader,
+		uint64_t header_offset, struct reader_entry *entry)
+{
+	const uint8_t *p;
+	uint64_t offset;
+
+	if (header_offset > reader->length || reader->length - header_offset < 30)
+		return SR_ERR_DATA;
+	p = reader->base + header_offset;
+	if (RL32(p) != ZIP_LOCAL_HEADER)
+		return SR_ERR_DATA;
+
+	offset = header_offset + 30 + RL16(p + 26) + RL16(p + 28);
+	if (offset > reader->length
+			|| reader->length - offset < entry->compressed_size)
+		return SR_ERR_DATA;
+	entry->data = reader->base + offset;
+
+	return SR_OK;
+}
+
+/* Find the central directory from the end of the archive. */
+static int find_central_dir(const struct sr_session_reader *reader,
+		uint64_t *dir_offset, uint64_t *num_entries)
+{
+	const uint8_t *p, *end;
+	uint64_t offset;
+
+	if (reader->length < 22)
+		return SR_ERR_DATA;
+
+	/* The end record is followed by a comment of up to 64 KiB. */
+	end = reader->base + reader->length - 22;
+	for (p = end; p >= reader->base && end - p <= ZIP_MAX16; p--) {
+		if (RL32(p) == ZIP_END_OF_DIR && RL16(p + 20) == end - p)
+			break;
+	}
+	if (p < reader->base || end - p > ZIP_MAX16)
+		return SR_ERR_DATA;
+
+	*num_entries = RL16(p + 10);
+	*dir_offset = RL32(p + 16);
+
+	/* A ZIP64 locator right before the end record points to the
+	 * ZIP64 end record, which has the real values. */
+	if (p - reader->base >= 20 && RL32(p - 20) == ZIP64_END_LOCATOR) {
+		offset = RL64(p - 12);
+		if (offset > reader->length || reader->length - offset < 56)
+			return SR_ERR_DATA;
+		p = reader->base + offset;
+		if (RL32(p) != ZIP64_END_OF_DIR)
+			return SR_ERR_DATA;
+		*num_entries = RL64(p + 32);
+		*dir_offset = RL64(p + 48);
+	}
+
+	if (*dir_offset > reader->length)
+		return SR_ERR_DATA;
+
+	return SR_OK;
+}
+
+/* Get the sizes and offset from a ZIP64 extra field where needed. */
+static int read_zip64_extra(const uint8_t *extra, unsigned int extra_len,
+		uint64_t *size, uint64_t *compressed_size, uint64_t *offset)
+{
+	uint64_t *fields[3];
+	unsigned int id, len, i, n;
+
+	n = 0;
+	if (*size == ZIP_MAX32)
+		fields[n++] = size;
+	if (*compressed_size == ZIP_MAX32)
+		fields[n++] = compressed_size;
+	if (*offset == ZIP_MAX32)
+		fields[n++] = offset;
+	if (n == 0)
+		return SR_OK;
+
+	while (extra_len >= 4) {
+		id = RL16(extra);
+		len = RL16(extra + 2);
+		if (len > extra_len - 4)
+			break;
+		if (id == ZIP64_EXTRA && len >= n * 8) {
+			for (i = 0; i < n; i++)
+				*fields[i] = RL64(extra + 4 + i * 8);
+			return SR_OK;
+		}
+		extra += 4 + len;
+		extra_len -= 4 + len;
+	}
+
+	return SR_ERR_DATA;
+}
+
+/*
+ * Get the numbers following the prefix of a chunk name, as in
+ * "<prefix>-<n1>-<n2>". Returns how many there are, or -1 if the name
+ * does not have this form.
+ */
+static int parse_name(const char *name, const char *prefix,
+		unsigned long *nums, int max_nums)
+{
+	size_t len;
+	char *end;
+	int n;
+
+	len = strlen(prefix);
+	if (strncmp(name, prefix, len))
+		return -1;
+	name += len;
+	for (n = 0; *name == '-' && n < max_nums; n++) {
+		if (!g_ascii_isdigit(name[1]))
+			return -1;
+		nums[n] = strtoul(name + 1, &end, 10);
+		name = end;
+	}
+
+	return *name == '\0' ? n : -1;
+}
+
+/* Find the stream a chunk belongs to, by its name. */
+static struct reader_stream *find_stream(struct sr_session_reader *reader,
+		const char *name, unsigned long *chunk_num)
+{
+	unsigned long nums[3], ch;
+	unsigned int levels;
+
+	levels = reader->num_levels;
+	if (reader->logic_name) {
+		switch (parse_name(name, reader->logic_name, nums, 1)) {
+		case 0:
+			/* The data is not split into chunks. */
+			*chunk_num = 1;
+			return &reader->logic;
+		case 1:
+			*chunk_num = nums[0];
+			return &reader->logic;
+		}
+		if (parse_name(name, reader->logic_overview_name, nums, 2) == 2
+				&& nums[0] < levels) {
+			*chunk_num = nums[1];
+			return &reader->logic_overview[nums[0]];
+		}
+	}
+
+	if (parse_name(name, "analog-1", nums, 2) == 2) {
+		ch = nums[0] - reader->first_analog;
+		if (nums[0] >= reader->first_analog
+				&& ch < reader->num_analog_channels) {
+			*chunk_num = nums[1];
+			return &reader->analog[ch];
+		}
+	} else if (parse_name(name, "overview-analog-1", nums, 3) == 3) {
+		ch = nums[0] - reader->first_analog;
+		if (nums[0] >= reader->first_analog
+				&& ch < reader->num_analog_channels
+				&& nums[1] < levels) {
+			*chunk_num = nums[2];
+			return &reader->analog_overview[ch * levels + nums[1]];
+		}
+	}
+
+	return NULL;
+}
+
+/* Add an entry to the stream it is a chunk of, if any. */
+static int add_chunk(struct sr_session_reader *reader, const char *name,
+		const struct reader_entry *entry)
+{
+	struct reader_stream *stream;
+	struct reader_chunk chunk;
+	unsigned long chunk_num;
+
+	if (!(stream = find_stream(reader, name, &chunk_num)) || chunk_num == 0
+			|| chunk_num > G_MAXUINT)
+		return SR_OK;
+
+	if (entry->method != ZIP_STORE && entry->method != ZIP_DEFLATE) {
+		sr_err("Unsupported compression method %d in '%s'.",
+			entry->method, name);
+		return SR_ERR_DATA;
+	}
+	chunk.chunk_num = chunk_num;
+	chunk.entry = *entry;
+	g_array_append_val(stream->chunks, chunk);
+
+	return SR_OK;
+}
+
+/*
+ * Walk the central directory to find the metadata and index the chunks.
+ * Only chunks of streams which were set up in the reader are indexed.
+ */
+static int read_central_dir(struct sr_session_reader *reader,
+		struct reader_entry *metadata)
+{
+	struct reader_entry entry;
+	const uint8_t *p;
+	uint64_t dir_offset, num_entries, i, offset;
+	unsigned int name_len, extra_len, comment_len, flags;
+	char *name;
+	int ret;
+
+	if ((ret = find_central_dir(reader, &dir_offset, &num_entries)) != SR_OK)
+		return ret;
+
+	p = reader->base + dir_offset;
+	for (i = 0; i < num_entries; i++) {
+		if (reader->base + reader->length - p < 46
+				|| RL32(p) != ZIP_CENTRAL_HEADER)
+			return SR_ERR_DATA;
+		flags = RL16(p + 8);
+		entry.method = RL16(p + 10);
+		entry.compressed_size = RL32(p + 20);
+		entry.size = RL32(p + 24);
+		name_len = RL16(p + 28);
+		extra_len = RL16(p + 30);
+		comment_len = RL16(p + 32);
+		offset = RL32(p + 42);
+		if ((uint64_t)(reader->base + reader->length - p)
+				< 46 + name_len + extra_len + comment_len)
+			return SR_ERR_DATA;
+		if (read_zip64_extra(p + 46 + name_len, extra_len, &entry.size,
+				&entry.compressed_size, &offset) != SR_OK)
+			return SR_ERR_DATA;
+		if (locate_entry(reader, offset, &entry) != SR_OK)
+			return SR_ERR_DATA;
+
+		name = g_strndup((const char *)p + 46, name_len);
+		ret = SR_OK;
+		if (flags & ZIP_ENCRYPTED) {
+			sr_err("Encrypted entry '%s'.", name);
+			ret = SR_ERR_DATA;
+		} else if (!strcmp(name, "metadata")) {
+			*metadata = entry;
+		} else {
+			ret = add_chunk(reader, name, &entry);
+		}
+		g_free(name);
+		if (ret != SR_OK)
+			return ret;
+
+		p += 46 + name_len + extra_len + comment_len;
+	}
+
+	return SR_OK;
+}
+
+static GKeyFile *read_metadata(const struct reader_entry *entry)
+{
+	GKeyFile *kf;
+	GError *error;
+	const uint8_t *data;
+	uint8_t *buf;
+	size_t buf_size;
+
+	buf = NULL;
+	buf_size = 0;
+	if (!(data = entry_contents(entry, &buf, &buf_size))) {
+		g_free(buf);
+		return NULL;
+	}
+
+	kf = g_key_file_new();
+	error = NULL;
+	g_key_file_load_from_data(kf, (const char *)data, entry->size,
+			G_KEY_FILE_NONE, &error);
+	g_free(buf);
+	if (error) {
+		sr_err("Failed to parse metadata: %s", error->message);
+		g_error_free(error);
+		g_key_file_free(kf);
+		return NULL;
+	}
+
+	return kf;
+}
+
+/**
+ * Open a session file for random access to its sample data.
+ *
+ * The file is mapped into memory and only the archive directory is read,
+ * which makes opening independent of the size of the capture. Samples
+ * are read with sr_session_reader_logic_read(),
+ * sr_session_reader_logic_map() and sr_session_reader_analog_read().
+ *
+ * @param filename The name of the session file. Must not be NULL.
+ * @param reader Pointer to store the new reader in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO The file could not be mapped.
+ * @retval SR_ERR_DATA The file is not a valid session file.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_reader_open(const char *filename,
+		struct sr_session_reader **reader)
+{
+	struct sr_session_reader *r;
+	struct reader_entry metadata;
+	GMappedFile *file;
+	GKeyFile *kf;
+	GError *error;
+	char *val;
+	gint *block_sizes;
+	gsize num_levels;
+	unsigned int i, j;
+	int num_analog, ret;
+
+	if (!filename || !reader)
+		return SR_ERR_ARG;
+	*reader = NULL;
+
+	if ((ret = sr_sessionfile_check(filename)) != SR_OK)
+		return SR_ERR_DATA;
+
+	error = NULL;
+	/* The session driver sends logic data straight from the mapping. */
+	if (!(file = sr_file_map_private(filename, &error))) {
+		sr_err("Failed to map '%s': %s.", filename, error->message);
+		g_error_free(error);
+		return SR_ERR_IO;
+	}
+
+	r = g_malloc0(sizeof(*r));
+	r->file = file;
+	r->base = (const uint8_t *)g_mapped_file_get_contents(file);
+	r->length = g_mapped_file_get_length(file);
+
+	/* Find the metadata first, it says which chunks to look for. */
+	metadata.data = NULL;
+	if ((ret = read_central_dir(r, &metadata)) != SR_OK
+			|| !metadata.data) {
+		sr_err("Invalid session file '%s'.", filename);
+		sr_session_reader_close(r);
+		return SR_ERR_DATA;
+	}
+	if (!(kf = read_metadata(&metadata))) {
+		sr_session_reader_close(r);
+		return SR_ERR_DATA;
+	}
+
+	if ((val = g_key_file_get_string(kf, "device 1", "samplerate", NULL))) {
+		sr_parse_sizestring(val, &r->samplerate);
+		g_free(val);
+	}
+	r->logic_name = g_key_file_get_string(kf, "device 1", "capturefile", NULL);
+	if (r->logic_name) {
+		r->unitsize = MAX(g_key_file_get_integer(kf, "device 1",
+				"unitsize", NULL), 0);
+		r->num_logic_channels = MAX(g_key_file_get_integer(kf,
+				"device 1", "total probes", NULL), 0);
+	}
+	/* Without unitsize, the logic data can't be split into samples. */
+	if (r->unitsize == 0) {
+		g_free(r->logic_name);
+		r->logic_name = NULL;
+	} else {
+		r->logic_overview_name = g_strconcat("overview-",
+				r->logic_name, NULL);
+	}
+	num_analog = g_key_file_get_integer(kf, "device 1", "total analog", NULL);
+	r->num_analog_channels = MAX(num_analog, 0);
+	/* Analog channels are numbered after all logic channels. */
+	r->first_analog = r->num_logic_channels + 1;
+
+	block_sizes = g_key_file_get_integer_list(kf, "device 1", "overview",
+			&num_levels, NULL);
+	r->block_sizes = g_malloc0(sizeof(uint64_t) * MAX(num_levels, 1));
+	for (i = 0; i < num_levels && block_sizes[i] > 0; i++)
+		r->block_sizes[i] = block_sizes[i];
+	r->num_levels = i;
+	g_free(block_sizes);
+	g_key_file_free(kf);
+
+	stream_init(&r->logic, MAX(r->unitsize, 1));
+	r->analog = g_malloc0(sizeof(*r->analog) * MAX(r->num_analog_channels, 1));
+	for (i = 0; i < r->num_analog_channels; i++)
+		stream_init(&r->analog[i], sizeof(float));
+	/* Overview records are a pair of samples. */
+	r->logic_overview = g_malloc0(sizeof(*r->logic_overview)
+			* MAX(r->num_levels, 1));
+	r->analog_overview = g_malloc0(sizeof(*r->analog_overview)
+			* MAX(r->num_analog_channels * r->num_levels, 1));
+	for (i = 0; i < r->num_levels; i++) {
+		stream_init(&r->logic_overview[i], 2 * MAX(r->unitsize, 1));
+		for (j = 0; j < r->num_analog_channels; j++)
+			stream_init(&r->analog_overview[j * r->num_levels + i],
+					2 * sizeof(float));
+	}
+
+	ret = read_central_dir(r, &metadata);
+	if (ret == SR_OK)
+		ret = stream_index(&r->logic);
+	for (i = 0; ret == SR_OK && i < r->num_analog_channels; i++)
+		ret = stream_index(&r->analog[i]);
+	for (i = 0; ret == SR_OK && i < r->num_levels; i++)
+		ret = stream_index(&r->logic_overview[i]);
+	for (i = 0; ret == SR_OK && i < r->num_analog_channels * r->num_levels; i++)
+		ret = stream_index(&r->analog_overview[i]);
+	if (ret != SR_OK) {
+		sr_err("Invalid session file '%s'.", filename);
+		sr_session_reader_close(r);
+		return SR_ERR_DATA;
+	}
+
+	sr_dbg("Indexed %" PRIu64 " logic samples and %u analog channels "
+		"of '%s'.", r->logic.num_samples, r->num_analog_channels,
+		filename);
+	*reader = r;
+
+	return SR_OK;
+}
+
+/**
+ * Close a session file reader.
+ *
+ * Pointers returned by sr_session_reader_logic_map() become invalid.
+ *
+ * @param reader The reader. NULL is ignored.
+ *
+ * @retval SR_OK Success.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_reader_close(struct sr_session_reader *reader)
+{
+	unsigned int i;
+
+	if (!reader)
+		return SR_OK;
+
+	stream_clear(&reader->logic);
+	if (reader->analog) {
+		for (i = 0; i < reader->num_analog_channels; i++)
+			stream_clear(&reader->analog[i]);
+	}
+	if (reader->logic_overview) {
+		for (i = 0; i < reader->num_levels; i++)
+			stream_clear(&reader->logic_overview[i]);
+	}
+	if (reader->analog_overview) {
+		for (i = 0; i < reader->num_analog_channels * reader->num_levels; i++)
+			stream_clear(&reader->analog_overview[i]);
+	}
+	g_free(reader->analog);
+	g_free(reader->logic_overview);
+	g_free(reader->analog_overview);
+	g_free(reader->block_sizes);
+	g_free(reader->logic_name);
+	g_free(reader->logic_overview_name);
+	g_mapped_file_unref(reader->file);
+	g_free(reader);
+
+	return SR_OK;
+}
+
+/**
+ * Get the samplerate of a session file.
+ *
+ * @param reader The reader. Must not be NULL.
+ *
+ * @return The samplerate in Hz, or 0 if it is unknown.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_session_reader_samplerate_get(
+		const struct sr_session_reader *reader)
+{
+	return reader->samplerate;
+}
+
+/**
+ * Get the size of a logic sample in a session file.
+ *
+ * @param reader The reader. Must not be NULL.
+ *
+ * @return The size of a sample in bytes, or 0 if the file has no logic data.
+ *
+ * @since 0.6.0
+ */
+SR_API unsigned int sr_session_reader_unitsize_get(
+		const struct sr_session_reader *reader)
+{
+	return reader->unitsize;
+}
+
+/**
+ * Get the number of logic samples in a session file.
+ *
+ * @param reader The reader. Must not be NULL.
+ *
+ * @return The number of samples.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_session_reader_logic_samples_get(
+		const struct sr_session_reader *reader)
+{
+	return reader->logic.num_samples;
+}
+
+/**
+ * Get the number of analog channels in a session file.
+ *
+ * @param reader The reader. Must not be NULL.
+ *
+ * @return The number of channels.
+ *
+ * @since 0.6.0
+ */
+SR_API unsigned int sr_session_reader_analog_channels_get(
+		const struct sr_session_reader *reader)
+{
+	return reader->num_analog_channels;
+}
+
+/**
+ * Get the number of samples of an analog channel in a session file.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param channel The analog channel, counting from 0.
+ *
+ * @return The number of samples, 0 for an invalid channel.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_session_reader_analog_samples_get(
+		const struct sr_session_reader *reader, unsigned int channel)
+{
+	if (channel >= reader->num_analog_channels)
+		return 0;
+
+	return reader->analog[channel].num_samples;
+}
+
+/*
+ * Get a pointer to the samples starting at the given one, and the number
+ * of samples available there up to the end of the chunk.
+ */
+static int stream_map(struct reader_stream *stream, uint64_t start,
+		const uint8_t **data, uint64_t *count)
+{
+	const struct reader_chunk *chunk;
+	const uint8_t *contents;
+	int index;
+
+	if (start >= stream->num_samples) {
+		*data = NULL;
+		*count = 0;
+		return start == stream->num_samples ? SR_OK : SR_ERR_ARG;
+	}
+
+	index = stream_find(stream, start);
+	chunk = &g_array_index(stream->chunks, struct reader_chunk, index);
+	if (!(contents = chunk_contents(stream, index)))
+		return SR_ERR_DATA;
+
+	*data = contents + (start - chunk->first_sample) * stream->sample_size;
+	*count = chunk->first_sample + chunk->num_samples - start;
+
+	return SR_OK;
+}
+
+static int stream_read(struct reader_stream *stream, uint64_t start,
+		uint64_t count, uint8_t *buf)
+{
+	const uint8_t *data;
+	uint64_t n;
+	int ret;
+
+	if (start > stream->num_samples || count > stream->num_samples - start)
+		return SR_ERR_ARG;
+
+	while (count > 0) {
+		if ((ret = stream_map(stream, start, &data, &n)) != SR_OK)
+			return ret;
+		n = MIN(n, count);
+		memcpy(buf, data, n * stream->sample_size);
+		buf += n * stream->sample_size;
+		start += n;
+		count -= n;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Get direct access to logic samples in a session file.
+ *
+ * Returns a pointer to the sample @a start and the number of samples
+ * which can be read from there, which ends at the next chunk boundary.
+ * Stored chunks are accessed right in the mapped file, compressed ones
+ * are inflated into a buffer of the reader which is reused for the
+ * next chunk. The data is valid until the next call for another chunk
+ * or until the reader is closed.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param start The first sample, counting from 0.
+ * @param data Pointer to store the address of the sample data in.
+ *             Must not be NULL.
+ * @param count Pointer to store the number of available samples in.
+ *              This is 0 if @a start is the end of the data. Must not
+ *              be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or @a start is past the end.
+ * @retval SR_ERR_DATA Failed to inflate the data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_reader_logic_map(struct sr_session_reader *reader,
+		uint64_t start, const uint8_t **data, uint64_t *count)
+{
+	if (!reader || !data || !count || !reader->unitsize)
+		return SR_ERR_ARG;
+
+	return stream_map(&reader->logic, start, data, count);
+}
+
+/**
+ * Read a range of logic samples from a session file.
+ *
+ * Only the chunks holding the requested samples are accessed.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param start The first sample, counting from 0.
+ * @param count The number of samples.
+ * @param buf Buffer to store the samples in, @a count times the unit size
+ *            bytes. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range exceeds the data.
+ * @retval SR_ERR_DATA Failed to inflate the data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_reader_logic_read(struct sr_session_reader *reader,
+		uint64_t start, uint64_t count, uint8_t *buf)
+{
+	if (!reader || !buf || !reader->unitsize)
+		return SR_ERR_ARG;
+
+	return stream_read(&reader->logic, start, count, buf);
+}
+
+/**
+ * Read a range of samples of an analog channel from a session file.
+ *
+ * Only the chunks holding the requested samples are accessed.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param channel The analog channel, counting from 0.
+ * @param start The first sample, counting from 0.
+ * @param count The number of samples.
+ * @param buf Buffer to store @a count samples in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range exceeds the data.
+ * @retval SR_ERR_DATA Failed to inflate the data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_reader_analog_read(struct sr_session_reader *reader,
+		unsigned int channel, uint64_t start, uint64_t count, float *buf)
+{
+	if (!reader || !buf || channel >= reader->num_analog_channels)
+		return SR_ERR_ARG;
+
+	return stream_read(&reader->analog[channel], start, count,
+			(uint8_t *)buf);
+}
+
+/**
+ * Get the number of overview levels in a session file.
+ *
+ * Overviews summarize blocks of samples, so long captures can be shown
+ * zoomed out without reading all samples. See
+ * sr_session_reader_logic_overview_read() and
+ * sr_session_reader_analog_overview_read().
+ *
+ * @param reader The reader. Must not be NULL.
+ *
+ * @return The number of levels, 0 if the file has no overview.
+ *
+ * @since 0.6.0
+ */
+SR_API unsigned int sr_session_reader_overview_levels_get(
+		const struct sr_session_reader *reader)
+{
+	return reader->num_levels;
+}
+
+/**
+ * Get the number of samples summarized by each record of an overview level.
+ *
+ * Higher levels have larger blocks. The data of a stream with N samples
+ * has (N + block_size - 1) / block_size records on a level, the last one
+ * may summarize fewer samples.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param level The level, counting from 0.
+ *
+ * @return The block size, 0 for an invalid level.
+ *
+ * @since 0.6.0
+ */
+SR_API uint64_t sr_session_reader_overview_block_size_get(
+		const struct sr_session_reader *reader, unsigned int level)
+{
+	if (level >= reader->num_levels)
+		return 0;
+
+	return reader->block_sizes[level];
+}
+
+/**
+ * Read a range of logic overview records from a session file.
+ *
+ * A record is two samples: in the first, the bits of channels which are
+ * high throughout the block are set, in the second those of channels
+ * which are high anywhere in the block. A channel whose bits differ
+ * between the two has transitions within the block.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param level The overview level, counting from 0.
+ * @param start The first record, counting from 0.
+ * @param count The number of records.
+ * @param buf Buffer to store the records in, @a count times twice the
+ *            unit size bytes. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range exceeds the data.
+ * @retval SR_ERR_DATA Failed to inflate the data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_reader_logic_overview_read(
+		struct sr_session_reader *reader, unsigned int level,
+		uint64_t start, uint64_t count, uint8_t *buf)
+{
+	if (!reader || !buf || !reader->unitsize || level >= reader->num_levels)
+		return SR_ERR_ARG;
+
+	return stream_read(&reader->logic_overview[level], start, count, buf);
+}
+
+/**
+ * Read a range of analog overview records from a session file.
+ *
+ * A record is the minimum and the maximum of the samples in the block.
+ *
+ * @param reader The reader. Must not be NULL.
+ * @param channel The analog channel, counting from 0.
+ * @param level The overview level, counting from 0.
+ * @param start The first record, counting from 0.
+ * @param count The number of records.
+ * @param buf Buffer to store @a count pairs of floats in. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument, or the range exceeds the data.
+ * @retval SR_ERR_DATA Failed to inflate the data.
+ *
+ * @since 0.6.0
+ */
+SR_API int sr_session_reader_analog_overview_read(
+		struct sr_session_reader *reader, unsigned int channel,
+		unsigned int level, uint64_t start, uint64_t count, float *buf)
+{
+	if (!reader || !buf || channel >= reader->num_analog_channels
+			|| level >= reader->num_levels)
+		return SR_ERR_ARG;
+
+	return stream_read(&reader->analog_overview[channel * reader->num_levels
+			+ level], start, count, (uint8_t *)buf);
+}
+
+/** @} */
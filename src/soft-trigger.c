@@ -26,11 +26,283 @@
 #define LOG_PREFIX "soft-trigger"
 /* @endcond */
 
+/*
+ * The trigger stages are compiled into bitmaps over one sample, so that
+ * a stage matches a sample S with predecessor P if and only if
+ *
+ *   (S & level_mask) == level_value &&
+ *   (P & prev_mask) == prev_value &&
+ *   ((S ^ P) & edge_mask) == edge_mask
+ *
+ * ZERO and ONE only constrain S, RISING and FALLING constrain both S and
+ * P, and EDGE requires the bit to have changed. Matches on disabled
+ * channels are left out, contradicting matches make a stage unmatchable.
+ *
+ * For samples of up to 64 bits the bitmaps are also kept as words, in
+ * memory byte order. The search for the first stage, where the trigger
+ * spends nearly all of its time, runs over whole vectors of samples.
+ */
+
+#define WORD_UNITSIZE 8
+
+struct soft_trigger_stage {
+	uint8_t *level_mask;
+	uint8_t *level_value;
+	uint8_t *prev_mask;
+	uint8_t *prev_value;
+	uint8_t *edge_mask;
+	/* The stage has no matches at all, which is a client error. */
+	gboolean empty;
+	/* The stage has contradicting matches and can never match. */
+	gboolean never;
+	uint64_t lm, lv, pm, pv, em;
+};
+
+static uint64_t load_word(const uint8_t *p, int unitsize)
+{
+	uint64_t w;
+
+	w = 0;
+	memcpy(&w, p, unitsize);
+
+	return w;
+}
+
+static void stage_require(struct soft_trigger_stage *st, uint8_t *mask,
+		uint8_t *value, int byte, uint8_t bit, gboolean set)
+{
+	if ((mask[byte] & bit) && !!(value[byte] & bit) != set)
+		st->never = TRUE;
+	mask[byte] |= bit;
+	if (set)
+		value[byte] |= bit;
+}
+
+static void stage_compile(struct soft_trigger_stage *st,
+		const struct sr_trigger_stage *stage, int unitsize)
+{
+	const struct sr_trigger_match *match;
+	const GSList *l;
+	int byte;
+	uint8_t bit;
+
+	st->empty = !stage->matches;
+
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			continue;
+		byte = match->channel->index / 8;
+		bit = 1 << (match->channel->index % 8);
+		switch (match->match) {
+		case SR_TRIGGER_ZERO:
+		case SR_TRIGGER_ONE:
+			stage_require(st, st->level_mask, st->level_value, byte,
+				bit, match->match == SR_TRIGGER_ONE);
+			break;
+		case SR_TRIGGER_RISING:
+		case SR_TRIGGER_FALLING:
+			stage_require(st, st->level_mask, st->level_value, byte,
+				bit, match->match == SR_TRIGGER_RISING);
+			stage_require(st, st->prev_mask, st->prev_value, byte,
+				bit, match->match == SR_TRIGGER_FALLING);
+			break;
+		case SR_TRIGGER_EDGE:
+			st->edge_mask[byte] |= bit;
+			break;
+		default:
+			/* Analog matches never match logic data. */
+			st->never = TRUE;
+			break;
+		}
+	}
+
+	if (unitsize <= WORD_UNITSIZE) {
+		st->lm = load_word(st->level_mask, unitsize);
+		st->lv = load_word(st->level_value, unitsize);
+		st->pm = load_word(st->prev_mask, unitsize);
+		st->pv = load_word(st->prev_value, unitsize);
+		st->em = load_word(st->edge_mask, unitsize);
+	}
+}
+
+static gboolean stage_match(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *st,
+		const uint8_t *sample, const uint8_t *prev)
+{
+	uint64_t s, p;
+	int i;
+
+	if (st->never)
+		return FALSE;
+
+	if (stl->unitsize <= WORD_UNITSIZE) {
+		s = load_word(sample, stl->unitsize);
+		p = load_word(prev, stl->unitsize);
+		return ((s & st->lm) ^ st->lv) == 0
+			&& ((p & st->pm) ^ st->pv) == 0
+			&& ((s ^ p) & st->em) == st->em;
+	}
+
+	for (i = 0; i < stl->unitsize; i++) {
+		if ((sample[i] & st->level_mask[i]) != st->level_value[i]
+				|| (prev[i] & st->prev_mask[i]) != st->prev_value[i]
+				|| ((sample[i] ^ prev[i]) & st->edge_mask[i])
+					!= st->edge_mask[i])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/*
+ * Compare whole vectors of samples against a stage. Returns the index of
+ * the first matching sample, or the index at which the caller has to go
+ * on with single samples. The predecessor of sample i is at i - 1, so i
+ * must be at least 1.
+ */
+static int stage_scan_vector(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *st, const uint8_t *buf,
+		int i, int num)
+{
+	__m128i lm, lv, pm, pv, em, s, p, bad;
+	unsigned int bits;
+	int per_vector, shift;
+
+	switch (stl->unitsize) {
+	case 1:
+		lm = _mm_set1_epi8(st->lm);
+		lv = _mm_set1_epi8(st->lv);
+		pm = _mm_set1_epi8(st->pm);
+		pv = _mm_set1_epi8(st->pv);
+		em = _mm_set1_epi8(st->em);
+		break;
+	case 2:
+		lm = _mm_set1_epi16(st->lm);
+		lv = _mm_set1_epi16(st->lv);
+		pm = _mm_set1_epi16(st->pm);
+		pv = _mm_set1_epi16(st->pv);
+		em = _mm_set1_epi16(st->em);
+		break;
+	case 4:
+		lm = _mm_set1_epi32(st->lm);
+		lv = _mm_set1_epi32(st->lv);
+		pm = _mm_set1_epi32(st->pm);
+		pv = _mm_set1_epi32(st->pv);
+		em = _mm_set1_epi32(st->em);
+		break;
+	default:
+		return i;
+	}
+	per_vector = 16 / stl->unitsize;
+	shift = stl->unitsize == 1 ? 0 : stl->unitsize == 2 ? 1 : 2;
+
+	for (; i + per_vector <= num; i += per_vector) {
+		s = _mm_loadu_si128((const __m128i *)(buf + i * stl->unitsize));
+		p = _mm_loadu_si128((const __m128i *)(buf + (i - 1) * stl->unitsize));
+		bad = _mm_or_si128(
+			_mm_xor_si128(_mm_and_si128(s, lm), lv),
+			_mm_or_si128(
+				_mm_xor_si128(_mm_and_si128(p, pm), pv),
+				_mm_xor_si128(_mm_and_si128(
+					_mm_xor_si128(s, p), em), em)));
+		/* Only lanes without any bad bit are all-zero. */
+		switch (stl->unitsize) {
+		case 1:
+			bad = _mm_cmpeq_epi8(bad, _mm_setzero_si128());
+			break;
+		case 2:
+			bad = _mm_cmpeq_epi16(bad, _mm_setzero_si128());
+			break;
+		default:
+			bad = _mm_cmpeq_epi32(bad, _mm_setzero_si128());
+			break;
+		}
+		if ((bits = _mm_movemask_epi8(bad)))
+			return i + (g_bit_nth_lsf(bits, -1) >> shift);
+	}
+
+	return i;
+}
+#else
+/*
+ * Without SIMD, compare eight 8 bit samples per 64 bit word. The zero
+ * byte test may report false positives above the first real zero byte,
+ * so a hit is only used as a hint to look at those samples one by one.
+ */
+static int stage_scan_vector(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *st, const uint8_t *buf,
+		int i, int num)
+{
+	const uint64_t ones = 0x0101010101010101ULL;
+	uint64_t lm, lv, pm, pv, em, s, p, bad;
+	int j;
+
+	if (stl->unitsize != 1)
+		return i;
+
+	lm = st->lm * ones;
+	lv = st->lv * ones;
+	pm = st->pm * ones;
+	pv = st->pv * ones;
+	em = st->em * ones;
+
+	for (; i + 8 <= num; i += 8) {
+		memcpy(&s, buf + i, 8);
+		memcpy(&p, buf + i - 1, 8);
+		bad = ((s & lm) ^ lv) | ((p & pm) ^ pv) | (((s ^ p) & em) ^ em);
+		if (!((bad - ones) & ~bad & (ones << 7)))
+			continue;
+		for (j = i; j < i + 8; j++) {
+			if (stage_match(stl, st, buf + j, buf + j - 1))
+				return j;
+		}
+	}
+
+	return i;
+}
+#endif
+
+/*
+ * Find the first sample at or after start which matches a stage. The
+ * predecessor of the start sample is prev, that of later samples is the
+ * sample before them. Returns num if there is no match.
+ */
+static int stage_find(const struct soft_trigger_logic *stl,
+		const struct soft_trigger_stage *st, const uint8_t *buf,
+		int start, int num, const uint8_t *prev)
+{
+	int i, unitsize;
+
+	if (st->never)
+		return num;
+
+	unitsize = stl->unitsize;
+	if (stage_match(stl, st, buf + start * unitsize, prev))
+		return start;
+
+	i = stage_scan_vector(stl, st, buf, start + 1, num);
+	for (; i < num; i++) {
+		if (stage_match(stl, st, buf + i * unitsize,
+				buf + (i - 1) * unitsize))
+			return i;
+	}
+
+	return num;
+}
+
 SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
 		int pre_trigger_samples)
 {
 	struct soft_trigger_logic *stl;
+	struct soft_trigger_stage *st;
+	const GSList *l;
+	uint8_t *masks;
+	int i;
 
 	stl = g_malloc0(sizeof(struct soft_trigger_logic));
 	stl->sdi = sdi;
@@ -55,11 +327,28 @@ SR_PRIV struct soft_trigger_logic *soft_trigger_logic_new(
 		return NULL;
 	}
 
+	stl->num_stages = g_slist_length(trigger->stages);
+	stl->stages = g_malloc0(stl->num_stages * sizeof(*stl->stages));
+	masks = g_malloc0(stl->num_stages * 5 * stl->unitsize);
+	for (l = trigger->stages, i = 0; l; l = l->next, i++) {
+		st = &stl->stages[i];
+		st->level_mask = masks;
+		st->level_value = st->level_mask + stl->unitsize;
+		st->prev_mask = st->level_value + stl->unitsize;
+		st->prev_value = st->prev_mask + stl->unitsize;
+		st->edge_mask = st->prev_value + stl->unitsize;
+		masks = st->edge_mask + stl->unitsize;
+		stage_compile(st, l->data, stl->unitsize);
+	}
+
 	return stl;
 }
 
 SR_PRIV void soft_trigger_logic_free(struct soft_trigger_logic *stl)
 {
+	if (stl->stages)
+		g_free(stl->stages[0].level_mask);
+	g_free(stl->stages);
 	g_free(stl->pre_trigger_buffer);
 	g_free(stl->prev_sample);
 	g_free(stl);
@@ -155,51 +444,89 @@ static gboolean logic_check_match(struct soft_trigger_logic *stl,
 	return result;
 }
 
+/*
+ * Check the current stage on one sample the way it was originally done,
+ * match by match. This is only used until the first match has actually
+ * been evaluated: an edge match evaluated first fails, as there is no
+ * previous sample yet, while later ones compare against zeroes.
+ */
+static gboolean logic_check_first(struct soft_trigger_logic *stl,
+		uint8_t *sample)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l;
+
+	stage = g_slist_nth_data(stl->trigger->stages, stl->cur_stage);
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			/* Ignore disabled channels with a trigger. */
+			continue;
+		if (!logic_check_match(stl, sample, match))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 /* Returns the offset (in samples) within buf of where the trigger
  * occurred, or -1 if not triggered. */
 SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		uint8_t *buf, int len, int *pre_trigger_samples)
 {
 	struct sr_datafeed_packet packet;
-	struct sr_trigger_stage *stage;
-	struct sr_trigger_match *match;
-	GSList *l, *l_stage;
-	int offset;
-	int i;
+	struct soft_trigger_stage *stage;
+	const uint8_t *prev;
+	uint8_t *sample;
+	int offset, num, i;
 	gboolean match_found;
 
 	offset = -1;
-	for (i = 0; i < len; i += stl->unitsize) {
-		l_stage = g_slist_nth(stl->trigger->stages, stl->cur_stage);
-		stage = l_stage->data;
-		if (!stage->matches)
+	num = len / stl->unitsize;
+	prev = stl->prev_sample;
+	for (i = 0; i < num; i++) {
+		stage = &stl->stages[stl->cur_stage];
+		if (stage->empty) {
 			/* No matches supplied, client error. */
+			if (prev != stl->prev_sample)
+				memcpy(stl->prev_sample, prev, stl->unitsize);
 			return SR_ERR_ARG;
+		}
 
-		match_found = TRUE;
-		for (l = stage->matches; l; l = l->next) {
-			match = l->data;
-			if (!match->channel->enabled)
-				/* Ignore disabled channels with a trigger. */
-				continue;
-			if (!logic_check_match(stl, buf + i, match)) {
-				match_found = FALSE;
+		if (stl->count == 0) {
+			if (prev != stl->prev_sample)
+				memcpy(stl->prev_sample, prev, stl->unitsize);
+			match_found = logic_check_first(stl, buf + i * stl->unitsize);
+		} else if (stl->cur_stage == 0) {
+			/* Skip ahead to the next sample matching stage 0. */
+			i = stage_find(stl, stage, buf, i, num, prev);
+			if (i == num) {
+				prev = buf + (num - 1) * stl->unitsize;
 				break;
 			}
+			match_found = TRUE;
+		} else {
+			match_found = stage_match(stl, stage,
+					buf + i * stl->unitsize, prev);
 		}
-		memcpy(stl->prev_sample, buf + i, stl->unitsize);
+		sample = buf + i * stl->unitsize;
+		prev = sample;
+
 		if (match_found) {
 			/* Matched on the current stage. */
-			if (l_stage->next) {
+			if (stl->cur_stage < stl->num_stages - 1) {
 				/* Advance to next stage. */
 				stl->cur_stage++;
 			} else {
 				/* Matched on last stage, send pre-trigger data. */
-				pre_trigger_append(stl, buf, i);
+				memcpy(stl->prev_sample, prev, stl->unitsize);
+				prev = stl->prev_sample;
+				pre_trigger_append(stl, buf, i * stl->unitsize);
 				pre_trigger_send(stl, pre_trigger_samples);
 
 				/* Fire trigger. */
-				offset = i / stl->unitsize;
+				offset = i;
 
 				packet.type = SR_DF_TRIGGER;
 				packet.payload = NULL;
@@ -214,9 +541,10 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 			 * seeing 00001, so we need to go back to stage 0 -- but
 			 * at the next sample from the one that matched originally,
 			 * which the counter increment at the end of the loop
-			 * takes care of.
+			 * takes care of. The failed sample stays the previous
+			 * one for edge matches.
 			 */
-			i -= stl->cur_stage * stl->unitsize;
+			i -= stl->cur_stage;
 			if (i < -1)
 				i = -1; /* Oops, went back past this buffer. */
 			/* Reset trigger stage. */
@@ -224,8 +552,634 @@ SR_PRIV int soft_trigger_logic_check(struct soft_trigger_logic *stl,
 		}
 	}
 
+	if (prev != stl->prev_sample)
+		memcpy(stl->prev_sample, prev, stl->unitsize);
+
 	if (offset == -1)
 		pre_trigger_append(stl, buf, len);
 
 	return offset;
 }
+
+/*
+ * The analog soft trigger works on sr_datafeed_analog packets, converted
+ * to floats. Every packet must carry the same channels in the same order,
+ * which are taken from the first one.
+ *
+ * OVER and UNDER match samples above and below the match value, two of
+ * them on one channel in the same stage make a window. RISING and FALLING
+ * match where the channel crosses the value, with a hysteresis: a channel
+ * has to go below value - hysteresis before it can rise above value
+ * again, and above value + hysteresis before it can fall below value.
+ * Like logic triggers, every stage after the first has to match on the
+ * sample following the previous stage's match.
+ *
+ * Every match needs its channel above or below some threshold, which the
+ * search for the first stage checks on blocks of samples at a time. Only
+ * candidates found that way look at the edge state of the channel.
+ */
+
+enum {
+	EDGE_UNKNOWN,
+	EDGE_LOW,
+	EDGE_HIGH,
+};
+
+struct analog_match {
+	int match;
+	/* Column of the channel in the current packet. */
+	const float *data;
+	int channel;
+	/* The first match on the channel, which fills in the column. */
+	gboolean fill_column;
+	/* The sample has to be above (or below) the threshold. */
+	gboolean above;
+	float threshold;
+	/* Edge matches: below lo the channel is low, above hi it is high. */
+	float lo, hi;
+	/* Edge state before the current packet. */
+	int state;
+	/* Edge state before sample cache_pos of the current packet. */
+	int cache_pos;
+	int cache_state;
+};
+
+struct soft_trigger_analog_stage {
+	struct analog_match *matches;
+	int num_matches;
+	/* The stage has no matches at all, which is a client error. */
+	gboolean empty;
+	/* The stage refers to channels or matches not in the analog data. */
+	gboolean never;
+};
+
+#define BLOCK 4
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/* Bit n is set if sample n of the block passes the threshold. */
+static inline unsigned int block_mask(const float *p, gboolean above,
+		float threshold)
+{
+	__m128 v, t;
+
+	v = _mm_loadu_ps(p);
+	t = _mm_set1_ps(threshold);
+
+	return _mm_movemask_ps(above ? _mm_cmpgt_ps(v, t) : _mm_cmplt_ps(v, t));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+
+static inline unsigned int block_mask(const float *p, gboolean above,
+		float threshold)
+{
+	static const uint32_t bits[BLOCK] = { 1, 2, 4, 8 };
+	float32x4_t v, t;
+	uint32x4_t c;
+
+	v = vld1q_f32(p);
+	t = vdupq_n_f32(threshold);
+	c = above ? vcgtq_f32(v, t) : vcltq_f32(v, t);
+
+	return vaddvq_u32(vandq_u32(c, vld1q_u32(bits)));
+}
+#else
+static inline unsigned int block_mask(const float *p, gboolean above,
+		float threshold)
+{
+	unsigned int bits;
+	int i;
+
+	bits = 0;
+	for (i = 0; i < BLOCK; i++) {
+		if (above ? p[i] > threshold : p[i] < threshold)
+			bits |= 1 << i;
+	}
+
+	return bits;
+}
+#endif
+
+static inline gboolean sample_passes(const struct analog_match *m, int i)
+{
+	return m->above ? m->data[i] > m->threshold : m->data[i] < m->threshold;
+}
+
+/* Find the first sample at or after i which is above (below) a threshold. */
+static int column_find(const float *data, int i, int num, gboolean above,
+		float threshold)
+{
+	unsigned int bits;
+
+	for (; i + BLOCK <= num; i += BLOCK) {
+		if ((bits = block_mask(data + i, above, threshold)))
+			return i + g_bit_nth_lsf(bits, -1);
+	}
+	for (; i < num; i++) {
+		if (above ? data[i] > threshold : data[i] < threshold)
+			return i;
+	}
+
+	return num;
+}
+
+/* The edge state of a match before sample i of the current packet. */
+static int edge_state(struct analog_match *m, int i)
+{
+	int j, state;
+
+	if (i < m->cache_pos) {
+		/* Went back in the packet, start over. */
+		m->cache_pos = 0;
+		m->cache_state = m->state;
+	}
+
+	state = m->cache_state;
+	for (j = i - 1; j >= m->cache_pos; j--) {
+		if (m->data[j] < m->lo) {
+			state = EDGE_LOW;
+			break;
+		}
+		if (m->data[j] > m->hi) {
+			state = EDGE_HIGH;
+			break;
+		}
+	}
+	m->cache_pos = i;
+	m->cache_state = state;
+
+	return state;
+}
+
+/* Whether an edge match is armed for its edge before sample i. */
+static gboolean edge_armed(struct analog_match *m, int i)
+{
+	if (m->match == SR_TRIGGER_RISING)
+		return edge_state(m, i) == EDGE_LOW;
+	if (m->match == SR_TRIGGER_FALLING)
+		return edge_state(m, i) == EDGE_HIGH;
+
+	return TRUE;
+}
+
+static gboolean analog_stage_match(struct soft_trigger_analog_stage *st,
+		int i)
+{
+	int m;
+
+	if (st->never)
+		return FALSE;
+
+	for (m = 0; m < st->num_matches; m++) {
+		if (!sample_passes(&st->matches[m], i))
+			return FALSE;
+	}
+	for (m = 0; m < st->num_matches; m++) {
+		if (!edge_armed(&st->matches[m], i))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Find the first sample at or after i where all matches of a stage pass
+ * their threshold. Returns num if there is none.
+ */
+static int analog_stage_scan(const struct soft_trigger_analog_stage *st,
+		int i, int num)
+{
+	const struct analog_match *m;
+	unsigned int bits;
+	int j;
+
+	if (st->num_matches == 1) {
+		m = &st->matches[0];
+		return column_find(m->data, i, num, m->above, m->threshold);
+	}
+
+	for (; i + BLOCK <= num; i += BLOCK) {
+		bits = (1 << BLOCK) - 1;
+		for (j = 0; j < st->num_matches && bits; j++) {
+			m = &st->matches[j];
+			bits &= block_mask(m->data + i, m->above, m->threshold);
+		}
+		if (bits)
+			return i + g_bit_nth_lsf(bits, -1);
+	}
+	for (; i < num; i++) {
+		for (j = 0; j < st->num_matches; j++) {
+			if (!sample_passes(&st->matches[j], i))
+				break;
+		}
+		if (j == st->num_matches)
+			return i;
+	}
+
+	return num;
+}
+
+/*
+ * Find the first sample at or after i which matches a stage. Returns num
+ * if there is no match.
+ */
+static int analog_stage_find(struct soft_trigger_analog_stage *st,
+		int i, int num)
+{
+	struct analog_match *m;
+	int j;
+
+	if (st->never)
+		return num;
+
+	while ((i = analog_stage_scan(st, i, num)) < num) {
+		for (j = 0; j < st->num_matches; j++) {
+			if (!edge_armed(&st->matches[j], i))
+				break;
+		}
+		if (j == st->num_matches)
+			return i;
+
+		/*
+		 * Match j passes its threshold but is not armed. Nothing
+		 * can match before its channel goes back past the other
+		 * end of the hysteresis band.
+		 */
+		m = &st->matches[j];
+		if (m->match == SR_TRIGGER_RISING)
+			i = column_find(m->data, i + 1, num, FALSE, m->lo);
+		else
+			i = column_find(m->data, i + 1, num, TRUE, m->hi);
+		if (i == num)
+			break;
+		m->cache_pos = ++i;
+		m->cache_state = m->match == SR_TRIGGER_RISING ?
+				EDGE_LOW : EDGE_HIGH;
+	}
+
+	return num;
+}
+
+/* Whether an earlier match refers to the same channel. */
+static gboolean channel_seen(const struct soft_trigger_analog *sta,
+		const struct soft_trigger_analog_stage *cur, int channel)
+{
+	const struct soft_trigger_analog_stage *st;
+	int i;
+
+	for (st = sta->stages; st <= cur; st++) {
+		for (i = 0; i < st->num_matches; i++) {
+			if (st->matches[i].channel == channel)
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void analog_stage_compile(struct soft_trigger_analog *sta,
+		struct soft_trigger_analog_stage *st,
+		const struct sr_trigger_stage *stage)
+{
+	const struct sr_trigger_match *match;
+	struct analog_match *m;
+	const GSList *l;
+	int channel;
+
+	st->empty = !stage->matches;
+	st->matches = g_malloc0(g_slist_length(stage->matches)
+			* sizeof(*st->matches));
+
+	for (l = stage->matches; l; l = l->next) {
+		match = l->data;
+		if (!match->channel->enabled)
+			continue;
+		channel = g_slist_index(sta->channels, match->channel);
+		if (channel < 0 || match->channel->type != SR_CHANNEL_ANALOG) {
+			st->never = TRUE;
+			continue;
+		}
+		m = &st->matches[st->num_matches];
+		m->fill_column = !channel_seen(sta, st, channel);
+		st->num_matches++;
+		m->match = match->match;
+		m->channel = channel;
+		m->threshold = match->value;
+		m->state = EDGE_UNKNOWN;
+		switch (match->match) {
+		case SR_TRIGGER_OVER:
+			m->above = TRUE;
+			break;
+		case SR_TRIGGER_UNDER:
+			m->above = FALSE;
+			break;
+		case SR_TRIGGER_RISING:
+			m->above = TRUE;
+			m->lo = match->value - sta->hysteresis;
+			m->hi = match->value;
+			break;
+		case SR_TRIGGER_FALLING:
+			m->above = FALSE;
+			m->lo = match->value;
+			m->hi = match->value + sta->hysteresis;
+			break;
+		default:
+			/* Logic matches never match analog data. */
+			st->never = TRUE;
+			break;
+		}
+	}
+}
+
+static gboolean same_channels(const GSList *a, const GSList *b)
+{
+	for (; a && b; a = a->next, b = b->next) {
+		if (a->data != b->data)
+			return FALSE;
+	}
+
+	return !a && !b;
+}
+
+/* Whether a packet holds native floats, which need no conversion. */
+static gboolean native_floats(const struct sr_datafeed_analog *analog)
+{
+	const struct sr_analog_encoding *encoding;
+	gboolean bigendian;
+
+#ifdef WORDS_BIGENDIAN
+	bigendian = TRUE;
+#else
+	bigendian = FALSE;
+#endif
+
+	encoding = analog->encoding;
+
+	return encoding->is_float && encoding->unitsize == sizeof(float)
+		&& encoding->is_bigendian == bigendian
+		&& encoding->scale.p == encoding->scale.q
+		&& encoding->offset.p == 0
+		&& (uintptr_t)analog->data % sizeof(float) == 0;
+}
+
+/*
+ * Get the samples of a packet as floats, and the channels matched on as
+ * columns. The trigger is set up on the first packet.
+ */
+static int analog_prepare(struct soft_trigger_analog *sta,
+		const struct sr_datafeed_analog *analog)
+{
+	struct analog_match *m;
+	const GSList *l;
+	float *col;
+	int num, count, i, s;
+
+	if (!analog->meaning->channels || !sta->num_stages)
+		return SR_ERR_ARG;
+
+	if (!sta->channels) {
+		sta->channels = g_slist_copy(analog->meaning->channels);
+		sta->num_channels = g_slist_length(sta->channels);
+		if (sta->pre_trigger_size > 0) {
+			sta->pre_trigger_buffer = g_try_malloc(sizeof(float)
+				* sta->pre_trigger_size * sta->num_channels);
+			if (!sta->pre_trigger_buffer)
+				return SR_ERR_MALLOC;
+		}
+		sta->stages = g_malloc0(sta->num_stages * sizeof(*sta->stages));
+		for (l = sta->trigger->stages, i = 0; l; l = l->next, i++)
+			analog_stage_compile(sta, &sta->stages[i], l->data);
+	} else if (!same_channels(sta->channels, analog->meaning->channels)) {
+		sr_err("Analog packet channels differ from the first packet.");
+		return SR_ERR_ARG;
+	}
+
+	num = analog->num_samples;
+	count = num * sta->num_channels;
+	if (count > sta->values_size) {
+		g_free(sta->values);
+		g_free(sta->columns);
+		sta->values = g_try_malloc(count * sizeof(float));
+		sta->columns = NULL;
+		if (sta->values && sta->num_channels > 1)
+			sta->columns = g_try_malloc(count * sizeof(float));
+		if (!sta->values || (sta->num_channels > 1 && !sta->columns)) {
+			g_free(sta->values);
+			sta->values = NULL;
+			sta->values_size = 0;
+			return SR_ERR_MALLOC;
+		}
+		sta->values_size = count;
+	}
+
+	if (native_floats(analog)) {
+		sta->samples = analog->data;
+	} else {
+		/* SR_ERR would read as "not triggered" to the caller. */
+		if (sr_analog_to_float(analog, sta->values) != SR_OK)
+			return SR_ERR_DATA;
+		sta->samples = sta->values;
+	}
+
+	for (s = 0; s < sta->num_stages; s++) {
+		for (i = 0; i < sta->stages[s].num_matches; i++) {
+			m = &sta->stages[s].matches[i];
+			m->cache_pos = 0;
+			m->cache_state = m->state;
+			if (sta->num_channels == 1) {
+				m->data = sta->samples;
+				continue;
+			}
+			col = sta->columns + m->channel * num;
+			m->data = col;
+			if (!m->fill_column)
+				continue;
+			for (count = 0; count < num; count++)
+				col[count] = sta->samples[count
+					* sta->num_channels + m->channel];
+		}
+	}
+
+	sta->meaning = *analog->meaning;
+	if (analog->spec)
+		sta->spec = *analog->spec;
+	sta->digits = analog->encoding->digits;
+
+	return SR_OK;
+}
+
+SR_PRIV struct soft_trigger_analog *soft_trigger_analog_new(
+		const struct sr_dev_inst *sdi, struct sr_trigger *trigger,
+		int pre_trigger_samples, float hysteresis)
+{
+	struct soft_trigger_analog *sta;
+
+	sta = g_malloc0(sizeof(struct soft_trigger_analog));
+	sta->sdi = sdi;
+	sta->trigger = trigger;
+	sta->hysteresis = MAX(hysteresis, 0);
+	sta->num_stages = g_slist_length(trigger->stages);
+	/* The buffer is allocated once the number of channels is known. */
+	sta->pre_trigger_size = MAX(pre_trigger_samples, 0);
+
+	return sta;
+}
+
+SR_PRIV void soft_trigger_analog_free(struct soft_trigger_analog *sta)
+{
+	int i;
+
+	if (sta->stages) {
+		for (i = 0; i < sta->num_stages; i++)
+			g_free(sta->stages[i].matches);
+	}
+	g_free(sta->stages);
+	g_slist_free(sta->channels);
+	g_free(sta->pre_trigger_buffer);
+	g_free(sta->values);
+	g_free(sta->columns);
+	g_free(sta);
+}
+
+static void analog_pre_trigger_append(struct soft_trigger_analog *sta,
+		const float *values, int num)
+{
+	int size;
+
+	if (!sta->pre_trigger_buffer)
+		return;
+
+	/* Avoid uselessly copying more than the pre-trigger size. */
+	if (num > sta->pre_trigger_size) {
+		values += (num - sta->pre_trigger_size) * sta->num_channels;
+		num = sta->pre_trigger_size;
+	}
+
+	sta->pre_trigger_fill = MIN(sta->pre_trigger_fill + num,
+	                            sta->pre_trigger_size);
+
+	while (num > 0) {
+		size = MIN(sta->pre_trigger_size - sta->pre_trigger_head, num);
+		memcpy(sta->pre_trigger_buffer
+			+ sta->pre_trigger_head * sta->num_channels, values,
+			size * sta->num_channels * sizeof(float));
+		sta->pre_trigger_head += size;
+		if (sta->pre_trigger_head >= sta->pre_trigger_size)
+			sta->pre_trigger_head = 0;
+		values += size * sta->num_channels;
+		num -= size;
+	}
+}
+
+static void analog_pre_trigger_send(struct soft_trigger_analog *sta,
+		int *pre_trigger_samples)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	int size;
+
+	sr_analog_init(&analog, &encoding, &meaning, &spec, sta->digits);
+	meaning = sta->meaning;
+	meaning.channels = sta->channels;
+	spec = sta->spec;
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+
+	if (pre_trigger_samples)
+		*pre_trigger_samples = 0;
+
+	/* If pre-trigger buffer not full, rewind head to the first valid sample. */
+	if (sta->pre_trigger_fill < sta->pre_trigger_size)
+		sta->pre_trigger_head = 0;
+
+	while (sta->pre_trigger_fill > 0) {
+		size = MIN(sta->pre_trigger_size - sta->pre_trigger_head,
+		           sta->pre_trigger_fill);
+		analog.num_samples = size;
+		analog.data = sta->pre_trigger_buffer
+			+ sta->pre_trigger_head * sta->num_channels;
+		sr_session_send(sta->sdi, &packet);
+		sta->pre_trigger_head = 0;
+		sta->pre_trigger_fill -= size;
+		if (pre_trigger_samples)
+			*pre_trigger_samples += size;
+	}
+}
+
+/* Returns the offset (in samples) within the packet of where the trigger
+ * occurred, -1 if not triggered, or an SR_ERR_* code below -1 on errors. */
+SR_PRIV int soft_trigger_analog_check(struct soft_trigger_analog *sta,
+		const struct sr_datafeed_analog *analog, int *pre_trigger_samples)
+{
+	struct sr_datafeed_packet packet;
+	struct soft_trigger_analog_stage *stage;
+	struct analog_match *m;
+	int offset, num, i, s, ret;
+	gboolean match_found;
+
+	if ((ret = analog_prepare(sta, analog)) != SR_OK)
+		return ret;
+
+	offset = -1;
+	num = analog->num_samples;
+	for (i = 0; i < num; i++) {
+		stage = &sta->stages[sta->cur_stage];
+		if (stage->empty)
+			/* No matches supplied, client error. */
+			return SR_ERR_ARG;
+
+		if (sta->cur_stage == 0) {
+			/* Skip ahead to the next sample matching stage 0. */
+			if ((i = analog_stage_find(stage, i, num)) == num)
+				break;
+			match_found = TRUE;
+		} else {
+			match_found = analog_stage_match(stage, i);
+		}
+
+		if (match_found) {
+			/* Matched on the current stage. */
+			if (sta->cur_stage < sta->num_stages - 1) {
+				/* Advance to next stage. */
+				sta->cur_stage++;
+			} else {
+				/* Matched on last stage, send pre-trigger data. */
+				analog_pre_trigger_append(sta, sta->samples, i);
+				analog_pre_trigger_send(sta, pre_trigger_samples);
+
+				/* Fire trigger. */
+				offset = i;
+
+				packet.type = SR_DF_TRIGGER;
+				packet.payload = NULL;
+				sr_session_send(sta->sdi, &packet);
+				return offset;
+			}
+		} else if (sta->cur_stage > 0) {
+			/* Start over after the sample which matched stage 0. */
+			i -= sta->cur_stage;
+			if (i < -1)
+				i = -1; /* Oops, went back past this packet. */
+			sta->cur_stage = 0;
+		}
+	}
+
+	/* Carry the edge states over to the next packet. */
+	for (s = 0; s < sta->num_stages; s++) {
+		for (i = 0; i < sta->stages[s].num_matches; i++) {
+			m = &sta->stages[s].matches[i];
+			if (m->match == SR_TRIGGER_RISING
+					|| m->match == SR_TRIGGER_FALLING)
+				m->state = edge_state(m, num);
+		}
+	}
+
+	analog_pre_trigger_append(sta, sta->samples, num);
+
+	return offset;
+}
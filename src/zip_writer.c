@@ -0,0 +1,593 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <zlib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+
+/** @cond PRIVATE */
+#define LOG_PREFIX "zip-writer"
+/** @endcond */
+
+/**
+ * @file
+ *
+ * Streaming ZIP archive writer.
+ *
+ * libzip rewrites the whole archive on zip_close(), so adding entries to
+ * a growing archive one close at a time takes quadratic time. This writer
+ * appends every entry to the file as soon as it is added and only keeps
+ * the central directory in memory, which is written when the archive is
+ * closed. ZIP64 records are used where offsets or sizes need them.
+ *
+ * Entries can be compressed on a pool of worker threads. They are still
+ * written to the file in the order they were added: whichever worker
+ * completes the oldest pending entry writes it out, along with any later
+ * entries which are already done. The number of pending entries is
+ * limited, sr_zip_writer_add() blocks while the backlog is full.
+ */
+
+#define ZIP_LOCAL_HEADER	0x04034b50
+#define ZIP_CENTRAL_HEADER	0x02014b50
+#define ZIP_END_OF_DIR		0x06054b50
+#define ZIP64_END_OF_DIR	0x06064b50
+#define ZIP64_END_LOCATOR	0x07064b50
+#define ZIP64_EXTRA		0x0001
+
+#define ZIP_VERSION		20
+#define ZIP64_VERSION		45
+#define ZIP_STORE		0
+#define ZIP_DEFLATE		8
+
+#define ZIP_MAX16		0xffff
+#define ZIP_MAX32		0xffffffff
+
+/* Pending entries allowed per worker thread. */
+#define BACKLOG_PER_THREAD	2
+
+struct zip_entry {
+	char *name;
+	uint16_t method;
+	uint32_t crc;
+	uint64_t compressed_size;
+	uint64_t size;
+	uint64_t offset;
+};
+
+/* An entry on its way to the file. */
+struct zip_job {
+	struct zip_entry entry;
+	struct sr_buffer *buf;
+	/* Compressed contents, NULL if the entry is stored. */
+	uint8_t *zbuf;
+	gboolean done;
+};
+
+/** @private */
+struct sr_zip_writer {
+	char *filename;
+	FILE *file;
+	/* Offset of the next entry in the file. */
+	uint64_t offset;
+	/* MS-DOS time and date for all entries. */
+	uint16_t dos_time, dos_date;
+	int level;
+	GArray *entries;
+	/* NULL if entries are compressed by the caller of sr_zip_writer_add(). */
+	GThreadPool *pool;
+	unsigned int max_backlog;
+	/* Protects everything below. */
+	GMutex mutex;
+	GCond cond;
+	/* Pending entries in the order they were added. */
+	GQueue jobs;
+	/* Set while a thread is writing completed entries to the file. */
+	gboolean writing;
+	/* Set after a failed write, the archive can't be completed. */
+	gboolean failed;
+	struct sr_zip_writer_stats stats;
+};
+
+static void put16(GByteArray *b, uint16_t x)
+{
+	uint8_t v[2];
+
+	WL16(v, x);
+	g_byte_array_append(b, v, sizeof(v));
+}
+
+static void put32(GByteArray *b, uint32_t x)
+{
+	uint8_t v[4];
+
+	WL32(v, x);
+	g_byte_array_append(b, v, sizeof(v));
+}
+
+static void put64(GByteArray *b, uint64_t x)
+{
+	put32(b, x & ZIP_MAX32);
+	put32(b, x >> 32);
+}
+
+static int write_bytes(struct sr_zip_writer *zw, const void *data,
+		size_t size)
+{
+	if (size && fwrite(data, size, 1, zw->file) != 1) {
+		sr_err("Failed to write to '%s': %s.", zw->filename,
+			g_strerror(errno));
+		return SR_ERR_IO;
+	}
+	zw->offset += size;
+
+	return SR_OK;
+}
+
+static void compress_job(int level, struct zip_job *job)
+{
+	struct zip_entry *e;
+	const uint8_t *data;
+	z_stream zs;
+	size_t bound;
+
+	e = &job->entry;
+	data = job->buf->data;
+	e->crc = crc32(crc32(0, Z_NULL, 0), data, e->size);
+	e->method = ZIP_STORE;
+	e->compressed_size = e->size;
+
+	if (level == 0 || e->size == 0)
+		return;
+
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK)
+		return;
+
+	bound = deflateBound(&zs, e->size);
+	if ((job->zbuf = g_try_malloc(bound))) {
+		zs.next_in = (Bytef *)data;
+		zs.avail_in = e->size;
+		zs.next_out = job->zbuf;
+		zs.avail_out = bound;
+		/* Keep the data uncompressed if it doesn't get any smaller. */
+		if (deflate(&zs, Z_FINISH) == Z_STREAM_END
+				&& zs.total_out < e->size) {
+			e->method = ZIP_DEFLATE;
+			e->compressed_size = zs.total_out;
+		} else {
+			g_free(job->zbuf);
+			job->zbuf = NULL;
+		}
+	}
+	deflateEnd(&zs);
+}
+
+static int write_job(struct sr_zip_writer *zw, struct zip_job *job)
+{
+	struct zip_entry *e;
+	GByteArray *header;
+	const void *out;
+	size_t name_len;
+	int ret;
+
+	e = &job->entry;
+	e->offset = zw->offset;
+	name_len = strlen(e->name);
+
+	header = g_byte_array_sized_new(30 + name_len);
+	put32(header, ZIP_LOCAL_HEADER);
+	put16(header, ZIP_VERSION);
+	put16(header, 0);
+	put16(header, e->method);
+	put16(header, zw->dos_time);
+	put16(header, zw->dos_date);
+	put32(header, e->crc);
+	put32(header, e->compressed_size);
+	put32(header, e->size);
+	put16(header, name_len);
+	put16(header, 0);
+	g_byte_array_append(header, (const guint8 *)e->name, name_len);
+
+	ret = write_bytes(zw, header->data, header->len);
+	g_byte_array_free(header, TRUE);
+	if (ret != SR_OK)
+		return ret;
+
+	out = job->zbuf ? job->zbuf : job->buf->data;
+	if ((ret = write_bytes(zw, out, e->compressed_size)) != SR_OK)
+		return ret;
+
+	/* The entry name now belongs to the central directory. */
+	g_array_append_val(zw->entries, *e);
+	e->name = NULL;
+
+	return SR_OK;
+}
+
+static void free_job(struct zip_job *job)
+{
+	g_free(job->entry.name);
+	sr_buffer_unref(job->buf);
+	g_free(job->zbuf);
+	g_free(job);
+}
+
+/*
+ * Mark a job as compressed, and write out all completed jobs at the head
+ * of the queue unless another thread is already doing that.
+ */
+static void complete_job(struct sr_zip_writer *zw, struct zip_job *job)
+{
+	uint64_t size, compressed_size;
+	gboolean failed;
+	int ret;
+
+	g_mutex_lock(&zw->mutex);
+	job->done = TRUE;
+	if (zw->writing) {
+		g_mutex_unlock(&zw->mutex);
+		return;
+	}
+	zw->writing = TRUE;
+	while ((job = g_queue_peek_head(&zw->jobs)) && job->done) {
+		g_queue_pop_head(&zw->jobs);
+		failed = zw->failed;
+		g_mutex_unlock(&zw->mutex);
+
+		size = job->entry.size;
+		compressed_size = job->entry.compressed_size;
+		ret = failed ? SR_ERR_IO : write_job(zw, job);
+		free_job(job);
+
+		g_mutex_lock(&zw->mutex);
+		if (ret == SR_OK) {
+			zw->stats.entries++;
+			zw->stats.size += size;
+			zw->stats.compressed_size += compressed_size;
+		} else {
+			zw->failed = TRUE;
+		}
+		zw->stats.backlog--;
+		g_cond_broadcast(&zw->cond);
+	}
+	zw->writing = FALSE;
+	g_mutex_unlock(&zw->mutex);
+}
+
+static void compress_worker(gpointer data, gpointer user_data)
+{
+	struct sr_zip_writer *zw;
+	struct zip_job *job;
+
+	job = data;
+	zw = user_data;
+
+	compress_job(zw->level, job);
+	complete_job(zw, job);
+}
+
+/**
+ * Create a ZIP archive for writing.
+ *
+ * An existing file of the same name is replaced.
+ *
+ * @param filename The name of the archive file. Must not be NULL.
+ * @param level The zlib compression level, 0 to store all entries
+ *              uncompressed or -1 for the default level.
+ * @param num_threads Number of threads compressing entries in the
+ *                    background. With 0, entries are compressed and
+ *                    written by sr_zip_writer_add() itself.
+ *
+ * @return The new writer, or NULL if the file could not be created.
+ *
+ * @private
+ */
+SR_PRIV struct sr_zip_writer *sr_zip_writer_new(const char *filename,
+		int level, unsigned int num_threads)
+{
+	struct sr_zip_writer *zw;
+	GDateTime *now;
+	FILE *file;
+
+	if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION) {
+		sr_err("Invalid compression level %d.", level);
+		return NULL;
+	}
+
+	if (!(file = g_fopen(filename, "wb"))) {
+		sr_err("Failed to create '%s': %s.", filename, g_strerror(errno));
+		return NULL;
+	}
+
+	zw = g_malloc0(sizeof(*zw));
+	zw->filename = g_strdup(filename);
+	zw->file = file;
+	zw->level = level;
+	zw->entries = g_array_new(FALSE, FALSE, sizeof(struct zip_entry));
+	g_mutex_init(&zw->mutex);
+	g_cond_init(&zw->cond);
+	g_queue_init(&zw->jobs);
+
+	now = g_date_time_new_now_local();
+	zw->dos_time = (g_date_time_get_hour(now) << 11)
+		| (g_date_time_get_minute(now) << 5)
+		| (g_date_time_get_second(now) / 2);
+	zw->dos_date = ((MAX(g_date_time_get_year(now), 1980) - 1980) << 9)
+		| (g_date_time_get_month(now) << 5)
+		| g_date_time_get_day_of_month(now);
+	g_date_time_unref(now);
+
+	if (num_threads > 0) {
+		zw->pool = g_thread_pool_new(compress_worker, zw, num_threads,
+				FALSE, NULL);
+		zw->max_backlog = num_threads * BACKLOG_PER_THREAD;
+	}
+
+	return zw;
+}
+
+/**
+ * Add an entry to a ZIP archive, without copying its contents.
+ *
+ * The writer takes its own reference to @a buf and drops it once the
+ * entry is written to the file. The caller must not change the contents
+ * of the buffer until then.
+ *
+ * Without worker threads, the entry is compressed and written right away.
+ * Otherwise this only blocks while the backlog of pending entries is
+ * full, and a failure to write an entry is reported by a later call or
+ * by sr_zip_writer_close().
+ *
+ * @param zw The writer. Must not be NULL.
+ * @param name The name of the entry. Must not be NULL.
+ * @param buf The buffer holding the contents of the entry. Must not be NULL.
+ * @param size The size of the entry in bytes, at most 4 GiB - 1 and not
+ *             larger than @a buf.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_IO Writing to the file failed.
+ *
+ * @private
+ */
+SR_PRIV int sr_zip_writer_add_buffer(struct sr_zip_writer *zw,
+		const char *name, struct sr_buffer *buf, size_t size)
+{
+	struct zip_job *job;
+	int64_t start;
+	int ret;
+
+	if (strlen(name) > ZIP_MAX16 || size >= ZIP_MAX32 || size > buf->size)
+		return SR_ERR_ARG;
+
+	g_mutex_lock(&zw->mutex);
+	if (zw->pool && zw->stats.backlog >= zw->max_backlog && !zw->failed) {
+		start = g_get_monotonic_time();
+		while (zw->stats.backlog >= zw->max_backlog && !zw->failed)
+			g_cond_wait(&zw->cond, &zw->mutex);
+		zw->stats.stalls++;
+		zw->stats.stall_time += g_get_monotonic_time() - start;
+	}
+	if (zw->failed) {
+		g_mutex_unlock(&zw->mutex);
+		return SR_ERR_IO;
+	}
+
+	job = g_malloc0(sizeof(*job));
+	job->entry.name = g_strdup(name);
+	job->entry.size = size;
+	job->buf = sr_buffer_ref(buf);
+	g_queue_push_tail(&zw->jobs, job);
+	zw->stats.backlog++;
+	zw->stats.max_backlog = MAX(zw->stats.max_backlog, zw->stats.backlog);
+	g_mutex_unlock(&zw->mutex);
+
+	if (zw->pool) {
+		g_thread_pool_push(zw->pool, job, NULL);
+		return SR_OK;
+	}
+
+	compress_job(zw->level, job);
+	complete_job(zw, job);
+
+	g_mutex_lock(&zw->mutex);
+	ret = zw->failed ? SR_ERR_IO : SR_OK;
+	g_mutex_unlock(&zw->mutex);
+
+	return ret;
+}
+
+/**
+ * Add an entry to a ZIP archive.
+ *
+ * Like sr_zip_writer_add_buffer(), but works on a copy of @a data.
+ *
+ * @param zw The writer. Must not be NULL.
+ * @param name The name of the entry. Must not be NULL.
+ * @param data The contents of the entry.
+ * @param size The size of @a data in bytes, at most 4 GiB - 1.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_MALLOC Not enough memory for the copy.
+ * @retval SR_ERR_IO Writing to the file failed.
+ *
+ * @private
+ */
+SR_PRIV int sr_zip_writer_add(struct sr_zip_writer *zw, const char *name,
+		const void *data, size_t size)
+{
+	struct sr_buffer *buf;
+	int ret;
+
+	if (!(buf = sr_buffer_new(size)))
+		return SR_ERR_MALLOC;
+	memcpy(buf->data, data, size);
+	ret = sr_zip_writer_add_buffer(zw, name, buf, size);
+	sr_buffer_unref(buf);
+
+	return ret;
+}
+
+/**
+ * Get the statistics of a ZIP archive writer.
+ *
+ * @param zw The writer. Must not be NULL.
+ * @param stats Filled in with the current statistics. Must not be NULL.
+ *
+ * @private
+ */
+SR_PRIV void sr_zip_writer_stats_get(struct sr_zip_writer *zw,
+		struct sr_zip_writer_stats *stats)
+{
+	g_mutex_lock(&zw->mutex);
+	*stats = zw->stats;
+	g_mutex_unlock(&zw->mutex);
+}
+
+static void put_central_header(GByteArray *dir, const struct zip_entry *e,
+		uint16_t dos_time, uint16_t dos_date)
+{
+	gboolean zip64;
+	size_t name_len;
+
+	zip64 = e->offset >= ZIP_MAX32;
+	name_len = strlen(e->name);
+
+	put32(dir, ZIP_CENTRAL_HEADER);
+	put16(dir, ZIP64_VERSION);
+	put16(dir, zip64 ? ZIP64_VERSION : ZIP_VERSION);
+	put16(dir, 0);
+	put16(dir, e->method);
+	put16(dir, dos_time);
+	put16(dir, dos_date);
+	put32(dir, e->crc);
+	put32(dir, e->compressed_size);
+	put32(dir, e->size);
+	put16(dir, name_len);
+	put16(dir, zip64 ? 12 : 0);
+	put16(dir, 0);
+	put16(dir, 0);
+	put16(dir, 0);
+	put32(dir, 0);
+	put32(dir, zip64 ? ZIP_MAX32 : e->offset);
+	g_byte_array_append(dir, (const guint8 *)e->name, name_len);
+	if (zip64) {
+		put16(dir, ZIP64_EXTRA);
+		put16(dir, 8);
+		put64(dir, e->offset);
+	}
+}
+
+/**
+ * Complete a ZIP archive and free the writer.
+ *
+ * Waits for all pending entries to be written, then writes the central
+ * directory and closes the file. The writer is freed even if that fails.
+ *
+ * @param zw The writer. NULL is ignored.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_IO Writing to the file failed.
+ *
+ * @private
+ */
+SR_PRIV int sr_zip_writer_close(struct sr_zip_writer *zw)
+{
+	struct zip_entry *e;
+	GByteArray *dir;
+	uint64_t dir_offset, dir_size, num_entries;
+	unsigned int i;
+	int ret;
+
+	if (!zw)
+		return SR_OK;
+
+	if (zw->pool) {
+		g_mutex_lock(&zw->mutex);
+		while (zw->stats.backlog > 0)
+			g_cond_wait(&zw->cond, &zw->mutex);
+		g_mutex_unlock(&zw->mutex);
+		g_thread_pool_free(zw->pool, FALSE, TRUE);
+	}
+
+	dir = g_byte_array_new();
+	for (i = 0; i < zw->entries->len; i++) {
+		e = &g_array_index(zw->entries, struct zip_entry, i);
+		put_central_header(dir, e, zw->dos_time, zw->dos_date);
+	}
+	dir_offset = zw->offset;
+	dir_size = dir->len;
+	num_entries = zw->entries->len;
+
+	if (dir_offset >= ZIP_MAX32 || dir_size >= ZIP_MAX32
+			|| num_entries >= ZIP_MAX16) {
+		put32(dir, ZIP64_END_OF_DIR);
+		put64(dir, 44);
+		put16(dir, ZIP64_VERSION);
+		put16(dir, ZIP64_VERSION);
+		put32(dir, 0);
+		put32(dir, 0);
+		put64(dir, num_entries);
+		put64(dir, num_entries);
+		put64(dir, dir_size);
+		put64(dir, dir_offset);
+
+		put32(dir, ZIP64_END_LOCATOR);
+		put32(dir, 0);
+		put64(dir, dir_offset + dir_size);
+		put32(dir, 1);
+	}
+
+	put32(dir, ZIP_END_OF_DIR);
+	put16(dir, 0);
+	put16(dir, 0);
+	put16(dir, MIN(num_entries, ZIP_MAX16));
+	put16(dir, MIN(num_entries, ZIP_MAX16));
+	put32(dir, MIN(dir_size, ZIP_MAX32));
+	put32(dir, MIN(dir_offset, ZIP_MAX32));
+	put16(dir, 0);
+
+	ret = zw->failed ? SR_ERR_IO : write_bytes(zw, dir->data, dir->len);
+	g_byte_array_free(dir, TRUE);
+
+	if (fclose(zw->file) != 0 && ret == SR_OK) {
+		sr_err("Failed to write to '%s': %s.", zw->filename,
+			g_strerror(errno));
+		ret = SR_ERR_IO;
+	}
+
+	for (i = 0; i < zw->entries->len; i++)
+		g_free(g_array_index(zw->entries, struct zip_entry, i).name);
+	g_array_free(zw->entries, TRUE);
+	g_mutex_clear(&zw->mutex);
+	g_cond_clear(&zw->cond);
+	g_free(zw->filename);
+	g_free(zw);
+
+	return ret;
+}
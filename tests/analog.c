@@ -19,6 +19,7 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <float.h>
 #include <math.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
@@ -85,6 +86,142 @@ START_TEST(test_analog_to_float)
 }
 END_TEST
 
+/*
+ * Check the conversion of all integer and float encodings, with enough
+ * samples to exercise both the vector kernels and the scalar tail.
+ */
+START_TEST(test_analog_to_float_encodings)
+{
+	int ret;
+	unsigned int i, n, us, be, sg;
+	float fout[37];
+	uint8_t data[37 * 4];
+	int64_t v;
+	float expected;
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	meaning.channels = g_slist_append(NULL, &ch);
+	analog.num_samples = ARRAY_SIZE(fout);
+	analog.data = data;
+	encoding.is_float = FALSE;
+	sr_rational_set(&encoding.scale, 1, 4);
+	sr_rational_set(&encoding.offset, 3, 1);
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = i * 37 + 11;
+
+	for (us = 1; us <= 4; us *= 2) {
+		for (be = 0; be < 2; be++) {
+			for (sg = 0; sg < 2; sg++) {
+				encoding.unitsize = us;
+				encoding.is_bigendian = be;
+				encoding.is_signed = sg;
+				ret = sr_analog_to_float(&analog, fout);
+				fail_unless(ret == SR_OK);
+				for (i = 0; i < ARRAY_SIZE(fout); i++) {
+					v = 0;
+					for (n = 0; n < us; n++)
+						v |= (int64_t)data[i * us + n]
+							<< (8 * (be ? us - 1 - n : n));
+					if (sg && v >= (int64_t)1 << (8 * us - 1))
+						v -= (int64_t)1 << (8 * us);
+					expected = 0.25f * (float)v + 3;
+					/* Fused multiply-adds may round differently. */
+					fail_unless(fabsf(fout[i] - expected) <= FLT_EPSILON
+						* (fabsf(0.25f * (float)v) + 3),
+						"unitsize %u be %u signed %u sample %u: "
+						"%f != %f", us, be, sg, i,
+						fout[i], expected);
+				}
+			}
+		}
+	}
+
+	/* Floats in the non-native byte order. */
+	encoding.unitsize = sizeof(float);
+	encoding.is_float = TRUE;
+	sr_rational_set(&encoding.scale, 1, 1);
+	sr_rational_set(&encoding.offset, 0, 1);
+	for (i = 0; i < ARRAY_SIZE(fout); i++) {
+		expected = i * 1.5f - 7;
+		memcpy(data + i * 4, &expected, 4);
+		for (n = 0; n < 2; n++) {
+			uint8_t t = data[i * 4 + n];
+			data[i * 4 + n] = data[i * 4 + 3 - n];
+			data[i * 4 + 3 - n] = t;
+		}
+	}
+#ifdef WORDS_BIGENDIAN
+	encoding.is_bigendian = FALSE;
+#else
+	encoding.is_bigendian = TRUE;
+#endif
+	ret = sr_analog_to_float(&analog, fout);
+	fail_unless(ret == SR_OK);
+	for (i = 0; i < ARRAY_SIZE(fout); i++)
+		fail_unless(fout[i] == i * 1.5f - 7, "%f != %f",
+			fout[i], i * 1.5f - 7);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
+/* Check whether a conversion plan gives the same result as a one-off. */
+START_TEST(test_analog_conv)
+{
+	int ret;
+	unsigned int i;
+	int16_t data[100];
+	float fout[100], fref[100];
+	struct sr_channel ch;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_analog_conv *conv;
+
+	sr_analog_init_(&analog, &encoding, &meaning, &spec, 3);
+	meaning.channels = g_slist_append(NULL, &ch);
+	analog.num_samples = ARRAY_SIZE(data);
+	analog.data = data;
+	encoding.unitsize = sizeof(int16_t);
+	encoding.is_float = FALSE;
+	encoding.is_signed = TRUE;
+	sr_rational_set(&encoding.scale, 10, 32768);
+	sr_rational_set(&encoding.offset, -1, 3);
+
+	for (i = 0; i < ARRAY_SIZE(data); i++)
+		data[i] = i * 655 - 32000;
+
+	ret = sr_analog_to_float(&analog, fref);
+	fail_unless(ret == SR_OK);
+	ret = sr_analog_conv_new(&encoding, &conv);
+	fail_unless(ret == SR_OK);
+	ret = sr_analog_conv_run(conv, data, ARRAY_SIZE(data), fout);
+	fail_unless(ret == SR_OK);
+	fail_unless(!memcmp(fout, fref, sizeof(fout)));
+
+	ret = sr_analog_conv_run(NULL, data, ARRAY_SIZE(data), fout);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_analog_conv_run(conv, data, ARRAY_SIZE(data), NULL);
+	fail_unless(ret == SR_ERR_ARG);
+	sr_analog_conv_free(conv);
+
+	ret = sr_analog_conv_new(NULL, &conv);
+	fail_unless(ret == SR_ERR_ARG);
+	encoding.unitsize = 3;
+	ret = sr_analog_conv_new(&encoding, &conv);
+	fail_unless(ret == SR_ERR);
+
+	g_slist_free(meaning.channels);
+}
+END_TEST
+
 START_TEST(test_analog_to_float_null)
 {
 	int ret;
@@ -386,6 +523,8 @@ Suite *suite_analog(void)
 	tc = tcase_create("analog_to_float");
 	tcase_add_test(tc, test_analog_to_float);
 	tcase_add_test(tc, test_analog_to_float_null);
+	tcase_add_test(tc, test_analog_to_float_encodings);
+	tcase_add_test(tc, test_analog_conv);
 	tcase_add_test(tc, test_analog_si_prefix);
 	tcase_add_test(tc, test_analog_si_prefix_null);
 	tcase_add_test(tc, test_analog_unit_to_string);
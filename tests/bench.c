@@ -0,0 +1,91 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Helpers shared by the microbenchmark programs. */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "bench.h"
+
+/* Minimum measurement time per case. */
+#define BENCH_TIME_US (200 * 1000)
+
+void bench_run(const char *group, const char *name,
+		void (*fn)(void *data), void *data, uint64_t items)
+{
+	int64_t start, elapsed;
+	uint64_t iterations;
+
+	/* Warm up caches and lazily initialized state. */
+	fn(data);
+
+	iterations = 0;
+	start = g_get_monotonic_time();
+	do {
+		fn(data);
+		iterations++;
+		elapsed = g_get_monotonic_time() - start;
+	} while (elapsed < BENCH_TIME_US);
+
+	printf("%-10s %-24s %10.1f M/s\n", group, name,
+		(double)items * iterations / elapsed);
+}
+
+void bench_fill(void *buf, size_t len)
+{
+	uint8_t *p;
+	uint32_t x;
+	size_t i;
+
+	p = buf;
+	x = 0x12345678;
+	for (i = 0; i < len; i++) {
+		/* xorshift32 */
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		p[i] = x;
+	}
+}
+
+int bench_main(int argc, char **argv,
+		const struct bench_group *groups, unsigned int num_groups)
+{
+	unsigned int i;
+	int a;
+
+	for (i = 0; i < num_groups; i++) {
+		if (argc > 1) {
+			for (a = 1; a < argc; a++) {
+				if (!strcmp(argv[a], groups[i].name))
+					break;
+			}
+			if (a == argc)
+				continue;
+		}
+		groups[i].run();
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LIBSIGROK_TESTS_BENCH_H
+#define LIBSIGROK_TESTS_BENCH_H
+
+#include <stdint.h>
+#include <glib.h>
+
+/*
+ * Run fn(data) repeatedly for at least the configured time and print
+ * the rate in items per second. Each call processes "items" items.
+ */
+void bench_run(const char *group, const char *name,
+		void (*fn)(void *data), void *data, uint64_t items);
+
+/* Fill a buffer with reproducible pseudo-random bytes. */
+void bench_fill(void *buf, size_t len);
+
+struct bench_group {
+	const char *name;
+	void (*run)(void);
+};
+
+/* Run the groups named on the command line, or all of them. */
+int bench_main(int argc, char **argv,
+		const struct bench_group *groups, unsigned int num_groups);
+
+void bench_analog(void);
+void bench_vcd(void);
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "bench.h"
+
+#define NUM_SAMPLES (64 * 1024)
+
+struct analog_case {
+	const char *name;
+	uint8_t unitsize;
+	gboolean is_signed;
+	gboolean is_float;
+	gboolean is_bigendian;
+};
+
+static const struct analog_case cases[] = {
+	{ "u8", 1, FALSE, FALSE, FALSE },
+	{ "s8", 1, TRUE, FALSE, FALSE },
+	{ "u16le", 2, FALSE, FALSE, FALSE },
+	{ "s16le", 2, TRUE, FALSE, FALSE },
+	{ "u16be", 2, FALSE, FALSE, TRUE },
+	{ "s16be", 2, TRUE, FALSE, TRUE },
+	{ "u32le", 4, FALSE, FALSE, FALSE },
+	{ "s32le", 4, TRUE, FALSE, FALSE },
+	{ "u32be", 4, FALSE, FALSE, TRUE },
+	{ "s32be", 4, TRUE, FALSE, TRUE },
+	{ "floatle", 4, TRUE, TRUE, FALSE },
+	{ "floatbe", 4, TRUE, TRUE, TRUE },
+};
+
+struct analog_bench {
+	struct sr_datafeed_analog analog;
+	struct sr_analog_conv *conv;
+	float *out;
+};
+
+static void run_to_float(void *data)
+{
+	struct analog_bench *b = data;
+
+	sr_analog_to_float(&b->analog, b->out);
+}
+
+static void run_conv(void *data)
+{
+	struct analog_bench *b = data;
+
+	sr_analog_conv_run(b->conv, b->analog.data, b->analog.num_samples,
+		b->out);
+}
+
+void bench_analog(void)
+{
+	struct analog_bench b;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	struct sr_channel ch;
+	unsigned int i;
+	char name[32];
+	void *samples;
+
+	samples = g_malloc(NUM_SAMPLES * sizeof(uint32_t));
+	bench_fill(samples, NUM_SAMPLES * sizeof(uint32_t));
+	b.out = g_malloc(NUM_SAMPLES * sizeof(float));
+
+	memset(&b.analog, 0, sizeof(b.analog));
+	memset(&meaning, 0, sizeof(meaning));
+	memset(&spec, 0, sizeof(spec));
+	meaning.channels = g_slist_append(NULL, &ch);
+	b.analog.encoding = &encoding;
+	b.analog.meaning = &meaning;
+	b.analog.spec = &spec;
+	b.analog.data = samples;
+	b.analog.num_samples = NUM_SAMPLES;
+
+	for (i = 0; i < G_N_ELEMENTS(cases); i++) {
+		memset(&encoding, 0, sizeof(encoding));
+		encoding.unitsize = cases[i].unitsize;
+		encoding.is_signed = cases[i].is_signed;
+		encoding.is_float = cases[i].is_float;
+		encoding.is_bigendian = cases[i].is_bigendian;
+		sr_rational_set(&encoding.scale, 5, 1024);
+		sr_rational_set(&encoding.offset, -1, 2);
+
+		snprintf(name, sizeof(name), "to_float/%s", cases[i].name);
+		bench_run("analog", name, run_to_float, &b, NUM_SAMPLES);
+
+		if (sr_analog_conv_new(&encoding, &b.conv) != SR_OK)
+			continue;
+		snprintf(name, sizeof(name), "conv/%s", cases[i].name);
+		bench_run("analog", name, run_conv, &b, NUM_SAMPLES);
+		sr_analog_conv_free(b.conv);
+	}
+
+	g_slist_free(meaning.channels);
+	g_free(b.out);
+	g_free(samples);
+}
@@ -0,0 +1,123 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmark of the C++ datafeed callback paths. Small logic packets are
+ * fed through the binary input module, and every callback sums up the
+ * samples of each packet:
+ *
+ * - "input": no callback, the cost of the input module and session.
+ * - "packet": Session::add_datafeed_callback(), a Packet per packet.
+ * - "view": Session::add_datafeed_view_callback(), a PacketView.
+ *
+ * Build with "make tests/bench-cxx-datafeed", rates are packets/s.
+ */
+
+#include <config.h>
+#include <libsigrokcxx/libsigrokcxx.hpp>
+
+extern "C" {
+#include "bench.h"
+}
+
+using namespace sigrok;
+
+#define NUM_PACKETS 1000
+#define PACKET_SIZE 64
+
+struct bench_state {
+	shared_ptr<Input> input;
+	vector<uint8_t> data;
+	uint64_t sum;
+};
+
+static void run_send(void *data)
+{
+	auto state = static_cast<struct bench_state *>(data);
+
+	for (unsigned int i = 0; i < NUM_PACKETS; i++)
+		state->input->send(state->data.data(), state->data.size());
+}
+
+static void bench_datafeed(const char *name,
+	void (*add_callback)(Session &session, struct bench_state &state))
+{
+	struct bench_state state;
+
+	auto context = Context::create();
+	auto session = context->create_session();
+	state.input = context->input_formats()["binary"]->create_input();
+	state.data.resize(PACKET_SIZE);
+	bench_fill(state.data.data(), state.data.size());
+	state.sum = 0;
+
+	/* The first chunk only makes the input's device available. */
+	state.input->send(state.data.data(), state.data.size());
+	session->add_device(state.input->device());
+	if (add_callback)
+		add_callback(*session, state);
+
+	bench_run("datafeed", name, run_send, &state, NUM_PACKETS);
+
+	state.input->end();
+	session->remove_datafeed_callbacks();
+	session->remove_devices();
+}
+
+static void add_packet_callback(Session &session, struct bench_state &state)
+{
+	session.add_datafeed_callback([&state] (shared_ptr<Device> device,
+			shared_ptr<Packet> packet) {
+		(void)device;
+		if (packet->type() != PacketType::LOGIC)
+			return;
+		auto logic = static_pointer_cast<Logic>(packet->payload());
+		auto samples = static_cast<const uint8_t *>(logic->data_pointer());
+		for (size_t i = 0; i < logic->data_length(); i++)
+			state.sum += samples[i];
+	});
+}
+
+static void add_view_callback(Session &session, struct bench_state &state)
+{
+	session.add_datafeed_view_callback([&state] (
+			const shared_ptr<Device> &device, const PacketView &packet) {
+		(void)device;
+		if (packet.type() != PacketType::LOGIC)
+			return;
+		for (auto sample : packet.logic().words<uint8_t>())
+			state.sum += sample;
+	});
+}
+
+static void bench_cxx_datafeed(void)
+{
+	bench_datafeed("input", nullptr);
+	bench_datafeed("packet", add_packet_callback);
+	bench_datafeed("view", add_view_callback);
+}
+
+static const struct bench_group groups[] = {
+	{ "datafeed", bench_cxx_datafeed },
+};
+
+int main(int argc, char **argv)
+{
+	return bench_main(argc, argv, groups, G_N_ELEMENTS(groups));
+}
@@ -0,0 +1,208 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks of the logic sample <-> bit plane transposes. They are
+ * compared against the loops they replace: the text output modules
+ * extracted one bit per sample and channel, and the DSLogic driver built
+ * each sample from one bit of every channel's word. Both references are
+ * kept here. The "kernel" runs use sr_logic_from_planes_kernel(), as the
+ * DSLogic driver does.
+ *
+ * The transposes are internal to libsigrok, so this program is built
+ * from their source directly. Build with "make tests/bench-logic-planes".
+ * Before timing, both directions are checked against the references on
+ * random data.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "bench.h"
+
+#define NUM_SAMPLES (256 * 1024)
+
+/* One bit per sample and channel, as the text output modules did. */
+static void ref_to_planes(uint64_t *planes, const uint8_t *samples,
+		unsigned int unitsize, unsigned int count)
+{
+	unsigned int k, ch;
+
+	memset(planes, 0, unitsize * 8 * sizeof(*planes));
+	for (k = 0; k < count; k++) {
+		for (ch = 0; ch < unitsize * 8; ch++) {
+			if (samples[k * unitsize + ch / 8] & (1 << (ch % 8)))
+				planes[ch] |= UINT64_C(1) << k;
+		}
+	}
+}
+
+/* One bit of every channel's word per sample, as the DSLogic driver did. */
+static void ref_from_planes(uint8_t *samples, const uint64_t *planes,
+		unsigned int unitsize, unsigned int count)
+{
+	unsigned int k, ch;
+
+	memset(samples, 0, count * unitsize);
+	for (k = 0; k < count; k++) {
+		for (ch = 0; ch < unitsize * 8; ch++) {
+			if ((planes[ch] >> k) & 1)
+				samples[k * unitsize + ch / 8] |= 1 << (ch % 8);
+		}
+	}
+}
+
+static void verify(void)
+{
+	GRand *rand;
+	uint8_t samples[64 * 16], out[64 * 16], ref[64 * 16];
+	uint8_t kernel_out[64 * 16];
+	uint64_t planes[128], ref_planes[128];
+	unsigned int c, i, unitsize, count;
+
+	rand = g_rand_new_with_seed(42);
+	for (c = 0; c < 100000; c++) {
+		unitsize = g_rand_int_range(rand, 1, 17);
+		count = g_rand_boolean(rand) ? 64 : g_rand_int_range(rand, 1, 65);
+		for (i = 0; i < sizeof(samples); i++)
+			samples[i] = g_rand_int(rand);
+
+		sr_logic_to_planes(planes, samples, unitsize, count);
+		ref_to_planes(ref_planes, samples, unitsize, count);
+		sr_logic_from_planes(out, planes, unitsize, count);
+		ref_from_planes(ref, planes, unitsize, count);
+		/* The kernels only build whole blocks. */
+		if (count == 64)
+			sr_logic_from_planes_kernel(unitsize)(kernel_out, planes,
+				unitsize);
+		else
+			memcpy(kernel_out, out, count * unitsize);
+		if (memcmp(planes, ref_planes, unitsize * 8 * sizeof(*planes))
+				|| memcmp(out, ref, count * unitsize)
+				|| memcmp(kernel_out, ref, count * unitsize)
+				|| memcmp(out, samples, count * unitsize)) {
+			printf("logic-planes mismatch in case %u "
+				"(unitsize %u, %u samples)\n", c, unitsize, count);
+			exit(EXIT_FAILURE);
+		}
+	}
+	g_rand_free(rand);
+	printf("%-10s verified against the original loops\n", "planes");
+}
+
+struct planes_bench {
+	unsigned int unitsize;
+	sr_logic_planes_kernel kernel;
+	uint8_t *samples;
+	uint64_t *planes;
+};
+
+static void run_ref_to(void *data)
+{
+	struct planes_bench *b = data;
+	unsigned int i;
+
+	for (i = 0; i < NUM_SAMPLES; i += 64)
+		ref_to_planes(b->planes + i / 8 * b->unitsize,
+			b->samples + i * b->unitsize, b->unitsize, 64);
+}
+
+static void run_to(void *data)
+{
+	struct planes_bench *b = data;
+	unsigned int i;
+
+	for (i = 0; i < NUM_SAMPLES; i += 64)
+		sr_logic_to_planes(b->planes + i / 8 * b->unitsize,
+			b->samples + i * b->unitsize, b->unitsize, 64);
+}
+
+static void run_ref_from(void *data)
+{
+	struct planes_bench *b = data;
+	unsigned int i;
+
+	for (i = 0; i < NUM_SAMPLES; i += 64)
+		ref_from_planes(b->samples + i * b->unitsize,
+			b->planes + i / 8 * b->unitsize, b->unitsize, 64);
+}
+
+static void run_from(void *data)
+{
+	struct planes_bench *b = data;
+	unsigned int i;
+
+	for (i = 0; i < NUM_SAMPLES; i += 64)
+		sr_logic_from_planes(b->samples + i * b->unitsize,
+			b->planes + i / 8 * b->unitsize, b->unitsize, 64);
+}
+
+static void run_kernel(void *data)
+{
+	struct planes_bench *b = data;
+	unsigned int i;
+
+	for (i = 0; i < NUM_SAMPLES; i += 64)
+		b->kernel(b->samples + i * b->unitsize,
+			b->planes + i / 8 * b->unitsize, b->unitsize);
+}
+
+static void bench_planes(void)
+{
+	static const unsigned int unitsizes[] = { 1, 2, 4, 8 };
+	struct planes_bench b;
+	char label[64];
+	unsigned int i;
+
+	verify();
+	for (i = 0; i < G_N_ELEMENTS(unitsizes); i++) {
+		b.unitsize = unitsizes[i];
+		b.samples = g_malloc(NUM_SAMPLES * b.unitsize);
+		b.planes = g_malloc(NUM_SAMPLES * b.unitsize);
+		bench_fill(b.samples, NUM_SAMPLES * b.unitsize);
+
+		snprintf(label, sizeof(label), "to/%uch/original", 8 * b.unitsize);
+		bench_run("planes", label, run_ref_to, &b, NUM_SAMPLES);
+		snprintf(label, sizeof(label), "to/%uch/transpose", 8 * b.unitsize);
+		bench_run("planes", label, run_to, &b, NUM_SAMPLES);
+		snprintf(label, sizeof(label), "from/%uch/original", 8 * b.unitsize);
+		bench_run("planes", label, run_ref_from, &b, NUM_SAMPLES);
+		snprintf(label, sizeof(label), "from/%uch/transpose", 8 * b.unitsize);
+		bench_run("planes", label, run_from, &b, NUM_SAMPLES);
+		b.kernel = sr_logic_from_planes_kernel(b.unitsize);
+		snprintf(label, sizeof(label), "from/%uch/kernel", 8 * b.unitsize);
+		bench_run("planes", label, run_kernel, &b, NUM_SAMPLES);
+
+		g_free(b.samples);
+		g_free(b.planes);
+	}
+}
+
+static const struct bench_group groups[] = {
+	{ "planes", bench_planes },
+};
+
+int main(int argc, char **argv)
+{
+	return bench_main(argc, argv, groups, G_N_ELEMENTS(groups));
+}
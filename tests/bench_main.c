@@ -0,0 +1,41 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks for libsigrok hot paths.
+ *
+ * Not part of "make check"; build with "make tests/bench" and run
+ * tests/bench [group...] to print items/s for every case of the given
+ * groups (all groups by default).
+ */
+
+#include <config.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "bench.h"
+
+static const struct bench_group groups[] = {
+	{ "analog", bench_analog },
+	{ "vcd", bench_vcd },
+};
+
+int main(int argc, char **argv)
+{
+	return bench_main(argc, argv, groups, G_N_ELEMENTS(groups));
+}
@@ -0,0 +1,772 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks of the soft triggers. The logic trigger is compared against
+ * its original per-sample implementation, the analog trigger against a
+ * straightforward one. Both references are kept here.
+ *
+ * The soft triggers are internal to libsigrok, so this program is built
+ * from their sources directly instead of linking the library. Build with
+ * "make tests/bench-soft-trigger". Before timing, every trigger is run on
+ * random data and must agree with its reference on every result.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "libsigrok-internal.h"
+#include "bench.h"
+
+#define NUM_SAMPLES (1024 * 1024)
+
+/* The analog pre-trigger samples last sent, interleaved. */
+static float sent_values[4096 * 4];
+static int sent_samples, sent_count;
+
+/* soft-trigger.c sends pre-trigger data and the trigger marker. */
+SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	const struct sr_datafeed_analog *analog;
+	int count;
+
+	(void)sdi;
+
+	if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		count = analog->num_samples
+			* g_slist_length(analog->meaning->channels);
+		if (sent_count + count <= (int)G_N_ELEMENTS(sent_values))
+			memcpy(sent_values + sent_count, analog->data,
+				count * sizeof(float));
+		sent_samples += analog->num_samples;
+		sent_count += count;
+	}
+
+	return SR_OK;
+}
+
+struct legacy_trigger {
+	const struct sr_trigger *trigger;
+	int count;
+	int unitsize;
+	int cur_stage;
+	uint8_t prev_sample[8];
+};
+
+static gboolean legacy_check_match(struct legacy_trigger *lt,
+		uint8_t *sample, struct sr_trigger_match *match)
+{
+	int bit, prev_bit;
+	gboolean result;
+
+	lt->count++;
+	result = FALSE;
+	bit = *(sample + match->channel->index / 8)
+			& (1 << (match->channel->index % 8));
+	if (match->match == SR_TRIGGER_ZERO)
+		result = bit == 0;
+	else if (match->match == SR_TRIGGER_ONE)
+		result = bit != 0;
+	else {
+		if (lt->count == 1)
+			return FALSE;
+		prev_bit = *(lt->prev_sample + match->channel->index / 8)
+				& (1 << (match->channel->index % 8));
+		if (match->match == SR_TRIGGER_RISING)
+			result = prev_bit == 0 && bit != 0;
+		else if (match->match == SR_TRIGGER_FALLING)
+			result = prev_bit != 0 && bit == 0;
+		else if (match->match == SR_TRIGGER_EDGE)
+			result = prev_bit != bit;
+	}
+
+	return result;
+}
+
+/*
+ * The original soft_trigger_logic_check() without the pre-trigger
+ * buffer. Going back past the start of the buffer now lands on the first
+ * sample, where the original ended up in the middle of it for samples
+ * of more than one byte.
+ */
+static int legacy_check(struct legacy_trigger *lt, uint8_t *buf, int len)
+{
+	struct sr_trigger_stage *stage;
+	struct sr_trigger_match *match;
+	GSList *l, *l_stage;
+	int i;
+	gboolean match_found;
+
+	for (i = 0; i < len; i += lt->unitsize) {
+		l_stage = g_slist_nth(lt->trigger->stages, lt->cur_stage);
+		stage = l_stage->data;
+		if (!stage->matches)
+			return SR_ERR_ARG;
+
+		match_found = TRUE;
+		for (l = stage->matches; l; l = l->next) {
+			match = l->data;
+			if (!match->channel->enabled)
+				continue;
+			if (!legacy_check_match(lt, buf + i, match)) {
+				match_found = FALSE;
+				break;
+			}
+		}
+		memcpy(lt->prev_sample, buf + i, lt->unitsize);
+		if (match_found) {
+			if (l_stage->next)
+				lt->cur_stage++;
+			else
+				return i / lt->unitsize;
+		} else if (lt->cur_stage > 0) {
+			i -= lt->cur_stage * lt->unitsize;
+			if (i < -lt->unitsize)
+				i = -lt->unitsize;
+			lt->cur_stage = 0;
+		}
+	}
+
+	return -1;
+}
+
+struct trigger_setup {
+	struct sr_dev_inst sdi;
+	struct sr_channel channels[64];
+	struct sr_trigger trigger;
+	struct sr_trigger_stage stages[4];
+	struct sr_trigger_match matches[16];
+	int num_matches;
+};
+
+static void setup_init(struct trigger_setup *ts, int num_channels)
+{
+	int i;
+
+	memset(ts, 0, sizeof(*ts));
+	for (i = 0; i < num_channels; i++) {
+		ts->channels[i].sdi = &ts->sdi;
+		ts->channels[i].index = i;
+		ts->channels[i].type = SR_CHANNEL_LOGIC;
+		ts->channels[i].enabled = TRUE;
+		ts->sdi.channels = g_slist_append(ts->sdi.channels,
+				&ts->channels[i]);
+	}
+}
+
+static struct sr_trigger_match *setup_add(struct trigger_setup *ts,
+		int stage, int channel, int match)
+{
+	struct sr_trigger_match *m;
+
+	while (g_slist_length(ts->trigger.stages) <= (guint)stage) {
+		ts->stages[g_slist_length(ts->trigger.stages)].stage =
+				g_slist_length(ts->trigger.stages);
+		ts->trigger.stages = g_slist_append(ts->trigger.stages,
+				&ts->stages[g_slist_length(ts->trigger.stages)]);
+	}
+	m = &ts->matches[ts->num_matches++];
+	m->channel = &ts->channels[channel];
+	m->match = match;
+	ts->stages[stage].matches = g_slist_append(ts->stages[stage].matches, m);
+
+	return m;
+}
+
+static void setup_clear(struct trigger_setup *ts)
+{
+	int i;
+
+	for (i = 0; i < 4; i++)
+		g_slist_free(ts->stages[i].matches);
+	g_slist_free(ts->trigger.stages);
+	g_slist_free(ts->sdi.channels);
+}
+
+static const int match_types[] = {
+	SR_TRIGGER_ZERO, SR_TRIGGER_ONE, SR_TRIGGER_RISING,
+	SR_TRIGGER_FALLING, SR_TRIGGER_EDGE,
+};
+
+/* Run both versions on random triggers and data, compare every result. */
+static void verify(void)
+{
+	struct trigger_setup ts;
+	struct soft_trigger_logic *stl;
+	struct legacy_trigger lt;
+	GRand *rand;
+	uint8_t buf[4096];
+	int c, n, i, chunk, pos, num_channels, len, r1, r2;
+
+	rand = g_rand_new_with_seed(42);
+	for (c = 0; c < 20000; c++) {
+		num_channels = g_rand_int_range(rand, 1, 4) * 8;
+		if (g_rand_boolean(rand))
+			num_channels = 64;
+		setup_init(&ts, num_channels);
+		n = g_rand_int_range(rand, 1, 4);
+		for (i = 0; i < n; i++) {
+			setup_add(&ts, i, g_rand_int_range(rand, 0, 4),
+				match_types[g_rand_int_range(rand, 0, 5)]);
+			if (g_rand_boolean(rand))
+				setup_add(&ts, i, g_rand_int_range(rand, 0, 4),
+					match_types[g_rand_int_range(rand, 0, 5)]);
+		}
+		if (g_rand_int_range(rand, 0, 8) == 0)
+			ts.channels[g_rand_int_range(rand, 0, 4)].enabled = FALSE;
+
+		stl = soft_trigger_logic_new(&ts.sdi, &ts.trigger, 0);
+		memset(&lt, 0, sizeof(lt));
+		lt.trigger = &ts.trigger;
+		lt.unitsize = stl->unitsize;
+
+		/* Mostly idle data on the trigger channels. */
+		for (i = 0; i < (int)sizeof(buf); i++)
+			buf[i] = g_rand_int_range(rand, 0, 8) ?
+				(i ? buf[i - 1] : 0) : g_rand_int(rand);
+		len = sizeof(buf) / stl->unitsize * stl->unitsize;
+
+		for (pos = 0; pos < len; pos += chunk) {
+			chunk = g_rand_int_range(rand, 1, 64) * stl->unitsize;
+			chunk = MIN(chunk, len - pos);
+			r1 = legacy_check(&lt, buf + pos, chunk);
+			r2 = soft_trigger_logic_check(stl, buf + pos, chunk, NULL);
+			if (r1 != r2 || lt.cur_stage != stl->cur_stage
+					|| memcmp(lt.prev_sample, stl->prev_sample,
+						stl->unitsize)) {
+				printf("soft-trigger mismatch in case %d at %d: "
+					"%d != %d\n", c, pos, r1, r2);
+				exit(EXIT_FAILURE);
+			}
+			if (r1 >= 0)
+				break;
+		}
+
+		soft_trigger_logic_free(stl);
+		setup_clear(&ts);
+	}
+	g_rand_free(rand);
+	printf("%-10s verified against the original implementation\n",
+		"trigger");
+}
+
+struct trigger_bench {
+	struct trigger_setup ts;
+	struct soft_trigger_logic *stl;
+	struct legacy_trigger lt;
+	uint8_t *buf;
+	int len;
+};
+
+static void run_legacy(void *data)
+{
+	struct trigger_bench *b = data;
+
+	legacy_check(&b->lt, b->buf, b->len);
+}
+
+static void run_compiled(void *data)
+{
+	struct trigger_bench *b = data;
+
+	soft_trigger_logic_check(b->stl, b->buf, b->len, NULL);
+}
+
+static void bench_case(const char *name, int num_channels,
+		const int (*matches)[3], int num_matches)
+{
+	struct trigger_bench b;
+	char label[64];
+	int i;
+
+	setup_init(&b.ts, num_channels);
+	for (i = 0; i < num_matches; i++)
+		setup_add(&b.ts, matches[i][0], matches[i][1], matches[i][2]);
+	b.stl = soft_trigger_logic_new(&b.ts.sdi, &b.ts.trigger, 0);
+	memset(&b.lt, 0, sizeof(b.lt));
+	b.lt.trigger = &b.ts.trigger;
+	b.lt.unitsize = b.stl->unitsize;
+
+	/* Channel 0 stays low, so the trigger never fires. */
+	b.len = NUM_SAMPLES * b.stl->unitsize;
+	b.buf = g_malloc(b.len);
+	bench_fill(b.buf, b.len);
+	for (i = 0; i < b.len; i += b.stl->unitsize)
+		b.buf[i] &= ~1;
+
+	snprintf(label, sizeof(label), "%s/original", name);
+	bench_run("trigger", label, run_legacy, &b, NUM_SAMPLES);
+	snprintf(label, sizeof(label), "%s/compiled", name);
+	bench_run("trigger", label, run_compiled, &b, NUM_SAMPLES);
+
+	g_free(b.buf);
+	soft_trigger_logic_free(b.stl);
+	setup_clear(&b.ts);
+}
+
+static void bench_soft_trigger(void)
+{
+	static const int rising[][3] = {
+		{ 0, 0, SR_TRIGGER_RISING },
+	};
+	static const int pattern[][3] = {
+		{ 0, 0, SR_TRIGGER_ONE },
+		{ 0, 3, SR_TRIGGER_ZERO },
+		{ 0, 9, SR_TRIGGER_EDGE },
+	};
+	static const int stages[][3] = {
+		{ 0, 1, SR_TRIGGER_ONE },
+		{ 1, 0, SR_TRIGGER_ONE },
+		{ 2, 2, SR_TRIGGER_FALLING },
+	};
+
+	verify();
+	bench_case("8ch-rising", 8, rising, G_N_ELEMENTS(rising));
+	bench_case("16ch-pattern", 16, pattern, G_N_ELEMENTS(pattern));
+	bench_case("32ch-pattern", 32, pattern, G_N_ELEMENTS(pattern));
+	bench_case("8ch-3stage", 8, stages, G_N_ELEMENTS(stages));
+}
+
+/*
+ * The analog reference works on the whole stream at once. The edge state
+ * before every sample is worked out first, then the stages are checked
+ * sample by sample with the same backtracking as the trigger.
+ */
+struct ref_match {
+	int match;
+	int channel;
+	float value, lo, hi;
+	int *state;
+};
+
+struct ref_stage {
+	struct ref_match matches[4];
+	int num_matches;
+	gboolean empty, never;
+};
+
+static gboolean ref_stage_match(const struct ref_stage *st,
+		const float *data, int num_channels, int g)
+{
+	const struct ref_match *m;
+	float x;
+	int i;
+
+	if (st->never)
+		return FALSE;
+	for (i = 0; i < st->num_matches; i++) {
+		m = &st->matches[i];
+		x = data[g * num_channels + m->channel];
+		if (m->match == SR_TRIGGER_OVER && !(x > m->value))
+			return FALSE;
+		if (m->match == SR_TRIGGER_UNDER && !(x < m->value))
+			return FALSE;
+		if (m->match == SR_TRIGGER_RISING
+				&& !(x > m->value && m->state[g] == 1))
+			return FALSE;
+		if (m->match == SR_TRIGGER_FALLING
+				&& !(x < m->value && m->state[g] == 2))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Returns the trigger sample in the stream, -1 or an error. */
+static int ref_analog(const struct sr_trigger *trigger, GSList *layout,
+		float hysteresis, const float *data, int num,
+		const int *chunks)
+{
+	struct ref_stage stages[4], *st;
+	struct ref_match *m;
+	const struct sr_trigger_match *match;
+	GSList *l, *lm;
+	int num_channels, num_stages, cur, base, n, i, g, s, state, ret;
+
+	num_channels = g_slist_length(layout);
+	memset(stages, 0, sizeof(stages));
+	num_stages = 0;
+	for (l = trigger->stages; l; l = l->next) {
+		st = &stages[num_stages++];
+		st->empty = !((struct sr_trigger_stage *)l->data)->matches;
+		for (lm = ((struct sr_trigger_stage *)l->data)->matches; lm;
+				lm = lm->next) {
+			match = lm->data;
+			if (!match->channel->enabled)
+				continue;
+			if (g_slist_index(layout, match->channel) < 0
+					|| match->match < SR_TRIGGER_RISING
+					|| match->match == SR_TRIGGER_EDGE) {
+				st->never = TRUE;
+				continue;
+			}
+			m = &st->matches[st->num_matches++];
+			m->match = match->match;
+			m->channel = g_slist_index(layout, match->channel);
+			m->value = match->value;
+			m->lo = m->hi = match->value;
+			if (m->match == SR_TRIGGER_RISING)
+				m->lo -= hysteresis;
+			else if (m->match == SR_TRIGGER_FALLING)
+				m->hi += hysteresis;
+			m->state = g_malloc(num * sizeof(int));
+			for (g = 0, state = 0; g < num; g++) {
+				m->state[g] = state;
+				if (data[g * num_channels + m->channel] < m->lo)
+					state = 1;
+				else if (data[g * num_channels + m->channel] > m->hi)
+					state = 2;
+			}
+		}
+	}
+
+	ret = -1;
+	cur = 0;
+	for (base = 0; *chunks && ret == -1; base += *chunks++) {
+		n = *chunks;
+		for (i = 0; i < n; i++) {
+			if (stages[cur].empty) {
+				ret = SR_ERR_ARG;
+				break;
+			}
+			if (ref_stage_match(&stages[cur], data, num_channels,
+					base + i)) {
+				if (cur < num_stages - 1) {
+					cur++;
+				} else {
+					ret = base + i;
+					break;
+				}
+			} else if (cur > 0) {
+				i -= cur;
+				if (i < -1)
+					i = -1;
+				cur = 0;
+			}
+		}
+	}
+
+	for (s = 0; s < num_stages; s++) {
+		for (i = 0; i < stages[s].num_matches; i++)
+			g_free(stages[s].matches[i].state);
+	}
+
+	return ret;
+}
+
+static const int analog_match_types[] = {
+	SR_TRIGGER_RISING, SR_TRIGGER_FALLING, SR_TRIGGER_OVER,
+	SR_TRIGGER_UNDER, SR_TRIGGER_RISING, SR_TRIGGER_FALLING,
+	SR_TRIGGER_ONE,
+};
+
+static float random_value(GRand *rand)
+{
+	return (g_rand_int_range(rand, 0, 4001) - 2000) / 1000.0f;
+}
+
+static void analog_packet(struct sr_datafeed_analog *analog,
+		struct sr_analog_encoding *encoding,
+		struct sr_analog_meaning *meaning, struct sr_analog_spec *spec,
+		GSList *layout, const float *data, int num)
+{
+	sr_analog_init(analog, encoding, meaning, spec, 3);
+	meaning->channels = layout;
+	meaning->mq = SR_MQ_VOLTAGE;
+	meaning->unit = SR_UNIT_VOLT;
+	analog->num_samples = num;
+	analog->data = (void *)data;
+}
+
+/* Run the analog trigger on random triggers and data against the reference. */
+static void verify_analog(void)
+{
+	struct trigger_setup ts;
+	struct soft_trigger_analog *sta;
+	struct sr_trigger_match *m;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+	GSList *layout;
+	GRand *rand;
+	float data[4096 * 4], swapped[4096 * 4], hysteresis;
+	uint32_t u;
+	int chunks[4096 + 1];
+	int c, n, i, j, k, pos, num, num_channels, pre, r1, r2, pre_sent;
+
+	rand = g_rand_new_with_seed(23);
+	for (c = 0; c < 20000; c++) {
+		num_channels = g_rand_int_range(rand, 1, 4);
+		setup_init(&ts, num_channels + 1);
+		for (i = 0; i <= num_channels; i++)
+			ts.channels[i].type = SR_CHANNEL_ANALOG;
+		layout = NULL;
+		for (i = 0; i < num_channels; i++)
+			layout = g_slist_append(layout, &ts.channels[i]);
+
+		n = g_rand_int_range(rand, 1, 4);
+		for (i = 0; i < n; i++) {
+			k = g_rand_int_range(rand, 1, 3);
+			for (j = 0; j < k; j++) {
+				m = setup_add(&ts, i,
+					g_rand_int_range(rand, 0, num_channels
+						+ (g_rand_int_range(rand, 0, 16) == 0)),
+					analog_match_types[g_rand_int_range(rand, 0,
+						G_N_ELEMENTS(analog_match_types) - 1
+						+ (g_rand_int_range(rand, 0, 16) == 0))]);
+				m->value = random_value(rand) / 2;
+			}
+		}
+		if (g_rand_int_range(rand, 0, 8) == 0)
+			ts.channels[g_rand_int_range(rand, 0,
+				num_channels)].enabled = FALSE;
+		hysteresis = g_rand_int_range(rand, 0, 3) * 0.25f;
+		pre = g_rand_int_range(rand, 0, 3) * 100;
+
+		/* Random walks with the occasional jump or NaN. */
+		num = g_rand_int_range(rand, 1, 4096);
+		for (i = 0; i < num * num_channels; i++) {
+			j = g_rand_int_range(rand, 0, 64);
+			if (i < num_channels || j == 0)
+				data[i] = random_value(rand);
+			else if (j == 1)
+				data[i] = NAN;
+			else if (isnan(data[i - num_channels]))
+				data[i] = 0;
+			else
+				data[i] = data[i - num_channels]
+					+ random_value(rand) / 16;
+		}
+		for (i = 0, pos = 0; pos < num; pos += chunks[i++]) {
+			chunks[i] = g_rand_int_range(rand, 1, 300);
+			chunks[i] = MIN(chunks[i], num - pos);
+		}
+		chunks[i] = 0;
+
+		r1 = ref_analog(&ts.trigger, layout, hysteresis, data, num,
+			chunks);
+
+		/* Every other case goes through the conversion to floats. */
+		for (i = 0; i < num * num_channels; i++) {
+			memcpy(&u, &data[i], sizeof(u));
+			u = GUINT32_SWAP_LE_BE(u);
+			memcpy(&swapped[i], &u, sizeof(u));
+		}
+
+		sta = soft_trigger_analog_new(&ts.sdi, &ts.trigger, pre,
+			hysteresis);
+		sent_samples = sent_count = 0;
+		r2 = -1;
+		for (i = 0, pos = 0; chunks[i]; pos += chunks[i++]) {
+			analog_packet(&analog, &encoding, &meaning, &spec,
+				layout, (c & 1 ? swapped : data)
+				+ pos * num_channels, chunks[i]);
+			if (c & 1)
+				encoding.is_bigendian = !encoding.is_bigendian;
+			r2 = soft_trigger_analog_check(sta, &analog, &pre_sent);
+			if (r2 >= 0) {
+				r2 += pos;
+				break;
+			}
+			if (r2 < -1)
+				break;
+		}
+		soft_trigger_analog_free(sta);
+
+		if (r1 != r2 || (r1 >= 0 && (pre_sent != MIN(pre, r1)
+				|| sent_samples != pre_sent
+				|| memcmp(sent_values, data + (r1 - pre_sent)
+					* num_channels, pre_sent * num_channels
+					* sizeof(float))))) {
+			printf("analog soft-trigger mismatch in case %d: "
+				"%d != %d\n", c, r1, r2);
+			exit(EXIT_FAILURE);
+		}
+
+		g_slist_free(layout);
+		setup_clear(&ts);
+	}
+	g_rand_free(rand);
+	printf("%-10s verified against the reference implementation\n",
+		"analog");
+}
+
+/*
+ * The straightforward way: look at every sample of every match, keeping
+ * the edge states up to date as it goes. Only single stage triggers.
+ */
+struct naive_trigger {
+	struct sr_trigger_match *matches[4];
+	int num_matches;
+	float hysteresis;
+	int state[4];
+};
+
+static int naive_check(struct naive_trigger *nt, const float *data,
+		int num_channels, int num)
+{
+	const struct sr_trigger_match *m;
+	float x;
+	int i, j, state;
+	gboolean match_found;
+
+	for (i = 0; i < num; i++) {
+		match_found = TRUE;
+		for (j = 0; j < nt->num_matches; j++) {
+			m = nt->matches[j];
+			x = data[i * num_channels + m->channel->index];
+			state = nt->state[j];
+			switch (m->match) {
+			case SR_TRIGGER_OVER:
+				match_found &= x > m->value;
+				break;
+			case SR_TRIGGER_UNDER:
+				match_found &= x < m->value;
+				break;
+			case SR_TRIGGER_RISING:
+				match_found &= x > m->value && state == 1;
+				if (x < m->value - nt->hysteresis)
+					state = 1;
+				else if (x > m->value)
+					state = 2;
+				break;
+			case SR_TRIGGER_FALLING:
+				match_found &= x < m->value && state == 2;
+				if (x < m->value)
+					state = 1;
+				else if (x > m->value + nt->hysteresis)
+					state = 2;
+				break;
+			}
+			nt->state[j] = state;
+		}
+		if (match_found)
+			return i;
+	}
+
+	return -1;
+}
+
+struct analog_bench {
+	struct trigger_setup ts;
+	struct soft_trigger_analog *sta;
+	struct naive_trigger nt;
+	GSList *layout;
+	int num_channels;
+	float *data;
+};
+
+static void run_naive(void *data)
+{
+	struct analog_bench *b = data;
+
+	naive_check(&b->nt, b->data, b->num_channels, NUM_SAMPLES);
+}
+
+static void run_analog(void *data)
+{
+	struct analog_bench *b = data;
+	struct sr_datafeed_analog analog;
+	struct sr_analog_encoding encoding;
+	struct sr_analog_meaning meaning;
+	struct sr_analog_spec spec;
+
+	analog_packet(&analog, &encoding, &meaning, &spec, b->layout,
+		b->data, NUM_SAMPLES);
+	soft_trigger_analog_check(b->sta, &analog, NULL);
+}
+
+static void bench_analog_case(const char *name, int num_channels,
+		const int (*matches)[2], const float *values, int num_matches)
+{
+	struct analog_bench b;
+	char label[64];
+	int i;
+
+	memset(&b, 0, sizeof(b));
+	setup_init(&b.ts, num_channels);
+	for (i = 0; i < num_channels; i++) {
+		b.ts.channels[i].type = SR_CHANNEL_ANALOG;
+		b.layout = g_slist_append(b.layout, &b.ts.channels[i]);
+	}
+	b.num_channels = num_channels;
+	for (i = 0; i < num_matches; i++) {
+		b.nt.matches[i] = setup_add(&b.ts, 0, matches[i][0],
+			matches[i][1]);
+		b.nt.matches[i]->value = values[i];
+	}
+	b.nt.num_matches = num_matches;
+	b.nt.hysteresis = 0.1;
+	b.sta = soft_trigger_analog_new(&b.ts.sdi, &b.ts.trigger, 0, 0.1);
+
+	/* Noisy sines staying within +-1, which the triggers never reach. */
+	b.data = g_malloc(NUM_SAMPLES * num_channels * sizeof(float));
+	for (i = 0; i < NUM_SAMPLES * num_channels; i++)
+		b.data[i] = 0.9f * sinf(i / 1000.0f)
+			+ 0.05f * ((i * 2654435761u) >> 24) / 256.0f;
+
+	snprintf(label, sizeof(label), "%s/naive", name);
+	bench_run("analog", label, run_naive, &b, NUM_SAMPLES);
+	snprintf(label, sizeof(label), "%s/scan", name);
+	bench_run("analog", label, run_analog, &b, NUM_SAMPLES);
+
+	g_free(b.data);
+	soft_trigger_analog_free(b.sta);
+	g_slist_free(b.layout);
+	setup_clear(&b.ts);
+}
+
+static void bench_soft_trigger_analog(void)
+{
+	static const int rising[][2] = {
+		{ 0, SR_TRIGGER_RISING },
+	};
+	static const float rising_values[] = { 1.5 };
+	static const int window[][2] = {
+		{ 0, SR_TRIGGER_OVER },
+		{ 0, SR_TRIGGER_UNDER },
+	};
+	static const float window_values[] = { 1.5, 2.0 };
+	static const int falling[][2] = {
+		{ 1, SR_TRIGGER_FALLING },
+	};
+	static const float falling_values[] = { -1.5 };
+
+	verify_analog();
+	bench_analog_case("1ch-rising", 1, rising, rising_values, 1);
+	bench_analog_case("1ch-window", 1, window, window_values, 2);
+	bench_analog_case("4ch-falling", 4, falling, falling_values, 1);
+}
+
+static const struct bench_group groups[] = {
+	{ "trigger", bench_soft_trigger },
+	{ "analog", bench_soft_trigger_analog },
+};
+
+int main(int argc, char **argv)
+{
+	return bench_main(argc, argv, groups, G_N_ELEMENTS(groups));
+}
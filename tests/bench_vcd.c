@@ -0,0 +1,119 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <libsigrok/libsigrok.h>
+#include "bench.h"
+
+#define NUM_SAMPLES (256 * 1024)
+
+struct vcd_case {
+	const char *name;
+	uint16_t unitsize;
+	/* On average, one in this many samples differs from the previous one. */
+	unsigned int change_interval;
+};
+
+static const struct vcd_case cases[] = {
+	{ "8ch/busy", 1, 1 },
+	{ "8ch/slow", 1, 100 },
+	{ "16ch/busy", 2, 1 },
+	{ "16ch/slow", 2, 100 },
+	{ "32ch/slow", 4, 100 },
+	{ "64ch/slow", 8, 100 },
+};
+
+struct vcd_bench {
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+};
+
+static void run_vcd(void *data)
+{
+	struct vcd_bench *b = data;
+	GString *out;
+
+	if (sr_output_send(b->o, &b->packet, &out) == SR_OK && out)
+		g_string_free(out, TRUE);
+}
+
+/* Samples which keep their value for change_interval samples on average. */
+static void fill_samples(uint8_t *samples, const struct vcd_case *c)
+{
+	uint8_t *rnd;
+	size_t i, size;
+
+	size = NUM_SAMPLES * c->unitsize;
+	rnd = g_malloc(size);
+	bench_fill(rnd, size);
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		if (i == 0 || rnd[i * c->unitsize] % c->change_interval == 0)
+			memcpy(samples + i * c->unitsize, rnd + i * c->unitsize,
+				c->unitsize);
+		else
+			memcpy(samples + i * c->unitsize,
+				samples + (i - 1) * c->unitsize, c->unitsize);
+	}
+	g_free(rnd);
+}
+
+void bench_vcd(void)
+{
+	struct vcd_bench b;
+	struct sr_datafeed_packet end;
+	struct sr_dev_inst *sdi;
+	const struct vcd_case *c;
+	GString *out;
+	uint8_t *samples;
+	unsigned int i, ch;
+
+	samples = g_malloc(NUM_SAMPLES * 8);
+	end.type = SR_DF_END;
+	end.payload = NULL;
+
+	for (i = 0; i < G_N_ELEMENTS(cases); i++) {
+		c = &cases[i];
+		fill_samples(samples, c);
+
+		sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+		for (ch = 0; ch < 8 * c->unitsize; ch++)
+			sr_dev_inst_channel_add(sdi, ch, SR_CHANNEL_LOGIC, "D");
+		b.o = sr_output_new(sr_output_find("vcd"), NULL, sdi, NULL);
+		if (!b.o)
+			continue;
+
+		b.packet.type = SR_DF_LOGIC;
+		b.packet.payload = &b.logic;
+		b.logic.length = NUM_SAMPLES * c->unitsize;
+		b.logic.unitsize = c->unitsize;
+		b.logic.data = samples;
+		bench_run("vcd", c->name, run_vcd, &b, NUM_SAMPLES);
+
+		if (sr_output_send(b.o, &end, &out) == SR_OK && out)
+			g_string_free(out, TRUE);
+		sr_output_free(b.o);
+	}
+
+	g_free(samples);
+}
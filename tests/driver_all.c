@@ -40,6 +40,88 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+static void scan_found(struct sr_dev_inst *sdi, void *cb_data)
+{
+	fail_unless(sdi != NULL);
+	(*(unsigned int *)cb_data)++;
+}
+
+/*
+ * Check whether sr_drivers_scan() reports every device through the
+ * callback, and passes a driver only the scan options it supports.
+ */
+START_TEST(test_drivers_scan)
+{
+	struct sr_dev_driver *drivers[2];
+	struct sr_config conn, channels;
+	GSList *options, *devices;
+	unsigned int found;
+
+	drivers[0] = srtest_driver_get("demo");
+	drivers[1] = NULL;
+	srtest_driver_init(srtest_ctx, drivers[0]);
+
+	/* The demo driver doesn't take a connection. */
+	conn.key = SR_CONF_CONN;
+	conn.data = g_variant_ref_sink(g_variant_new_string("/dev/null"));
+	channels.key = SR_CONF_NUM_LOGIC_CHANNELS;
+	channels.data = g_variant_ref_sink(g_variant_new_int32(4));
+	options = g_slist_append(NULL, &conn);
+	options = g_slist_append(options, &channels);
+
+	found = 0;
+	devices = sr_drivers_scan(srtest_ctx, drivers, options,
+			scan_found, &found);
+	fail_unless(devices != NULL, "No demo device found.");
+	fail_unless(found == g_slist_length(devices));
+	fail_unless(g_slist_length(sr_dev_inst_channels_get(devices->data)) >= 4);
+
+	g_slist_free(devices);
+	g_slist_free(options);
+	g_variant_unref(conn.data);
+	g_variant_unref(channels.data);
+
+	fail_unless(sr_drivers_scan(NULL, drivers, NULL, NULL, NULL) == NULL);
+	fail_unless(sr_scan_config_set(srtest_ctx, 1, 100, 1000) == SR_OK);
+	fail_unless(sr_scan_cache_clear(srtest_ctx) == SR_OK);
+	fail_unless(sr_scan_config_set(NULL, 1, 0, 0) == SR_ERR_ARG);
+}
+END_TEST
+
+/*
+ * Check whether sr_drivers_scan() reports the same devices whether the
+ * drivers scan one after another or in a pool of threads.
+ */
+START_TEST(test_drivers_scan_threads)
+{
+	struct sr_dev_driver *drivers[2];
+	GSList *devices, *l;
+	unsigned int threads, found;
+
+	drivers[0] = srtest_driver_get("demo");
+	drivers[1] = NULL;
+	srtest_driver_init(srtest_ctx, drivers[0]);
+
+	for (threads = 1; threads <= 4; threads++) {
+		fail_unless(sr_scan_config_set(srtest_ctx, threads, 0, 0) == SR_OK);
+		found = 0;
+		devices = sr_drivers_scan(srtest_ctx, drivers, NULL,
+				scan_found, &found);
+		fail_unless(devices != NULL,
+			"No demo device found with %d threads.", threads);
+		fail_unless(found == g_slist_length(devices));
+		for (l = devices; l; l = l->next)
+			fail_unless(sr_dev_inst_driver_get(l->data) == drivers[0]);
+		fail_unless(g_slist_length(sr_dev_list(drivers[0]))
+				== g_slist_length(devices));
+		g_slist_free(devices);
+		fail_unless(sr_dev_clear(drivers[0]) == SR_OK);
+	}
+
+	fail_unless(sr_scan_config_set(srtest_ctx, 1, 0, 0) == SR_OK);
+}
+END_TEST
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -70,6 +152,8 @@ Suite *suite_driver_all(void)
 	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
 	tcase_add_test(tc, test_driver_available);
 	tcase_add_test(tc, test_driver_init_all);
+	tcase_add_test(tc, test_drivers_scan);
+	tcase_add_test(tc, test_drivers_scan_threads);
 	// TODO: Currently broken.
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
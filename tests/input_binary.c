@@ -18,6 +18,8 @@
  */
 
 #include <config.h>
+#include <string.h>
+#include <unistd.h>
 #include <check.h>
 #include <glib/gstdio.h>
 #include <libsigrok/libsigrok.h>
@@ -221,6 +223,78 @@ static void check_buf(GHashTable *options, const uint8_t *buf, int check,
 	g_string_free(gbuf, TRUE);
 }
 
+static void check_file(GHashTable *options, const uint8_t *buf, int check,
+		uint64_t samples, uint64_t *samplerate, gboolean invert)
+{
+	int ret, fd;
+	struct sr_input *in;
+	const struct sr_input_module *imod;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	const struct sr_transform *t;
+	gchar *filename, *contents;
+	gsize length;
+	gboolean done;
+
+	/* Initialize global variables for this run. */
+	df_packet_counter = sample_counter = 0;
+	have_seen_df_end = FALSE;
+	logic_channellist = NULL;
+	check_to_perform = check;
+	expected_samples = samples;
+	expected_samplerate = samplerate;
+
+	fd = g_file_open_tmp("input-binary-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create temporary file.");
+	close(fd);
+	fail_unless(g_file_set_contents(filename, (const gchar *)buf,
+		(gssize)samples, NULL), "Failed to write temporary file.");
+
+	imod = sr_input_find("binary");
+	fail_unless(imod != NULL, "Failed to find input module.");
+
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+
+	/* The first call returns as soon as the device is ready. */
+	sdi = NULL;
+	t = NULL;
+	done = FALSE;
+	while (!done) {
+		ret = sr_input_send_file(in, filename, &done);
+		fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+		if (!sdi && (sdi = sr_input_dev_inst_get(in))) {
+			sr_session_dev_add(session, sdi);
+			/* Modifies the packets right in the file mapping. */
+			if (invert)
+				t = sr_transform_new(sr_transform_find("invert"),
+						NULL, sdi);
+		}
+	}
+	fail_unless(sdi != NULL, "Device instance never became ready.");
+
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	fail_unless(have_seen_df_end, "No SR_DF_END was sent.");
+	sr_input_free(in);
+
+	sr_session_destroy(session);
+	if (t)
+		sr_transform_free(t);
+
+	/* Nothing may have been written back to the file. */
+	fail_unless(g_file_get_contents(filename, &contents, &length, NULL));
+	fail_unless(length == samples && !memcmp(contents, buf, length),
+		"The file was modified.");
+	g_free(contents);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+
 START_TEST(test_input_binary_all_low)
 {
 	uint64_t i, samplerate;
@@ -308,6 +382,40 @@ START_TEST(test_input_binary_hello_world)
 }
 END_TEST
 
+START_TEST(test_input_binary_send_file)
+{
+	uint64_t samplerate;
+	uint8_t *buf;
+	GHashTable *options;
+	GVariant *gvar;
+
+	buf = g_malloc(5 * BUFSIZE);
+	memset(buf, 0xff, 5 * BUFSIZE);
+
+	/* Larger than one window of the mapped file. */
+	check_file(NULL, buf, CHECK_ALL_HIGH, 5 * BUFSIZE, NULL, FALSE);
+	check_file(NULL, buf, CHECK_ALL_HIGH, 1, NULL, FALSE);
+
+	/* A transform working in place on the mapped file. */
+	check_file(NULL, buf, CHECK_ALL_LOW, 5 * BUFSIZE, NULL, TRUE);
+	g_free(buf);
+
+	buf = (uint8_t *)g_strdup("Hello world");
+
+	gvar = g_variant_new_uint64(1250);
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("samplerate"),
+			g_variant_ref_sink(gvar));
+	samplerate = SR_HZ(1250);
+
+	check_file(options, buf, CHECK_HELLO_WORLD, 11, &samplerate, FALSE);
+
+	g_hash_table_destroy(options);
+	g_free(buf);
+}
+END_TEST
+
 Suite *suite_input_binary(void)
 {
 	Suite *s;
@@ -321,6 +429,7 @@ Suite *suite_input_binary(void)
 	tcase_add_test(tc, test_input_binary_all_high);
 	tcase_add_loop_test(tc, test_input_binary_all_high_loop, 1, 10);
 	tcase_add_test(tc, test_input_binary_hello_world);
+	tcase_add_test(tc, test_input_binary_send_file);
 	suite_add_tcase(s, tc);
 
 	return s;
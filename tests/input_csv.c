@@ -0,0 +1,187 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <check.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/* A timestamp, two logic and one analog column, with CRLF line ends. */
+static const char *csv_data =
+	"time,clk,data,-,volt\r\n"
+	"0.000,1,0,x,1.25\r\n"
+	"0.001,0,1,y,-2.5e-1\r\n"
+	"; comment\r\n"
+	"\r\n"
+	"0.002, 1 , 1 ,z, 3\r\n"
+	"0.003,0,0,w,1e3";
+
+static const uint8_t expected_logic[] = { 0x01, 0x02, 0x03, 0x00 };
+static const float expected_analog[] = { 1.25, -0.25, 3, 1000 };
+
+static uint64_t logic_samples, analog_samples, samplerate;
+static gboolean have_seen_df_end;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_meta *meta;
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_config *src;
+	const struct sr_channel *ch;
+	const uint8_t *data;
+	const float *fdata;
+	uint64_t i;
+	GSList *l;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1);
+		fail_unless(logic_samples + logic->length <= ARRAY_SIZE(expected_logic));
+		data = logic->data;
+		for (i = 0; i < logic->length; i++)
+			fail_unless(data[i] == expected_logic[logic_samples + i],
+				"Logic sample %" PRIu64 " is 0x%02x.",
+				logic_samples + i, data[i]);
+		logic_samples += logic->length;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		ch = analog->meaning->channels->data;
+		fail_unless(!strcmp(ch->name, "volt"));
+		fail_unless(analog_samples + analog->num_samples <= ARRAY_SIZE(expected_analog));
+		fdata = analog->data;
+		for (i = 0; i < analog->num_samples; i++)
+			fail_unless(fdata[i] == expected_analog[analog_samples + i],
+				"Analog sample %" PRIu64 " is %f.",
+				analog_samples + i, fdata[i]);
+		analog_samples += analog->num_samples;
+		break;
+	case SR_DF_END:
+		have_seen_df_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Feed the CSV data to the input module in pieces of the given size. */
+static void check_csv(size_t piece)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	GHashTable *options;
+	GString *gbuf;
+	size_t len, pos, n;
+	int ret;
+
+	logic_samples = analog_samples = samplerate = 0;
+	have_seen_df_end = FALSE;
+
+	options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(options, g_strdup("column-formats"),
+		g_variant_ref_sink(g_variant_new_string("t,2l,-,a")));
+	g_hash_table_insert(options, g_strdup("header"),
+		g_variant_ref_sink(g_variant_new_boolean(TRUE)));
+
+	imod = sr_input_find("csv");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, options);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sdi = sr_input_dev_inst_get(in);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sdi);
+
+	len = strlen(csv_data);
+	for (pos = 0; pos < len; pos += n) {
+		n = MIN(piece, len - pos);
+		gbuf = g_string_new_len(csv_data + pos, n);
+		ret = sr_input_send(in, gbuf);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		g_string_free(gbuf, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	fail_unless(g_slist_length(sr_dev_inst_channels_get(sdi)) == 3);
+	fail_unless(have_seen_df_end);
+	fail_unless(samplerate == SR_KHZ(1),
+		"Expected samplerate 1000, got %" PRIu64 ".", samplerate);
+	fail_unless(logic_samples == ARRAY_SIZE(expected_logic),
+		"Expected %zu logic samples, got %" PRIu64 ".",
+		ARRAY_SIZE(expected_logic), logic_samples);
+	fail_unless(analog_samples == ARRAY_SIZE(expected_analog),
+		"Expected %zu analog samples, got %" PRIu64 ".",
+		ARRAY_SIZE(expected_analog), analog_samples);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+	g_hash_table_destroy(options);
+}
+
+START_TEST(test_input_csv_column_formats)
+{
+	check_csv(strlen(csv_data));
+}
+END_TEST
+
+START_TEST(test_input_csv_pieces)
+{
+	size_t piece;
+
+	for (piece = 1; piece < 48; piece += 5)
+		check_csv(piece);
+}
+END_TEST
+
+Suite *suite_input_csv(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-csv");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_csv_column_formats);
+	tcase_add_test(tc, test_input_csv_pieces);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
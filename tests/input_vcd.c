@@ -0,0 +1,199 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <config.h>
+#include <check.h>
+#include <string.h>
+#include <libsigrok/libsigrok.h>
+#include "lib.h"
+
+/*
+ * Eight logic channels (clk, data[0..3], cnt[0..2]) and one analog
+ * channel (volt), with scalars, vectors, real values and a comment in
+ * the data section.
+ */
+static const char *vcd_data =
+	"$timescale 1 us $end\n"
+	"$scope module top $end\n"
+	"$var wire 1 ! clk $end\n"
+	"$var reg 4 \" data [3:0] $end\n"
+	"$var integer 3 #a cnt $end\n"
+	"$var real 64 $ volt $end\n"
+	"$upscope $end\n"
+	"$enddefinitions $end\n"
+	"#0\n"
+	"$dumpvars 0! b0 \" b101 #a r0 $ $end\n"
+	"#2\n"
+	"1! b1111 \" r1.5 $\n"
+	"#4\n"
+	"0 ! b10 \" bx #a r-2.25 $\n"
+	"#5 $comment ignored $end z!\n"
+	"#7\n"
+	"1! b11111 \" r3 $\n"
+	"#8\n";
+
+static const uint8_t expected_logic[] = {
+	0xa0, 0xa0, 0xbf, 0xbf, 0x04, 0x04, 0x04, 0x1f,
+};
+
+static const float expected_analog[] = {
+	0, 0, 1.5, 1.5, -2.25, -2.25, -2.25, 3,
+};
+
+static uint64_t logic_samples, analog_samples;
+static gboolean have_seen_df_end;
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	const struct sr_channel *ch;
+	const uint8_t *data;
+	const float *fdata;
+	uint64_t i, num_samples;
+
+	(void)sdi;
+	(void)cb_data;
+
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		logic = packet->payload;
+		fail_unless(logic->unitsize == 1);
+		num_samples = logic->length / logic->unitsize;
+		fail_unless(logic_samples + num_samples <= ARRAY_SIZE(expected_logic));
+		data = logic->data;
+		for (i = 0; i < num_samples; i++)
+			fail_unless(data[i] == expected_logic[logic_samples + i],
+				"Logic sample %" PRIu64 " is 0x%02x.",
+				logic_samples + i, data[i]);
+		logic_samples += num_samples;
+		break;
+	case SR_DF_ANALOG:
+		analog = packet->payload;
+		fail_unless(g_slist_length(analog->meaning->channels) == 1);
+		ch = analog->meaning->channels->data;
+		fail_unless(!strcmp(ch->name, "volt"));
+		fail_unless(analog_samples + analog->num_samples <= ARRAY_SIZE(expected_analog));
+		fdata = analog->data;
+		for (i = 0; i < analog->num_samples; i++)
+			fail_unless(fdata[i] == expected_analog[analog_samples + i],
+				"Analog sample %" PRIu64 " is %f.",
+				analog_samples + i, fdata[i]);
+		analog_samples += analog->num_samples;
+		break;
+	case SR_DF_END:
+		have_seen_df_end = TRUE;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Feed the VCD data to the input module in pieces of the given size. */
+static void check_vcd(size_t piece)
+{
+	const struct sr_input_module *imod;
+	struct sr_input *in;
+	struct sr_session *session;
+	struct sr_dev_inst *sdi;
+	struct sr_channel *ch;
+	GString *gbuf;
+	GSList *l;
+	size_t len, pos, n;
+	int ret, num_logic, num_analog;
+
+	logic_samples = analog_samples = 0;
+	have_seen_df_end = FALSE;
+
+	imod = sr_input_find("vcd");
+	fail_unless(imod != NULL, "Failed to find input module.");
+	in = sr_input_new(imod, NULL);
+	fail_unless(in != NULL, "Failed to create input instance.");
+	sdi = sr_input_dev_inst_get(in);
+
+	sr_session_new(srtest_ctx, &session);
+	sr_session_datafeed_callback_add(session, datafeed_in, NULL);
+	sr_session_dev_add(session, sdi);
+
+	len = strlen(vcd_data);
+	for (pos = 0; pos < len; pos += n) {
+		n = MIN(piece, len - pos);
+		gbuf = g_string_new_len(vcd_data + pos, n);
+		ret = sr_input_send(in, gbuf);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+		g_string_free(gbuf, TRUE);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	num_logic = num_analog = 0;
+	for (l = sr_dev_inst_channels_get(sdi); l; l = l->next) {
+		ch = l->data;
+		if (ch->type == SR_CHANNEL_LOGIC)
+			num_logic++;
+		else if (ch->type == SR_CHANNEL_ANALOG)
+			num_analog++;
+	}
+	fail_unless(num_logic == 8, "Expected 8 logic channels, got %d.", num_logic);
+	fail_unless(num_analog == 1, "Expected 1 analog channel, got %d.", num_analog);
+
+	fail_unless(have_seen_df_end);
+	fail_unless(logic_samples == ARRAY_SIZE(expected_logic),
+		"Expected %zu logic samples, got %" PRIu64 ".",
+		ARRAY_SIZE(expected_logic), logic_samples);
+	fail_unless(analog_samples == ARRAY_SIZE(expected_analog),
+		"Expected %zu analog samples, got %" PRIu64 ".",
+		ARRAY_SIZE(expected_analog), analog_samples);
+
+	sr_input_free(in);
+	sr_session_destroy(session);
+}
+
+START_TEST(test_input_vcd_vectors)
+{
+	check_vcd(strlen(vcd_data));
+}
+END_TEST
+
+START_TEST(test_input_vcd_pieces)
+{
+	size_t piece;
+
+	for (piece = 1; piece < 64; piece += 7)
+		check_vcd(piece);
+}
+END_TEST
+
+Suite *suite_input_vcd(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("input-vcd");
+
+	tc = tcase_create("basic");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_input_vcd_vectors);
+	tcase_add_test(tc, test_input_vcd_pieces);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
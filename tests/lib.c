@@ -90,6 +90,33 @@ void srtest_driver_init_all(struct sr_context *sr_ctx)
 	}
 }
 
+/* Scan and open a demo device with the given numbers of channels. */
+struct sr_dev_inst *srtest_demo_dev_new(struct sr_dev_driver *driver,
+		int num_logic, int num_analog)
+{
+	struct sr_config opts[2];
+	GSList *options, *devices;
+	struct sr_dev_inst *sdi;
+
+	opts[0].key = SR_CONF_NUM_LOGIC_CHANNELS;
+	opts[0].data = g_variant_ref_sink(g_variant_new_int32(num_logic));
+	opts[1].key = SR_CONF_NUM_ANALOG_CHANNELS;
+	opts[1].data = g_variant_ref_sink(g_variant_new_int32(num_analog));
+	options = g_slist_append(g_slist_append(NULL, &opts[0]), &opts[1]);
+
+	devices = sr_driver_scan(driver, options);
+	fail_unless(g_slist_length(devices) == 1, "Demo scan failed.");
+	sdi = devices->data;
+	fail_unless(sr_dev_open(sdi) == SR_OK, "Failed to open demo device.");
+
+	g_slist_free(devices);
+	g_slist_free(options);
+	g_variant_unref(opts[0].data);
+	g_variant_unref(opts[1].data);
+
+	return sdi;
+}
+
 /* Set the samplerate for the respective driver to the specified value. */
 void srtest_set_samplerate(struct sr_dev_driver *driver, uint64_t samplerate)
 {
@@ -19,6 +19,10 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <zip.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -96,6 +100,514 @@ START_TEST(test_output_options)
 }
 END_TEST
 
+static uint8_t *read_entry(struct zip *archive, const char *name, size_t *size)
+{
+	struct zip_stat zs;
+	struct zip_file *zf;
+	uint8_t *buf;
+
+	if (zip_stat(archive, name, 0, &zs) < 0)
+		return NULL;
+	buf = g_malloc(zs.size + 1);
+	zf = zip_fopen_index(archive, zs.index, 0);
+	fail_unless(zf != NULL, "Failed to open '%s'.", name);
+	fail_unless(zip_fread(zf, buf, zs.size) == (zip_int64_t)zs.size,
+		"Failed to read '%s'.", name);
+	zip_fclose(zf);
+	buf[zs.size] = '\0';
+	*size = zs.size;
+
+	return buf;
+}
+
+/* Check that srzip collects logic packets into chunks and completes the file. */
+START_TEST(test_output_srzip)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_dev_inst *sdi;
+	struct zip *archive;
+	GKeyFile *kf;
+	GString *out;
+	uint8_t data[1000], *buf;
+	char *filename;
+	size_t size;
+	int fd, i, j;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 8; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+
+	fd = g_file_open_tmp("srzip-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create a temporary file.");
+	close(fd);
+
+	o = sr_output_new(sr_output_find("srzip"), NULL, sdi, filename);
+	fail_unless(o != NULL, "Failed to create srzip output.");
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = sizeof(data);
+	logic.unitsize = 1;
+	logic.data = data;
+	for (i = 0; i < 100; i++) {
+		for (j = 0; j < (int)sizeof(data); j++)
+			data[j] = i + j;
+		fail_unless(sr_output_send(o, &packet, &out) == SR_OK,
+			"Failed to send logic packet.");
+	}
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK,
+		"Failed to complete srzip file.");
+	sr_output_free(o);
+
+	archive = zip_open(filename, 0, NULL);
+	fail_unless(archive != NULL, "Failed to open srzip file.");
+
+	buf = read_entry(archive, "logic-1-1", &size);
+	fail_unless(buf != NULL, "No logic data chunk.");
+	fail_unless(size == 100 * sizeof(data), "Wrong chunk size %d.", (int)size);
+	for (i = 0; i < 100; i++) {
+		for (j = 0; j < (int)sizeof(data); j++)
+			fail_unless(buf[i * sizeof(data) + j] == (uint8_t)(i + j),
+				"Wrong logic data at %d.", i * (int)sizeof(data) + j);
+	}
+	g_free(buf);
+	fail_unless(read_entry(archive, "logic-1-2", &size) == NULL,
+		"Packets not collected into one chunk.");
+
+	buf = read_entry(archive, "metadata", &size);
+	fail_unless(buf != NULL, "No metadata.");
+	kf = g_key_file_new();
+	fail_unless(g_key_file_load_from_data(kf, (char *)buf, size, 0, NULL),
+		"Invalid metadata.");
+	fail_unless(g_key_file_get_integer(kf, "device 1", "unitsize", NULL) == 1,
+		"Wrong unitsize in metadata.");
+	fail_unless(g_key_file_get_integer(kf, "device 1", "total probes", NULL) == 8,
+		"Wrong number of channels in metadata.");
+	g_key_file_free(kf);
+	g_free(buf);
+
+	zip_discard(archive);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/* Check that chunks compressed in parallel are written in order. */
+START_TEST(test_output_srzip_threads)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_dev_inst *sdi;
+	struct zip *archive;
+	struct zip_stat zs;
+	GHashTable *opts;
+	GString *out;
+	uint8_t *data, *buf;
+	char *filename, name[32];
+	size_t size, k, total;
+	int fd, i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 16; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+
+	fd = g_file_open_tmp("srzip-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create a temporary file.");
+	close(fd);
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "threads",
+			g_variant_ref_sink(g_variant_new_uint32(4)));
+	g_hash_table_insert(opts, "store",
+			g_variant_ref_sink(g_variant_new_boolean(TRUE)));
+	o = sr_output_new(sr_output_find("srzip"), opts, sdi, filename);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create srzip output.");
+
+	/* 24 MiB in 1 MiB packets, six chunks. */
+	size = 1024 * 1024;
+	data = g_malloc(size);
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = size;
+	logic.unitsize = 2;
+	logic.data = data;
+	for (i = 0; i < 24; i++) {
+		for (k = 0; k < size; k++)
+			data[k] = (i * size + k) / 3;
+		fail_unless(sr_output_send(o, &packet, &out) == SR_OK,
+			"Failed to send logic packet.");
+	}
+	g_free(data);
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK,
+		"Failed to complete srzip file.");
+	sr_output_free(o);
+
+	archive = zip_open(filename, 0, NULL);
+	fail_unless(archive != NULL, "Failed to open srzip file.");
+
+	total = 0;
+	for (i = 1; i <= 6; i++) {
+		snprintf(name, sizeof(name), "logic-1-%d", i);
+		fail_unless(zip_stat(archive, name, 0, &zs) == 0,
+			"No chunk '%s'.", name);
+		fail_unless(zs.comp_method == ZIP_CM_STORE,
+			"Chunk '%s' was compressed.", name);
+		buf = read_entry(archive, name, &size);
+		for (k = 0; k < size; k++)
+			fail_unless(buf[k] == (uint8_t)((total + k) / 3),
+				"Wrong logic data at %d.", (int)(total + k));
+		total += size;
+		g_free(buf);
+	}
+	fail_unless(total == 24 * 1024 * 1024, "Wrong total size %d.",
+		(int)total);
+	fail_unless(read_entry(archive, "logic-1-7", &size) == NULL,
+		"Too many chunks.");
+
+	zip_discard(archive);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+/*
+ * Run packets through a new instance of an output module, collect all
+ * output, or write it to a sink if one is given.
+ */
+static GString *output_feed(const char *id, struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet p;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GString *all, *out;
+	int i;
+
+	o = sr_output_new(sr_output_find((char *)id), NULL, sdi, NULL);
+	fail_unless(o != NULL, "Failed to create %s output.", id);
+
+	src.key = SR_CONF_SAMPLERATE;
+	src.data = g_variant_ref_sink(g_variant_new_uint64(SR_MHZ(1)));
+	meta.config = g_slist_append(NULL, &src);
+
+	all = g_string_new(NULL);
+	for (i = 0; i < 3; i++) {
+		if (i == 0) {
+			p.type = SR_DF_META;
+			p.payload = &meta;
+		} else if (i == 1) {
+			p = *packet;
+		} else {
+			p.type = SR_DF_END;
+			p.payload = NULL;
+		}
+		if (sink) {
+			fail_unless(sr_output_send_sink(o, &p, sink) == SR_OK,
+				"Failed to send packet to %s output.", id);
+			continue;
+		}
+		out = NULL;
+		fail_unless(sr_output_send(o, &p, &out) == SR_OK,
+			"Failed to send packet to %s output.", id);
+		if (out) {
+			g_string_append_len(all, out->str, out->len);
+			g_string_free(out, TRUE);
+		}
+	}
+	sr_output_free(o);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+	if (sink) {
+		g_string_free(all, TRUE);
+		all = NULL;
+	}
+
+	return all;
+}
+
+static GString *output_run(const char *id, struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet)
+{
+	return output_feed(id, sdi, packet, NULL);
+}
+
+/* Skip the VCD header, which contains the current time. */
+static const char *vcd_body(const GString *s)
+{
+	const char *body;
+
+	body = strstr(s->str, "$enddefinitions $end\n");
+	fail_unless(body != NULL, "No VCD header.");
+
+	return body;
+}
+
+/*
+ * Check that transition-encoded logic data is expanded for output
+ * modules which don't take it, and gives the same VCD as dense data.
+ */
+START_TEST(test_output_logic_rle)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_logic_rle rle;
+	struct sr_dev_inst *sdi;
+	GString *dense_out, *rle_out;
+	uint64_t lengths[] = { 5, 700000, 1, 3 };
+	uint16_t values[] = { 0x0001, 0x0103, 0x0001, 0x0001 };
+	uint16_t *data, part[4];
+	uint64_t num_samples, j, k;
+	unsigned int i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 16; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+
+	num_samples = 0;
+	for (i = 0; i < G_N_ELEMENTS(lengths); i++)
+		num_samples += lengths[i];
+	data = g_malloc(num_samples * sizeof(*data));
+	for (i = 0, k = 0; i < G_N_ELEMENTS(lengths); k += lengths[i++])
+		for (j = 0; j < lengths[i]; j++)
+			data[k + j] = GUINT16_TO_LE(values[i]);
+
+	rle.num_samples = num_samples;
+	rle.num_runs = G_N_ELEMENTS(lengths);
+	rle.unitsize = sizeof(*data);
+	rle.lengths = lengths;
+	rle.values = values;
+	for (i = 0; i < G_N_ELEMENTS(values); i++)
+		values[i] = GUINT16_TO_LE(values[i]);
+
+	/* Expand a range which spans several runs. */
+	fail_unless(sr_logic_rle_expand(&rle, 700003, 4, part) == SR_OK);
+	fail_unless(!memcmp(part, data + 700003, sizeof(part)));
+	fail_unless(sr_logic_rle_expand(&rle, num_samples - 1, 2, part)
+		== SR_ERR_ARG);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = num_samples * sizeof(*data);
+	logic.unitsize = sizeof(*data);
+	logic.data = data;
+	dense_out = output_run("binary", sdi, &packet);
+	fail_unless(dense_out->len == logic.length);
+	packet.type = SR_DF_LOGIC_RLE;
+	packet.payload = &rle;
+	rle_out = output_run("binary", sdi, &packet);
+	fail_unless(rle_out->len == dense_out->len
+		&& !memcmp(rle_out->str, dense_out->str, dense_out->len),
+		"Expanded data differs.");
+	g_string_free(dense_out, TRUE);
+	g_string_free(rle_out, TRUE);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	dense_out = output_run("vcd", sdi, &packet);
+	packet.type = SR_DF_LOGIC_RLE;
+	packet.payload = &rle;
+	rle_out = output_run("vcd", sdi, &packet);
+	fail_unless(!strcmp(vcd_body(rle_out), vcd_body(dense_out)),
+		"VCD differs: '%s', expected '%s'.",
+		vcd_body(rle_out), vcd_body(dense_out));
+	g_string_free(dense_out, TRUE);
+	g_string_free(rle_out, TRUE);
+
+	g_free(data);
+}
+END_TEST
+
+/* Check the bits of wide logic samples end up in the right columns. */
+START_TEST(test_output_csv)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_dev_inst *sdi;
+	GString *out;
+	uint16_t data[] = { 0x0000, 0x0201, 0x03ff };
+	unsigned int i;
+	const char *expected =
+		"samples,logic,logic,logic,logic,logic,logic,logic,logic,logic,logic\n"
+		"0,0,0,0,0,0,0,0,0,0,0\n"
+		"0,1,0,0,0,0,0,0,0,0,1\n"
+		"0,1,1,1,1,1,1,1,1,1,1\n";
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 10; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		data[i] = GUINT16_TO_LE(data[i]);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = sizeof(data);
+	logic.unitsize = sizeof(data[0]);
+	logic.data = data;
+	out = output_run("csv", sdi, &packet);
+	fail_unless(!strcmp(out->str, expected),
+		"CSV differs: '%s', expected '%s'.", out->str, expected);
+	g_string_free(out, TRUE);
+}
+END_TEST
+
+/* Check the text formats draw each channel's bits on a line of its own. */
+START_TEST(test_output_text)
+{
+	static const struct {
+		const char *id;
+		const char *expected;
+	} cases[] = {
+		{ "bits",
+			"D0:01001010 0101\nD1:01111001 0110\n"
+			"D2:01111000 1101\nD3:00101101 0110\n"
+			"T:     ^ 5\n"
+			"D0:00101001 \nD1:00011010 \nD2:01010011 \nD3:01100011 \n" },
+		{ "hex",
+			"D0:4a \nD1:79 \nD2:78 \nD3:2d \n"
+			"T: ^ 5\n"
+			"D0:29 \nD1:1a \nD2:53 \nD3:63 \n" },
+		{ "ascii",
+			"D0:./\\./\\/\\./\\/\nD1:./\"\"\"\\./\\/\"\\\n"
+			"D2:./\"\"\"\\../\"\\/\nD3:../\\/\"\\/\\/\"\\\n"
+			"T:     ^ 5\n"
+			"D0:../\\/\\./\nD1:.../\"\\/\\\nD2:./\\/\\./\"\nD3:./\"\\../\"\n" },
+	};
+	static const char *names[] = { "D0", "D1", "D2", "D3" };
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_dev_inst *sdi;
+	GHashTable *opts;
+	GString *all, *out;
+	uint8_t data[20];
+	const char *body;
+	unsigned int i, j;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < G_N_ELEMENTS(names); i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, names[i]);
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		data[i] = (i * 7 + i * i / 5) & 0xf;
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "width",
+			g_variant_ref_sink(g_variant_new_uint32(12)));
+
+	for (i = 0; i < G_N_ELEMENTS(cases); i++) {
+		o = sr_output_new(sr_output_find((char *)cases[i].id), opts,
+				sdi, NULL);
+		fail_unless(o != NULL, "Failed to create %s output.", cases[i].id);
+		all = g_string_new(NULL);
+		/* Five samples, the trigger, 15 more samples. */
+		for (j = 0; j < 4; j++) {
+			packet.type = j == 1 ? SR_DF_TRIGGER
+				: j == 3 ? SR_DF_END : SR_DF_LOGIC;
+			packet.payload = j == 0 || j == 2 ? &logic : NULL;
+			logic.unitsize = 1;
+			logic.data = j == 0 ? data : data + 5;
+			logic.length = j == 0 ? 5 : G_N_ELEMENTS(data) - 5;
+			out = NULL;
+			fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+			if (out) {
+				g_string_append_len(all, out->str, out->len);
+				g_string_free(out, TRUE);
+			}
+		}
+		sr_output_free(o);
+		/* Skip the header. */
+		body = strstr(all->str, "D0:");
+		fail_unless(body && !strcmp(body, cases[i].expected),
+			"%s output differs: '%s', expected '%s'.", cases[i].id,
+			body, cases[i].expected);
+		g_string_free(all, TRUE);
+	}
+	g_hash_table_destroy(opts);
+}
+END_TEST
+
+static int append_output(const uint8_t *data, size_t len, void *cb_data)
+{
+	g_string_append_len(cb_data, (const char *)data, len);
+
+	return SR_OK;
+}
+
+/* Check that writing to a sink gives the same output as sr_output_send(). */
+START_TEST(test_output_sink)
+{
+	static const char *ids[] = {
+		"binary", "bits", "hex", "ascii", "csv", "vcd",
+	};
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_output_sink *sink;
+	struct sr_dev_inst *sdi;
+	GString *expected, *out;
+	uint16_t data[20000];
+	char *filename, *contents;
+	gsize len;
+	unsigned int i;
+	int fd;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 16; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+	for (i = 0; i < G_N_ELEMENTS(data); i++)
+		data[i] = GUINT16_TO_LE((i / 7) ^ (i << 3));
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = sizeof(data);
+	logic.unitsize = sizeof(data[0]);
+	logic.data = data;
+	for (i = 0; i < G_N_ELEMENTS(ids); i++) {
+		expected = output_run(ids[i], sdi, &packet);
+
+		fd = g_file_open_tmp("output-XXXXXX", &filename, NULL);
+		fail_unless(fd >= 0, "Failed to create a temporary file.");
+		sink = sr_output_sink_new_fd(fd);
+		output_feed(ids[i], sdi, &packet, sink);
+		fail_unless(sr_output_sink_free(sink) == SR_OK,
+			"Failed to write %s output.", ids[i]);
+		close(fd);
+		fail_unless(g_file_get_contents(filename, &contents, &len, NULL));
+		out = g_string_new_len(contents, len);
+		g_free(contents);
+		g_unlink(filename);
+		g_free(filename);
+		if (!strcmp(ids[i], "vcd"))
+			fail_unless(!strcmp(vcd_body(out), vcd_body(expected)),
+				"VCD differs.");
+		else
+			fail_unless(out->len == expected->len
+				&& !memcmp(out->str, expected->str, out->len),
+				"%s output differs.", ids[i]);
+		g_string_free(out, TRUE);
+
+		out = g_string_new(NULL);
+		sink = sr_output_sink_new_callback(append_output, out);
+		output_feed(ids[i], sdi, &packet, sink);
+		fail_unless(sr_output_sink_free(sink) == SR_OK);
+		if (strcmp(ids[i], "vcd"))
+			fail_unless(g_string_equal(out, expected),
+				"%s output differs.", ids[i]);
+		g_string_free(out, TRUE);
+		g_string_free(expected, TRUE);
+	}
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -110,6 +622,15 @@ Suite *suite_output_all(void)
 	tcase_add_test(tc, test_output_desc);
 	tcase_add_test(tc, test_output_find);
 	tcase_add_test(tc, test_output_options);
+	tcase_add_test(tc, test_output_logic_rle);
+	tcase_add_test(tc, test_output_csv);
+	tcase_add_test(tc, test_output_sink);
+	tcase_add_test(tc, test_output_text);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("srzip");
+	tcase_add_test(tc, test_output_srzip);
+	tcase_add_test(tc, test_output_srzip_threads);
 	suite_add_tcase(s, tc);
 
 	return s;
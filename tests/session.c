@@ -19,6 +19,9 @@
 
 #include <config.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -185,6 +188,961 @@ START_TEST(test_session_trigger_get_null)
 }
 END_TEST
 
+static GString *async_data;
+static int async_first_type, async_last_type;
+static uint64_t async_packets;
+
+static void datafeed_async(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (async_packets++ == 0)
+		async_first_type = packet->type;
+	async_last_type = packet->type;
+
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		g_string_append_len(async_data, logic->data, logic->length);
+	}
+}
+
+/*
+ * Check whether an asynchronous datafeed callback receives all packets,
+ * in order, and with payloads that outlive the sender's buffers.
+ */
+START_TEST(test_session_datafeed_async)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct sr_datafeed_queue_stats stats;
+	GString *buf;
+
+	async_data = g_string_new(NULL);
+	async_first_type = async_last_type = 0;
+	async_packets = 0;
+
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_datafeed_callback_add_async(sess, datafeed_async,
+			NULL, 16);
+	fail_unless(ret == SR_OK, "Failed to add async callback: %d.", ret);
+	sr_session_dev_add(sess, sr_input_dev_inst_get(in));
+
+	buf = g_string_new("Hello world");
+	ret = sr_input_send(in, buf);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	ret = sr_session_datafeed_callback_stats_get(sess, datafeed_async,
+			NULL, &stats);
+	fail_unless(ret == SR_OK);
+	fail_unless(stats.dropped == 0);
+	fail_unless(stats.capacity == 16);
+
+	/* Destroying the session waits for the worker to catch up. */
+	sr_session_destroy(sess);
+	sr_input_free(in);
+
+	fail_unless(async_packets == stats.queued);
+	fail_unless(async_first_type == SR_DF_HEADER);
+	fail_unless(async_last_type == SR_DF_END);
+	fail_unless(!strcmp(async_data->str, buf->str),
+		"Expected '%s', got '%s'.", buf->str, async_data->str);
+
+	g_string_free(buf, TRUE);
+	g_string_free(async_data, TRUE);
+}
+END_TEST
+
+static gint async_removed;
+
+/* Removes all datafeed callbacks from its own worker thread. */
+static void datafeed_async_remove(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	(void)sdi;
+	(void)packet;
+
+	if (g_atomic_int_get(&async_removed))
+		return;
+	fail_unless(sr_session_datafeed_callback_remove_all(cb_data) == SR_OK);
+	g_atomic_int_set(&async_removed, 1);
+}
+
+/* Check whether an asynchronous callback can remove itself. */
+START_TEST(test_session_datafeed_async_remove)
+{
+	int ret, i;
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct sr_datafeed_queue_stats stats;
+	GString *buf;
+
+	g_atomic_int_set(&async_removed, 0);
+
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	ret = sr_session_datafeed_callback_add_async(sess,
+			datafeed_async_remove, sess, 16);
+	fail_unless(ret == SR_OK, "Failed to add async callback: %d.", ret);
+	sr_session_dev_add(sess, sr_input_dev_inst_get(in));
+
+	/* The first chunk only sets the device up. */
+	buf = g_string_new("Hello world");
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	g_string_free(buf, TRUE);
+
+	for (i = 0; i < 5000 && !g_atomic_int_get(&async_removed); i++)
+		g_usleep(1000);
+	fail_unless(g_atomic_int_get(&async_removed), "Callback didn't run.");
+
+	ret = sr_session_datafeed_callback_stats_get(sess,
+			datafeed_async_remove, sess, &stats);
+	fail_unless(ret == SR_ERR_ARG, "Callback wasn't removed.");
+
+	fail_unless(sr_input_end(in) == SR_OK);
+	sr_session_destroy(sess);
+	sr_input_free(in);
+}
+END_TEST
+
+/* Check whether the async callback functions reject bogus parameters. */
+START_TEST(test_session_datafeed_async_bogus)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_datafeed_queue_stats stats;
+
+	sr_session_new(srtest_ctx, &sess);
+
+	ret = sr_session_datafeed_callback_add_async(NULL, datafeed_async,
+			NULL, 0);
+	fail_unless(ret != SR_OK);
+	ret = sr_session_datafeed_callback_add_async(sess, NULL, NULL, 0);
+	fail_unless(ret != SR_OK);
+
+	/* Unknown callback. */
+	ret = sr_session_datafeed_callback_stats_get(sess, datafeed_async,
+			NULL, &stats);
+	fail_unless(ret == SR_ERR_ARG);
+	ret = sr_session_datafeed_callback_stats_get(sess, datafeed_async,
+			NULL, NULL);
+	fail_unless(ret == SR_ERR_ARG);
+
+	sr_session_destroy(sess);
+}
+END_TEST
+
+static GString *merged_data;
+static uint64_t merged_packets;
+static uint64_t merged_max_length;
+static int merged_last_type;
+
+static void datafeed_merged(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	uint64_t length;
+
+	(void)sdi;
+	(void)cb_data;
+
+	merged_last_type = packet->type;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		g_string_append_len(merged_data, logic->data, logic->length);
+		length = logic->length;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		length = analog->num_samples * analog->encoding->unitsize;
+		g_string_append_len(merged_data, analog->data, length);
+	} else {
+		return;
+	}
+	merged_packets++;
+	merged_max_length = MAX(merged_max_length, length);
+}
+
+/*
+ * Send 1000 bytes in small chunks through an input module, return the
+ * number of logic or analog packets.
+ */
+static uint64_t send_in_chunks(char *input, size_t max_bytes)
+{
+	int ret;
+	unsigned int i;
+	struct sr_session *sess;
+	struct sr_input *in;
+	GString *buf, *all;
+
+	merged_data = g_string_new(NULL);
+	merged_packets = merged_max_length = 0;
+	merged_last_type = 0;
+
+	in = sr_input_new(sr_input_find(input), NULL);
+	fail_unless(in != NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_datafeed_callback_add(sess, datafeed_merged, NULL);
+	ret = sr_session_coalesce_set(sess, max_bytes, 0);
+	fail_unless(ret == SR_OK, "sr_session_coalesce_set() error: %d", ret);
+	sr_session_dev_add(sess, sr_input_dev_inst_get(in));
+
+	all = g_string_new(NULL);
+	buf = g_string_sized_new(10);
+	for (i = 0; i < 100; i++) {
+		g_string_printf(buf, "chunk %03u ", i);
+		g_string_append(all, buf->str);
+		ret = sr_input_send(in, buf);
+		fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	}
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+
+	sr_session_destroy(sess);
+	sr_input_free(in);
+
+	fail_unless(merged_last_type == SR_DF_END);
+	fail_unless(!strcmp(merged_data->str, all->str),
+		"Expected '%s', got '%s'.", all->str, merged_data->str);
+
+	g_string_free(buf, TRUE);
+	g_string_free(all, TRUE);
+	g_string_free(merged_data, TRUE);
+
+	return merged_packets;
+}
+
+/*
+ * Check whether small logic packets are merged up to the configured size,
+ * and whether SR_DF_END flushes the rest.
+ */
+START_TEST(test_session_coalesce)
+{
+	uint64_t packets;
+
+	packets = send_in_chunks("binary", 0);
+	fail_unless(packets >= 99, "Expected >= 99 packets, got %" PRIu64 ".",
+		packets);
+
+	packets = send_in_chunks("binary", 256);
+	fail_unless(packets <= 5, "Expected <= 5 packets, got %" PRIu64 ".",
+		packets);
+	fail_unless(merged_max_length <= 256);
+
+	/* Chunks of at least half the merged size are passed on as is. */
+	packets = send_in_chunks("binary", 16);
+	fail_unless(packets >= 99, "Expected >= 99 packets, got %" PRIu64 ".",
+		packets);
+
+	fail_unless(sr_session_coalesce_set(NULL, 256, 0) == SR_ERR_ARG);
+}
+END_TEST
+
+/* Check whether single channel analog packets (8 bit samples) are merged. */
+START_TEST(test_session_coalesce_analog)
+{
+	uint64_t packets;
+
+	packets = send_in_chunks("raw_analog", 0);
+	fail_unless(packets >= 99, "Expected >= 99 packets, got %" PRIu64 ".",
+		packets);
+
+	packets = send_in_chunks("raw_analog", 256);
+	fail_unless(packets <= 5, "Expected <= 5 packets, got %" PRIu64 ".",
+		packets);
+	fail_unless(merged_max_length <= 256);
+}
+END_TEST
+
+/*
+ * Check whether the latency bound flushes staged samples from the session
+ * main loop. The demo device sends 2 or 3 samples every 100 ms, which
+ * would be merged with the next round's without the timer.
+ */
+START_TEST(test_session_coalesce_latency)
+{
+	int ret;
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+
+	merged_data = g_string_new(NULL);
+	merged_packets = merged_max_length = 0;
+	merged_last_type = 0;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	sdi = srtest_demo_dev_new(driver, 8, 0);
+	sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE, g_variant_new_uint64(20));
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES, g_variant_new_uint64(10));
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_datafeed_callback_add(sess, datafeed_merged, NULL);
+	ret = sr_session_coalesce_set(sess, 4096, 10);
+	fail_unless(ret == SR_OK, "sr_session_coalesce_set() error: %d", ret);
+
+	fail_unless(sr_session_start(sess) == SR_OK);
+	fail_unless(sr_session_run(sess) == SR_OK);
+	sr_session_destroy(sess);
+
+	fail_unless(merged_last_type == SR_DF_END);
+	fail_unless(merged_data->len == 10, "Expected 10 samples, got %zu.",
+		merged_data->len);
+	fail_unless(merged_max_length <= 3,
+		"Samples of several rounds merged (%" PRIu64 " bytes).",
+		merged_max_length);
+
+	g_string_free(merged_data, TRUE);
+}
+END_TEST
+
+static const uint8_t *passed_data;
+static gboolean passed_contiguous;
+
+static void datafeed_passed(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	merged_packets++;
+	if (passed_data && passed_data != logic->data)
+		passed_contiguous = FALSE;
+	passed_data = (const uint8_t *)logic->data + logic->length;
+}
+
+/*
+ * Check whether packets of at least half the merged size are passed on
+ * without a copy: sent from a mapped file, they follow each other in
+ * memory, a stage would have copied them into a buffer of its own.
+ */
+START_TEST(test_session_coalesce_passthrough)
+{
+	int ret, fd;
+	struct sr_session *sess;
+	struct sr_input *in;
+	char *filename, *contents;
+	size_t size;
+	gboolean done, added;
+
+	size = 12 * 1024 * 1024;
+	contents = g_malloc0(size);
+	fd = g_file_open_tmp("coalesce-XXXXXX", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create a temporary file.");
+	close(fd);
+	fail_unless(g_file_set_contents(filename, contents, size, NULL));
+	g_free(contents);
+
+	merged_packets = 0;
+	passed_data = NULL;
+	passed_contiguous = TRUE;
+
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL);
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_datafeed_callback_add(sess, datafeed_passed, NULL);
+	/* The binary input sends the file in 4 MiB packets. */
+	ret = sr_session_coalesce_set(sess, 8 * 1024 * 1024, 0);
+	fail_unless(ret == SR_OK, "sr_session_coalesce_set() error: %d", ret);
+
+	added = done = FALSE;
+	while (!done) {
+		ret = sr_input_send_file(in, filename, &done);
+		fail_unless(ret == SR_OK, "sr_input_send_file() error: %d", ret);
+		if (!added && sr_input_dev_inst_get(in)) {
+			sr_session_dev_add(sess, sr_input_dev_inst_get(in));
+			added = TRUE;
+		}
+	}
+	fail_unless(sr_input_end(in) == SR_OK);
+	sr_session_destroy(sess);
+	sr_input_free(in);
+	g_unlink(filename);
+	g_free(filename);
+
+	fail_unless(merged_packets >= 3, "Expected >= 3 packets, got %" PRIu64 ".",
+		merged_packets);
+	fail_unless(passed_contiguous, "Packets were copied.");
+}
+END_TEST
+
+/* Sends more data of the device when it gets the first samples. */
+static void datafeed_reentrant(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct sr_input *in;
+	GString *buf;
+
+	(void)sdi;
+
+	in = cb_data;
+	merged_last_type = packet->type;
+	if (packet->type != SR_DF_LOGIC)
+		return;
+
+	logic = packet->payload;
+	g_string_append_len(merged_data, logic->data, logic->length);
+	if (merged_packets++)
+		return;
+
+	buf = g_string_new(" more");
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	g_string_free(buf, TRUE);
+}
+
+/* Check whether a callback can send packets while merged ones are flushed. */
+START_TEST(test_session_coalesce_reentrant)
+{
+	struct sr_session *sess;
+	struct sr_input *in;
+	GString *buf;
+
+	merged_data = g_string_new(NULL);
+	merged_packets = 0;
+	merged_last_type = 0;
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_datafeed_callback_add(sess, datafeed_reentrant, in);
+	sr_session_coalesce_set(sess, 256, 0);
+	sr_session_dev_add(sess, sr_input_dev_inst_get(in));
+
+	buf = g_string_new("Hello world");
+	fail_unless(sr_input_send(in, buf) == SR_OK);
+	fail_unless(sr_input_end(in) == SR_OK);
+	g_string_free(buf, TRUE);
+
+	sr_session_destroy(sess);
+	sr_input_free(in);
+
+	/* The samples staged from the callback go out before SR_DF_END. */
+	fail_unless(merged_last_type == SR_DF_END);
+	fail_unless(!strcmp(merged_data->str, "Hello world more"),
+		"Expected 'Hello world more', got '%s'.", merged_data->str);
+	g_string_free(merged_data, TRUE);
+}
+END_TEST
+
+/* Check whether sr_session_threading_set() rejects bogus parameters. */
+START_TEST(test_session_threading_set)
+{
+	struct sr_session *sess;
+
+	sr_session_new(srtest_ctx, &sess);
+	fail_unless(sr_session_threading_set(sess,
+		SR_SESSION_THREADING_DEVICE) == SR_OK);
+	fail_unless(sr_session_threading_set(sess,
+		SR_SESSION_THREADING_NONE) == SR_OK);
+	fail_unless(sr_session_threading_set(sess, -1) == SR_ERR_ARG);
+	fail_unless(sr_session_threading_set(sess,
+		SR_SESSION_THREADING_TRANSPORT + 1) == SR_ERR_ARG);
+	fail_unless(sr_session_threading_set(NULL,
+		SR_SESSION_THREADING_DEVICE) == SR_ERR_ARG);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+struct dev_order {
+	const struct sr_dev_inst *sdi;
+	int first_type;
+	int last_type;
+	uint64_t packets;
+	uint64_t after_end;
+};
+
+static struct dev_order dev_orders[2];
+
+/* Record the packet sequence of each of two devices. */
+static void datafeed_order(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct dev_order *o;
+	unsigned int i;
+
+	(void)cb_data;
+
+	for (i = 0; i < ARRAY_SIZE(dev_orders); i++) {
+		if (!dev_orders[i].sdi)
+			dev_orders[i].sdi = sdi;
+		if (dev_orders[i].sdi == sdi)
+			break;
+	}
+	fail_unless(i < ARRAY_SIZE(dev_orders), "Packet of an unknown device.");
+
+	o = &dev_orders[i];
+	if (o->packets++ == 0)
+		o->first_type = packet->type;
+	if (o->last_type == SR_DF_END)
+		o->after_end++;
+	o->last_type = packet->type;
+}
+
+/*
+ * Check whether two demo devices running in threads of their own each
+ * send their packets in order, from SR_DF_HEADER to SR_DF_END.
+ */
+START_TEST(test_session_threading_order)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi[2];
+	struct sr_session *sess;
+	unsigned int i;
+
+	memset(dev_orders, 0, sizeof(dev_orders));
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	sr_session_new(srtest_ctx, &sess);
+	for (i = 0; i < ARRAY_SIZE(sdi); i++) {
+		sdi[i] = srtest_demo_dev_new(driver, 8, 1);
+		sr_config_set(sdi[i], NULL, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(SR_MHZ(1)));
+		sr_config_set(sdi[i], NULL, SR_CONF_LIMIT_MSEC,
+			g_variant_new_uint64(300));
+		sr_session_dev_add(sess, sdi[i]);
+	}
+	sr_session_datafeed_callback_add(sess, datafeed_order, NULL);
+	fail_unless(sr_session_threading_set(sess,
+		SR_SESSION_THREADING_DEVICE) == SR_OK);
+
+	fail_unless(sr_session_start(sess) == SR_OK);
+	fail_unless(sr_session_run(sess) == SR_OK);
+	sr_session_destroy(sess);
+
+	for (i = 0; i < ARRAY_SIZE(dev_orders); i++) {
+		fail_unless(dev_orders[i].sdi != NULL, "Device %u sent nothing.", i);
+		fail_unless(dev_orders[i].packets > 2,
+			"Device %u sent no data.", i);
+		fail_unless(dev_orders[i].first_type == SR_DF_HEADER);
+		fail_unless(dev_orders[i].last_type == SR_DF_END);
+		fail_unless(dev_orders[i].after_end == 0);
+	}
+}
+END_TEST
+
+/* Check the parallel start setting, and start times of unstarted devices. */
+START_TEST(test_session_parallel_start)
+{
+	struct sr_dev_driver *driver;
+	struct sr_session *sess;
+	struct sr_dev_inst *sdi;
+	int64_t begin, end;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	sdi = srtest_demo_dev_new(driver, 8, 0);
+	fail_unless(sr_dev_inst_start_time_get(sdi, &begin, &end) == SR_ERR_NA);
+	fail_unless(sr_dev_inst_start_time_get(NULL, &begin, &end) == SR_ERR_ARG);
+
+	sr_session_new(srtest_ctx, &sess);
+	fail_unless(sr_session_parallel_start_set(sess, TRUE) == SR_OK);
+	fail_unless(sr_session_parallel_start_set(NULL, TRUE) == SR_ERR_ARG);
+
+	/* The setting can't change while the session runs. */
+	sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		g_variant_new_uint64(1000));
+	sr_session_dev_add(sess, sdi);
+	fail_unless(sr_session_start(sess) == SR_OK);
+	fail_unless(sr_session_parallel_start_set(sess, FALSE) == SR_ERR_BUG);
+	fail_unless(sr_session_run(sess) == SR_OK);
+	fail_unless(sr_dev_inst_start_time_get(sdi, &begin, &end) == SR_OK);
+	fail_unless(begin <= end);
+	sr_session_destroy(sess);
+}
+END_TEST
+
+/*
+ * Check whether two demo devices which are started concurrently both send
+ * data. Without threading they share the main context, with transport
+ * threading they share a loop, with device threading they don't.
+ */
+START_TEST(test_session_parallel_start_data)
+{
+	static const int threadings[] = {
+		SR_SESSION_THREADING_NONE,
+		SR_SESSION_THREADING_DEVICE,
+		SR_SESSION_THREADING_TRANSPORT,
+	};
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi[2];
+	struct sr_session *sess;
+	unsigned int i, t;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+
+	for (t = 0; t < ARRAY_SIZE(threadings); t++) {
+		memset(dev_orders, 0, sizeof(dev_orders));
+		sr_session_new(srtest_ctx, &sess);
+		for (i = 0; i < ARRAY_SIZE(sdi); i++) {
+			sdi[i] = srtest_demo_dev_new(driver, 8, 0);
+			sr_config_set(sdi[i], NULL, SR_CONF_LIMIT_SAMPLES,
+				g_variant_new_uint64(10000));
+			sr_session_dev_add(sess, sdi[i]);
+		}
+		sr_session_datafeed_callback_add(sess, datafeed_order, NULL);
+		fail_unless(sr_session_threading_set(sess,
+			threadings[t]) == SR_OK);
+		fail_unless(sr_session_parallel_start_set(sess, TRUE) == SR_OK);
+
+		fail_unless(sr_session_start(sess) == SR_OK);
+		fail_unless(sr_session_run(sess) == SR_OK);
+		sr_session_destroy(sess);
+
+		for (i = 0; i < ARRAY_SIZE(dev_orders); i++) {
+			fail_unless(dev_orders[i].sdi != NULL,
+				"Device %u sent nothing (threading %d).",
+				i, threadings[t]);
+			fail_unless(dev_orders[i].packets > 2,
+				"Device %u sent no data (threading %d).",
+				i, threadings[t]);
+			fail_unless(dev_orders[i].first_type == SR_DF_HEADER);
+			fail_unless(dev_orders[i].last_type == SR_DF_END);
+			fail_unless(sr_dev_inst_start_time_get(sdi[i],
+				NULL, NULL) == SR_OK);
+		}
+	}
+}
+END_TEST
+
+/*
+ * Check whether a device which was started concurrently with a device
+ * which can't start is stopped again, so that it doesn't send any data
+ * past its SR_DF_END.
+ */
+START_TEST(test_session_parallel_start_fail)
+{
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi[2];
+	struct sr_session *sess;
+	unsigned int i;
+
+	memset(dev_orders, 0, sizeof(dev_orders));
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	sr_session_new(srtest_ctx, &sess);
+	for (i = 0; i < ARRAY_SIZE(sdi); i++) {
+		sdi[i] = srtest_demo_dev_new(driver, 8, 0);
+		sr_config_set(sdi[i], NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(10000));
+		sr_session_dev_add(sess, sdi[i]);
+	}
+	/* A closed device can't start. */
+	fail_unless(sr_dev_close(sdi[1]) == SR_OK);
+
+	sr_session_datafeed_callback_add(sess, datafeed_order, NULL);
+	fail_unless(sr_session_threading_set(sess,
+		SR_SESSION_THREADING_DEVICE) == SR_OK);
+	fail_unless(sr_session_parallel_start_set(sess, TRUE) == SR_OK);
+
+	fail_unless(sr_session_start(sess) != SR_OK);
+	fail_unless(sr_session_run(sess) != SR_OK, "The session runs.");
+	for (i = 0; i < ARRAY_SIZE(dev_orders); i++) {
+		if (!dev_orders[i].sdi)
+			continue;
+		fail_unless(dev_orders[i].sdi == sdi[0],
+			"The closed device sent data.");
+		fail_unless(dev_orders[i].first_type == SR_DF_HEADER);
+		fail_unless(dev_orders[i].last_type == SR_DF_END,
+			"The started device wasn't stopped.");
+	}
+	sr_session_destroy(sess);
+}
+END_TEST
+
+static GSList *retained;
+
+static void datafeed_retain(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct sr_datafeed_packet *ref1, *ref2;
+
+	(void)sdi;
+	(void)cb_data;
+
+	fail_unless(sr_packet_ref(packet, &ref1) == SR_OK);
+	fail_unless(sr_packet_ref(packet, &ref2) == SR_OK);
+	/* Both consumers share one retained packet. */
+	fail_unless(ref1 == ref2);
+	fail_unless(ref1->type == packet->type);
+	sr_packet_unref(ref2);
+	retained = g_slist_append(retained, ref1);
+}
+
+/* Check whether packets retained in a callback stay valid afterwards. */
+START_TEST(test_session_packet_ref)
+{
+	int ret;
+	struct sr_session *sess;
+	struct sr_input *in;
+	struct sr_datafeed_packet *packet;
+	const struct sr_datafeed_logic *logic;
+	GString *buf, *data;
+	GSList *l;
+
+	retained = NULL;
+	in = sr_input_new(sr_input_find("binary"), NULL);
+	fail_unless(in != NULL);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_datafeed_callback_add(sess, datafeed_retain, NULL);
+	sr_session_dev_add(sess, sr_input_dev_inst_get(in));
+
+	buf = g_string_new("Hello world");
+	ret = sr_input_send(in, buf);
+	fail_unless(ret == SR_OK, "sr_input_send() error: %d", ret);
+	ret = sr_input_end(in);
+	fail_unless(ret == SR_OK, "sr_input_end() error: %d", ret);
+	sr_session_destroy(sess);
+	sr_input_free(in);
+
+	data = g_string_new(NULL);
+	for (l = retained; l; l = l->next) {
+		packet = l->data;
+		if (packet->type == SR_DF_LOGIC) {
+			logic = packet->payload;
+			g_string_append_len(data, logic->data, logic->length);
+		}
+		sr_packet_unref(packet);
+	}
+	g_slist_free(retained);
+
+	fail_unless(!strcmp(data->str, buf->str),
+		"Expected '%s', got '%s'.", buf->str, data->str);
+
+	g_string_free(data, TRUE);
+	g_string_free(buf, TRUE);
+}
+END_TEST
+
+/* Check whether retaining a packet outside a callback copies the samples. */
+START_TEST(test_session_packet_ref_copy)
+{
+	uint8_t samples[] = { 0x01, 0x02, 0x03, 0x04 };
+	struct sr_datafeed_logic logic;
+	struct sr_datafeed_packet packet, *ref;
+	const struct sr_datafeed_logic *logic_ref;
+
+	logic.length = sizeof(samples);
+	logic.unitsize = 1;
+	logic.data = samples;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+
+	fail_unless(sr_packet_ref(&packet, &ref) == SR_OK);
+	logic_ref = ref->payload;
+	fail_unless(logic_ref->data != samples);
+	fail_unless(logic_ref->length == sizeof(samples));
+	fail_unless(!memcmp(logic_ref->data, samples, sizeof(samples)));
+	sr_packet_unref(ref);
+
+	fail_unless(sr_packet_ref(NULL, &ref) == SR_ERR_ARG);
+	fail_unless(sr_packet_ref(&packet, NULL) == SR_ERR_ARG);
+	sr_packet_unref(NULL);
+}
+END_TEST
+
+/* Write a session file of 3 Mi samples of 2 bytes, in chunks of 4 and 2 MiB. */
+static char *write_session_file(unsigned int level, gboolean overview)
+{
+	const struct sr_output *o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	struct sr_dev_inst *sdi;
+	GHashTable *opts;
+	GString *out;
+	uint8_t *data;
+	char *filename;
+	size_t size, k;
+	int fd, i;
+
+	sdi = sr_dev_inst_user_new("Vendor", "Model", "Version");
+	for (i = 0; i < 16; i++)
+		sr_dev_inst_channel_add(sdi, i, SR_CHANNEL_LOGIC, "D");
+
+	fd = g_file_open_tmp("reader-XXXXXX.sr", &filename, NULL);
+	fail_unless(fd >= 0, "Failed to create a temporary file.");
+	close(fd);
+
+	opts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+			(GDestroyNotify)g_variant_unref);
+	g_hash_table_insert(opts, "level",
+			g_variant_ref_sink(g_variant_new_uint32(level)));
+	g_hash_table_insert(opts, "threads",
+			g_variant_ref_sink(g_variant_new_uint32(0)));
+	g_hash_table_insert(opts, "overview",
+			g_variant_ref_sink(g_variant_new_boolean(overview)));
+	o = sr_output_new(sr_output_find("srzip"), opts, sdi, filename);
+	g_hash_table_destroy(opts);
+	fail_unless(o != NULL, "Failed to create srzip output.");
+
+	size = 1024 * 1024;
+	data = g_malloc(size);
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = size;
+	logic.unitsize = 2;
+	logic.data = data;
+	for (i = 0; i < 6; i++) {
+		for (k = 0; k < size; k++)
+			data[k] = (i * size + k) / 5;
+		fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	}
+	g_free(data);
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	fail_unless(sr_output_send(o, &packet, &out) == SR_OK);
+	sr_output_free(o);
+
+	return filename;
+}
+
+/* Check ranged reads and direct access to stored and compressed chunks. */
+static void check_session_reader(unsigned int level)
+{
+	struct sr_session_reader *reader;
+	const uint8_t *data;
+	uint8_t *buf;
+	uint64_t start, count, k, n;
+	char *filename;
+	int ret;
+
+	filename = write_session_file(level, FALSE);
+	ret = sr_session_reader_open(filename, &reader);
+	fail_unless(ret == SR_OK, "sr_session_reader_open() error: %d", ret);
+	fail_unless(sr_session_reader_unitsize_get(reader) == 2);
+	fail_unless(sr_session_reader_overview_levels_get(reader) == 0);
+	fail_unless(sr_session_reader_analog_channels_get(reader) == 0);
+	n = sr_session_reader_logic_samples_get(reader);
+	fail_unless(n == 3 * 1024 * 1024, "Wrong sample count %d.", (int)n);
+
+	/* Cross the boundary between the first and second chunk. */
+	start = 2 * 1024 * 1024 - 1000;
+	count = 5000;
+	buf = g_malloc(count * 2);
+	ret = sr_session_reader_logic_read(reader, start, count, buf);
+	fail_unless(ret == SR_OK, "sr_session_reader_logic_read() error: %d", ret);
+	for (k = 0; k < count * 2; k++)
+		fail_unless(buf[k] == (uint8_t)((start * 2 + k) / 5),
+			"Wrong data at sample %d.", (int)(start + k / 2));
+
+	/* Past the end. */
+	fail_unless(sr_session_reader_logic_read(reader, n - 1, 2, buf) == SR_ERR_ARG);
+	g_free(buf);
+
+	/* Direct access ends at the chunk boundary. */
+	ret = sr_session_reader_logic_map(reader, n - 10, &data, &count);
+	fail_unless(ret == SR_OK, "sr_session_reader_logic_map() error: %d", ret);
+	fail_unless(count == 10);
+	fail_unless(data[19] == (uint8_t)((n * 2 - 1) / 5));
+	ret = sr_session_reader_logic_map(reader, n, &data, &count);
+	fail_unless(ret == SR_OK && count == 0);
+
+	sr_session_reader_close(reader);
+	g_unlink(filename);
+	g_free(filename);
+}
+
+START_TEST(test_session_reader)
+{
+	check_session_reader(0);
+	check_session_reader(6);
+}
+END_TEST
+
+/* Check the overview records against the samples they summarize. */
+START_TEST(test_session_reader_overview)
+{
+	struct sr_session_reader *reader;
+	uint8_t *buf, rec[4], and[2], or[2];
+	uint64_t block_size, n, start, k;
+	unsigned int level, num_levels, i;
+	char *filename;
+	int ret;
+
+	filename = write_session_file(1, TRUE);
+	ret = sr_session_reader_open(filename, &reader);
+	fail_unless(ret == SR_OK, "sr_session_reader_open() error: %d", ret);
+	num_levels = sr_session_reader_overview_levels_get(reader);
+	fail_unless(num_levels > 0, "No overview found.");
+	n = sr_session_reader_logic_samples_get(reader);
+
+	for (level = 0; level < num_levels; level++) {
+		block_size = sr_session_reader_overview_block_size_get(reader, level);
+		fail_unless(block_size > 0);
+		/* The first block, and the last one which may be partial. */
+		for (start = 0; start < n; start += ((n - 1) / block_size) * block_size) {
+			ret = sr_session_reader_logic_overview_read(reader, level,
+					start / block_size, 1, rec);
+			fail_unless(ret == SR_OK,
+				"sr_session_reader_logic_overview_read() error: %d", ret);
+			k = MIN(block_size, n - start);
+			buf = g_malloc(k * 2);
+			ret = sr_session_reader_logic_read(reader, start, k, buf);
+			fail_unless(ret == SR_OK);
+			and[0] = and[1] = 0xff;
+			or[0] = or[1] = 0;
+			while (k--) {
+				for (i = 0; i < 2; i++) {
+					and[i] &= buf[k * 2 + i];
+					or[i] |= buf[k * 2 + i];
+				}
+			}
+			g_free(buf);
+			fail_unless(!memcmp(rec, and, 2) && !memcmp(rec + 2, or, 2),
+				"Wrong overview at level %u, sample %d.",
+				level, (int)start);
+			if (n <= block_size)
+				break;
+		}
+		/* Past the end. */
+		ret = sr_session_reader_logic_overview_read(reader, level,
+				(n + block_size - 1) / block_size, 1, rec);
+		fail_unless(ret == SR_ERR_ARG);
+	}
+	fail_unless(sr_session_reader_overview_block_size_get(reader,
+			num_levels) == 0);
+
+	sr_session_reader_close(reader);
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+START_TEST(test_session_reader_bogus)
+{
+	struct sr_session_reader *reader;
+
+	fail_unless(sr_session_reader_open(NULL, &reader) == SR_ERR_ARG);
+	fail_unless(sr_session_reader_open("/nonexistent.sr", &reader) != SR_OK);
+	fail_unless(sr_session_reader_open("/nonexistent.sr", NULL) == SR_ERR_ARG);
+	fail_unless(sr_session_reader_close(NULL) == SR_OK);
+}
+END_TEST
+
 Suite *suite_session(void)
 {
 	Suite *s;
@@ -209,5 +1167,31 @@ Suite *suite_session(void)
 	tcase_add_test(tc, test_session_trigger_get_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("datafeed");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_datafeed_async);
+	tcase_add_test(tc, test_session_datafeed_async_remove);
+	tcase_add_test(tc, test_session_datafeed_async_bogus);
+	tcase_add_test(tc, test_session_packet_ref);
+	tcase_add_test(tc, test_session_packet_ref_copy);
+	tcase_add_test(tc, test_session_coalesce);
+	tcase_add_test(tc, test_session_coalesce_analog);
+	tcase_add_test(tc, test_session_coalesce_latency);
+	tcase_add_test(tc, test_session_coalesce_passthrough);
+	tcase_add_test(tc, test_session_coalesce_reentrant);
+	tcase_add_test(tc, test_session_threading_set);
+	tcase_add_test(tc, test_session_threading_order);
+	tcase_add_test(tc, test_session_parallel_start);
+	tcase_add_test(tc, test_session_parallel_start_data);
+	tcase_add_test(tc, test_session_parallel_start_fail);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("reader");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_session_reader);
+	tcase_add_test(tc, test_session_reader_overview);
+	tcase_add_test(tc, test_session_reader_bogus);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
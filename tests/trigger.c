@@ -20,6 +20,7 @@
 #include <config.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
 #include <check.h>
 #include <libsigrok/libsigrok.h>
 #include "lib.h"
@@ -249,6 +250,99 @@ START_TEST(test_trigger_match_add_bogus)
 }
 END_TEST
 
+static int analog_triggers;
+static gboolean analog_trigger_early;
+static uint64_t analog_trigger_samples;
+static float analog_trigger_first;
+
+static void datafeed_analog_trigger(const struct sr_dev_inst *sdi,
+	const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_analog *analog;
+	float *values;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_TRIGGER) {
+		analog_triggers++;
+		analog_trigger_early = analog_trigger_samples == 0;
+		return;
+	}
+	if (packet->type != SR_DF_ANALOG)
+		return;
+
+	analog = packet->payload;
+	if (analog_trigger_samples == 0 && analog->num_samples > 0) {
+		values = g_malloc(analog->num_samples * sizeof(float));
+		fail_unless(sr_analog_to_float(analog, values) == SR_OK);
+		analog_trigger_first = values[0];
+		g_free(values);
+	}
+	analog_trigger_samples += analog->num_samples;
+}
+
+/*
+ * Check that the demo driver's analog soft trigger sends SR_DF_TRIGGER
+ * before any data, and drops the samples before the rising edge.
+ */
+START_TEST(test_trigger_demo_analog)
+{
+	int ret;
+	struct sr_dev_driver *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_session *sess;
+	struct sr_trigger *t;
+	struct sr_trigger_stage *stage;
+	struct sr_channel *ch;
+
+	analog_triggers = 0;
+	analog_trigger_early = FALSE;
+	analog_trigger_samples = 0;
+	analog_trigger_first = 0;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(srtest_ctx, driver);
+	sdi = srtest_demo_dev_new(driver, 0, 1);
+	ch = sr_dev_inst_channels_get(sdi)->data;
+	fail_unless(ch->type == SR_CHANNEL_ANALOG);
+
+	ret = sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+			g_variant_new_uint64(SR_MHZ(1)));
+	fail_unless(ret == SR_OK);
+	ret = sr_config_set(sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+			g_variant_new_uint64(1000));
+	fail_unless(ret == SR_OK);
+
+	t = sr_trigger_new(NULL);
+	stage = sr_trigger_stage_add(t);
+	ret = sr_trigger_match_add(stage, ch, SR_TRIGGER_RISING, 0);
+	fail_unless(ret == SR_OK);
+
+	sr_session_new(srtest_ctx, &sess);
+	sr_session_dev_add(sess, sdi);
+	sr_session_trigger_set(sess, t);
+	sr_session_datafeed_callback_add(sess, datafeed_analog_trigger, NULL);
+
+	ret = sr_session_start(sess);
+	fail_unless(ret == SR_OK, "sr_session_start() failed: %d.", ret);
+	ret = sr_session_run(sess);
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+
+	sr_session_destroy(sess);
+	sr_trigger_free(t);
+
+	fail_unless(analog_triggers == 1, "%d triggers.", analog_triggers);
+	fail_unless(analog_trigger_early, "No trigger before the data.");
+	fail_unless(analog_trigger_samples == 1000,
+		"Expected 1000 samples, got %" PRIu64 ".",
+		analog_trigger_samples);
+	/* The square wave starts low, the first sample sent is high. */
+	fail_unless(analog_trigger_first > 0,
+		"First sample %f is before the edge.", analog_trigger_first);
+}
+END_TEST
+
 Suite *suite_trigger(void)
 {
 	Suite *s;
@@ -276,5 +370,10 @@ Suite *suite_trigger(void)
 	tcase_add_test(tc, test_trigger_match_add_bogus);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("soft");
+	tcase_add_checked_fixture(tc, srtest_setup, srtest_teardown);
+	tcase_add_test(tc, test_trigger_demo_analog);
+	suite_add_tcase(s, tc);
+
 	return s;
 }